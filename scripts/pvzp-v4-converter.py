@@ -50,7 +50,17 @@ from typing import Any, Optional, Type
 
 SAVE_MAGIC = b"PVZP_SAVE4\x00\x00"  # 12 bytes with null padding
 SAVE_VERSION = 1
+SAVE_VERSION_COMPRESSED = 2  # header is followed by codec(4) + rawSize(4)
+SAVE_VERSION_DELTA = 3  # like version 2; the payload starts with a DELTA_BASE chunk
 HEADER_SIZE = 24  # magic(12) + version(4) + payloadSize(4) + payloadCrc(4)
+CODEC_HEADER_SIZE = 8
+MAX_RAW_PAYLOAD_SIZE = 64 << 20
+
+# Payload codecs, matching SaveGameCodec in SaveGame.h
+CODEC_NONE = 0
+CODEC_LZ4 = 1
+CODEC_ZLIB = 2
+CODEC_NAMES = {CODEC_NONE: "none", CODEC_LZ4: "lz4", CODEC_ZLIB: "zlib"}
 
 # Board constants from Board.h
 MAX_ZOMBIE_WAVES = 100
@@ -84,6 +94,7 @@ class ChunkType(IntEnum):
     SEEDPACKETS = 18
     CHALLENGE = 19
     MUSIC = 20
+    DELTA_BASE = 21  # delta saves only: which chunks come from <save>.base0/.base1
 
 
 # Chunks that we parse into human-readable format
@@ -1585,6 +1596,162 @@ def write_object_array(header_dict: dict, objects: list, tail_writer) -> bytes:
     return write_data_array_tlv(header, items)
 
 
+# ============================================================================
+# Payload Compression
+# ============================================================================
+
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5
+LZ4_MF_LIMIT = 12
+LZ4_MAX_OFFSET = 65535
+LZ4_HASH_LOG = 12
+
+
+def _lz4_hash(value: int) -> int:
+    return ((value * 2654435761) & 0xFFFFFFFF) >> (32 - LZ4_HASH_LOG)
+
+
+def _lz4_write_length(out: bytearray, length: int):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def lz4_compress(src: bytes) -> bytes:
+    """LZ4 block compression, producing the same bytes as the game's encoder (misc/LZ4Block.cpp).
+
+    Both hash the next four bytes read as little-endian, so the output does not depend on the host's byte order.
+    """
+    out = bytearray()
+    size = len(src)
+    anchor = 0
+
+    if size > LZ4_MF_LIMIT:
+        table = [-1] * (1 << LZ4_HASH_LOG)
+        match_start_limit = size - LZ4_MF_LIMIT
+        match_end_limit = size - LZ4_LAST_LITERALS
+        pos = 0
+        while pos < match_start_limit:
+            sequence = int.from_bytes(src[pos:pos + 4], "little")
+            h = _lz4_hash(sequence)
+            ref = table[h]
+            table[h] = pos
+            if ref < 0 or pos - ref > LZ4_MAX_OFFSET or src[ref:ref + 4] != src[pos:pos + 4]:
+                pos += 1
+                continue
+
+            while pos > anchor and ref > 0 and src[pos - 1] == src[ref - 1]:
+                pos -= 1
+                ref -= 1
+            match_len = LZ4_MIN_MATCH
+            while pos + match_len < match_end_limit and src[pos + match_len] == src[ref + match_len]:
+                match_len += 1
+
+            literal_len = pos - anchor
+            token_index = len(out)
+            out.append((min(literal_len, 15)) << 4)
+            if literal_len >= 15:
+                _lz4_write_length(out, literal_len - 15)
+            out += src[anchor:pos]
+
+            offset = pos - ref
+            out += struct.pack("<H", offset)
+
+            len_code = match_len - LZ4_MIN_MATCH
+            out[token_index] |= min(len_code, 15)
+            if len_code >= 15:
+                _lz4_write_length(out, len_code - 15)
+
+            pos += match_len
+            anchor = pos
+            if 0 < pos - 2 < match_start_limit:
+                table[_lz4_hash(int.from_bytes(src[pos - 2:pos + 2], "little"))] = pos - 2
+
+    literal_len = size - anchor
+    out.append(min(literal_len, 15) << 4)
+    if literal_len >= 15:
+        _lz4_write_length(out, literal_len - 15)
+    out += src[anchor:]
+    return bytes(out)
+
+
+def lz4_decompress(src: bytes, raw_size: int) -> bytes:
+    """LZ4 block decompression into exactly raw_size bytes."""
+    out = bytearray()
+    pos = 0
+    end = len(src)
+
+    def read_length(length: int) -> int:
+        nonlocal pos
+        if length == 15:
+            while True:
+                if pos >= end:
+                    raise ValueError("Truncated LZ4 length")
+                b = src[pos]
+                pos += 1
+                length += b
+                if b != 255:
+                    break
+        return length
+
+    while pos < end:
+        token = src[pos]
+        pos += 1
+        literal_len = read_length(token >> 4)
+        if pos + literal_len > end or len(out) + literal_len > raw_size:
+            raise ValueError("LZ4 literal run out of bounds")
+        out += src[pos:pos + literal_len]
+        pos += literal_len
+        if pos == end:
+            break
+
+        if end - pos < 2:
+            raise ValueError("Truncated LZ4 offset")
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        if offset == 0 or offset > len(out):
+            raise ValueError("Invalid LZ4 offset")
+        match_len = read_length(token & 15) + LZ4_MIN_MATCH
+        if len(out) + match_len > raw_size:
+            raise ValueError("LZ4 match out of bounds")
+        start = len(out) - offset
+        for i in range(match_len):  # overlapping copies repeat the pattern
+            out.append(out[start + i])
+
+    if len(out) != raw_size:
+        raise ValueError(f"LZ4 payload size mismatch: expected {raw_size}, got {len(out)}")
+    return bytes(out)
+
+
+def compress_payload(codec: int, payload: bytes) -> bytes:
+    if codec == CODEC_LZ4:
+        return lz4_compress(payload)
+    if codec == CODEC_ZLIB:
+        return zlib.compress(payload)
+    raise ValueError(f"Unknown payload codec {codec}")
+
+
+def decompress_payload(codec: int, stored: bytes, raw_size: int) -> bytes:
+    if raw_size > MAX_RAW_PAYLOAD_SIZE:
+        raise ValueError(f"Payload too large: {raw_size} bytes")
+    if codec == CODEC_LZ4:
+        return lz4_decompress(stored, raw_size)
+    if codec == CODEC_ZLIB:
+        payload = zlib.decompress(stored)
+        if len(payload) != raw_size:
+            raise ValueError(f"zlib payload size mismatch: expected {raw_size}, got {len(payload)}")
+        return payload
+    raise ValueError(f"Unknown payload codec {codec}")
+
+
+def codec_from_name(name: str) -> int:
+    for codec, codec_name in CODEC_NAMES.items():
+        if codec_name == name:
+            return codec
+    raise ValueError(f"Unknown codec '{name}', expected one of: {', '.join(CODEC_NAMES.values())}")
+
+
 # ============================================================================
 # Main Save File Structure
 # ============================================================================
@@ -1593,6 +1760,7 @@ def write_object_array(header_dict: dict, objects: list, tail_writer) -> bytes:
 class SaveFile:
     """Represents a parsed v4 save file."""
     version: int = SAVE_VERSION
+    codec: int = CODEC_NONE  # payload compression, see CODEC_NAMES
     chunk_order: list = field(default_factory=list)  # Preserve original order
     
     # Parsed readable chunks
@@ -1613,8 +1781,89 @@ class SaveFile:
     binary_chunks: dict = field(default_factory=dict)
 
 
-def parse_save_file(data: bytes) -> SaveFile:
-    """Parse a v4 save file."""
+def decode_save_payload(data: bytes) -> tuple[int, int, bytes]:
+    """Check the header of a v4 save and return (version, codec, raw payload)."""
+    version = struct.unpack("<I", data[12:16])[0]
+    if version not in (SAVE_VERSION, SAVE_VERSION_COMPRESSED, SAVE_VERSION_DELTA):
+        print(f"Warning: File header says version {version}, but script expects version {SAVE_VERSION}, {SAVE_VERSION_COMPRESSED} or {SAVE_VERSION_DELTA}.")
+        print("Proceeding anyway, but errors may occur.")
+    
+    payload_size = struct.unpack("<I", data[16:20])[0]
+    stored_crc = struct.unpack("<I", data[20:24])[0]
+    
+    # Compressed files: codec(4) + rawSize(4) follow the header, and the CRC covers the stored bytes
+    codec = CODEC_NONE
+    payload_offset = HEADER_SIZE
+    if version in (SAVE_VERSION_COMPRESSED, SAVE_VERSION_DELTA):
+        if len(data) < HEADER_SIZE + CODEC_HEADER_SIZE:
+            raise ValueError("Compressed save file is missing its codec header")
+        codec, raw_size = struct.unpack("<II", data[HEADER_SIZE:HEADER_SIZE + CODEC_HEADER_SIZE])
+        payload_offset += CODEC_HEADER_SIZE
+    
+    payload = data[payload_offset:payload_offset + payload_size]
+    calculated_crc = zlib.crc32(payload) & 0xFFFFFFFF
+    if stored_crc != calculated_crc:
+        raise ValueError(f"CRC mismatch: stored {stored_crc:08x}, calculated {calculated_crc:08x}")
+    if codec != CODEC_NONE:
+        payload = decompress_payload(codec, payload, raw_size)
+    return version, codec, payload
+
+
+def split_chunks(payload: bytes) -> list[tuple[int, bytes]]:
+    """Split a raw payload into (chunk type, chunk data) pairs."""
+    chunks = []
+    reader = BinaryReader(payload)
+    while reader.remaining >= 8:
+        chunk_type = reader.read_u32()
+        chunk_size = reader.read_u32()
+        if reader.remaining < chunk_size:
+            break
+        chunks.append((chunk_type, reader.read_bytes(chunk_size)))
+    return chunks
+
+
+def resolve_delta_payload(payload: bytes, save_path: Path) -> bytes:
+    """Rebuild the full payload of a delta save from its inline chunks and its base file."""
+    chunks = split_chunks(payload)
+    if not chunks or chunks[0][0] != ChunkType.DELTA_BASE:
+        raise ValueError("Delta save does not start with a DELTA_BASE chunk")
+
+    table = BinaryReader(chunks[0][1])
+    base_index = table.read_u32()
+    base_crc = table.read_u32()
+    count = table.read_u32()
+
+    base_path = save_path.with_name(save_path.name + f".base{base_index}")
+    if not base_path.exists():
+        raise ValueError(f"Base file not found: {base_path}")
+    base_data = base_path.read_bytes()
+    if not base_data.startswith(b"PVZP_SAVE4"):
+        raise ValueError(f"Base file is not a v4 save: {base_path}")
+    _, _, base_payload = decode_save_payload(base_data)
+    if zlib.crc32(base_payload) & 0xFFFFFFFF != base_crc:
+        raise ValueError(f"Base file {base_path} does not belong to this save")
+    base_chunks = dict(split_chunks(base_payload))
+
+    writer = BinaryWriter()
+    inline = iter(chunks[1:])
+    for _ in range(count):
+        chunk_type, size, crc, in_base = (table.read_u32() for _ in range(4))
+        if in_base:
+            chunk_data = base_chunks.get(chunk_type)
+        else:
+            inline_type, chunk_data = next(inline, (None, None))
+            if inline_type != chunk_type:
+                chunk_data = None
+        if chunk_data is None or len(chunk_data) != size or zlib.crc32(chunk_data) & 0xFFFFFFFF != crc:
+            raise ValueError(f"Delta save chunk {enum_name(ChunkType, chunk_type)} does not match")
+        writer.write_u32(chunk_type)
+        writer.write_u32(len(chunk_data))
+        writer.write_bytes(chunk_data)
+    return writer.get_bytes()
+
+
+def parse_save_file(data: bytes, save_path: Optional[Path] = None) -> SaveFile:
+    """Parse a v4 save file; delta saves also read their base file next to save_path."""
     if len(data) < HEADER_SIZE:
         print(f"Error: File is too small ({len(data)} bytes). Expected at least {HEADER_SIZE} bytes.")
         print("This does not appear to be a valid PvZ-Portable save file.")
@@ -1644,21 +1893,15 @@ def parse_save_file(data: bytes) -> SaveFile:
             print(f"Error: Invalid magic: {magic!r}")
         sys.exit(1)
     
-    version = struct.unpack("<I", data[12:16])[0]
-    if version != SAVE_VERSION:
-        print(f"Warning: File header says version {version}, but script expects version {SAVE_VERSION}.")
-        print("Proceeding anyway, but errors may occur.")
-    
-    payload_size = struct.unpack("<I", data[16:20])[0]
-    stored_crc = struct.unpack("<I", data[20:24])[0]
-    
-    payload = data[24:24 + payload_size]
-    calculated_crc = zlib.crc32(payload) & 0xFFFFFFFF
-    if stored_crc != calculated_crc:
-        raise ValueError(f"CRC mismatch: stored {stored_crc:08x}, calculated {calculated_crc:08x}")
+    version, codec, payload = decode_save_payload(data)
+    if version == SAVE_VERSION_DELTA:
+        if save_path is None:
+            raise ValueError("Delta save needs its file path to find the base file")
+        payload = resolve_delta_payload(payload, save_path)
+        version = SAVE_VERSION
     
     # Parse chunks
-    save = SaveFile(version=version)
+    save = SaveFile(version=SAVE_VERSION if version == SAVE_VERSION_COMPRESSED else version, codec=codec)
     reader = BinaryReader(payload)
     
     while reader.remaining >= 8:
@@ -1784,14 +2027,25 @@ def write_save_file(save: SaveFile) -> bytes:
             payload.write_bytes(chunk_data)
     
     payload_bytes = payload.get_bytes()
+    
+    # Like the game, fall back to an uncompressed file when compression does not shrink the payload
+    version = save.version
+    codec_header = b""
+    if save.codec != CODEC_NONE:
+        compressed = compress_payload(save.codec, payload_bytes)
+        if len(compressed) + CODEC_HEADER_SIZE < len(payload_bytes):
+            codec_header = struct.pack("<II", save.codec, len(payload_bytes))
+            version = SAVE_VERSION_COMPRESSED
+            payload_bytes = compressed
     payload_crc = zlib.crc32(payload_bytes) & 0xFFFFFFFF
     
     # Build file
     result = BinaryWriter()
     result.write_bytes(SAVE_MAGIC)
-    result.write_u32(save.version)
+    result.write_u32(version)
     result.write_u32(len(payload_bytes))
     result.write_u32(payload_crc)
+    result.write_bytes(codec_header)
     result.write_bytes(payload_bytes)
     
     return result.get_bytes()
@@ -1806,6 +2060,7 @@ def export_to_yaml(save: SaveFile) -> str:
     output = {
         "_format": "PvZ-Portable Save v4",
         "_version": save.version,
+        "_codec": CODEC_NAMES.get(save.codec, "none"),
         "_chunk_order": save.chunk_order,
         "board": save.board,
         "zombies_header": save.zombies_header,
@@ -1831,6 +2086,7 @@ def import_from_yaml(yaml_str: str) -> SaveFile:
     
     save = SaveFile(
         version=data.get("_version", SAVE_VERSION),
+        codec=codec_from_name(data.get("_codec", "none")),
         chunk_order=data.get("_chunk_order", []),
         board=data.get("board", {}),
         zombies_header=data.get("zombies_header", {}),
@@ -1860,6 +2116,7 @@ def export_to_text(save: SaveFile) -> str:
     lines.append("=" * 60)
     lines.append("PvZ-Portable Mid-Level Save File (v4 Format)")
     lines.append("=" * 60)
+    lines.append(f"  Compression: {CODEC_NAMES.get(save.codec, 'unknown')}")
     lines.append("")
     
     # Board info
@@ -1996,7 +2253,7 @@ def cmd_info(args):
     
     try:
         data = save_path.read_bytes()
-        save = parse_save_file(data)
+        save = parse_save_file(data, save_path)
         print(export_to_text(save))
         return 0
     except Exception as e:
@@ -2015,7 +2272,7 @@ def cmd_export(args):
     
     try:
         data = save_path.read_bytes()
-        save = parse_save_file(data)
+        save = parse_save_file(data, save_path)
         
         output = export_to_yaml(save)
         output_path.write_text(output, encoding="utf-8")
@@ -2038,6 +2295,8 @@ def cmd_import(args):
     try:
         yaml_str = yaml_path.read_text(encoding="utf-8")
         save = import_from_yaml(yaml_str)
+        if args.codec is not None:
+            save.codec = codec_from_name(args.codec)
         data = write_save_file(save)
         output_path.write_bytes(data)
         print(f"Imported to: {output_path}")
@@ -2061,6 +2320,7 @@ Examples:
   %(prog)s export game1.v4 game1.yaml      Export to YAML format (lossless)
   %(prog)s export --expand-waves game1.v4 game1.yaml  Export with expanded wave data
   %(prog)s import game1.yaml game1_new.v4  Import YAML back to v4 format
+  %(prog)s import --codec lz4 game1.yaml game1_new.v4  Import with an LZ4-compressed payload
 
 This converter is LOSSLESS - the YAML contains all data needed to
 recreate an identical v4 save file. Human-readable fields can be
@@ -2086,6 +2346,8 @@ edited, while complex binary data is preserved as base64.
     import_parser = subparsers.add_parser("import", help="Import YAML and generate v4 save")
     import_parser.add_argument("input", help="Input YAML file")
     import_parser.add_argument("output", help="Output v4 save file")
+    import_parser.add_argument("--codec", choices=list(CODEC_NAMES.values()),
+                               help="Payload compression (default: same as the exported save)")
     import_parser.set_defaults(func=cmd_import)
     
     args = parser.parse_args()
@@ -5,6 +5,7 @@
 #include "BoardInclude.h"
 #include "System/Music.h"
 #include "System/SaveGame.h"
+#include "System/BoardSnapshot.h"
 #include "Widget/LawnDialog.h"
 #include "System/PlayerInfo.h"
 #include "System/PoolEffect.h"
@@ -25,6 +26,8 @@
 #include "../Sexy.TodLib/EffectSystem.h"
 #include "../Sexy.TodLib/TodStringFile.h"
 #include "graphics/ImageFont.h"
+#include "graphics/GLImage.h"
+#include "graphics/GLInterface.h"
 #include "sound/SoundManager.h"
 #include "widget/ButtonWidget.h"
 #include "widget/WidgetManager.h"
@@ -122,7 +125,7 @@ Board::Board(LawnApp* theApp)
 	mIntervalDrawTime = 0;
 	mIntervalDrawCountStart = 0;
 	mPreloadTime = 0;
-	mGameID = time(0);
+	mGameID = mApp->GetWallTime();
 	mMinFPS = 1000.0f;
 	mGravesCleared = 0;
 	mPlantsEaten = 0;
@@ -158,6 +161,10 @@ Board::Board(LawnApp* theApp)
 	//mDebugFont = new SysFont("Arial Unicode MS", 10, true, false, false);
 	mAdvice = new MessageWidget(mApp);
 	mBackground = BackgroundType::BACKGROUND_1_DAY;
+	mBackdropCache = nullptr;
+	mBackdropCacheFailed = false;
+	mDebugSnapshot = nullptr;
+	InvalidateBackdropCache();
 	mMainCounter = 0;
 	mTutorialState = TutorialState::TUTORIAL_OFF;
 	mTutorialTimer = -1;
@@ -211,6 +218,8 @@ Board::Board(LawnApp* theApp)
 //0x408670 and 0x408690
 Board::~Board()
 {
+	delete mBackdropCache;
+	delete mDebugSnapshot;
 	delete mAdvice;
 	delete mCursorObject;
 	delete mCursorPreview;
@@ -337,8 +346,16 @@ void Board::TryToSaveGame()
 
 		MkDir(GetAppDataPath("userdata"));
 		mApp->mMusic->GameMusicPause(true);
-		LawnSaveGame(this, aFileName);
-		LawnSaveGameLegacy(this, GetLegacySavedGameName(mApp->mGameMode, mApp->mPlayerInfo->mId));
+		// Once the .v4 save is on disk the legacy save is older than it; pvz-exportlegacy recreates it
+		LawnApp* anApp = mApp;
+		std::string aLegacyFileName = GetLegacySavedGameName(mApp->mGameMode, mApp->mPlayerInfo->mId);
+		LawnSaveGameAsync(this, aFileName, [anApp, aFileName, aLegacyFileName](bool theSuccess)
+		{
+			if (theSuccess)
+				anApp->EraseFile(aLegacyFileName);
+			else
+				TodTrace("Failed to save game %s", aFileName.c_str());
+		});
 		mApp->ClearUpdateBacklog();
 		SurvivalSaveScore();
 	}
@@ -359,7 +376,7 @@ bool Board::NeedSaveGame()
 void Board::SaveGame(const std::string& theFileName)
 { 
 	LawnSaveGame(this, theFileName);
-	LawnSaveGameLegacy(this, GetLegacySavedGameName(mApp->mGameMode, mApp->mPlayerInfo->mId));
+	mApp->EraseFile(GetLegacySavedGameName(mApp->mGameMode, mApp->mPlayerInfo->mId));
 }
 
 // GOTY @Patoke: 0x40B739
@@ -900,6 +917,7 @@ void Board::LoadBackgroundImages()
 
 	for (std::string& resource : mLoadedResourceNames)
 		TodLoadResources(resource.c_str());
+	InvalidateBackdropCache();
 }
 
 //0x40A550
@@ -6089,8 +6107,7 @@ void Board::DrawIce(Graphics* g, int theGridY)
 	g->SetColorizeImages(false);
 }
 
-//0x416290
-void Board::DrawBackdrop(Graphics* g)
+void Board::DrawBackdropImage(Graphics* g)
 {
 	Image* aBgImage = nullptr;
 	switch (mBackground)
@@ -6142,6 +6159,63 @@ void Board::DrawBackdrop(Graphics* g)
 			g->DrawImage(aBgImage, -BOARD_OFFSET, 0);
 		}
 	}
+}
+
+void Board::InvalidateBackdropCache()
+{
+	mBackdropCacheKey[0] = -1;
+}
+
+// The background image and sod strips only change with the level and the sod roll, so they are composited
+// once into an offscreen target spanning the whole backdrop and drawn with a single blit afterwards.
+// The target is in board space, so panning the board (CutScene::AnimateBoard) reuses it as is.
+bool Board::DrawBackdropCached(Graphics* g)
+{
+	if (mBackdropCacheFailed || !GLImage::Check3D(g->mDestImage))
+		return false;
+
+	int aKey[4] = { (int)mBackground, mLevel, (int)mApp->mGameMode, mSodPosition };
+	if (memcmp(aKey, mBackdropCacheKey, sizeof(aKey)) != 0)
+	{
+		// Don't recomposite every frame while the sod is being rolled out
+		if (mSodPosition > 0 && mSodPosition < 1000)
+			return false;
+
+		GLInterface* aGLInterface = mApp->mGLInterface;
+		if (mBackdropCache == nullptr)
+		{
+			mBackdropCache = new GLImage(aGLInterface);
+			mBackdropCache->mWidth = BOARD_IMAGE_WIDTH_OFFSET + BOARD_OFFSET;
+			mBackdropCache->mHeight = BOARD_HEIGHT;
+		}
+
+		if (!aGLInterface->BeginRenderTarget(mBackdropCache))
+		{
+			mBackdropCacheFailed = true;
+			delete mBackdropCache;
+			mBackdropCache = nullptr;
+			return false;
+		}
+
+		Graphics aCacheG(mBackdropCache);
+		aCacheG.Translate(BOARD_OFFSET, 0);
+		DrawBackdropImage(&aCacheG);
+		aGLInterface->EndRenderTarget();
+
+		memcpy(mBackdropCacheKey, aKey, sizeof(aKey));
+	}
+
+	g->DrawImage(mBackdropCache, -BOARD_OFFSET, 0);
+	return true;
+}
+
+//0x416290
+void Board::DrawBackdrop(Graphics* g)
+{
+	if (!DrawBackdropCached(g))
+	{
+		DrawBackdropImage(g);
+	}
 
 	if (mApp->mGameScene == GameScenes::SCENE_ZOMBIES_WON)
 	{
@@ -7322,6 +7396,19 @@ void Board::DrawDebugText(Graphics* g)
 		aText += StrFormat("COLLISION DEBUG\n");
 		break;
 
+	case DebugTextMode::DEBUG_TEXT_RENDER:
+	{
+		const RenderStats& aStats = mApp->mGLInterface->mLastFrameStats;
+		aText += StrFormat("RENDER DEBUG\n");
+		aText += StrFormat("draw calls %d\n", aStats.mDrawCalls);
+		aText += StrFormat("vertices %d\n", aStats.mVertices);
+		aText += StrFormat("texture binds %d\n", aStats.mTextureBinds);
+		aText += StrFormat("blend changes %d\n", aStats.mBlendChanges);
+		aText += StrFormat("texture uploads %d (%d KB)\n", aStats.mTextureUploads, (int)(aStats.mTextureUploadBytes / 1024));
+		aText += StrFormat("fbo switches %d\n", aStats.mFramebufferSwitches);
+		break;
+	}
+
 	default:
 		TOD_ASSERT(false);
 		break;
@@ -8340,7 +8427,7 @@ void Board::KeyChar(char theChar)
 	else if (theChar == 'z')
 	{
 		mDebugTextMode = static_cast<DebugTextMode>(static_cast<int>(mDebugTextMode) + 1);
-		if (mDebugTextMode > DebugTextMode::DEBUG_TEXT_COLLISION)
+		if (mDebugTextMode > DebugTextMode::DEBUG_TEXT_RENDER)
 		{
 			mDebugTextMode = DebugTextMode::DEBUG_TEXT_NONE;
 		}
@@ -8351,6 +8438,25 @@ void Board::KeyChar(char theChar)
 		return;
 	}
 
+	if (theChar == 'k')
+	{
+		if (mDebugSnapshot == nullptr)
+			mDebugSnapshot = new BoardSnapshot();
+		PerfTimer aTimer;
+		aTimer.Start();
+		mDebugSnapshot->Capture(this);
+		TodTrace("board snapshot captured: %zu bytes in %.3f ms", mDebugSnapshot->GetMemoryUsage(), aTimer.GetDuration());
+		return;
+	}
+	if (theChar == 'K')
+	{
+		PerfTimer aTimer;
+		aTimer.Start();
+		if (mDebugSnapshot && mDebugSnapshot->Restore(this))
+			TodTrace("board snapshot restored in %.3f ms", aTimer.GetDuration());
+		return;
+	}
+
 	Zombie* aBossZombie = GetBossZombie();
 	if (aBossZombie && !aBossZombie->IsDeadOrDying())
 	{
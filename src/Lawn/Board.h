@@ -33,6 +33,7 @@ class SeedBank;
 class ToolTipWidget;
 class CutScene;
 class Challenge;
+class BoardSnapshot;
 class Reanimation;
 class DataSync;
 class TodParticleSystem;
@@ -42,6 +43,7 @@ namespace Sexy
 	class ButtonWidget;
 	class WidgetManager;
 	class Image;
+	class GLImage;
 	class MTRand;
 }
 
@@ -224,6 +226,10 @@ public:
 	int								mDiamondsCollected;										//+0x57A4 GOTY @Patoke: 0x57CC
 	int								mPottedPlantsCollected;									//+0x57A8
 	int								mChocolateCollected;									//+0x57AC
+	GLImage*						mBackdropCache;
+	int								mBackdropCacheKey[4];
+	bool							mBackdropCacheFailed;
+	BoardSnapshot*					mDebugSnapshot;
 
 public:
 	Board(LawnApp* theApp);
@@ -265,6 +271,9 @@ public:
 	void							UpdateLayers();
 	virtual void					Draw(Graphics* g);
 	void							DrawBackdrop(Graphics* g);
+	void							DrawBackdropImage(Graphics* g);
+	bool							DrawBackdropCached(Graphics* g);
+	void							InvalidateBackdropCache();
 	virtual void					ButtonPress  	(int){}
 	virtual void					ButtonDepress	(int){}
 	virtual void					ButtonDownTick	(int){}
@@ -130,7 +130,7 @@ std::string GetLegacySavedGameName(GameMode theGameMode, int theProfileId)
 //0x456980
 int GetCurrentDaysSince2000()
 {
-    time_t aNow = time(0);
+    time_t aNow = static_cast<time_t>(gLawnApp->GetWallTime());
     tm aNowTM = *localtime(&aNow);
 
     int dy = aNowTM.tm_year - 100;
@@ -0,0 +1,232 @@
+#include "BoardSnapshot.h"
+#include "../Board.h"
+#include "../Challenge.h"
+#include "../SeedPacket.h"
+#include "../../LawnApp.h"
+#include "../CursorObject.h"
+#include "../MessageWidget.h"
+#include "../../Sexy.TodLib/Trail.h"
+#include "../../Sexy.TodLib/Attachment.h"
+#include "../../Sexy.TodLib/Reanimator.h"
+#include "../../Sexy.TodLib/TodParticle.h"
+#include "../../Sexy.TodLib/EffectSystem.h"
+#include "../../Sexy.TodLib/DataArray.h"
+#include "../../Sexy.TodLib/TodList.h"
+#include <cstring>
+
+BoardSnapshot::BoardSnapshot()
+{
+	mBoard = nullptr;
+}
+
+template <typename T> static void CaptureDataArray(DataArraySnapshot& theSnapshot, DataArray<T>& theDataArray)
+{
+	size_t aSize = theDataArray.mMaxUsedCount * sizeof(*theDataArray.mBlock);
+	theSnapshot.mBlock.resize(aSize);
+	if (aSize > 0)
+		memcpy(theSnapshot.mBlock.data(), theDataArray.mBlock, aSize);
+	theSnapshot.mMaxUsedCount = theDataArray.mMaxUsedCount;
+	theSnapshot.mFreeListHead = theDataArray.mFreeListHead;
+	theSnapshot.mSize = theDataArray.mSize;
+	theSnapshot.mNextKey = theDataArray.mNextKey;
+}
+
+// Items past mMaxUsedCount are left as they are; DataArrayAlloc clears every item it hands out
+template <typename T> static void RestoreDataArray(const DataArraySnapshot& theSnapshot, DataArray<T>& theDataArray)
+{
+	if (!theSnapshot.mBlock.empty())
+		memcpy(theDataArray.mBlock, theSnapshot.mBlock.data(), theSnapshot.mBlock.size());
+	theDataArray.mMaxUsedCount = theSnapshot.mMaxUsedCount;
+	theDataArray.mFreeListHead = theSnapshot.mFreeListHead;
+	theDataArray.mSize = theSnapshot.mSize;
+	theDataArray.mNextKey = theSnapshot.mNextKey;
+}
+
+template <typename T> static void CaptureIDList(std::vector<unsigned int>& theIDs, TodList<T>& theList)
+{
+	theIDs.push_back(theList.mSize);
+	for (TodListNode<T>* aNode = theList.mHead; aNode != nullptr; aNode = aNode->mNext)
+		theIDs.push_back(static_cast<unsigned int>(aNode->mValue));
+}
+
+// The list header was just overwritten with the captured one, whose nodes may have been freed since;
+// only its allocator is kept and the nodes are rebuilt from the captured IDs.
+template <typename T> static void RestoreIDList(const unsigned int*& theIDs, TodList<T>& theList)
+{
+	theList.mHead = nullptr;
+	theList.mTail = nullptr;
+	theList.mSize = 0;
+	unsigned int aCount = *theIDs++;
+	for (unsigned int i = 0; i < aCount; i++)
+		theList.AddTail(static_cast<T>(*theIDs++));
+}
+
+// The state of these objects starts at theFirstField and runs to the end of the object
+template <typename T> static void AppendSideState(std::vector<unsigned char>& theOut, T& theObject, const void* theFirstField)
+{
+	const unsigned char* aStart = static_cast<const unsigned char*>(theFirstField);
+	const unsigned char* anEnd = reinterpret_cast<const unsigned char*>(&theObject) + sizeof(T);
+	theOut.insert(theOut.end(), aStart, anEnd);
+}
+
+template <typename T> static void ApplySideState(const unsigned char*& theData, T& theObject, void* theFirstField)
+{
+	unsigned char* aStart = static_cast<unsigned char*>(theFirstField);
+	size_t aSize = reinterpret_cast<unsigned char*>(&theObject) + sizeof(T) - aStart;
+	memcpy(aStart, theData, aSize);
+	theData += aSize;
+}
+
+static int GetTrackInstancesSize(Reanimation* theReanimation)
+{
+	return theReanimation->mTrackInstances ? theReanimation->mDefinition->mTracks.count * sizeof(ReanimatorTrackInstance) : 0;
+}
+
+void BoardSnapshot::Capture(Board* theBoard)
+{
+	EffectSystem* aEffectSystem = theBoard->mApp->mEffectSystem;
+	TodParticleHolder* aParticleHolder = aEffectSystem->mParticleHolder;
+	mBoard = theBoard;
+
+	unsigned char* aBoardStart = reinterpret_cast<unsigned char*>(&theBoard->mPaused);
+	unsigned char* aBoardEnd = reinterpret_cast<unsigned char*>(&theBoard->mBackdropCache);
+	mBoardState.assign(aBoardStart, aBoardEnd);
+
+	CaptureDataArray(mZombies, theBoard->mZombies);
+	CaptureDataArray(mPlants, theBoard->mPlants);
+	CaptureDataArray(mProjectiles, theBoard->mProjectiles);
+	CaptureDataArray(mCoins, theBoard->mCoins);
+	CaptureDataArray(mLawnMowers, theBoard->mLawnMowers);
+	CaptureDataArray(mGridItems, theBoard->mGridItems);
+	CaptureDataArray(mParticleSystems, aParticleHolder->mParticleSystems);
+	CaptureDataArray(mEmitters, aParticleHolder->mEmitters);
+	CaptureDataArray(mParticles, aParticleHolder->mParticles);
+	CaptureDataArray(mReanimations, aEffectSystem->mReanimationHolder->mReanimations);
+	CaptureDataArray(mTrails, aEffectSystem->mTrailHolder->mTrails);
+	CaptureDataArray(mAttachments, aEffectSystem->mAttachmentHolder->mAttachments);
+
+	mEffectListIDs.clear();
+	{
+		TodParticleSystem* aParticleSystem = nullptr;
+		while (aParticleHolder->mParticleSystems.IterateNext(aParticleSystem))
+			CaptureIDList(mEffectListIDs, aParticleSystem->mEmitterList);
+	}
+	{
+		TodParticleEmitter* aEmitter = nullptr;
+		while (aParticleHolder->mEmitters.IterateNext(aEmitter))
+			CaptureIDList(mEffectListIDs, aEmitter->mParticleList);
+	}
+
+	mTrackInstances.clear();
+	{
+		Reanimation* aReanimation = nullptr;
+		while (aEffectSystem->mReanimationHolder->mReanimations.IterateNext(aReanimation))
+		{
+			const unsigned char* aTracks = reinterpret_cast<const unsigned char*>(aReanimation->mTrackInstances);
+			mTrackInstances.insert(mTrackInstances.end(), aTracks, aTracks + GetTrackInstancesSize(aReanimation));
+		}
+	}
+
+	mSideState.clear();
+	AppendSideState(mSideState, *theBoard->mCursorObject, &theBoard->mCursorObject->mX);
+	AppendSideState(mSideState, *theBoard->mCursorPreview, &theBoard->mCursorPreview->mX);
+	AppendSideState(mSideState, *theBoard->mAdvice, &theBoard->mAdvice->mLabel);
+	AppendSideState(mSideState, *theBoard->mSeedBank, &theBoard->mSeedBank->mX);
+	AppendSideState(mSideState, *theBoard->mChallenge, &theBoard->mChallenge->mBeghouledMouseCapture);
+
+	GetRandState(mRandState);
+}
+
+bool BoardSnapshot::Restore(Board* theBoard) const
+{
+	if (mBoard == nullptr || theBoard != mBoard)
+		return false;
+
+	EffectSystem* aEffectSystem = theBoard->mApp->mEffectSystem;
+	TodParticleHolder* aParticleHolder = aEffectSystem->mParticleHolder;
+	DataArray<Reanimation>& aReanimations = aEffectSystem->mReanimationHolder->mReanimations;
+
+	// Release what the current effects own outside their arrays before the arrays are overwritten
+	{
+		TodParticleSystem* aParticleSystem = nullptr;
+		while (aParticleHolder->mParticleSystems.IterateNext(aParticleSystem))
+			aParticleSystem->mEmitterList.RemoveAll();
+	}
+	{
+		TodParticleEmitter* aEmitter = nullptr;
+		while (aParticleHolder->mEmitters.IterateNext(aEmitter))
+			aEmitter->mParticleList.RemoveAll();
+	}
+	{
+		Reanimation* aReanimation = nullptr;
+		while (aReanimations.IterateNext(aReanimation))
+		{
+			int aSize = GetTrackInstancesSize(aReanimation);
+			if (aSize > 0)
+				FindGlobalAllocator(aSize)->Free(aReanimation->mTrackInstances, aSize);
+			aReanimation->mTrackInstances = nullptr;
+		}
+	}
+
+	memcpy(&theBoard->mPaused, mBoardState.data(), mBoardState.size());
+
+	RestoreDataArray(mZombies, theBoard->mZombies);
+	RestoreDataArray(mPlants, theBoard->mPlants);
+	RestoreDataArray(mProjectiles, theBoard->mProjectiles);
+	RestoreDataArray(mCoins, theBoard->mCoins);
+	RestoreDataArray(mLawnMowers, theBoard->mLawnMowers);
+	RestoreDataArray(mGridItems, theBoard->mGridItems);
+	RestoreDataArray(mParticleSystems, aParticleHolder->mParticleSystems);
+	RestoreDataArray(mEmitters, aParticleHolder->mEmitters);
+	RestoreDataArray(mParticles, aParticleHolder->mParticles);
+	RestoreDataArray(mReanimations, aReanimations);
+	RestoreDataArray(mTrails, aEffectSystem->mTrailHolder->mTrails);
+	RestoreDataArray(mAttachments, aEffectSystem->mAttachmentHolder->mAttachments);
+
+	const unsigned int* aIDs = mEffectListIDs.data();
+	{
+		TodParticleSystem* aParticleSystem = nullptr;
+		while (aParticleHolder->mParticleSystems.IterateNext(aParticleSystem))
+			RestoreIDList(aIDs, aParticleSystem->mEmitterList);
+	}
+	{
+		TodParticleEmitter* aEmitter = nullptr;
+		while (aParticleHolder->mEmitters.IterateNext(aEmitter))
+			RestoreIDList(aIDs, aEmitter->mParticleList);
+	}
+
+	const unsigned char* aTracks = mTrackInstances.data();
+	{
+		Reanimation* aReanimation = nullptr;
+		while (aReanimations.IterateNext(aReanimation))
+		{
+			if (aReanimation->mTrackInstances == nullptr)
+				continue;
+
+			int aSize = aReanimation->mDefinition->mTracks.count * sizeof(ReanimatorTrackInstance);
+			aReanimation->mTrackInstances = static_cast<ReanimatorTrackInstance*>(FindGlobalAllocator(aSize)->Alloc(aSize));
+			memcpy(aReanimation->mTrackInstances, aTracks, aSize);
+			aTracks += aSize;
+		}
+	}
+
+	const unsigned char* aSideState = mSideState.data();
+	ApplySideState(aSideState, *theBoard->mCursorObject, &theBoard->mCursorObject->mX);
+	ApplySideState(aSideState, *theBoard->mCursorPreview, &theBoard->mCursorPreview->mX);
+	ApplySideState(aSideState, *theBoard->mAdvice, &theBoard->mAdvice->mLabel);
+	ApplySideState(aSideState, *theBoard->mSeedBank, &theBoard->mSeedBank->mX);
+	ApplySideState(aSideState, *theBoard->mChallenge, &theBoard->mChallenge->mBeghouledMouseCapture);
+
+	SetRandState(mRandState);
+	return true;
+}
+
+size_t BoardSnapshot::GetMemoryUsage() const
+{
+	const DataArraySnapshot* aArrays[] = { &mZombies, &mPlants, &mProjectiles, &mCoins, &mLawnMowers, &mGridItems,
+		&mParticleSystems, &mEmitters, &mParticles, &mReanimations, &mTrails, &mAttachments };
+	size_t aSize = mBoardState.size() + mEffectListIDs.size() * sizeof(unsigned int) + mTrackInstances.size() + mSideState.size();
+	for (const DataArraySnapshot* aArray : aArrays)
+		aSize += aArray->mBlock.size();
+	return aSize;
+}
@@ -0,0 +1,56 @@
+#ifndef __BOARDSNAPSHOT_H__
+#define __BOARDSNAPSHOT_H__
+
+#include <vector>
+#include "misc/MTRand.h"
+
+class Board;
+
+// Raw copy of one DataArray: the used part of its block and the bookkeeping needed to hand out the same IDs again
+class DataArraySnapshot
+{
+public:
+	std::vector<unsigned char>	mBlock;
+	unsigned int				mMaxUsedCount;
+	unsigned int				mFreeListHead;
+	unsigned int				mSize;
+	unsigned int				mNextKey;
+};
+
+// In-memory copy of the simulation state of a running Board, for rewinding and what-if simulation.
+// Objects keep their IDs, pointers and memory locations, so a snapshot can only be restored onto the Board
+// it was taken from while that Board is alive; nothing is re-linked on restore. The game objects, effects,
+// cursor, seed bank, advice and challenge state and the global random number generator are included;
+// music, sounds, cut scenes and widgets are not. Reusing one snapshot keeps its buffers allocated.
+class BoardSnapshot
+{
+public:
+	Board*						mBoard;
+	std::vector<unsigned char>	mBoardState;
+	DataArraySnapshot			mZombies;
+	DataArraySnapshot			mPlants;
+	DataArraySnapshot			mProjectiles;
+	DataArraySnapshot			mCoins;
+	DataArraySnapshot			mLawnMowers;
+	DataArraySnapshot			mGridItems;
+	DataArraySnapshot			mParticleSystems;
+	DataArraySnapshot			mEmitters;
+	DataArraySnapshot			mParticles;
+	DataArraySnapshot			mReanimations;
+	DataArraySnapshot			mTrails;
+	DataArraySnapshot			mAttachments;
+	std::vector<unsigned int>	mEffectListIDs;				// emitter IDs of each particle system, then particle IDs of each emitter
+	std::vector<unsigned char>	mTrackInstances;			// track instances of each reanimation, in array order
+	std::vector<unsigned char>	mSideState;					// cursor, cursor preview, advice, seed bank and challenge
+	Sexy::MTRand				mRandState;
+
+public:
+	BoardSnapshot();
+
+	void						Capture(Board* theBoard);
+	bool						Restore(Board* theBoard) const;
+	inline bool					IsValid() const { return mBoard != nullptr; }
+	size_t						GetMemoryUsage() const;
+};
+
+#endif
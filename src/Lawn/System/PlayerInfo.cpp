@@ -2,6 +2,7 @@
 
 #include "DataSync.h"
 #include "PlayerInfo.h"
+#include "SaveGame.h"
 #include "../LawnCommon.h"
 #include "../Widget/ChallengeScreen.h"
 #include "../../Sexy.TodLib/TodDebug.h"
@@ -173,9 +174,10 @@ void PlayerInfo::SaveDetails()
 	DataSync aSync(aWriter);
 	SyncDetails(aSync);
 
-	MkDir(GetAppDataPath("userdata"));
+	// The snapshot is written in the background; a newer save of the same profile replaces it if it is still queued
 	std::string aFileName = GetAppDataPath(StrFormat("userdata/user%d.dat", mId));
-	gSexyAppBase->WriteBytesToFile(aFileName, aWriter.GetDataPtr(), aWriter.GetDataLen());
+	const uchar* aData = static_cast<const uchar*>(aWriter.GetDataPtr());
+	gSexyAppBase->WriteBytesToFileAsync(aFileName, std::vector<uchar>(aData, aData + aWriter.GetDataLen()));
 }
 
 //0x469810
@@ -187,7 +189,7 @@ void PlayerInfo::DeleteUserFiles()
 	for (int i = 0; i < static_cast<int>(GameMode::NUM_GAME_MODES); i++)
 	{
 		std::string aFileName = GetSavedGameName((GameMode)i, mId);
-		gSexyAppBase->EraseFile(aFileName);
+		LawnEraseSaveGame(aFileName);
 		std::string aLegacyFileName = GetLegacySavedGameName((GameMode)i, mId);
 		gSexyAppBase->EraseFile(aLegacyFileName);
 	}
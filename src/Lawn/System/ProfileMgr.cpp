@@ -100,9 +100,10 @@ void ProfileMgr::Save()
     DataSync aSync(aWriter);
     SyncState(aSync);
 
-    MkDir(GetAppDataPath("userdata"));
+    // 在后台线程写入，若上一次保存仍在队列中则直接替换其数据
     std::string aFileName = GetAppDataPath("userdata/users.dat");
-    gSexyAppBase->WriteBytesToFile(aFileName, aWriter.GetDataPtr(), aWriter.GetDataLen());
+    const uchar* aData = static_cast<const uchar*>(aWriter.GetDataPtr());
+    gSexyAppBase->WriteBytesToFileAsync(aFileName, std::vector<uchar>(aData, aData + aWriter.GetDataLen()));
 }
 
 void ProfileMgr::DeleteProfile(ProfileMap::iterator theProfile)
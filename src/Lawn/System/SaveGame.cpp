@@ -16,8 +16,16 @@
 #include "../../Sexy.TodLib/EffectSystem.h"
 #include "../../Sexy.TodLib/DataArray.h"
 #include "../../Sexy.TodLib/TodList.h"
+#include "../../Sexy.TodLib/Definition.h"
+#include "../../Sexy.TodLib/TodTaskGraph.h"
 #include "DataSync.h"
+#include "misc/LZ4Block.h"
+#include "misc/PerfTimer.h"
+#include "misc/AsyncFileWriter.h"
 #include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
 #include <vector>
 
 static const char* FILE_COMPILE_TIME_STRING = "Jul  2 201011:47:03"; // The compile time of 1.2.0.1073 GOTY
@@ -28,13 +36,27 @@ static unsigned int SAVE_FILE_DATE = crc32(0, (Bytef*)FILE_COMPILE_TIME_STRING,
 
 static const char SAVE_FILE_MAGIC_V4[12] = "PVZP_SAVE4";
 static const unsigned int SAVE_FILE_V4_VERSION = 1U;
+static const unsigned int SAVE_FILE_V4_VERSION_COMPRESSED = 2U;	// adds SaveFileCodecHeaderV4 after the header
+static const unsigned int SAVE_FILE_V4_VERSION_DELTA = 3U;		// like version 2, and the payload starts with a SAVE4_CHUNK_DELTA_BASE chunk
+static const unsigned int SAVE_FILE_V4_MAX_RAW_SIZE = 64U << 20;
+static const int SAVE_DELTA_MAX_DELTAS = 32;					// delta saves written before a fresh base
+static const size_t SAVE_CHUNK_RECORD_HEADER = 8;				// chunk type and data size in front of every chunk
+
+int gSaveGameCodec = SAVE_CODEC_NONE;
+bool gSaveGameDelta = false;
 
 struct SaveFileHeaderV4
 {
 	char			mMagic[12];
 	unsigned int	mVersion;
-	unsigned int	mPayloadSize;
-	unsigned int	mPayloadCrc;
+	unsigned int	mPayloadSize;	// stored bytes after all headers
+	unsigned int	mPayloadCrc;	// crc32 of the stored bytes
+};
+
+struct SaveFileCodecHeaderV4
+{
+	unsigned int	mCodec;
+	unsigned int	mRawSize;		// payload size before compression
 };
 
 enum SaveChunkTypeV4
@@ -58,11 +80,46 @@ enum SaveChunkTypeV4
 	SAVE4_CHUNK_SEEDBANK = 17,
 	SAVE4_CHUNK_SEEDPACKETS = 18,
 	SAVE4_CHUNK_CHALLENGE = 19,
-	SAVE4_CHUNK_MUSIC = 20
+	SAVE4_CHUNK_MUSIC = 20,
+	SAVE4_CHUNK_DELTA_BASE = 21		// only in delta saves: where every chunk of the save comes from
 };
 
 static const unsigned int SAVE4_CHUNK_VERSION = 1U;
 
+static const uint32_t SAVE4_CHUNK_ORDER[] = {
+	SAVE4_CHUNK_BOARD_BASE, SAVE4_CHUNK_ZOMBIES, SAVE4_CHUNK_PLANTS, SAVE4_CHUNK_PROJECTILES, SAVE4_CHUNK_COINS,
+	SAVE4_CHUNK_MOWERS, SAVE4_CHUNK_GRIDITEMS, SAVE4_CHUNK_PARTICLE_EMITTERS, SAVE4_CHUNK_PARTICLE_PARTICLES,
+	SAVE4_CHUNK_PARTICLE_SYSTEMS, SAVE4_CHUNK_REANIMATIONS, SAVE4_CHUNK_TRAILS, SAVE4_CHUNK_ATTACHMENTS,
+	SAVE4_CHUNK_CURSOR, SAVE4_CHUNK_CURSOR_PREVIEW, SAVE4_CHUNK_ADVICE, SAVE4_CHUNK_SEEDBANK,
+	SAVE4_CHUNK_SEEDPACKETS, SAVE4_CHUNK_CHALLENGE, SAVE4_CHUNK_MUSIC
+};
+
+// Chunks that only touch their own DataArray can be written and read on the worker pool.
+// The particle chunks are read by a single task, because the systems look up emitters and particles by ID.
+// Everything else (board base, reanimations, widgets, music) stays on the calling thread; reanimations
+// may load their definition on demand, which is not safe off the game thread.
+static uint32_t GetChunkTaskV4(uint32_t theChunkType)
+{
+	switch (theChunkType)
+	{
+	case SAVE4_CHUNK_ZOMBIES:
+	case SAVE4_CHUNK_PLANTS:
+	case SAVE4_CHUNK_PROJECTILES:
+	case SAVE4_CHUNK_COINS:
+	case SAVE4_CHUNK_MOWERS:
+	case SAVE4_CHUNK_GRIDITEMS:
+	case SAVE4_CHUNK_TRAILS:
+	case SAVE4_CHUNK_ATTACHMENTS:
+		return theChunkType;
+	case SAVE4_CHUNK_PARTICLE_EMITTERS:
+	case SAVE4_CHUNK_PARTICLE_PARTICLES:
+	case SAVE4_CHUNK_PARTICLE_SYSTEMS:
+		return SAVE4_CHUNK_PARTICLE_SYSTEMS;
+	default:
+		return 0;
+	}
+}
+
 static void AppendU32LE(std::vector<unsigned char>& theOut, uint32_t theValue)
 {
 	unsigned char aBytes[4];
@@ -2267,33 +2324,171 @@ static bool ReadChunkV4(uint32_t theChunkType, const unsigned char* theData, siz
 	return aApplied;
 }
 
-static bool LawnLoadGameV4(Board* theBoard, const std::string& theFilePath)
+const char* SaveGameGetCodecName(int theCodec)
 {
-	Buffer aBuffer;
-	if (!gSexyAppBase->ReadBufferFromFile(theFilePath, &aBuffer, false))
+	switch (theCodec)
+	{
+	case SAVE_CODEC_NONE:	return "none";
+	case SAVE_CODEC_LZ4:	return "lz4";
+	case SAVE_CODEC_ZLIB:	return "zlib";
+	default:				return "unknown";
+	}
+}
+
+static bool CompressSavePayload(int theCodec, const unsigned char* theData, unsigned int theSize, std::vector<unsigned char>& theResult, size_t theOffset)
+{
+	switch (theCodec)
+	{
+	case SAVE_CODEC_LZ4:
+	{
+		theResult.resize(theOffset + LZ4CompressBound(static_cast<int>(theSize)));
+		int aSize = LZ4Compress(theData, static_cast<int>(theSize), theResult.data() + theOffset, static_cast<int>(theResult.size() - theOffset));
+		theResult.resize(theOffset + aSize);
+		return aSize > 0;
+	}
+	case SAVE_CODEC_ZLIB:
+	{
+		uLongf aSize = compressBound(theSize);
+		theResult.resize(theOffset + aSize);
+		if (compress2(theResult.data() + theOffset, &aSize, theData, theSize, Z_DEFAULT_COMPRESSION) != Z_OK)
+			return false;
+		theResult.resize(theOffset + aSize);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static bool DecompressSavePayload(int theCodec, const unsigned char* theData, unsigned int theSize, unsigned char* theResult, unsigned int theResultSize)
+{
+	switch (theCodec)
+	{
+	case SAVE_CODEC_LZ4:
+		return LZ4Decompress(theData, static_cast<int>(theSize), theResult, static_cast<int>(theResultSize)) == static_cast<int>(theResultSize);
+	case SAVE_CODEC_ZLIB:
+	{
+		uLongf aSize = theResultSize;
+		return uncompress(theResult, &aSize, theData, theSize) == Z_OK && aSize == theResultSize;
+	}
+	default:
 		return false;
-	if (static_cast<unsigned int>(aBuffer.GetDataLen()) < sizeof(SaveFileHeaderV4))
+	}
+}
+
+// Checks the header and checksum of a v4 save file and returns its raw chunk payload.
+// Uncompressed payloads point into theData; compressed ones are unpacked into theBuffer.
+bool DecodeSaveGameV4(const unsigned char* theData, size_t theSize, std::vector<unsigned char>& theBuffer, const unsigned char*& thePayload, unsigned int& thePayloadSize)
+{
+	if (theSize < sizeof(SaveFileHeaderV4))
 		return false;
 
 	SaveFileHeaderV4 aHeader;
-	memcpy(&aHeader, aBuffer.GetDataPtr(), sizeof(aHeader));
+	memcpy(&aHeader, theData, sizeof(aHeader));
 	aHeader.mVersion = FromLE32(aHeader.mVersion);
 	aHeader.mPayloadSize = FromLE32(aHeader.mPayloadSize);
 	aHeader.mPayloadCrc = FromLE32(aHeader.mPayloadCrc);
 	if (memcmp(aHeader.mMagic, SAVE_FILE_MAGIC_V4, sizeof(aHeader.mMagic)) != 0)
 		return false;
+	if (aHeader.mVersion != SAVE_FILE_V4_VERSION && aHeader.mVersion != SAVE_FILE_V4_VERSION_COMPRESSED && aHeader.mVersion != SAVE_FILE_V4_VERSION_DELTA)
+		return false;
+
+	size_t aHeaderSize = sizeof(SaveFileHeaderV4);
+	SaveFileCodecHeaderV4 aCodecHeader{ SAVE_CODEC_NONE, aHeader.mPayloadSize };
 	if (aHeader.mVersion != SAVE_FILE_V4_VERSION)
+	{
+		if (theSize < aHeaderSize + sizeof(SaveFileCodecHeaderV4))
+			return false;
+		memcpy(&aCodecHeader, theData + aHeaderSize, sizeof(aCodecHeader));
+		aCodecHeader.mCodec = FromLE32(aCodecHeader.mCodec);
+		aCodecHeader.mRawSize = FromLE32(aCodecHeader.mRawSize);
+		aHeaderSize += sizeof(SaveFileCodecHeaderV4);
+	}
+	if (aHeader.mPayloadSize > theSize - aHeaderSize)
 		return false;
-	if (aHeader.mPayloadSize + sizeof(SaveFileHeaderV4) > static_cast<unsigned int>(aBuffer.GetDataLen()))
+
+	const unsigned char* aStored = theData + aHeaderSize;
+	if (crc32(0, aStored, aHeader.mPayloadSize) != aHeader.mPayloadCrc)
 		return false;
 
-	unsigned char* aPayload = (unsigned char*)aBuffer.GetDataPtr() + sizeof(SaveFileHeaderV4);
-	unsigned int aCrc = crc32(0, (Bytef*)aPayload, aHeader.mPayloadSize);
-	if (aCrc != aHeader.mPayloadCrc)
+	if (aCodecHeader.mCodec == SAVE_CODEC_NONE)
+	{
+		thePayload = aStored;
+		thePayloadSize = aHeader.mPayloadSize;
+		return true;
+	}
+
+	if (aCodecHeader.mRawSize > SAVE_FILE_V4_MAX_RAW_SIZE)
+		return false;
+	theBuffer.resize(aCodecHeader.mRawSize);
+	if (!DecompressSavePayload(aCodecHeader.mCodec, aStored, aHeader.mPayloadSize, theBuffer.data(), aCodecHeader.mRawSize))
 		return false;
+	thePayload = theBuffer.data();
+	thePayloadSize = aCodecHeader.mRawSize;
+	return true;
+}
 
-	TLVReader aReader(aPayload, aHeader.mPayloadSize);
-	bool aBaseLoaded = false;
+struct SaveChunkRefV4
+{
+	uint32_t				mType;
+	const unsigned char*	mData;
+	uint32_t				mSize;
+};
+
+// Delta saves (-savedelta) store only the chunks that changed since the last base save. The base is a complete
+// save in "<file>.base0" or "<file>.base1"; a fresh base always goes to the one the save file does not use yet,
+// so the file on disk stays loadable until the new base and the delta that points to it are both written.
+// The SAVE4_CHUNK_DELTA_BASE chunk holds the base index, the crc32 of the base payload and one
+// SaveDeltaEntryV4 per chunk of the save, in load order.
+struct SaveDeltaEntryV4
+{
+	uint32_t				mType;
+	uint32_t				mSize;			// chunk data size
+	uint32_t				mCrc;			// crc32 of the chunk data
+	uint32_t				mInBase;		// 1 if the chunk is taken from the base, 0 if it follows in this file
+};
+
+// What the game thread knows about the newest base: written by the last compaction or read by the last load
+struct SaveDeltaStateV4
+{
+	std::string							mFilePath;
+	unsigned int						mBaseIndex = 0;
+	uint32_t							mBaseCrc = 0;
+	std::vector<std::vector<unsigned char>>	mBaseChunks;		// complete chunk records by SAVE4_CHUNK_ORDER index; empty if missing
+	int									mNumDeltas = 0;
+	bool								mBasePending = false;	// the save that writes the base is still queued
+	std::shared_ptr<std::atomic<int>>	mBaseResult;			// set by the writer thread: 1 once the base is on disk, -1 if it failed
+	std::vector<uint32_t>				mLastChunkCrcs;			// chunk crcs and sizes of the previous save, by SAVE4_CHUNK_ORDER index
+	std::vector<size_t>					mLastChunkSizes;
+};
+
+static SaveDeltaStateV4 gSaveDeltaState;
+
+static std::string GetDeltaBaseName(const std::string& theFilePath, unsigned int theBaseIndex)
+{
+	return theFilePath + StrFormat(".base%u", theBaseIndex);
+}
+
+static int GetChunkOrderIndexV4(uint32_t theChunkType)
+{
+	for (size_t i = 0; i < LENGTH(SAVE4_CHUNK_ORDER); i++)
+		if (SAVE4_CHUNK_ORDER[i] == theChunkType)
+			return static_cast<int>(i);
+	return -1;
+}
+
+// While a demo is recorded or played, the prepare step of a save runs on the game thread and the base goes through the
+// demo aware WriteBytesToFile: recording logs the write, and playback must not replace the real base file
+static bool WriteDeltaBaseV4(const std::string& theBaseName, const std::vector<unsigned char>& theData)
+{
+	if (gSexyAppBase->mPlayingDemoBuffer || gSexyAppBase->mRecordingDemoBuffer)
+		return gSexyAppBase->WriteBytesToFile(theBaseName, theData.data(), static_cast<unsigned long>(theData.size()));
+	return AsyncFileWriter::WriteFileAtomic(theBaseName, theData.data(), theData.size());
+}
+
+static bool ParseChunksV4(const unsigned char* thePayload, unsigned int thePayloadSize, std::vector<SaveChunkRefV4>& theChunks)
+{
+	TLVReader aReader(thePayload, thePayloadSize);
 	while (aReader.mOk && aReader.mPos < aReader.mSize)
 	{
 		uint32_t aChunkType = 0;
@@ -2304,17 +2499,173 @@ static bool LawnLoadGameV4(Board* theBoard, const std::string& theFilePath)
 		if (!aReader.ReadBytes(aChunkData, aChunkSize))
 			break;
 
-		if (!ReadChunkV4(aChunkType, aChunkData, aChunkSize, theBoard))
+		theChunks.push_back(SaveChunkRefV4{ aChunkType, aChunkData, aChunkSize });
+	}
+	return !theChunks.empty();
+}
+
+// Replaces the chunk list of a delta save with the complete list, taking unchanged chunks from the base file.
+// theBaseBuffer and theBaseDecoded keep the base data alive for the returned references.
+static bool ResolveDeltaChunksV4(const std::string& theFilePath, std::vector<SaveChunkRefV4>& theChunks, Buffer& theBaseBuffer, std::vector<unsigned char>& theBaseDecoded)
+{
+	TLVReader aTable(theChunks[0].mData, theChunks[0].mSize);
+	uint32_t aBaseIndex = 0, aBaseCrc = 0, aNumEntries = 0;
+	if (!aTable.ReadU32(aBaseIndex) || !aTable.ReadU32(aBaseCrc) || !aTable.ReadU32(aNumEntries) || aNumEntries > 1024)
+		return false;
+
+	std::string aBaseName = GetDeltaBaseName(theFilePath, aBaseIndex);
+	const unsigned char* aBasePayload = nullptr;
+	unsigned int aBasePayloadSize = 0;
+	std::vector<SaveChunkRefV4> aBaseChunks;
+	if (!gSexyAppBase->ReadBufferFromFile(aBaseName, &theBaseBuffer, false) ||
+		!DecodeSaveGameV4(theBaseBuffer.GetDataPtr(), static_cast<size_t>(theBaseBuffer.GetDataLen()), theBaseDecoded, aBasePayload, aBasePayloadSize) ||
+		crc32(0, aBasePayload, aBasePayloadSize) != aBaseCrc || !ParseChunksV4(aBasePayload, aBasePayloadSize, aBaseChunks))
+	{
+		TodTrace("Delta save %s: base %s is missing or does not match", theFilePath.c_str(), aBaseName.c_str());
+		return false;
+	}
+
+	std::vector<SaveChunkRefV4> aChunks;
+	size_t aNextInline = 1;
+	for (uint32_t i = 0; i < aNumEntries; i++)
+	{
+		SaveDeltaEntryV4 anEntry;
+		if (!aTable.ReadU32(anEntry.mType) || !aTable.ReadU32(anEntry.mSize) || !aTable.ReadU32(anEntry.mCrc) || !aTable.ReadU32(anEntry.mInBase))
 			return false;
-		if (aChunkType == SAVE4_CHUNK_BOARD_BASE)
-			aBaseLoaded = true;
+
+		const SaveChunkRefV4* aChunk = nullptr;
+		if (!anEntry.mInBase)
+		{
+			aChunk = aNextInline < theChunks.size() ? &theChunks[aNextInline++] : nullptr;
+		}
+		else
+		{
+			for (const SaveChunkRefV4& aBaseChunk : aBaseChunks)
+				if (aBaseChunk.mType == anEntry.mType)
+					aChunk = &aBaseChunk;
+		}
+		if (aChunk == nullptr || aChunk->mType != anEntry.mType || aChunk->mSize != anEntry.mSize || crc32(0, aChunk->mData, aChunk->mSize) != anEntry.mCrc)
+			return false;
+		aChunks.push_back(*aChunk);
+	}
+
+	// The next delta save can build on the base that was just read
+	gSaveDeltaState.mFilePath = theFilePath;
+	gSaveDeltaState.mBaseIndex = aBaseIndex;
+	gSaveDeltaState.mBaseCrc = aBaseCrc;
+	gSaveDeltaState.mBaseChunks.assign(LENGTH(SAVE4_CHUNK_ORDER), std::vector<unsigned char>());
+	gSaveDeltaState.mNumDeltas = 0;
+	gSaveDeltaState.mBasePending = false;
+	gSaveDeltaState.mBaseResult.reset();
+	gSaveDeltaState.mLastChunkCrcs.clear();
+	gSaveDeltaState.mLastChunkSizes.clear();
+	for (const SaveChunkRefV4& aBaseChunk : aBaseChunks)
+	{
+		int anIndex = GetChunkOrderIndexV4(aBaseChunk.mType);
+		if (anIndex >= 0)
+			AppendChunk(gSaveDeltaState.mBaseChunks[anIndex], aBaseChunk.mType, std::vector<unsigned char>(aBaseChunk.mData, aBaseChunk.mData + aBaseChunk.mSize));
+	}
+
+	theChunks.swap(aChunks);
+	return true;
+}
+
+// Loads the .v4 file image theData into theBoard. theFilePath only locates the base of a delta save; delta saves
+// are rejected without it. theTimings, if given, accumulates the time spent in each step after reading the file.
+static bool LawnLoadGameDataV4(Board* theBoard, const unsigned char* theData, size_t theSize, const std::string& theFilePath, SaveGameTimings* theTimings)
+{
+	SaveGameTimings aTimings;
+	PerfTimer aTimer;
+	aTimer.Start();
+	std::vector<unsigned char> aDecoded;
+	const unsigned char* aPayload = nullptr;
+	unsigned int aPayloadSize = 0;
+	if (!DecodeSaveGameV4(theData, theSize, aDecoded, aPayload, aPayloadSize))
+		return false;
+
+	std::vector<SaveChunkRefV4> aChunks;
+	if (!ParseChunksV4(aPayload, aPayloadSize, aChunks))
+		return false;
+
+	Buffer aBaseBuffer;
+	std::vector<unsigned char> aBaseDecoded;
+	if (aChunks[0].mType != SAVE4_CHUNK_DELTA_BASE)
+	{
+		if (gSaveDeltaState.mFilePath == theFilePath)
+			gSaveDeltaState = SaveDeltaStateV4();
 	}
+	else if (theFilePath.empty() || !ResolveDeltaChunksV4(theFilePath, aChunks, aBaseBuffer, aBaseDecoded))
+		return false;
+
+	bool aBaseLoaded = false;
+	for (const SaveChunkRefV4& aChunk : aChunks)
+		if (aChunk.mType == SAVE4_CHUNK_BOARD_BASE)
+			aBaseLoaded = true;
 
 	if (!aBaseLoaded)
 		return false;
+	aTimings.mDecode = aTimer.GetDuration();
+
+	aTimer.Start();
+
+	// The board base goes first, then the independent arrays in parallel, then the rest in file order
+	for (const SaveChunkRefV4& aChunk : aChunks)
+		if (aChunk.mType == SAVE4_CHUNK_BOARD_BASE && !ReadChunkV4(aChunk.mType, aChunk.mData, aChunk.mSize, theBoard))
+			return false;
+
+	TodTaskGraph aGraph;
+	std::vector<uint32_t> aTasks;
+	for (const SaveChunkRefV4& aChunk : aChunks)
+	{
+		uint32_t aTask = GetChunkTaskV4(aChunk.mType);
+		if (aTask == 0 || std::find(aTasks.begin(), aTasks.end(), aTask) != aTasks.end())
+			continue;
+
+		aTasks.push_back(aTask);
+		aGraph.AddTask(StrFormat("read chunk %u", aTask).c_str(), 1, [&aChunks, aTask, theBoard]()
+		{
+			for (const SaveChunkRefV4& aChunk : aChunks)
+				if (GetChunkTaskV4(aChunk.mType) == aTask && !ReadChunkV4(aChunk.mType, aChunk.mData, aChunk.mSize, theBoard))
+					return false;
+			return true;
+		});
+	}
+	if (!aGraph.Run(DefinitionGetLoadThreadCount(aGraph.GetNumTasks())))
+		return false;
+
+	for (const SaveChunkRefV4& aChunk : aChunks)
+		if (aChunk.mType != SAVE4_CHUNK_BOARD_BASE && GetChunkTaskV4(aChunk.mType) == 0 && !ReadChunkV4(aChunk.mType, aChunk.mData, aChunk.mSize, theBoard))
+			return false;
+	aTimings.mParse = aTimer.GetDuration();
 
+	aTimer.Start();
 	FixBoardAfterLoad(theBoard);
 	theBoard->mApp->mGameScene = GameScenes::SCENE_PLAYING;
+	aTimings.mFixUp = aTimer.GetDuration();
+
+	if (theTimings)
+	{
+		theTimings->mDecode += aTimings.mDecode;
+		theTimings->mParse += aTimings.mParse;
+		theTimings->mFixUp += aTimings.mFixUp;
+	}
+	return true;
+}
+
+// theTimings, if given, accumulates the time spent in each step
+static bool LawnLoadGameV4(Board* theBoard, const std::string& theFilePath, SaveGameTimings* theTimings = nullptr)
+{
+	PerfTimer aTimer;
+	aTimer.Start();
+	Buffer aBuffer;
+	if (!gSexyAppBase->ReadBufferFromFile(theFilePath, &aBuffer, false))
+		return false;
+	double aReadTime = aTimer.GetDuration();
+
+	if (!LawnLoadGameDataV4(theBoard, aBuffer.GetDataPtr(), static_cast<size_t>(aBuffer.GetDataLen()), theFilePath, theTimings))
+		return false;
+	if (theTimings)
+		theTimings->mRead += aReadTime;
 	return true;
 }
 
@@ -2663,8 +3014,10 @@ template <typename T> inline static void SyncDataArray(SaveGameContext& theConte
 void SyncBoard(SaveGameContext& theContext, Board* theBoard)
 {
 	// TODO test if gives sane results
+	// The members from mBackdropCache on are runtime caches that must not be saved or overwritten
 	size_t offset = size_t(&theBoard->mPaused) - size_t(theBoard);
-	theContext.SyncBytes(&theBoard->mPaused, sizeof(Board) - offset);
+	size_t end = size_t(&theBoard->mBackdropCache) - size_t(theBoard);
+	theContext.SyncBytes(&theBoard->mPaused, end - offset);
 
 	SyncDataArray(theContext, theBoard->mZombies);													//0x482190
 	SyncDataArray(theContext, theBoard->mPlants);													//0x482280
@@ -2932,43 +3285,416 @@ bool LawnLoadGame(Board* theBoard, const std::string& theFilePath)
 	return true;
 }
 
-//0x4820D0
-bool LawnSaveGame(Board* theBoard, const std::string& theFilePath)
+// Serializes the board into one complete chunk record per entry of SAVE4_CHUNK_ORDER (empty for chunks with nothing
+// to write) and the crc32 of each record's chunk data. This is the only part of saving that has to run on the game thread.
+// The game thread waits while the worker pool serializes the independent arrays, each into its own buffer.
+static bool SerializeChunksV4(Board* theBoard, std::vector<std::vector<unsigned char>>& theChunks, std::vector<uint32_t>& theChunkCrcs)
 {
-	std::vector<unsigned char> aPayload;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_BOARD_BASE, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_ZOMBIES, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_PLANTS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_PROJECTILES, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_COINS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_MOWERS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_GRIDITEMS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_PARTICLE_EMITTERS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_PARTICLE_PARTICLES, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_PARTICLE_SYSTEMS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_REANIMATIONS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_TRAILS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_ATTACHMENTS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_CURSOR, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_CURSOR_PREVIEW, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_ADVICE, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_SEEDBANK, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_SEEDPACKETS, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_CHALLENGE, theBoard)) return false;
-	if (!WriteChunkV4(aPayload, SAVE4_CHUNK_MUSIC, theBoard)) return false;
+	const int aNumChunks = LENGTH(SAVE4_CHUNK_ORDER);
+	theChunks.assign(aNumChunks, std::vector<unsigned char>());
+	theChunkCrcs.assign(aNumChunks, 0);
+	auto aWriteChunk = [&](int theIndex)
+	{
+		std::vector<unsigned char>& aChunk = theChunks[theIndex];
+		if (!WriteChunkV4(aChunk, SAVE4_CHUNK_ORDER[theIndex], theBoard))
+			return false;
+		if (aChunk.size() > SAVE_CHUNK_RECORD_HEADER)
+			theChunkCrcs[theIndex] = static_cast<uint32_t>(crc32(0, aChunk.data() + SAVE_CHUNK_RECORD_HEADER, static_cast<uInt>(aChunk.size() - SAVE_CHUNK_RECORD_HEADER)));
+		return true;
+	};
+
+	TodTaskGraph aGraph;
+	for (int i = 0; i < aNumChunks; i++)
+	{
+		if (GetChunkTaskV4(SAVE4_CHUNK_ORDER[i]) != 0)
+			aGraph.AddTask(StrFormat("write chunk %u", SAVE4_CHUNK_ORDER[i]).c_str(), 1, [&aWriteChunk, i]() { return aWriteChunk(i); });
+		else if (!aWriteChunk(i))
+			return false;
+	}
+	return aGraph.Run(DefinitionGetLoadThreadCount(aGraph.GetNumTasks()));
+}
+
+// Appends theChunk to theData and folds its crc32 into theCrc
+static void AppendChunkRecordV4(std::vector<unsigned char>& theData, uLong& theCrc, const std::vector<unsigned char>& theChunk, uint32_t theChunkCrc)
+{
+	if (theChunk.empty())
+		return;
+
+	uLong aRecordCrc = crc32(0, theChunk.data(), SAVE_CHUNK_RECORD_HEADER);
+	aRecordCrc = crc32_combine(aRecordCrc, theChunkCrc, static_cast<z_off_t>(theChunk.size() - SAVE_CHUNK_RECORD_HEADER));
+	theCrc = crc32_combine(theCrc, aRecordCrc, static_cast<z_off_t>(theChunk.size()));
+	theData.insert(theData.end(), theChunk.begin(), theChunk.end());
+}
+
+// Joins the chunks into theData, leaving room for the header in front of the payload, and returns
+// the crc32 of the payload in thePayloadCrc.
+static void AssembleSaveGameV4(const std::vector<std::vector<unsigned char>>& theChunks, const std::vector<uint32_t>& theChunkCrcs, std::vector<unsigned char>& theData, uint32_t& thePayloadCrc)
+{
+	size_t aPayloadSize = 0;
+	for (const std::vector<unsigned char>& aChunk : theChunks)
+		aPayloadSize += aChunk.size();
+
+	theData.reserve(sizeof(SaveFileHeaderV4) + aPayloadSize);
+	theData.assign(sizeof(SaveFileHeaderV4), 0);
+	uLong aCrc = 0;
+	for (size_t i = 0; i < theChunks.size(); i++)
+		AppendChunkRecordV4(theData, aCrc, theChunks[i], theChunkCrcs[i]);
+	thePayloadCrc = static_cast<uint32_t>(aCrc);
+}
+
+static bool SnapshotSaveGameV4(Board* theBoard, std::vector<unsigned char>& theData, uint32_t& thePayloadCrc)
+{
+	std::vector<std::vector<unsigned char>> aChunks;
+	std::vector<uint32_t> aChunkCrcs;
+	if (!SerializeChunksV4(theBoard, aChunks, aChunkCrcs))
+		return false;
+
+	AssembleSaveGameV4(aChunks, aChunkCrcs, theData, thePayloadCrc);
+	return true;
+}
+
+// Fills in the header of a snapshot, compressing the payload with theCodec when that makes it smaller.
+// thePayloadCrc is the crc32 of the uncompressed payload. Delta saves always carry the codec header.
+// Touches nothing but theData, so it can run on the file writer thread.
+static bool FinishSaveGameV4(std::vector<unsigned char>& theData, int theCodec, uint32_t thePayloadCrc, bool theDelta = false)
+{
+	unsigned int aRawSize = static_cast<unsigned int>(theData.size() - sizeof(SaveFileHeaderV4));
+	const size_t aHeaderSize = sizeof(SaveFileHeaderV4) + sizeof(SaveFileCodecHeaderV4);
+
+	// Uncompressed saves keep version 1 so that older builds can still read them
+	std::vector<unsigned char> aCompressed;
+	bool aUseCodec = theCodec != SAVE_CODEC_NONE && CompressSavePayload(theCodec, theData.data() + sizeof(SaveFileHeaderV4), aRawSize, aCompressed, aHeaderSize) &&
+		aCompressed.size() < theData.size();
+	if (aUseCodec)
+	{
+		SaveFileCodecHeaderV4 aCodecHeader{ ToLE32(static_cast<unsigned int>(theCodec)), ToLE32(aRawSize) };
+		memcpy(aCompressed.data() + sizeof(SaveFileHeaderV4), &aCodecHeader, sizeof(aCodecHeader));
+		theData.swap(aCompressed);
+	}
+	else if (theDelta)
+	{
+		SaveFileCodecHeaderV4 aCodecHeader{ ToLE32(static_cast<unsigned int>(SAVE_CODEC_NONE)), ToLE32(aRawSize) };
+		const unsigned char* aCodecBytes = reinterpret_cast<const unsigned char*>(&aCodecHeader);
+		theData.insert(theData.begin() + sizeof(SaveFileHeaderV4), aCodecBytes, aCodecBytes + sizeof(aCodecHeader));
+	}
 
 	SaveFileHeaderV4 aHeader{};
 	memcpy(aHeader.mMagic, SAVE_FILE_MAGIC_V4, sizeof(aHeader.mMagic));
-	aHeader.mVersion = ToLE32(SAVE_FILE_V4_VERSION);
-	aHeader.mPayloadSize = ToLE32(static_cast<unsigned int>(aPayload.size()));
-	aHeader.mPayloadCrc = ToLE32(crc32(0, reinterpret_cast<Bytef*>(aPayload.data()), static_cast<unsigned int>(aPayload.size())));
+	aHeader.mVersion = ToLE32(theDelta ? SAVE_FILE_V4_VERSION_DELTA : aUseCodec ? SAVE_FILE_V4_VERSION_COMPRESSED : SAVE_FILE_V4_VERSION);
+	const size_t aPayloadOffset = aUseCodec || theDelta ? aHeaderSize : sizeof(SaveFileHeaderV4);
+	unsigned int aPayloadSize = static_cast<unsigned int>(theData.size() - aPayloadOffset);
+	aHeader.mPayloadSize = ToLE32(aPayloadSize);
+	aHeader.mPayloadCrc = ToLE32(aUseCodec ? crc32(0, theData.data() + aPayloadOffset, aPayloadSize) : thePayloadCrc);
+	memcpy(theData.data(), &aHeader, sizeof(aHeader));
+	return true;
+}
+
+// Packs a raw chunk payload, as returned by DecodeSaveGameV4, into a complete save file.
+bool EncodeSaveGameV4(const unsigned char* thePayload, unsigned int thePayloadSize, int theCodec, std::vector<unsigned char>& theResult)
+{
+	theResult.assign(sizeof(SaveFileHeaderV4), 0);
+	theResult.insert(theResult.end(), thePayload, thePayload + thePayloadSize);
+	return FinishSaveGameV4(theResult, theCodec, crc32(0, thePayload, thePayloadSize));
+}
+
+static void SaveGameDone(const std::string& theFilePath, bool theSuccess)
+{
+	if (!theSuccess)
+		TodTrace("Failed to save game %s", theFilePath.c_str());
+}
+
+// Called whenever theFilePath is replaced by a save that does not refer to a base
+static void ForgetDeltaBase(const std::string& theFilePath)
+{
+	if (gSaveDeltaState.mFilePath == theFilePath)
+		gSaveDeltaState = SaveDeltaStateV4();
+}
+
+//0x4820D0
+bool LawnSaveGame(Board* theBoard, const std::string& theFilePath)
+{
+	std::vector<unsigned char> aData;
+	uint32_t aCrc = 0;
+	if (!SnapshotSaveGameV4(theBoard, aData, aCrc) || !FinishSaveGameV4(aData, gSaveGameCodec, aCrc))
+		return false;
+
+	ForgetDeltaBase(theFilePath);
+	return gSexyAppBase->WriteBytesToFile(theFilePath, aData.data(), static_cast<int>(aData.size()));
+}
 
-	std::vector<unsigned char> aOutBuffer;
-	aOutBuffer.resize(sizeof(aHeader) + aPayload.size());
-	memcpy(aOutBuffer.data(), &aHeader, sizeof(aHeader));
-	memcpy(aOutBuffer.data() + sizeof(aHeader), aPayload.data(), aPayload.size());
+// Ends the wait for the base written by the queued save; a base that did not make it is never referred to
+static void SettleDeltaBaseV4(SaveDeltaStateV4& theState, bool theSuccess)
+{
+	theState.mBasePending = false;
+	theState.mBaseResult.reset();
+	// The file still refers to the other base (if any); the next save writes a base to this index again
+	if (!theSuccess)
+	{
+		theState.mBaseChunks.clear();
+		theState.mBaseIndex ^= 1;
+	}
+}
 
-	return gSexyAppBase->WriteBytesToFile(theFilePath, aOutBuffer.data(), static_cast<int>(aOutBuffer.size()));
+// Queues theFilePath as a delta save: a SAVE4_CHUNK_DELTA_BASE table followed by the chunks that differ from the base.
+// A fresh base is written first when there is none for this file or after SAVE_DELTA_MAX_DELTAS deltas. Otherwise
+// the decision is made per chunk: a chunk that changed since the last save is written by every save with or without
+// a new base, so only the chunks that differ from the base but stayed the same since the last save count. A new base
+// is written once those would cost more over the remaining deltas than the base itself. The base goes to the index
+// the file on disk does not use and is written by the same job, just before the file, so the pair is only replaced
+// once the base is safely on disk.
+static void LawnSaveGameDeltaV4(const std::string& theFilePath, const std::vector<std::vector<unsigned char>>& theChunks, const std::vector<uint32_t>& theChunkCrcs,
+	std::function<void(bool)> theDone, double theSnapshotTime)
+{
+	SaveDeltaStateV4& aState = gSaveDeltaState;
+	if (aState.mBasePending && aState.mFilePath == theFilePath)
+	{
+		// A delta must not be coalesced into the queued job that writes its base. Only that job is waited for,
+		// and its prepare step has recorded whether the base made it, so no other completion runs from here
+		gSexyAppBase->mFileWriter->WaitForFile(theFilePath);
+		SettleDeltaBaseV4(aState, *aState.mBaseResult > 0);
+	}
+
+	const int aNumChunks = LENGTH(SAVE4_CHUNK_ORDER);
+	bool aHaveBase = aState.mFilePath == theFilePath && aState.mBaseChunks.size() == static_cast<size_t>(aNumChunks) && aState.mNumDeltas < SAVE_DELTA_MAX_DELTAS;
+	bool aHaveLast = aState.mFilePath == theFilePath && aState.mLastChunkCrcs.size() == static_cast<size_t>(aNumChunks);
+	std::vector<bool> aInBase(aNumChunks, false);
+	size_t aFullSize = 0;
+	size_t anInlineSize = 0;
+	size_t aStaleSize = 0;
+	for (int i = 0; i < aNumChunks; i++)
+	{
+		aFullSize += theChunks[i].size();
+		aInBase[i] = aHaveBase && !theChunks[i].empty() && theChunks[i] == aState.mBaseChunks[i];
+		if (!aInBase[i])
+		{
+			anInlineSize += theChunks[i].size();
+			if (aHaveLast && aState.mLastChunkCrcs[i] == theChunkCrcs[i] && aState.mLastChunkSizes[i] == theChunks[i].size())
+				aStaleSize += theChunks[i].size();
+		}
+	}
+
+	std::shared_ptr<std::vector<unsigned char>> aBaseData;
+	std::shared_ptr<std::atomic<int>> aBaseResult;
+	std::string aBaseName;
+	if (!aHaveBase || aStaleSize * (SAVE_DELTA_MAX_DELTAS - aState.mNumDeltas) > aFullSize)
+	{
+		aBaseData = std::make_shared<std::vector<unsigned char>>();
+		aBaseResult = std::make_shared<std::atomic<int>>(0);
+		uint32_t aBaseCrc = 0;
+		AssembleSaveGameV4(theChunks, theChunkCrcs, *aBaseData, aBaseCrc);
+
+		aState.mBaseIndex = aState.mFilePath == theFilePath ? aState.mBaseIndex ^ 1 : 0;
+		aState.mFilePath = theFilePath;
+		aState.mBaseCrc = aBaseCrc;
+		aState.mBaseChunks = theChunks;
+		aState.mNumDeltas = 0;
+		aState.mBasePending = true;
+		aState.mBaseResult = aBaseResult;
+		aBaseName = GetDeltaBaseName(theFilePath, aState.mBaseIndex);
+		for (int i = 0; i < aNumChunks; i++)
+			aInBase[i] = !theChunks[i].empty();
+		anInlineSize = 0;
+	}
+	else
+		aState.mNumDeltas++;
+	aState.mLastChunkCrcs = theChunkCrcs;
+	aState.mLastChunkSizes.resize(aNumChunks);
+	for (int i = 0; i < aNumChunks; i++)
+		aState.mLastChunkSizes[i] = theChunks[i].size();
+
+	std::vector<unsigned char> aTable;
+	int aNumEntries = 0;
+	AppendU32LE(aTable, aState.mBaseIndex);
+	AppendU32LE(aTable, aState.mBaseCrc);
+	AppendU32LE(aTable, 0);
+	for (int i = 0; i < aNumChunks; i++)
+	{
+		if (theChunks[i].empty())
+			continue;
+		AppendU32LE(aTable, SAVE4_CHUNK_ORDER[i]);
+		AppendU32LE(aTable, static_cast<uint32_t>(theChunks[i].size() - SAVE_CHUNK_RECORD_HEADER));
+		AppendU32LE(aTable, theChunkCrcs[i]);
+		AppendU32LE(aTable, aInBase[i] ? 1 : 0);
+		aNumEntries++;
+	}
+	uint32_t aNumEntriesLE = ToLE32(static_cast<uint32_t>(aNumEntries));
+	memcpy(aTable.data() + 8, &aNumEntriesLE, sizeof(aNumEntriesLE));
+
+	std::vector<unsigned char> aData;
+	aData.reserve(sizeof(SaveFileHeaderV4) + SAVE_CHUNK_RECORD_HEADER + aTable.size() + anInlineSize);
+	aData.assign(sizeof(SaveFileHeaderV4), 0);
+	AppendChunk(aData, SAVE4_CHUNK_DELTA_BASE, aTable);
+	uLong aCrc = crc32(0, aData.data() + sizeof(SaveFileHeaderV4), static_cast<uInt>(aData.size() - sizeof(SaveFileHeaderV4)));
+	for (int i = 0; i < aNumChunks; i++)
+		if (!aInBase[i])
+			AppendChunkRecordV4(aData, aCrc, theChunks[i], theChunkCrcs[i]);
+
+	TodTrace("Delta save %s: %s, %d bytes of %d written (%.2f ms snapshot)", theFilePath.c_str(), aBaseData ? "new base" : "delta",
+		static_cast<int>(aData.size() + (aBaseData ? aBaseData->size() : 0)), static_cast<int>(aFullSize + sizeof(SaveFileHeaderV4)), theSnapshotTime);
+
+	int aCodec = gSaveGameCodec;
+	uint32_t aPayloadCrc = static_cast<uint32_t>(aCrc);
+	auto aPrepare = [aCodec, aPayloadCrc, aBaseData, aBaseResult, aBaseName, aBaseCrc = aState.mBaseCrc](std::vector<unsigned char>& theData)
+	{
+		if (aBaseData)
+		{
+			bool aBaseWritten = FinishSaveGameV4(*aBaseData, aCodec, aBaseCrc) && WriteDeltaBaseV4(aBaseName, *aBaseData);
+			aBaseResult->store(aBaseWritten ? 1 : -1);
+			if (!aBaseWritten)
+				return false;
+		}
+		return FinishSaveGameV4(theData, aCodec, aPayloadCrc, true);
+	};
+	auto aDone = [theFilePath, aBaseResult, theDone = std::move(theDone)](bool theSuccess)
+	{
+		// Unless the next save already settled the base while waiting for this job
+		SaveDeltaStateV4& aState = gSaveDeltaState;
+		if (aBaseResult && aState.mBasePending && aState.mBaseResult == aBaseResult)
+			SettleDeltaBaseV4(aState, theSuccess);
+		theDone(theSuccess);
+	};
+	gSexyAppBase->WriteBytesToFileAsync(theFilePath, std::move(aData), aPrepare, aDone);
+}
+
+// Takes the snapshot now and leaves the compression and the write to the file writer thread.
+// Returns false only if the snapshot failed; write errors are reported to theDone.
+bool LawnSaveGameAsync(Board* theBoard, const std::string& theFilePath, std::function<void(bool)> theDone)
+{
+	if (!theDone)
+		theDone = [theFilePath](bool theSuccess) { SaveGameDone(theFilePath, theSuccess); };
+
+	if (gSaveGameDelta)
+	{
+		PerfTimer aTimer;
+		aTimer.Start();
+		std::vector<std::vector<unsigned char>> aChunks;
+		std::vector<uint32_t> aChunkCrcs;
+		if (!SerializeChunksV4(theBoard, aChunks, aChunkCrcs))
+			return false;
+
+		aTimer.Stop();
+		LawnSaveGameDeltaV4(theFilePath, aChunks, aChunkCrcs, std::move(theDone), aTimer.GetDuration());
+		return true;
+	}
+
+	std::vector<unsigned char> aData;
+	uint32_t aCrc = 0;
+	if (!SnapshotSaveGameV4(theBoard, aData, aCrc))
+		return false;
+
+	ForgetDeltaBase(theFilePath);
+	int aCodec = gSaveGameCodec;
+	gSexyAppBase->WriteBytesToFileAsync(theFilePath, std::move(aData), [aCodec, aCrc](std::vector<unsigned char>& theData) { return FinishSaveGameV4(theData, aCodec, aCrc); }, std::move(theDone));
+	return true;
+}
+
+// Writes theBoard to theFilePath as a delta save and waits until it is on disk. theTimings.mSerialize gets the
+// snapshot time and mWrite the rest, compression included; mSize is set to the bytes this save wrote, base included.
+bool LawnSaveGameDeltaTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings)
+{
+	PerfTimer aTimer;
+	aTimer.Start();
+	std::vector<std::vector<unsigned char>> aChunks;
+	std::vector<uint32_t> aChunkCrcs;
+	if (!SerializeChunksV4(theBoard, aChunks, aChunkCrcs))
+		return false;
+	double aSerializeTime = aTimer.GetDuration();
+	theTimings.mSerialize += aSerializeTime;
+
+	aTimer.Start();
+	bool aSuccess = false;
+	LawnSaveGameDeltaV4(theFilePath, aChunks, aChunkCrcs, [&aSuccess](bool theSuccess) { aSuccess = theSuccess; }, aSerializeTime);
+	gSexyAppBase->mFileWriter->WaitForFile(theFilePath);
+	gSexyAppBase->mFileWriter->DispatchCompletions();
+	theTimings.mWrite += aTimer.GetDuration();
+
+	std::error_code anError;
+	uintmax_t aSize = std::filesystem::file_size(PathFromU8(theFilePath), anError);
+	if (aSuccess && gSaveDeltaState.mNumDeltas == 0)  // a new base was written as well
+		aSize += std::filesystem::file_size(PathFromU8(GetDeltaBaseName(theFilePath, gSaveDeltaState.mBaseIndex)), anError);
+	theTimings.mSize = anError ? 0 : static_cast<int>(aSize);
+	return aSuccess;
+}
+
+// Writes theBoard to theFilePath like LawnSaveGame, adding the time of each step to theTimings.
+// thePayload receives the uncompressed payload for LawnCompareSaveGame.
+bool LawnSaveGameTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings, std::vector<unsigned char>& thePayload)
+{
+	PerfTimer aTimer;
+	aTimer.Start();
+	std::vector<std::vector<unsigned char>> aChunks;
+	std::vector<uint32_t> aChunkCrcs;
+	if (!SerializeChunksV4(theBoard, aChunks, aChunkCrcs))
+		return false;
+	std::vector<unsigned char> aData;
+	uint32_t aCrc = 0;
+	AssembleSaveGameV4(aChunks, aChunkCrcs, aData, aCrc);
+	theTimings.mSerialize += aTimer.GetDuration();
+
+	// The save path folds the crc into the serialization tasks; this measures a plain pass over the payload
+	aTimer.Start();
+	uint32_t aCheckCrc = static_cast<uint32_t>(crc32(0, aData.data() + sizeof(SaveFileHeaderV4), static_cast<uInt>(aData.size() - sizeof(SaveFileHeaderV4))));
+	theTimings.mCrc += aTimer.GetDuration();
+	if (aCheckCrc != aCrc)
+		return false;
+
+	thePayload.assign(aData.begin() + sizeof(SaveFileHeaderV4), aData.end());
+	aTimer.Start();
+	if (!FinishSaveGameV4(aData, gSaveGameCodec, aCrc))
+		return false;
+	theTimings.mEncode += aTimer.GetDuration();
+
+	aTimer.Start();
+	ForgetDeltaBase(theFilePath);
+	bool aSuccess = gSexyAppBase->WriteBytesToFile(theFilePath, aData.data(), static_cast<int>(aData.size()));
+	theTimings.mWrite += aTimer.GetDuration();
+	theTimings.mSize = static_cast<int>(aData.size());
+	return aSuccess;
+}
+
+bool LawnLoadGameTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings)
+{
+	return LawnLoadGameV4(theBoard, theFilePath, &theTimings);
+}
+
+bool LawnLoadGameFromData(Board* theBoard, const unsigned char* theData, size_t theSize)
+{
+	return LawnLoadGameDataV4(theBoard, theData, theSize, std::string(), nullptr);
+}
+
+// Serializes theBoard again and lists the chunk types whose data differs from thePayload
+bool LawnCompareSaveGame(Board* theBoard, const std::vector<unsigned char>& thePayload, std::vector<uint32_t>& theDiffs)
+{
+	std::vector<std::vector<unsigned char>> aChunks;
+	std::vector<uint32_t> aChunkCrcs;
+	std::vector<SaveChunkRefV4> anExpected;
+	if (!SerializeChunksV4(theBoard, aChunks, aChunkCrcs) || !ParseChunksV4(thePayload.data(), static_cast<unsigned int>(thePayload.size()), anExpected))
+		return false;
+
+	theDiffs.clear();
+	for (size_t i = 0; i < LENGTH(SAVE4_CHUNK_ORDER); i++)
+	{
+		const SaveChunkRefV4* aMatch = nullptr;
+		for (const SaveChunkRefV4& aChunk : anExpected)
+			if (aChunk.mType == SAVE4_CHUNK_ORDER[i])
+				aMatch = &aChunk;
+
+		const std::vector<unsigned char>& aChunk = aChunks[i];
+		bool aEqual = aChunk.empty() ? aMatch == nullptr :
+			aMatch != nullptr && aMatch->mSize == aChunk.size() - SAVE_CHUNK_RECORD_HEADER && memcmp(aMatch->mData, aChunk.data() + SAVE_CHUNK_RECORD_HEADER, aMatch->mSize) == 0;
+		if (!aEqual)
+			theDiffs.push_back(SAVE4_CHUNK_ORDER[i]);
+	}
+	return true;
+}
+
+// Removes a save together with the base files of its delta saves
+void LawnEraseSaveGame(const std::string& theFilePath)
+{
+	ForgetDeltaBase(theFilePath);
+	gSexyAppBase->EraseFile(theFilePath);
+	gSexyAppBase->EraseFile(GetDeltaBaseName(theFilePath, 0));
+	gSexyAppBase->EraseFile(GetDeltaBaseName(theFilePath, 1));
 }
 
 bool LawnSaveGameLegacy(Board* theBoard, const std::string& theFilePath)
@@ -2986,3 +3712,13 @@ bool LawnSaveGameLegacy(Board* theBoard, const std::string& theFilePath)
 	SyncBoard(aContext, theBoard);
 	return gSexyAppBase->WriteBufferToFile(theFilePath, &aContext.mBuffer);
 }
+
+// Legacy saves are no longer written when the game saves; this produces one on demand from a .v4 save.
+// theBoard receives the loaded game and should be a fresh board that is discarded afterwards.
+bool LawnExportLegacySave(Board* theBoard, const std::string& theFilePath, const std::string& theLegacyFilePath)
+{
+	if (!LawnLoadGameV4(theBoard, theFilePath))
+		return false;
+
+	return LawnSaveGameLegacy(theBoard, theLegacyFilePath);
+}
@@ -2,6 +2,9 @@
 #define __SAVEGAMECONTEXT_H__
 
 #include <string>
+#include <functional>
+#include <vector>
+#include <cstdint>
 #include "../../Sexy.TodLib/TodList.h"
 #include "misc/Buffer.h"
 
@@ -19,6 +22,31 @@ namespace Sexy
 }
 using namespace Sexy;
 
+enum SaveGameCodec
+{
+    SAVE_CODEC_NONE = 0,
+    SAVE_CODEC_LZ4 = 1,
+    SAVE_CODEC_ZLIB = 2,
+    NUM_SAVE_CODECS
+};
+
+extern int          gSaveGameCodec;     // codec for new .v4 saves; files that do not shrink are stored uncompressed
+extern bool         gSaveGameDelta;     // background saves only store the chunks that changed since a base file
+
+// Time in milliseconds spent in each step of LawnSaveGameTimed and LawnLoadGameTimed
+struct SaveGameTimings
+{
+    double          mSerialize = 0.0;   // chunks, including their crc32
+    double          mCrc = 0.0;         // one crc32 pass over the payload
+    double          mEncode = 0.0;      // header and compression
+    double          mWrite = 0.0;
+    double          mRead = 0.0;
+    double          mDecode = 0.0;      // header check, decompression and chunk list
+    double          mParse = 0.0;       // reading the chunks into the board
+    double          mFixUp = 0.0;       // FixBoardAfterLoad
+    int             mSize = 0;          // bytes on disk
+};
+
 struct SaveFileHeader
 {
     unsigned int    mMagicNumber;
@@ -54,5 +82,16 @@ void				FixBoardAfterLoad(Board* theBoard);
 bool				LawnLoadGame(Board* theBoard, const std::string& theFilePath);
 bool				LawnSaveGame(Board* theBoard, const std::string& theFilePath);
 bool				LawnSaveGameLegacy(Board* theBoard, const std::string& theFilePath);
+bool				LawnSaveGameAsync(Board* theBoard, const std::string& theFilePath, std::function<void(bool)> theDone = nullptr);
+bool				LawnSaveGameDeltaTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings);
+bool				LawnSaveGameTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings, std::vector<unsigned char>& thePayload);
+bool				LawnLoadGameTimed(Board* theBoard, const std::string& theFilePath, SaveGameTimings& theTimings);
+bool				LawnLoadGameFromData(Board* theBoard, const unsigned char* theData, size_t theSize);    // a whole .v4 file; delta saves are rejected
+bool				LawnCompareSaveGame(Board* theBoard, const std::vector<unsigned char>& thePayload, std::vector<uint32_t>& theDiffs);
+void				LawnEraseSaveGame(const std::string& theFilePath);
+bool				LawnExportLegacySave(Board* theBoard, const std::string& theFilePath, const std::string& theLegacyFilePath);
+bool				EncodeSaveGameV4(const unsigned char* thePayload, unsigned int thePayloadSize, int theCodec, std::vector<unsigned char>& theResult);
+bool				DecodeSaveGameV4(const unsigned char* theData, size_t theSize, std::vector<unsigned char>& theBuffer, const unsigned char*& thePayload, unsigned int& thePayloadSize);
+const char*			SaveGameGetCodecName(int theCodec);
 
 #endif
@@ -1171,7 +1171,7 @@ void GameSelector::KeyChar(char theChar)
 				mApp->mPlayerInfo->mChallengeRecords[i - 1] = 20;
 		SyncProfile(true);
 
-		mApp->EraseFile(GetSavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
+		LawnEraseSaveGame(GetSavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
 		mApp->EraseFile(GetLegacySavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
 	}
 
@@ -1248,7 +1248,7 @@ void GameSelector::ClickedAdventure()
 
 		mApp->mPlayerInfo->mLevel = 24;
 		mApp->mPlayerInfo->mFinishedAdventure = 0;
-		mApp->EraseFile(GetSavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
+		LawnEraseSaveGame(GetSavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
 		mApp->EraseFile(GetLegacySavedGameName(GameMode::GAMEMODE_ADVENTURE, mApp->mPlayerInfo->mId));
 	}
 
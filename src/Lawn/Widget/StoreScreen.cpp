@@ -971,7 +971,7 @@ void StoreScreen::PurchaseItem(StoreItem theStoreItem)
             }
             else if (theStoreItem == STORE_ITEM_STINKY_THE_SNAIL)
             {
-                uint32_t aTime = static_cast<uint32_t>(time(0));
+                uint32_t aTime = static_cast<uint32_t>(mApp->GetWallTime());
                 if (aTime == 0) aTime = 1;
                 mApp->mPlayerInfo->mPurchases[theStoreItem] = aTime;
             }
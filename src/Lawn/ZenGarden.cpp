@@ -500,7 +500,7 @@ void ZenGarden::MouseDownWithMoneySign(Plant* thePlant)
 void ZenGarden::PlantFertilized(Plant* thePlant)
 {
     PottedPlant* aPottedPlant = PottedPlantFromIndex(thePlant->mPottedPlantIndex);
-    aPottedPlant->mLastFertilizedTime = static_cast<int64_t>(time(0));
+    aPottedPlant->mLastFertilizedTime = mApp->GetWallTime();
     aPottedPlant->mPlantAge = static_cast<PottedPlantAge>(static_cast<int>(aPottedPlant->mPlantAge) + 1);
     aPottedPlant->mPlantNeed = PottedPlantNeed::PLANTNEED_NONE;
     aPottedPlant->mTimesFed = 0;
@@ -545,7 +545,7 @@ void ZenGarden::PlantFertilized(Plant* thePlant)
 void ZenGarden::PlantFulfillNeed(Plant* thePlant)
 {
     PottedPlant* aPottedPlant = PottedPlantFromIndex(thePlant->mPottedPlantIndex);
-    aPottedPlant->mLastNeedFulfilledTime = static_cast<int64_t>(time(0));
+    aPottedPlant->mLastNeedFulfilledTime = mApp->GetWallTime();
     aPottedPlant->mPlantNeed = PottedPlantNeed::PLANTNEED_NONE;
     aPottedPlant->mTimesFed = 0;
 
@@ -624,7 +624,7 @@ void ZenGarden::PlantWatered(Plant* thePlant)
     {
         aTimeSpan = 9;
     }
-    aPottedPlant->mLastWateredTime = static_cast<int64_t>(time(0)) - aTimeSpan;
+    aPottedPlant->mLastWateredTime = mApp->GetWallTime() - aTimeSpan;
 
     mApp->PlayFoley(FoleyType::FOLEY_SPAWN_SUN);
     mBoard->AddCoin(thePlant->mX + 40, thePlant->mY, CoinType::COIN_SILVER, CoinMotion::COIN_MOTION_COIN);
@@ -747,7 +747,7 @@ void ZenGarden::RemoveHappyEffect(Plant* thePlant)
 //0x51E890
 bool ZenGarden::WasPlantNeedFulfilledToday(PottedPlant* thePottedPlant)
 {
-    time_t aNowTime = time(0);
+    time_t aNowTime = mApp->GetWallTime();
     int64_t aNow = static_cast<int64_t>(aNowTime);
     if (aNow - thePottedPlant->mLastNeedFulfilledTime < 3600)
     {
@@ -763,7 +763,7 @@ bool ZenGarden::WasPlantNeedFulfilledToday(PottedPlant* thePottedPlant)
 //0x51E910
 bool ZenGarden::PlantShouldRefreshNeed(PottedPlant* thePottedPlant)
 {
-    time_t aNowTime = time(0);
+    time_t aNowTime = mApp->GetWallTime();
     int64_t aNow = static_cast<int64_t>(aNowTime);
     if (aNow - thePottedPlant->mLastWateredTime < 3600)
     {
@@ -786,7 +786,7 @@ void ZenGarden::RefreshPlantNeeds(PottedPlant* thePottedPlant)
 
     if (Plant::IsAquatic(thePottedPlant->mSeedType))
     {
-        thePottedPlant->mLastWateredTime = static_cast<int64_t>(time(0));
+        thePottedPlant->mLastWateredTime = mApp->GetWallTime();
         thePottedPlant->mPlantNeed = static_cast<PottedPlantNeed>(
             RandRangeInt(static_cast<int>(PottedPlantNeed::PLANTNEED_BUGSPRAY),
                 static_cast<int>(PottedPlantNeed::PLANTNEED_PHONOGRAPH)));
@@ -815,7 +815,7 @@ void ZenGarden::UpdatePlantNeeds()
 
 bool ZenGarden::WasPlantFertilizedInLastHour(PottedPlant* thePottedPlant)
 {
-    return static_cast<int64_t>(time(0)) - thePottedPlant->mLastFertilizedTime < 3600;
+    return mApp->GetWallTime() - thePottedPlant->mLastFertilizedTime < 3600;
 }
 
 //0x51EA30
@@ -832,7 +832,7 @@ PottedPlantNeed ZenGarden::GetPlantsNeed(PottedPlant* thePottedPlant)
         return PottedPlantNeed::PLANTNEED_NONE;
     }
 
-    int64_t aNow = static_cast<int64_t>(time(0));
+    int64_t aNow = mApp->GetWallTime();
     bool aTooLongSinceWatering = aNow - thePottedPlant->mLastWateredTime > 15;
     bool aTooShortSinceWatering = aNow - thePottedPlant->mLastWateredTime < 3;
 
@@ -911,7 +911,7 @@ void ZenGarden::MouseDownWithFeedingTool(int x, int y, CursorType theCursorType)
         {
             WakeStinky();
             mApp->AddTodParticle(aStinky->mPosX + 40.0f, aStinky->mPosY + 40.0f, aStinky->mRenderOrder + 1, ParticleEffect::PARTICLE_PRESENT_PICKUP);
-            mApp->mPlayerInfo->mLastStinkyChocolateTime = static_cast<uint32_t>(time(0));
+            mApp->mPlayerInfo->mLastStinkyChocolateTime = static_cast<uint32_t>(mApp->GetWallTime());
             mApp->mPlayerInfo->mPurchases[StoreItem::STORE_ITEM_CHOCOLATE]--;
 
             mApp->PlayFoley(FoleyType::FOLEY_WAKEUP);
@@ -997,7 +997,7 @@ void ZenGarden::MouseDownWithFeedingTool(int x, int y, CursorType theCursorType)
 void ZenGarden::FeedChocolateToPlant(Plant* thePlant)
 {
     PottedPlant* aPottedPlant = PottedPlantFromIndex(thePlant->mPottedPlantIndex);
-    aPottedPlant->mLastChocolateTime = static_cast<int64_t>(time(0));
+    aPottedPlant->mLastChocolateTime = mApp->GetWallTime();
     thePlant->mLaunchCounter = 60;
     mApp->AddTodParticle(thePlant->mX + 40.0f, thePlant->mY + 40.0f, thePlant->mRenderOrder + 1, ParticleEffect::PARTICLE_PRESENT_PICKUP);
 }
@@ -1284,7 +1284,7 @@ void ZenGarden::AddStinky()
     if (!mApp->mPlayerInfo->mHasSeenStinky)
     {
         mApp->mPlayerInfo->mHasSeenStinky = 1;
-        uint32_t aTime = static_cast<uint32_t>(time(0));
+        uint32_t aTime = static_cast<uint32_t>(mApp->GetWallTime());
         if (aTime == 0) aTime = 1;
         mApp->mPlayerInfo->mPurchases[StoreItem::STORE_ITEM_STINKY_THE_SNAIL] = aTime;
     }
@@ -2247,7 +2247,7 @@ void ZenGarden::SetPlantAnimSpeed(Plant* thePlant)
 int ZenGarden::PlantGetMinutesSinceHappy(Plant* thePlant)
 {
     PottedPlant* aPottedPlant = PottedPlantFromIndex(thePlant->mPottedPlantIndex);
-    int aMinutes = static_cast<int>((static_cast<int64_t>(time(0)) - aPottedPlant->mLastNeedFulfilledTime) / 60);
+    int aMinutes = static_cast<int>((mApp->GetWallTime() - aPottedPlant->mLastNeedFulfilledTime) / 60);
     if (PlantHighOnChocolate(aPottedPlant))
     {
         aMinutes = 0;
@@ -2294,7 +2294,7 @@ void ZenGarden::ResetPlantTimers(PottedPlant* thePottedPlant)
 void ZenGarden::PottedPlantUpdate(Plant* thePlant)
 {
     PottedPlant* aPottedPlant = PottedPlantFromIndex(thePlant->mPottedPlantIndex);
-    int64_t aNow = static_cast<int64_t>(time(0));
+    int64_t aNow = mApp->GetWallTime();
     if (aPottedPlant->mLastWateredTime > aNow || 
         aPottedPlant->mLastNeedFulfilledTime > aNow || 
         aPottedPlant->mLastFertilizedTime > aNow || 
@@ -2360,7 +2360,7 @@ void ZenGarden::DrawPlantOverlay(Graphics* g, Plant* thePlant)
 //0x521FE0
 void ZenGarden::WakeStinky()
 {
-    uint32_t aTime = static_cast<uint32_t>(time(0));
+    uint32_t aTime = static_cast<uint32_t>(mApp->GetWallTime());
     if (aTime == 0) aTime = 1;
     mApp->mPlayerInfo->mPurchases[StoreItem::STORE_ITEM_STINKY_THE_SNAIL] = aTime;
     mApp->PlaySample(SOUND_TAP);
@@ -2372,12 +2372,12 @@ void ZenGarden::WakeStinky()
 bool ZenGarden::IsStinkyHighOnChocolate()
 {
     // Unsigned arithmetic extends limit to 2106 and handles wrap-around correctly so that after 2106 is also OK.
-    return static_cast<uint32_t>(time(0)) - mApp->mPlayerInfo->mLastStinkyChocolateTime < 3600;
+    return static_cast<uint32_t>(mApp->GetWallTime()) - mApp->mPlayerInfo->mLastStinkyChocolateTime < 3600;
 }
 
 bool ZenGarden::PlantHighOnChocolate(PottedPlant* thePottedPlant)
 {
-    return static_cast<int64_t>(time(0)) - thePottedPlant->mLastChocolateTime < 300;
+    return mApp->GetWallTime() - thePottedPlant->mLastChocolateTime < 300;
 }
 
 bool ZenGarden::IsStinkySleeping()
@@ -2394,7 +2394,7 @@ bool ZenGarden::ShouldStinkyBeAwake()
         return true;
     }
     // Unsigned arithmetic extends limit to 2106 and handles wrap-around correctly.
-    return static_cast<uint32_t>(time(0)) -
+    return static_cast<uint32_t>(mApp->GetWallTime()) -
         static_cast<uint32_t>(mApp->mPlayerInfo->mPurchases[StoreItem::STORE_ITEM_STINKY_THE_SNAIL]) < 180;
 }
 
@@ -9,6 +9,7 @@
 #include "Lawn/Challenge.h"
 #include "Lawn/ZenGarden.h"
 #include "Sexy.TodLib/Trail.h"
+#include "Sexy.TodLib/Definition.h"
 #include "Lawn/System/Music.h"
 #include "Lawn/System/SaveGame.h"
 #include "Sexy.TodLib/TodDebug.h"
@@ -32,6 +33,7 @@
 #include "Sexy.TodLib/FilterEffect.h"
 #include "graphics/Graphics.h"
 #include "Sexy.TodLib/TodStringFile.h"
+#include "Sexy.TodLib/TodTaskGraph.h"
 #include "Lawn/Widget/AlmanacDialog.h"
 #include "Lawn/Widget/NewUserDialog.h"
 #include "Lawn/Widget/ContinueDialog.h"
@@ -41,6 +43,11 @@
 #include "Lawn/Widget/SeedChooserScreen.h"
 #include "widget/WidgetManager.h"
 #include "misc/ResourceManager.h"
+#include "misc/SelfTest.h"
+#include "imagelib/ImageLib.h"
+#include "imagelib/PixelKernels.h"
+#include "paklib/PakInterface.h"
+#include "graphics/GLInterface.h"
 
 #include "widget/Checkbox.h"
 #include "widget/Dialog.h"
@@ -113,6 +120,10 @@ LawnApp::LawnApp()
 	mSfxVolume = 0.5525;
 	mAutoStartLoadingThread = false;
 	mDebugKeysEnabled = false;
+	mBenchmarkPixelKernels = false;
+	mTextureBudgetMB = 0;
+	mRunSelfTests = false;
+	mLoadingTaskGraph = nullptr;
 	mProdName = "io.github.wszqkzqk.pvz-portable";
 	std::string aTitleName = "PvZ Portable";
 	mTitle = aTitleName;
@@ -236,6 +247,7 @@ LawnApp::~LawnApp()
 
 	delete mProfileMgr;
 	delete mLastLevelStats;
+	delete mLoadingTaskGraph.load();
 
 	mResourceManager->DeleteResources("");
 	/*
@@ -323,7 +335,7 @@ void LawnApp::KillBoard()
 			mBoardResult == BoardResult::BOARDRESULT_CHEAT))
 		{
 			std::string aFileName = GetSavedGameName(mGameMode, mPlayerInfo->mId);
-			EraseFile(aFileName);
+			LawnEraseSaveGame(aFileName);
 			std::string aLegacyFileName = GetLegacySavedGameName(mGameMode, mPlayerInfo->mId);
 			EraseFile(aLegacyFileName);
 		}
@@ -421,7 +433,7 @@ void LawnApp::PreNewGame(GameMode theGameMode, bool theLookForSavedGame)
 		return;
 
 	std::string aFileName = GetSavedGameName(mGameMode, mPlayerInfo->mId);
-	EraseFile(aFileName);
+	LawnEraseSaveGame(aFileName);
 	std::string aLegacyFileName = GetLegacySavedGameName(mGameMode, mPlayerInfo->mId);
 	EraseFile(aLegacyFileName);
 	NewGame();
@@ -1287,6 +1299,19 @@ void LawnApp::Init()
 	mSawYeti = false;
 
 	SexyApp::Init();
+	if (mPlayingDemoBuffer || mRecordingDemoBuffer)
+	{
+		// 录像回放时关卡随机种子必须与录制时一致
+		mAppRandSeed = mRandSeed;
+	}
+	if (!mRenderStatsFile.empty() && !mGLInterface->StartRenderStatsLog(mRenderStatsFile))
+	{
+		TodTrace("Couldn't open render stats log %s", mRenderStatsFile.c_str());
+	}
+	if (mTextureBudgetMB > 0)
+	{
+		mGLInterface->SetTextureBudget((int64_t)mTextureBudgetMB << 20);
+	}
 	// @Patoke: horrible debug checks, breaks the whole exe in release mode
 //#ifdef _PVZ_DEBUG
 	TodAssertInitForApp();
@@ -1395,6 +1420,16 @@ void LawnApp::Start()
 //0x4522C0
 bool LawnApp::DebugKeyDown(int theKey)
 {
+	// F11：运行中开始/停止记录渲染统计（每次开始都会覆盖 -renderstats 指定的文件）
+	if (theKey == KeyCode::KEYCODE_F11 && mGLInterface != nullptr)
+	{
+		if (mGLInterface->IsRenderStatsLogging())
+			mGLInterface->StopRenderStatsLog();
+		else if (!mGLInterface->StartRenderStatsLog(mRenderStatsFile.empty() ? "renderstats.csv" : mRenderStatsFile))
+			TodTrace("Couldn't open render stats log %s", mRenderStatsFile.c_str());
+		return true;
+	}
+
 	return SexyAppBase::DebugKeyDown(theKey);
 }
 
@@ -1408,6 +1443,46 @@ void LawnApp::HandleCmdLineParam(const std::string& theParamName, const std::str
 		mDebugKeysEnabled = true;
 #endif
 	}
+	else if (theParamName == "-renderstats")
+	{
+		mRenderStatsFile = theParamValue.empty() ? "renderstats.csv" : theParamValue;
+	}
+	else if (theParamName == "-texbudget")
+	{
+		mTextureBudgetMB = std::max(atoi(theParamValue.c_str()), 0);
+	}
+	else if (theParamName == "-defthreads")
+	{
+		gDefinitionLoadThreads = std::max(atoi(theParamValue.c_str()), 0);
+	}
+	else if (theParamName == "-defcodec")
+	{
+		for (int aCodec = 0; aCodec < NUM_DEFINITION_CODECS; aCodec++)
+			if (theParamValue == DefinitionGetCodecName(aCodec))
+				gDefinitionCompiledCodec = aCodec;
+	}
+	else if (theParamName == "-savecodec")
+	{
+		for (int aCodec = 0; aCodec < NUM_SAVE_CODECS; aCodec++)
+			if (theParamValue == SaveGameGetCodecName(aCodec))
+				gSaveGameCodec = aCodec;
+	}
+	else if (theParamName == "-savedelta")
+	{
+		gSaveGameDelta = true;
+	}
+	else if (theParamName == "-selftest")
+	{
+		mRunSelfTests = true;
+	}
+	else if (theParamName == "-savebench")
+	{
+		mBenchmarkSaveDir = theParamValue.empty() ? GetAppDataPath("userdata") : theParamValue;
+	}
+	else if (theParamName == "-pixelbench")
+	{
+		mBenchmarkPixelKernels = true;
+	}
 	else
 	{
 		SexyApp::HandleCmdLineParam(theParamName, theParamValue);
@@ -1726,29 +1801,58 @@ void LawnApp::ToggleFastMo()
 }
 
 //0x452740
-void LawnApp::LoadGroup(const char* theGroupName, int theGroupAveMsToLoad)
+bool LawnApp::LoadGroup(const char* theGroupName)
 {
-	PerfTimer aTimer;
-	aTimer.Start();
-
-	mResourceManager->StartLoadResources(theGroupName);
-	while (!mShutdown && !mCloseRequest && !mLoadingFailed && TodLoadNextResource())
+	// 资源管理器的分组迭代不可重入，同一时刻仅有一个分组在加载（见任务图的资源通道）；
+	// 逐个资源加锁，使并行加载的定义能在两个资源之间按名称取得贴图
+	{
+		std::scoped_lock aLock(gDefinitionResourceLock);
+		mResourceManager->StartLoadResources(theGroupName);
+	}
+	while (!mShutdown && !mCloseRequest && !mLoadingFailed)
 	{
-		mCompletedLoadingThreadTasks += theGroupAveMsToLoad;
+		{
+			std::scoped_lock aLock(gDefinitionResourceLock);
+			if (!TodLoadNextResource())
+				break;
+		}
+		AdvanceLoadingProgress(1);
 	}
 
 	if (mShutdown || mCloseRequest)
-		return;
+		return false;
 
+	std::scoped_lock aLock(gDefinitionResourceLock);
 	if (mResourceManager->HadError() || !ExtractResourcesByName(mResourceManager, theGroupName))
 	{
 		ShowResourceError();
 		mLoadingFailed = true;
 	}
+	return !mLoadingFailed;
+}
 
-	//int aTotalGroupWeight = mResourceManager->GetNumResources(theGroupName) * theGroupAveMsToLoad;
-	//int aGroupTime = max(aTimer.GetDuration(), 0.0);
-	//TraceLoadGroup(theGroupName, aGroupTime, aTotalGroupWeight, theGroupAveMsToLoad);
+// 任务的预计耗时取自上次启动时的实测值，首次启动时使用原版手调的权重
+int LawnApp::GetLoadingTaskCost(const char* theTaskName, int theDefaultCost)
+{
+	int aCost;
+	if (RegistryReadInteger(StrFormat("LoadingCost_%s", theTaskName), &aCost) && aCost > 0)
+		return aCost;
+	return theDefaultCost;
+}
+
+// 为当前加载任务推进进度；不在加载任务图中时（如游戏选择界面的预加载）沿用旧的计数
+void LawnApp::AdvanceLoadingProgress(int theTasks)
+{
+	if (!TodTaskGraph::AdvanceCurrentTask(theTasks))
+		mCompletedLoadingThreadTasks += theTasks;
+}
+
+double LawnApp::GetLoadingThreadProgress()
+{
+	TodTaskGraph* aGraph = mLoadingTaskGraph;
+	if (!mLoaded && aGraph != nullptr)
+		return aGraph->GetProgress();
+	return SexyApp::GetLoadingThreadProgress();
 }
 
 //0x4528E0
@@ -1764,65 +1868,307 @@ void LawnApp::LoadingThreadProc()
 		mTitleScreen->mLoaderScreenIsLoaded = true;
 	}
 
-	const char* groups[] = { "LoadingFonts", "LoadingImages", "LoadingSounds" };
-	int group_ave_ms_to_load[] = { 54, 9, 54 };
-	for (int i = 0; i < 3; i++)
+	TodHesitationTrace("start loading");
+
+	// 各阶段只依赖其实际用到的资源，音乐、音效与定义加载可与贴图加载并行，标题界面就绪的时刻受关键路径约束。
+	// 三个资源分组共用资源管理器的分组迭代器，因此位于同一互斥通道上。
+	const int LOADING_LANE_RESOURCES = 0;
+	TodTaskGraph* aGraph = new TodTaskGraph();
+
+	int aNumImages = mResourceManager->GetNumResources("LoadingImages");
+	int aImages = aGraph->AddTask("images", GetLoadingTaskCost("images", aNumImages * 9), [this]() { return LoadGroup("LoadingImages"); }, {}, LOADING_LANE_RESOURCES);
+	aGraph->SetTaskUnits(aImages, aNumImages);
+
+	int aNumFonts = mResourceManager->GetNumResources("LoadingFonts");
+	int aFonts = aGraph->AddTask("fonts", GetLoadingTaskCost("fonts", aNumFonts * 54), [this]() { return LoadGroup("LoadingFonts"); }, {}, LOADING_LANE_RESOURCES);
+	aGraph->SetTaskUnits(aFonts, aNumFonts);
+
+	int aNumSounds = mResourceManager->GetNumResources("LoadingSounds");
+	int aSounds = aGraph->AddTask("sounds", GetLoadingTaskCost("sounds", aNumSounds * 54), [this]() { return LoadGroup("LoadingSounds"); }, {}, LOADING_LANE_RESOURCES);
+	aGraph->SetTaskUnits(aSounds, aNumSounds);
+
+	aGraph->AddTask("music", GetLoadingTaskCost("music", mMusic->GetNumLoadingTasks()), [this]()
 	{
-		mNumLoadingThreadTasks += mResourceManager->GetNumResources(groups[i]) * group_ave_ms_to_load[i];
-	}
-	mNumLoadingThreadTasks += 636;
-	mNumLoadingThreadTasks += GetNumPreloadingTasks();
-	mNumLoadingThreadTasks += mMusic->GetNumLoadingTasks();
+		mMusic->MusicInit();
+		return !mShutdown && !mCloseRequest;
+	});
 
-	PerfTimer aTimer;
-	aTimer.Start();
+	int aStuff = aGraph->AddTask("stuff", GetLoadingTaskCost("stuff", 36), [this]()
+	{
+		mZenGarden = new ZenGarden();
+		mReanimatorCache = new ReanimatorCache();
+		mReanimatorCache->ReanimatorCacheInitialize();
+		TodFoleyInitialize(gLawnFoleyParamArray, LENGTH(gLawnFoleyParamArray));
+		return true;
+	});
 
-	TodHesitationTrace("start loading");
-	TodHesitationBracket aHesitationResources("Resources");
-	TodHesitationTrace("loading thread start");
+	aGraph->AddTask("pool", GetLoadingTaskCost("pool", 20), [this]()
+	{
+		mPoolEffect = new PoolEffect();
+		mPoolEffect->PoolEffectInitialize();
+		return true;
+	}, { aImages });
+
+	int aTrails = aGraph->AddTask("trail", GetLoadingTaskCost("trail", 80), []()
+	{
+		TrailLoadDefinitions(gLawnTrailArray, LENGTH(gLawnTrailArray));
+		return true;
+	}, { aImages });
+
+	int aParticles = aGraph->AddTask("particle", GetLoadingTaskCost("particle", 500), []()
+	{
+		TodParticleLoadDefinitions(gLawnParticleArray, LENGTH(gLawnParticleArray));
+		return true;
+	}, { aImages });
+
+	if (mBenchmarkPixelKernels || !mBenchmarkSaveDir.empty() || mRunSelfTests)
+	{
+		aGraph->AddTask("benchmark", 1, [this]()
+		{
+			if (mBenchmarkPixelKernels)
+				BenchmarkPixelKernels();
+			if (!mBenchmarkSaveDir.empty())
+				BenchmarkSaveGames();
+			if (mRunSelfTests)
+				TodTrace("self test: %d check(s) failed", RunSelfTests(GetAppDataPath("userdata")));
+			return true;
+		}, { aTrails, aParticles });
+	}
 
-	LoadGroup("LoadingImages", 9);
-	LoadGroup("LoadingFonts", 54);
-	if (mLoadingFailed || mShutdown || mCloseRequest)
+	int aNumPreloadingTasks = GetNumPreloadingTasks();
+	int aPreload = aGraph->AddTask("preload", GetLoadingTaskCost("preload", aNumPreloadingTasks), [this]()
+	{
+		PreloadForUser();
+		return !mLoadingFailed && !mShutdown && !mCloseRequest;
+	}, { aImages, aFonts, aStuff, aTrails, aParticles });
+	aGraph->SetTaskUnits(aPreload, aNumPreloadingTasks);
+
+	mLoadingTaskGraph = aGraph;
+	bool aLoaded = aGraph->Run(DefinitionGetLoadThreadCount(aGraph->GetNumTasks()));
+	aGraph->TraceSchedule();
+	DefinitionTraceArenaStats();
+	if (!aLoaded)
 		return;
 
-	aHesitationResources.EndBracket();
-	TodTrace("loading '%s' %d ms", "resources", static_cast<int>(aTimer.GetDuration()));
+	for (int i = 0; i < aGraph->GetNumTasks(); i++)
+	{
+		const TodTaskGraph::Task& aTask = aGraph->GetTask(i);
+		mLoadingTaskCosts.emplace_back(aTask.mName, std::max(static_cast<int>(aTask.mDuration), 1));
+	}
+	TodHesitationTrace("finished loading");
+}
 
-	mMusic->MusicInit();
-	// aDuration goes unused
-	//int aDuration = max(aTimer.GetDuration(), 0.0);
-	aTimer.Start();
+// 资源包内全部贴图的文件名；未使用资源包时，改为遍历资源清单中的贴图
+static std::vector<std::string> GetImageFileNames(ResourceManager* theResourceManager)
+{
+	std::vector<std::string> aFileNames;
+	for (const auto& [aKey, aRecord] : gPakInterface->mPakRecordMap)
+	{
+		size_t aDot = aRecord.mFileName.rfind('.');
+		std::string anExt = aDot == std::string::npos ? "" : StringToLower(aRecord.mFileName.substr(aDot));
+		if (anExt == ".png" || anExt == ".jpg" || anExt == ".gif" || anExt == ".tga")
+			aFileNames.push_back(aRecord.mFileName);
+	}
+	if (aFileNames.empty())
+	{
+		for (const auto& [anId, aRes] : theResourceManager->mImageMap)
+			aFileNames.push_back(aRes->mPath);
+	}
+	return aFileNames;
+}
+
+// 统计每种像素内核在资源包内全部贴图上的吞吐量，并以标量实现为基准核对其输出（合成数据上的校验见 -selftest）
+void LawnApp::BenchmarkPixelKernels()
+{
+	std::vector<std::string> aFileNames = GetImageFileNames(mResourceManager);
+
+	const ImageLib::PixelKernels& aScalar = ImageLib::GetScalarPixelKernels();
+	std::vector<const ImageLib::PixelKernels*> aVariants = ImageLib::GetAvailablePixelKernels();
+	enum { KERNEL_COMPOSE, KERNEL_ALPHA_TO_IMAGE, KERNEL_RGBA, KERNEL_4444, KERNEL_565, KERNEL_HALVE, NUM_KERNELS };
+	static const char* KERNEL_NAMES[NUM_KERNELS] = { "compose", "alpha", "rgba", "4444", "565", "halve" };
+	std::vector<std::array<double, NUM_KERNELS>> aTimes(aVariants.size(), std::array<double, NUM_KERNELS>{});
+	std::vector<int> aMismatches(aVariants.size(), 0);
+	int64_t aNumPixels = 0;
+	int aNumImages = 0;
+	double aReferenceDownscaleTime = 0.0;
+	double aDownscaleTime = 0.0;
+	int aDownscaleMismatches = 0;
 
-	mPoolEffect = new PoolEffect();
-	mPoolEffect->PoolEffectInitialize();
-	mZenGarden = new ZenGarden();
-	mReanimatorCache = new ReanimatorCache();
-	mReanimatorCache->ReanimatorCacheInitialize();
-	TodFoleyInitialize(gLawnFoleyParamArray, LENGTH(gLawnFoleyParamArray));
+	for (const std::string& aFileName : aFileNames)
+	{
+		std::unique_ptr<ImageLib::Image> anImage(ImageLib::GetImage(aFileName, false));
+		if (anImage == nullptr || anImage->mBits == nullptr)
+			continue;
 
-	TodTrace("loading '%s' %d ms", "stuff", static_cast<int>(aTimer.GetDuration()));
-	aTimer.Start();
+		const int aCount = anImage->mWidth * anImage->mHeight;
+		const uint32_t* aBits = anImage->mBits;
+		std::vector<uint32_t> anExpected32(aCount), aResult32(aCount);
+		std::vector<uint16_t> anExpected16(aCount), aResult16(aCount);
+		aNumPixels += aCount;
+		aNumImages++;
 
-	TrailLoadDefinitions(gLawnTrailArray, LENGTH(gLawnTrailArray));
-	TodTrace("loading '%s' %d ms", "trail", static_cast<int>(aTimer.GetDuration()));
-	aTimer.Start();
-	TodHesitationTrace("trail");
-	
-	TodParticleLoadDefinitions(gLawnParticleArray, LENGTH(gLawnParticleArray));
-	//aDuration = max(aTimer.GetDuration(), 0.0);
-	aTimer.Start();
+		for (size_t aVariant = 0; aVariant < aVariants.size(); aVariant++)
+		{
+			const ImageLib::PixelKernels& aKernels = *aVariants[aVariant];
+			std::array<double, NUM_KERNELS>& aTime = aTimes[aVariant];
+			PerfTimer aTimer;
+
+			// 合并透明度：以自身的蓝色通道作为透明度来源
+			anExpected32.assign(aBits, aBits + aCount);
+			aScalar.mComposeAlpha(anExpected32.data(), aBits, aCount);
+			aResult32.assign(aBits, aBits + aCount);
+			aTimer.Start();
+			aKernels.mComposeAlpha(aResult32.data(), aBits, aCount);
+			aTime[KERNEL_COMPOSE] += aTimer.GetDuration();
+			aMismatches[aVariant] += anExpected32 != aResult32;
+
+			// 透明度图转为图像：以蓝色通道作为透明度，配以白色
+			anExpected32.assign(aBits, aBits + aCount);
+			aScalar.mAlphaToImage(anExpected32.data(), 0x00FFFFFF, aCount);
+			aResult32.assign(aBits, aBits + aCount);
+			aTimer.Start();
+			aKernels.mAlphaToImage(aResult32.data(), 0x00FFFFFF, aCount);
+			aTime[KERNEL_ALPHA_TO_IMAGE] += aTimer.GetDuration();
+			aMismatches[aVariant] += anExpected32 != aResult32;
+
+			aScalar.mArgbToRgba(anExpected32.data(), aBits, aCount);
+			aTimer.Start();
+			aKernels.mArgbToRgba(aResult32.data(), aBits, aCount);
+			aTime[KERNEL_RGBA] += aTimer.GetDuration();
+			aMismatches[aVariant] += anExpected32 != aResult32;
 
-	PreloadForUser();
-	if (mLoadingFailed || mShutdown || mCloseRequest)
+			aScalar.mArgbTo4444(anExpected16.data(), aBits, aCount);
+			aTimer.Start();
+			aKernels.mArgbTo4444(aResult16.data(), aBits, aCount);
+			aTime[KERNEL_4444] += aTimer.GetDuration();
+			aMismatches[aVariant] += anExpected16 != aResult16;
+
+			aScalar.mArgbTo565(anExpected16.data(), aBits, aCount);
+			aTimer.Start();
+			aKernels.mArgbTo565(aResult16.data(), aBits, aCount);
+			aTime[KERNEL_565] += aTimer.GetDuration();
+			aMismatches[aVariant] += anExpected16 != aResult16;
+
+			// 缩小一半：逐行处理，与载入时的用法一致
+			const int aHalfWidth = anImage->mWidth / 2;
+			const int aHalfCount = aHalfWidth * (anImage->mHeight / 2);
+			for (int y = 0; y < anImage->mHeight / 2; y++)
+				aScalar.mHalve(anExpected32.data() + y * aHalfWidth, aBits + y * 2 * anImage->mWidth, aBits + (y * 2 + 1) * anImage->mWidth, aHalfWidth);
+			aTimer.Start();
+			for (int y = 0; y < anImage->mHeight / 2; y++)
+				aKernels.mHalve(aResult32.data() + y * aHalfWidth, aBits + y * 2 * anImage->mWidth, aBits + (y * 2 + 1) * anImage->mWidth, aHalfWidth);
+			aTime[KERNEL_HALVE] += aTimer.GetDuration() * aCount / std::max(aHalfCount, 1);  // 按源像素数折算吞吐量
+			aMismatches[aVariant] += !std::equal(anExpected32.begin(), anExpected32.begin() + aHalfCount, aResult32.begin());
+		}
+
+		// 载入时的缩小与原有逐字节实现的结果必须逐字节相同
+		const int aNewWidth = anImage->mWidth / 2;
+		const int aNewHeight = anImage->mHeight / 2;
+		if (aNewWidth > 0 && aNewHeight > 0)
+		{
+			PerfTimer aTimer;
+			aTimer.Start();
+			std::unique_ptr<unsigned char[]> aReference(ImageLib::RescaleReference(anImage->mWidth, anImage->mHeight, aNewWidth, aNewHeight, (const unsigned char*)aBits));
+			aReferenceDownscaleTime += aTimer.GetDuration();
+			aTimer.Start();
+			ImageLib::DownscaleImage(anImage.get(), 2);
+			aDownscaleTime += aTimer.GetDuration();
+			aDownscaleMismatches += memcmp(aReference.get(), anImage->mBits, aNewWidth * aNewHeight * sizeof(uint32_t)) != 0;
+		}
+	}
+
+	TodTrace("pixel kernels: %d images, %lld pixels, using '%s'", aNumImages, (long long)aNumPixels, ImageLib::GetPixelKernels().mName);
+	for (size_t aVariant = 0; aVariant < aVariants.size(); aVariant++)
+	{
+		std::string aLine = StrFormat("pixel kernels '%s':", aVariants[aVariant]->mName);
+		for (int aKernel = 0; aKernel < NUM_KERNELS; aKernel++)
+		{
+			double aMs = aTimes[aVariant][aKernel];
+			aLine += StrFormat(" %s %.0f Mpix/s", KERNEL_NAMES[aKernel], aMs > 0.0 ? aNumPixels / (aMs * 1000.0) : 0.0);
+		}
+		aLine += StrFormat(", %d mismatches", aMismatches[aVariant]);
+		TodTrace("%s", aLine.c_str());
+	}
+	TodTrace("downscale: reference %.2f ms, '%s' %.2f ms, %d mismatches", aReferenceDownscaleTime, ImageLib::GetPixelKernels().mName, aDownscaleTime, aDownscaleMismatches);
+}
+
+// 以每种压缩方式重新打包目录内全部 .v4 存档，比较其大小与存取耗时，并校验解包结果与原始数据一致
+void LawnApp::BenchmarkSaveGames()
+{
+	const int BENCHMARK_PASSES = 10;
+
+	std::vector<std::vector<unsigned char>> aPayloads;
+	std::error_code anError;
+	for (const std::filesystem::directory_entry& anEntry : std::filesystem::directory_iterator(PathFromU8(mBenchmarkSaveDir), anError))
+	{
+		if (!anEntry.is_regular_file() || anEntry.path().extension() != ".v4")
+			continue;
+
+		Buffer aBuffer;
+		std::vector<unsigned char> aDecoded;
+		const unsigned char* aPayload = nullptr;
+		unsigned int aPayloadSize = 0;
+		if (ReadBufferFromFile(PathToU8(anEntry.path()), &aBuffer, false) &&
+			DecodeSaveGameV4(aBuffer.GetDataPtr(), static_cast<size_t>(aBuffer.GetDataLen()), aDecoded, aPayload, aPayloadSize))
+			aPayloads.emplace_back(aPayload, aPayload + aPayloadSize);
+	}
+	if (aPayloads.empty())
+	{
+		TodTrace("save bench: no .v4 saves in '%s'", mBenchmarkSaveDir.c_str());
 		return;
+	}
 
-	//aDuration = max(aTimer.GetDuration(), 0.0);
-	aTimer.Start();
+	std::string aTempPath = GetAppDataPath("userdata/savebench.tmp");
+	for (int aCodec = 0; aCodec < NUM_SAVE_CODECS; aCodec++)
+	{
+		int64_t aRawSize = 0;
+		int64_t aStoredSize = 0;
+		double anEncodeTime = 0.0;
+		double aWriteTime = 0.0;
+		double aReadTime = 0.0;
+		double aDecodeTime = 0.0;
+		int aMismatches = 0;
+		for (const std::vector<unsigned char>& aPayload : aPayloads)
+		{
+			for (int aPass = 0; aPass < BENCHMARK_PASSES; aPass++)
+			{
+				PerfTimer aTimer;
+				std::vector<unsigned char> aData;
+				aTimer.Start();
+				EncodeSaveGameV4(aPayload.data(), static_cast<unsigned int>(aPayload.size()), aCodec, aData);
+				anEncodeTime += aTimer.GetDuration();
+
+				aTimer.Start();
+				AsyncFileWriter::WriteFileAtomic(aTempPath, aData.data(), aData.size());
+				aWriteTime += aTimer.GetDuration();
+
+				Buffer aBuffer;
+				aTimer.Start();
+				ReadBufferFromFile(aTempPath, &aBuffer, false);
+				aReadTime += aTimer.GetDuration();
+
+				std::vector<unsigned char> aDecoded;
+				const unsigned char* aResult = nullptr;
+				unsigned int aResultSize = 0;
+				aTimer.Start();
+				bool aDecodedOk = DecodeSaveGameV4(aBuffer.GetDataPtr(), static_cast<size_t>(aBuffer.GetDataLen()), aDecoded, aResult, aResultSize);
+				aDecodeTime += aTimer.GetDuration();
+
+				if (aPass == 0)
+				{
+					aRawSize += aPayload.size();
+					aStoredSize += aData.size();
+					aMismatches += !aDecodedOk || aResultSize != aPayload.size() || memcmp(aResult, aPayload.data(), aResultSize) != 0;
+				}
+			}
+		}
 
-	GetNumPreloadingTasks();
-	LoadGroup("LoadingSounds", 54);
-	TodHesitationTrace("finished loading");
+		double aScale = 1.0 / (BENCHMARK_PASSES * aPayloads.size());
+		TodTrace("save bench %-4s: %d saves, %lld -> %lld bytes (%.1f%%), encode %.3f ms, write %.3f ms, read %.3f ms, decode %.3f ms, %d mismatches",
+			SaveGameGetCodecName(aCodec), (int)aPayloads.size(), (long long)aRawSize, (long long)aStoredSize, aStoredSize * 100.0 / std::max<int64_t>(aRawSize, 1),
+			anEncodeTime * aScale, aWriteTime * aScale, aReadTime * aScale, aDecodeTime * aScale, aMismatches);
+	}
+	EraseFile(aTempPath);
 }
 
 //0x452C60
@@ -1840,6 +2186,19 @@ void LawnApp::FastLoad(GameMode theGameMode)
 
 void LawnApp::LoadingThreadCompleted()
 {
+	// 实测耗时供下次启动估算进度；注册表只在主线程中写入，且仅在与已存值相差超过四分之一（至少 5 毫秒）时改写
+	const int LOADING_COST_TOLERANCE_DIVISOR = 4;
+	const int LOADING_COST_TOLERANCE_MIN = 5;
+	for (const auto& aCost : mLoadingTaskCosts)
+	{
+		std::string aKey = StrFormat("LoadingCost_%s", aCost.first.c_str());
+		int aStoredCost;
+		if (RegistryReadInteger(aKey, &aStoredCost) && aStoredCost > 0 &&
+			std::abs(aCost.second - aStoredCost) <= std::max(aStoredCost / LOADING_COST_TOLERANCE_DIVISOR, LOADING_COST_TOLERANCE_MIN))
+			continue;
+		RegistryWriteInteger(aKey, aCost.second);
+	}
+	mLoadingTaskCosts.clear();
 }
 
 //0x452CB0
@@ -3154,11 +3513,18 @@ int LawnApp::GetNumPreloadingTasks()
 //0x455720
 void LawnApp::PreloadForUser()
 {
-	int aNumTasks = mNumLoadingThreadTasks + GetNumPreloadingTasks();
+	int aNumTasks = GetNumPreloadingTasks();
+	int aCompletedTasks = 0;
+	auto aAdvance = [&](int theTasks)
+	{
+		aCompletedTasks += theTasks;
+		AdvanceLoadingProgress(theTasks);
+	};
+
 	if (mTitleScreen && mTitleScreen->mQuickLoadKey != KeyCode::KEYCODE_UNKNOWN)
 	{
 		TodTrace("preload canceled\n");
-		mNumLoadingThreadTasks = aNumTasks;
+		aAdvance(aNumTasks - aCompletedTasks);
 		return;
 	}
 
@@ -3166,19 +3532,19 @@ void LawnApp::PreloadForUser()
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_PUFF, true);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_LAWN_MOWERED_ZOMBIE, true);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_READYSETPLANT, true);
-	mCompletedLoadingThreadTasks += 68;
+	aAdvance(68);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_FINAL_WAVE, true);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_SUN, true);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_TEXT_FADE_ON, true);
-	mCompletedLoadingThreadTasks += 68;
+	aAdvance(68);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_ZOMBIE, true);
-	mCompletedLoadingThreadTasks += 68;
+	aAdvance(68);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_ZOMBIE_NEWSPAPER, true);
-	mCompletedLoadingThreadTasks += 68;
+	aAdvance(68);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_SELECTOR_SCREEN, true);
-	mCompletedLoadingThreadTasks += 340;
+	aAdvance(340);
 	ReanimatorEnsureDefinitionLoaded(ReanimationType::REANIM_ZOMBIE_HAND, true);
-	mCompletedLoadingThreadTasks += 68;
+	aAdvance(68);
 
 	if (mPlayerInfo)
 	{
@@ -3187,15 +3553,15 @@ void LawnApp::PreloadForUser()
 			if (HasSeedType(i) || HasFinishedAdventure())
 			{
 				Plant::PreloadPlantResources(i);
-				if (mCompletedLoadingThreadTasks < aNumTasks)
+				if (aCompletedTasks < aNumTasks)
 				{
-					mCompletedLoadingThreadTasks += 68;
+					aAdvance(68);
 				}
 
 				if (mTitleScreen && mTitleScreen->mQuickLoadKey != KeyCode::KEYCODE_UNKNOWN)
 				{
 					TodTrace("preload canceled\n");
-					mNumLoadingThreadTasks = aNumTasks;
+					aAdvance(aNumTasks - aCompletedTasks);
 					return;
 				}
 
@@ -3219,15 +3585,15 @@ void LawnApp::PreloadForUser()
 			}
 
 			Zombie::PreloadZombieResources(i);
-			if (mCompletedLoadingThreadTasks < aNumTasks)
+			if (aCompletedTasks < aNumTasks)
 			{
-				mCompletedLoadingThreadTasks += 68;
+				aAdvance(68);
 			}
 
 			if (mTitleScreen && mTitleScreen->mQuickLoadKey != KeyCode::KEYCODE_UNKNOWN)
 			{
 				TodTrace("preload canceled\n");
-				mNumLoadingThreadTasks = aNumTasks;
+				aAdvance(aNumTasks - aCompletedTasks);
 				return;
 			}
 
@@ -3239,10 +3605,10 @@ void LawnApp::PreloadForUser()
 	}
 #endif
 
-	if (mCompletedLoadingThreadTasks != aNumTasks)
+	if (aCompletedTasks != aNumTasks)
 	{
 		TodTrace("num preload tasks wasn't calculated correctly");
-		mCompletedLoadingThreadTasks = aNumTasks;
+		aAdvance(aNumTasks - aCompletedTasks);
 	}
 }
 
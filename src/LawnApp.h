@@ -4,6 +4,7 @@
 #include "ConstEnums.h"
 #include "SexyAppFramework/SexyApp.h"
 #include "Sexy.TodLib/TodFoley.h"
+#include <atomic>
 
 class Board;
 class GameSelector;
@@ -27,6 +28,7 @@ class ChallengeScreen;
 class StoreScreen;
 class AlmanacDialog;
 class TypingCheck;
+class TodTaskGraph;
 
 namespace Sexy
 {
@@ -122,6 +124,13 @@ public:
 	TrialType						mTrialType;										//+0x8C0
 	bool							mDebugTrialLocked;								//+0x8C4
 	bool							mMuteSoundsForCutscene;							//+0x8C5
+	std::string						mRenderStatsFile;
+	int								mTextureBudgetMB;
+	bool							mBenchmarkPixelKernels;
+	std::string						mBenchmarkSaveDir;
+	bool							mRunSelfTests;
+	std::atomic<TodTaskGraph*>		mLoadingTaskGraph;
+	std::vector<std::pair<std::string, int>> mLoadingTaskCosts;
 
 public:
 	LawnApp();
@@ -136,6 +145,9 @@ public:
 	virtual void					LoadingThreadProc();
 	virtual void					LoadingCompleted();
 	virtual void					LoadingThreadCompleted();
+	virtual double					GetLoadingThreadProgress();
+	void							AdvanceLoadingProgress(int theTasks);
+	int								GetLoadingTaskCost(const char* theTaskName, int theDefaultCost);
 	virtual void					URLOpenFailed(const std::string& theURL);
 	virtual void					URLOpenSucceeded(const std::string& theURL);
 	virtual bool					OpenURL(const std::string& theURL, bool shutdownOnOpen);
@@ -216,6 +228,8 @@ public:
 	void							PlayFoleyPitch(FoleyType theFoleyType, float thePitch);
 	void							PlaySample(int theSoundNum);
 	void							FastLoad(GameMode theGameMode);
+	void							BenchmarkPixelKernels();
+	void							BenchmarkSaveGames();
 	static std::string				GetStageString(int theLevel);
 	/*inline*/ void					KillChallengeScreen();
 	void							ShowChallengeScreen(ChallengePage thePage);
@@ -300,7 +314,7 @@ public:
 	inline std::string				GetCurrentLevelName() { return "Unknown"; }
 	/*inline*/ int					TrophiesNeedForGoldSunflower();
 	/*inline*/ int					GetCurrentChallengeIndex();
-	void							LoadGroup(const char* theGroupName, int theGroupAveMsToLoad);
+	bool							LoadGroup(const char* theGroupName);
 //	void							TraceLoadGroup(const char* theGroupName, int theGroupTime, int theTotalGroupWeigth, int theTaskWeight);
 	void							CrazyDaveStopSound();
 	/*inline*/ bool					IsTrialStageLocked();
@@ -7,10 +7,19 @@
 #include <sys/stat.h>
 #include <filesystem>
 #include <fstream>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "TodDebug.h"
+#include "TodTaskGraph.h"
 #include "Definition.h"
 #include "zlib.h"
 #include "paklib/PakInterface.h"
+#include "misc/LZ4Block.h"
 #include "misc/PerfTimer.h"
 #include "misc/XMLParser.h"
 #include "../Resources.h"
@@ -146,6 +155,10 @@ DefField gReanimatorDefFields[] = {
 };  //0x69F184
 DefMap gReanimatorDefMap = { gReanimatorDefFields, sizeof(ReanimatorDefinition), ReanimatorDefinitionConstructor };  //0x69F1B4
 
+int gDefinitionLoadThreads = 0;
+int gDefinitionCompiledCodec = DEFINITION_CODEC_LZ4;
+std::mutex gDefinitionResourceLock;
+
 static DefLoadResPath gDefLoadResPaths[4] = { {"IMAGE_", ""}, {"IMAGE_", "particles/"}, {"IMAGE_REANIM_", "reanim/"}, {"IMAGE_REANIM_", "images/"} };  //0x6A1A48
 
 //0x5155A0
@@ -311,7 +324,195 @@ unsigned int DefinitionGetSize(DefMap* theDefMap, void* theDefinition) {
     return theDefMap->mDefSize + DefinitionGetDeepSize(theDefMap, theDefinition);
 }
 
+// ====================================================================================================
+// ★ 【定义数据分配区】
+// ----------------------------------------------------------------------------------------------------
+// 一个定义文件的全部数组、字符串与轨道节点依次从同一分配区中切分，释放定义时整体释放，无须逐个遍历释放。
+// ====================================================================================================
+class DefinitionArena
+{
+public:
+    static constexpr size_t ARENA_BLOCK_SIZE = 16384;
+    static constexpr size_t ARENA_ALIGN = alignof(std::max_align_t);
+
+    struct Block
+    {
+        char*           mData;
+        size_t          mSize;
+        bool            mShared;                        // 由多次分配切分而成，不能单独释放
+    };
+
+    std::vector<Block>  mBlocks;                        // 按起始地址排序，以便二分查找
+    char*               mCur = nullptr;
+    char*               mEnd = nullptr;
+
+public:
+    ~DefinitionArena()
+    {
+        for (Block& aBlock : mBlocks)
+            delete[] aBlock.mData;
+    }
+
+    void AddBlock(char* theData, size_t theSize, bool theShared)
+    {
+        auto anItr = std::lower_bound(mBlocks.begin(), mBlocks.end(), theData, [](const Block& aBlock, const char* theData) { return aBlock.mData < theData; });
+        mBlocks.insert(anItr, { theData, theSize, theShared });
+        gDefinitionArenaStats.mBlocks++;
+    }
+
+    // 返回包含 thePtr 的块，不属于本分配区时返回 mBlocks.end()
+    std::vector<Block>::iterator Find(const void* thePtr)
+    {
+        auto anItr = std::upper_bound(mBlocks.begin(), mBlocks.end(), (const char*)thePtr, [](const char* thePtr, const Block& aBlock) { return thePtr < aBlock.mData; });
+        if (anItr == mBlocks.begin())
+            return mBlocks.end();
+        --anItr;
+        return (const char*)thePtr < anItr->mData + anItr->mSize ? anItr : mBlocks.end();
+    }
+
+    // 单独成块的分配，可由 Free 立即释放；数组扩容时使用，以免旧数组留在分配区中直到定义释放
+    void* AllocBlock(size_t theSize)
+    {
+        char* aData = new char[theSize]();
+        AddBlock(aData, theSize, false);
+        return aData;
+    }
+
+    void* Alloc(size_t theSize)
+    {
+        size_t aSize = (theSize + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+        if (aSize > ARENA_BLOCK_SIZE / 4)  // 较大的分配单独成块，以免浪费当前块的剩余空间
+            return AllocBlock(aSize);
+        if (mCur == nullptr || (size_t)(mEnd - mCur) < aSize)
+        {
+            if (mCur)
+                gDefinitionArenaStats.mBytesWasted += mEnd - mCur;
+            mCur = new char[ARENA_BLOCK_SIZE]();
+            mEnd = mCur + ARENA_BLOCK_SIZE;
+            AddBlock(mCur, ARENA_BLOCK_SIZE, true);
+        }
+        void* aPtr = mCur;
+        mCur += aSize;
+        return aPtr;
+    }
+
+    // 接管一块已分配好的内存（如 v2 格式的整个数据块）
+    void Adopt(char* theData, size_t theSize)
+    {
+        AddBlock(theData, theSize, true);
+    }
+
+    // thePtr 属于本分配区时返回 true；单独成块的分配随即释放，切分出的分配则留待分配区整体释放
+    bool Free(void* thePtr)
+    {
+        auto anItr = Find(thePtr);
+        if (anItr == mBlocks.end())
+            return false;
+        if (!anItr->mShared && anItr->mData == thePtr)
+        {
+            delete[] anItr->mData;
+            mBlocks.erase(anItr);
+        }
+        return true;
+    }
+};
+
+DefinitionArenaStats gDefinitionArenaStats;
+static thread_local DefinitionArena* gDefinitionCurrentArena = nullptr;
+static std::mutex gDefinitionArenaLock;
+static std::unordered_map<void*, DefinitionArena*> gDefinitionArenas;
+
+static void DefinitionClearRootPointers(DefMap* theDefMap, void* theDefinition);
+
+DefinitionArenaScope::DefinitionArenaScope(DefMap* theDefMap, void* theDefinition)
+{
+    mDefMap = theDefMap;
+    mDefinition = theDefinition;
+    mArena = nullptr;
+    mCommitted = false;
+    if (gDefinitionCurrentArena == nullptr)  // 嵌套时沿用外层的分配区
+    {
+        mArena = new DefinitionArena();
+        gDefinitionCurrentArena = mArena;
+    }
+}
+
+DefinitionArenaScope::~DefinitionArenaScope()
+{
+    if (mArena == nullptr)
+        return;
+
+    gDefinitionCurrentArena = nullptr;
+    if (mArena->mBlocks.empty())
+    {
+        delete mArena;
+        return;
+    }
+
+    // 加载失败：定义中指向分配区的指针随分配区一并作废，不登记分配区
+    if (!mCommitted)
+    {
+        DefinitionClearRootPointers(mDefMap, mDefinition);
+        delete mArena;
+        return;
+    }
+
+    std::scoped_lock aLock(gDefinitionArenaLock);
+    DefinitionArena*& anArena = gDefinitionArenas[mDefinition];
+    if (anArena == nullptr)
+    {
+        anArena = mArena;
+        gDefinitionArenaStats.mArenas++;
+    }
+    else  // 同一定义再次加载时，并入已有的分配区
+    {
+        for (const DefinitionArena::Block& aBlock : mArena->mBlocks)
+        {
+            anArena->AddBlock(aBlock.mData, aBlock.mSize, aBlock.mShared);
+            gDefinitionArenaStats.mBlocks--;
+        }
+        mArena->mBlocks.clear();
+        delete mArena;
+    }
+}
+
 void* DefinitionAlloc(int theSize)
+{
+    if (gDefinitionCurrentArena)
+    {
+        gDefinitionArenaStats.mAllocs++;
+        gDefinitionArenaStats.mBytes += theSize;
+        return gDefinitionCurrentArena->Alloc(theSize);
+    }
+
+    void* aPtr = operator new[](theSize);
+    TOD_ASSERT(aPtr);
+    memset(aPtr, 0, theSize);
+    return aPtr;
+}
+
+// 可能随后被 DefinitionFree 释放（如扩容中的数组）的分配：在分配区中单独成块
+static void* DefinitionAllocReleasable(int theSize)
+{
+    if (gDefinitionCurrentArena)
+    {
+        gDefinitionArenaStats.mAllocs++;
+        gDefinitionArenaStats.mBytes += theSize;
+        return gDefinitionCurrentArena->AllocBlock(theSize);
+    }
+    return DefinitionAlloc(theSize);
+}
+
+// 释放由 DefinitionAlloc 分配的内存，分配区中切分出的内存随分配区一并释放
+void DefinitionFree(void* thePtr)
+{
+    if (gDefinitionCurrentArena && gDefinitionCurrentArena->Free(thePtr))
+        return;
+    delete[] (char *)thePtr;
+}
+
+// 读取缓存、压缩等过程中的临时缓冲区，不应占用定义的分配区
+static void* DefinitionAllocScratch(int theSize)
 {
     void* aPtr = operator new[](theSize);
     TOD_ASSERT(aPtr);
@@ -329,6 +530,8 @@ bool DefinitionLoadImage(Image** theImage, const std::string& theName)
         return true;
     }
 
+    std::scoped_lock aLock(gDefinitionResourceLock);
+
     // 尝试借助资源管理器，从 XML 中加载贴图
     Image* anImage = (Image*)gSexyAppBase->mResourceManager->LoadImage(theName);
     if (anImage)
@@ -363,6 +566,7 @@ bool DefinitionLoadImage(Image** theImage, const std::string& theName)
 //0x443F60
 bool DefinitionLoadFont(_Font** theFont, const std::string& theName)
 {
+    std::scoped_lock aLock(gDefinitionResourceLock);
     _Font* aFont = gSexyAppBase->mResourceManager->LoadFont(theName);
     *theFont = aFont;
     return aFont != nullptr;
@@ -541,6 +745,22 @@ uint DefinitionCalcHash(DefMap* theDefMap)
     return aResult;
 }
 
+// 结构图在运行期不会改变，校验值只需计算一次
+uint DefinitionGetSchemaHash(DefMap* theDefMap)
+{
+    static std::mutex sSchemaHashLock;
+    static std::unordered_map<DefMap*, uint> sSchemaHashes;
+
+    std::scoped_lock aLock(sSchemaHashLock);
+    auto anItr = sSchemaHashes.find(theDefMap);
+    if (anItr != sSchemaHashes.end())
+        return anItr->second;
+
+    uint aHash = DefinitionCalcHash(theDefMap);
+    sSchemaHashes.emplace(theDefMap, aHash);
+    return aHash;
+}
+
 //0x444500 : UnCompress(&theUncompressedSize, theCompressedBufferSize, esi = *theCompressedBuffer)
 void* DefinitionUncompressCompiledBuffer(void* theCompressedBuffer, size_t theCompressedBufferSize, size_t& theUncompressedSize, const std::string& theCompiledFilePath)
 {
@@ -558,7 +778,7 @@ void* DefinitionUncompressCompiledBuffer(void* theCompressedBuffer, size_t theCo
         return nullptr;
     }
     
-    Bytef* aUncompressedBuffer = (Bytef*)DefinitionAlloc(aHeader->mUncompressedSize);
+    Bytef* aUncompressedBuffer = (Bytef*)DefinitionAllocScratch(aHeader->mUncompressedSize);
     Bytef* aSrc = (Bytef*)((intptr_t)theCompressedBuffer + sizeof(CompressedDefinitionHeader));  // 实际解压数据从第 3 个四字节开始
     // BuGFIXX!!
     ulong aUncompressedSizeResult = aHeader->mUncompressedSize;  // 用作出参的未压缩数据实际长度
@@ -589,6 +809,123 @@ static bool DefinitionGetFileModTime(const std::string& theFilePath, std::filesy
     return !ec;
 }
 
+bool DefinitionReadCompiledBlob(std::ifstream& theFileStream, const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition)
+{
+    CompiledDefinitionBlobHeader aHeader;
+    theFileStream.seekg(0, std::ios::beg);
+    if (!theFileStream.read(reinterpret_cast<char*>(&aHeader), sizeof(aHeader)) || aHeader.mCookie != COMPILED_DEFINITION_BLOB_COOKIE)
+    {
+        TodTrace("Compiled file cookie wrong: %s\n", theCompiledFilePath.c_str());
+        return false;
+    }
+    if (aHeader.mSchemaHash != DefinitionGetSchemaHash(theDefMap))
+    {
+        TodTrace("Compiled file schema wrong: %s\n", theCompiledFilePath.c_str());
+        return false;
+    }
+    if (aHeader.mBlobSize < (unsigned int)theDefMap->mDefSize)
+    {
+        TodTrace("Compiled file size too small: %s\n", theCompiledFilePath.c_str());
+        return false;
+    }
+
+    // 分配前先核对头中的各项长度：各段之和须恰好等于文件长度，解压后的数据块也不得超过上限，
+    // 以免损坏或恶意构造的文件触发巨量分配
+    theFileStream.seekg(0, std::ios::end);
+    uint64_t aFileSize = (uint64_t)theFileStream.tellg();
+    theFileStream.seekg(sizeof(aHeader), std::ios::beg);
+    uint64_t aStoredSize = aHeader.mCodec == DEFINITION_CODEC_NONE ? aHeader.mBlobSize : aHeader.mStoredSize;
+    uint64_t anExpectedSize = sizeof(aHeader) + aStoredSize + (uint64_t)aHeader.mRelocCount * sizeof(unsigned int) +
+        (uint64_t)aHeader.mResourceCount * sizeof(DefinitionBlobResource);
+    if (aHeader.mCodec >= NUM_DEFINITION_CODECS || aHeader.mBlobSize > MAX_COMPILED_BLOB_SIZE || anExpectedSize != aFileSize)
+    {
+        TodTrace("Compiled file wrong size: %s\n", theCompiledFilePath.c_str());
+        return false;
+    }
+
+    // 数据块一次分配、一次读入；重定位表与资源表仅在读取期间使用
+    char* aBlob = new char[aHeader.mBlobSize];
+    std::vector<char> aStored;
+    std::vector<unsigned int> aRelocs(aHeader.mRelocCount);
+    std::vector<DefinitionBlobResource> aResources(aHeader.mResourceCount);
+    if (aHeader.mCodec == DEFINITION_CODEC_NONE)
+        theFileStream.read(aBlob, aHeader.mBlobSize);
+    else
+    {
+        aStored.resize(aHeader.mStoredSize);
+        theFileStream.read(aStored.data(), aStored.size());
+    }
+    theFileStream.read(reinterpret_cast<char*>(aRelocs.data()), aRelocs.size() * sizeof(unsigned int));
+    theFileStream.read(reinterpret_cast<char*>(aResources.data()), aResources.size() * sizeof(DefinitionBlobResource));
+    if (!theFileStream || theFileStream.peek() != std::char_traits<char>::eof())
+    {
+        TodTrace("Compiled file wrong size: %s\n", theCompiledFilePath.c_str());
+        delete[] aBlob;
+        return false;
+    }
+    if (aHeader.mCodec != DEFINITION_CODEC_NONE && !DefinitionDecodeBlob(aHeader.mCodec, aStored.data(), aStored.size(), aBlob, aHeader.mBlobSize))
+    {
+        TodTrace("Failed to decompress compiled file: %s\n", theCompiledFilePath.c_str());
+        delete[] aBlob;
+        return false;
+    }
+
+    // 重定位：将记录的偏移量加上数据块的基址
+    for (unsigned int aFieldOffset : aRelocs)
+    {
+        uintptr_t aTarget;
+        if ((size_t)aFieldOffset + sizeof(uintptr_t) > aHeader.mBlobSize)
+        {
+            delete[] aBlob;
+            return false;
+        }
+        memcpy(&aTarget, aBlob + aFieldOffset, sizeof(uintptr_t));
+        if (aTarget >= aHeader.mBlobSize)
+        {
+            delete[] aBlob;
+            return false;
+        }
+        aTarget += (uintptr_t)aBlob;
+        memcpy(aBlob + aFieldOffset, &aTarget, sizeof(uintptr_t));
+    }
+
+    bool aResult = true;
+    for (const DefinitionBlobResource& aResource : aResources)
+    {
+        if ((size_t)aResource.mFieldOffset + sizeof(void*) > aHeader.mBlobSize || aResource.mNameOffset >= aHeader.mBlobSize ||
+            memchr(aBlob + aResource.mNameOffset, '\0', aHeader.mBlobSize - aResource.mNameOffset) == nullptr)
+        {
+            aResult = false;
+            break;
+        }
+
+        const char* aName = aBlob + aResource.mNameOffset;
+        void* aField = aBlob + aResource.mFieldOffset;
+        if (aResource.mFieldType == (unsigned int)DefFieldType::DT_IMAGE)
+            aResult = DefinitionLoadImage((Image**)aField, aName);
+        else if (aResource.mFieldType == (unsigned int)DefFieldType::DT_FONT)
+            aResult = DefinitionLoadFont((_Font**)aField, aName);
+        else
+            aResult = false;
+
+        if (!aResult)
+            break;
+    }
+    if (!aResult)
+    {
+        TodTrace("Compiled file resource missing: %s\n", theCompiledFilePath.c_str());
+        delete[] aBlob;
+        return false;
+    }
+
+    // 根结构位于数据块起始处，复制到调用者提供的定义中，其余部分留在数据块内，由定义的分配区接管
+    memcpy(theDefinition, aBlob, theDefMap->mDefSize);
+    DefinitionArenaScope aArenaScope(theDefMap, theDefinition);
+    gDefinitionCurrentArena->Adopt(aBlob, aHeader.mBlobSize);
+    aArenaScope.Commit();
+    return true;
+}
+
 //0x444560 : (void* def, *defMap, eax = string& compiledFilePath)  //esp -= 8
 bool DefinitionReadCompiledFile(const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition)
 {
@@ -604,10 +941,16 @@ bool DefinitionReadCompiledFile(const std::string& theCompiledFilePath, DefMap*
 
     if (!aFileStream) return false;
 
+    unsigned int aCookie = 0;
+    aFileStream.read(reinterpret_cast<char*>(&aCookie), sizeof(aCookie));
+    if (aFileStream && aCookie == COMPILED_DEFINITION_BLOB_COOKIE)
+        return DefinitionReadCompiledBlob(aFileStream, theCompiledFilePath, theDefMap, theDefinition);
+    aFileStream.clear();
+
     aFileStream.seekg(0, std::ios::end);
     size_t aCompressedSize = (size_t)aFileStream.tellg();
     aFileStream.seekg(0, std::ios::beg);
-    void* aCompressedBuffer = DefinitionAlloc(aCompressedSize);
+    void* aCompressedBuffer = DefinitionAllocScratch(aCompressedSize);
     aFileStream.read(reinterpret_cast<char*>(aCompressedBuffer), (std::streamsize)aCompressedSize);
     bool aReadCompressedFailed = !aFileStream || (size_t)aFileStream.gcount() != aCompressedSize;
     if (aReadCompressedFailed) { // 判断是否读取成功
@@ -621,7 +964,7 @@ bool DefinitionReadCompiledFile(const std::string& theCompiledFilePath, DefMap*
     delete[] (char *)aCompressedBuffer;
     if (!aUncompressedBuffer) return false;
     
-    uint aDefHash = DefinitionCalcHash(theDefMap);  // 计算 CRC 校验值，后将用于检测数据的完整性
+    uint aDefHash = DefinitionGetSchemaHash(theDefMap);  // 计算 CRC 校验值，后将用于检测数据的完整性
     if (aUncompressedSize < theDefMap->mDefSize + sizeof(uint)) {
         TodTrace("Compiled file size too small: %s\n", theCompiledFilePath.c_str());
         delete[] (char *)aUncompressedBuffer;
@@ -830,10 +1173,11 @@ bool DefinitionReadArrayField(XMLParser* theXmlParser, DefinitionArrayDef* theAr
 {
     DefMap* aDefMap = (DefMap*)theField->mExtraData;
 
+    // 元素个数事先未知，按 2 的幂扩容；扩容中的数组单独成块，旧数组复制后立即释放
     if (theArray->mArrayCount == 0)
     {
         theArray->mArrayCount = 1;
-        theArray->mArrayData = DefinitionAlloc(aDefMap->mDefSize);
+        theArray->mArrayData = DefinitionAllocReleasable(aDefMap->mDefSize);
     }
     else
     {
@@ -842,9 +1186,9 @@ bool DefinitionReadArrayField(XMLParser* theXmlParser, DefinitionArrayDef* theAr
         if (theArray->mArrayCount >= 1 && (theArray->mArrayCount == 1 || ((theArray->mArrayCount & (theArray->mArrayCount - 1)) == 0)))
         {
             void* anOldData = theArray->mArrayData;
-            theArray->mArrayData = DefinitionAlloc(2 * theArray->mArrayCount * aDefMap->mDefSize);
+            theArray->mArrayData = DefinitionAllocReleasable(2 * theArray->mArrayCount * aDefMap->mDefSize);
             memcpy(theArray->mArrayData, anOldData, theArray->mArrayCount * aDefMap->mDefSize);
-            delete[] (char *)anOldData;
+            DefinitionFree(anOldData);
         }
         theArray->mArrayCount++;
     }
@@ -1273,7 +1617,7 @@ void DefMapWriteToCache(void*& theWritePtr, DefMap* theDefMap, void* theDefiniti
 
 void* DefinitionCompressCompiledBuffer(void* theBuffer, unsigned int theBufferSize, unsigned int* theResultSize) {
     uLongf aCompressedSize = compressBound(theBufferSize);
-    auto aCompressedBuffer = (CompressedDefinitionHeader*)DefinitionAlloc(aCompressedSize + sizeof(CompressedDefinitionHeader));
+    auto aCompressedBuffer = (CompressedDefinitionHeader*)DefinitionAllocScratch(aCompressedSize + sizeof(CompressedDefinitionHeader));
     compress((Bytef*)((uintptr_t)aCompressedBuffer + sizeof(CompressedDefinitionHeader)), &aCompressedSize, (Bytef*)theBuffer, theBufferSize);
     aCompressedBuffer->mCookie = 0xDEADFED4;
     aCompressedBuffer->mUncompressedSize = theBufferSize;
@@ -1281,34 +1625,156 @@ void* DefinitionCompressCompiledBuffer(void* theBuffer, unsigned int theBufferSi
     return aCompressedBuffer;
 }
 
-bool DefinitionWriteCompiledFile(const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition) {
-    unsigned int aCompressedSize = 0;
-    unsigned int aDefSize = DefinitionGetSize(theDefMap, theDefinition) + sizeof(unsigned int);
-    void* aDefBasePtr = DefinitionAlloc(aDefSize);
-    void* aDef = aDefBasePtr;
-    uint aDefHash = DefinitionCalcHash(theDefMap);
+// 将定义树展开为一个连续的数据块，指针成员改写为数据块内的偏移量并记入重定位表
+class DefinitionBlobWriter
+{
+public:
+    std::vector<char>                       mBlob;
+    std::vector<unsigned int>               mRelocs;
+    std::vector<DefinitionBlobResource>     mResources;
+
+    unsigned int Append(const void* theData, size_t theSize, size_t theAlign)
+    {
+        size_t anOffset = (mBlob.size() + theAlign - 1) & ~(theAlign - 1);
+        mBlob.resize(anOffset + theSize);
+        if (theSize > 0)
+            memcpy(mBlob.data() + anOffset, theData, theSize);
+        return (unsigned int)anOffset;
+    }
+
+    template <typename T> T Get(unsigned int theOffset)
+    {
+        T aValue;
+        memcpy(&aValue, mBlob.data() + theOffset, sizeof(T));
+        return aValue;
+    }
 
-    SMemW(aDef, &aDefHash, sizeof(uint));
-    SMemW(aDef, theDefinition, theDefMap->mDefSize);
-    DefMapWriteToCache(aDef, theDefMap, theDefinition);
-    void* aCompressedDef = DefinitionCompressCompiledBuffer(aDefBasePtr, aDefSize, &aCompressedSize);
+    void SetPointer(unsigned int theFieldOffset, unsigned int theTargetOffset, bool theIsNull = false)
+    {
+        uintptr_t aValue = theTargetOffset;
+        if (theIsNull)
+            aValue = 0;
+        else
+            mRelocs.push_back(theFieldOffset);
+        memcpy(mBlob.data() + theFieldOffset, &aValue, sizeof(uintptr_t));
+    }
+
+    void AddResource(unsigned int theFieldOffset, DefFieldType theType, const std::string& theName)
+    {
+        SetPointer(theFieldOffset, 0, true);
+        if (!theName.empty())
+            mResources.push_back({ theFieldOffset, (unsigned int)theType, Append(theName.c_str(), theName.length() + 1, 1) });
+    }
+
+    void WriteMap(DefMap* theDefMap, unsigned int theStructOffset)
+    {
+        for (DefField* aField = theDefMap->mMapFields; *aField->mFieldName != '\0'; aField++)
+        {
+            unsigned int aFieldOffset = theStructOffset + aField->mFieldOffset;
+            switch (aField->mFieldType)
+            {
+            case DefFieldType::DT_STRING:
+            {
+                const char* aString = Get<const char*>(aFieldOffset);
+                if (aString == nullptr)
+                    SetPointer(aFieldOffset, 0, true);
+                else
+                    SetPointer(aFieldOffset, Append(aString, strlen(aString) + 1, 1));
+                break;
+            }
+            case DefFieldType::DT_ARRAY:
+            {
+                DefinitionArrayDef anArray = Get<DefinitionArrayDef>(aFieldOffset);
+                DefMap* anElementMap = (DefMap*)aField->mExtraData;
+                unsigned int aDataField = aFieldOffset + offsetof(DefinitionArrayDef, mArrayData);
+                if (anArray.mArrayCount <= 0 || anArray.mArrayData == nullptr)
+                {
+                    SetPointer(aDataField, 0, true);
+                    break;
+                }
+                unsigned int aDataOffset = Append(anArray.mArrayData, anElementMap->mDefSize * anArray.mArrayCount, alignof(std::max_align_t));
+                SetPointer(aDataField, aDataOffset);
+                for (int i = 0; i < anArray.mArrayCount; i++)
+                    WriteMap(anElementMap, aDataOffset + anElementMap->mDefSize * i);
+                break;
+            }
+            case DefFieldType::DT_TRACK_FLOAT:
+            {
+                FloatParameterTrack aTrack = Get<FloatParameterTrack>(aFieldOffset);
+                unsigned int aNodesField = aFieldOffset + offsetof(FloatParameterTrack, mNodes);
+                if (aTrack.mCountNodes <= 0 || aTrack.mNodes == nullptr)
+                    SetPointer(aNodesField, 0, true);
+                else
+                    SetPointer(aNodesField, Append(aTrack.mNodes, sizeof(FloatParameterTrackNode) * aTrack.mCountNodes, alignof(std::max_align_t)));
+                break;
+            }
+            case DefFieldType::DT_IMAGE:
+            {
+                std::string aImageName;
+                Image* anImage = Get<Image*>(aFieldOffset);
+                if (anImage)
+                {
+                    std::scoped_lock aLock(gDefinitionResourceLock);
+                    TodFindImagePath(anImage, &aImageName);
+                }
+                AddResource(aFieldOffset, DefFieldType::DT_IMAGE, aImageName);
+                break;
+            }
+            case DefFieldType::DT_FONT:
+            {
+                std::string aFontName;
+                _Font* aFont = Get<_Font*>(aFieldOffset);
+                if (aFont)
+                {
+                    std::scoped_lock aLock(gDefinitionResourceLock);
+                    TodFindFontPath(aFont, &aFontName);
+                }
+                AddResource(aFieldOffset, DefFieldType::DT_FONT, aFontName);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+};
 
-    delete[] (uint *)aDefBasePtr; // already compressed, no need to keep this instance alive
+bool DefinitionWriteCompiledFile(const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition) {
+    DefinitionBlobWriter aWriter;
+    aWriter.Append(theDefinition, theDefMap->mDefSize, alignof(std::max_align_t));
+    aWriter.WriteMap(theDefMap, 0);
+
+    CompiledDefinitionBlobHeader aHeader;
+    aHeader.mCookie = COMPILED_DEFINITION_BLOB_COOKIE;
+    aHeader.mSchemaHash = DefinitionGetSchemaHash(theDefMap);
+    aHeader.mBlobSize = (unsigned int)aWriter.mBlob.size();
+    aHeader.mRelocCount = (unsigned int)aWriter.mRelocs.size();
+    aHeader.mResourceCount = (unsigned int)aWriter.mResources.size();
+
+    // 压缩后不比原数据小时直接存储原数据
+    std::vector<char> aStored;
+    aHeader.mCodec = gDefinitionCompiledCodec;
+    if (aHeader.mCodec == DEFINITION_CODEC_NONE || !DefinitionEncodeBlob(aHeader.mCodec, aWriter.mBlob.data(), aWriter.mBlob.size(), aStored) ||
+        aStored.size() >= aWriter.mBlob.size())
+    {
+        aHeader.mCodec = DEFINITION_CODEC_NONE;
+        aStored.swap(aWriter.mBlob);
+    }
+    aHeader.mStoredSize = (unsigned int)aStored.size();
 
     std::string aFullCompiledPath = DefinitionGetCompiledCacheFullPath(theCompiledFilePath);
     std::string aFilePath = GetFileDir(aFullCompiledPath);
     MkDir(aFilePath);
 
     std::ofstream aFileStream(Sexy::PathFromU8(aFullCompiledPath), std::ios::binary);
-    if (aFileStream) {
-        aFileStream.write(reinterpret_cast<const char*>(aCompressedDef), (std::streamsize)aCompressedSize);
-
-        delete[] (char *)aCompressedDef;
-        return aFileStream.good();
-    }
+    if (!aFileStream)
+        return false;
 
-    delete[] (char *)aCompressedDef;
-    return false;
+    aFileStream.write(reinterpret_cast<const char*>(&aHeader), sizeof(aHeader));
+    aFileStream.write(aStored.data(), (std::streamsize)aStored.size());
+    aFileStream.write(reinterpret_cast<const char*>(aWriter.mRelocs.data()), (std::streamsize)(aWriter.mRelocs.size() * sizeof(unsigned int)));
+    aFileStream.write(reinterpret_cast<const char*>(aWriter.mResources.data()), (std::streamsize)(aWriter.mResources.size() * sizeof(DefinitionBlobResource)));
+    return aFileStream.good();
 }
 
 bool DefinitionCompileFile(const std::string theXMLFilePath, const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition)
@@ -1328,6 +1794,7 @@ bool DefinitionCompileFile(const std::string theXMLFilePath, const std::string&
 //0x4447F0 : (void* def, *defMap, string& xmlFilePath)  //esp -= 0xC
 bool DefinitionCompileAndLoad(const std::string& theXMLFilePath, DefMap* theDefMap, void* theDefinition)
 {
+    DefinitionArenaScope aArenaScope(theDefMap, theDefinition);
 #ifdef _PVZ_DEBUG
     const bool aRequireCompiledUpToDate = true;
 #else
@@ -1341,6 +1808,7 @@ bool DefinitionCompileAndLoad(const std::string& theXMLFilePath, DefMap* theDefM
     if (aShouldTryCompiled && DefinitionReadCompiledFile(aCompiledFilePath, theDefMap, theDefinition))
     {
         TodHesitationTrace("loaded %s", aCompiledFilePath.c_str());
+        aArenaScope.Commit();
         return true;
     }
 
@@ -1350,7 +1818,10 @@ bool DefinitionCompileAndLoad(const std::string& theXMLFilePath, DefMap* theDefM
     TodTrace("compile %d ms:'%s'", (int)aTimer.GetDuration(), aCompiledFilePath.c_str());
     TodHesitationTrace("compiled %s", aCompiledFilePath.c_str());
     if (aResult)
+    {
+        aArenaScope.Commit();
         return true;
+    }
 
 #ifndef _PVZ_DEBUG
     TodErrorMessageBox(StrFormat("missing resource %s", aCompiledFilePath.c_str()).c_str(), "Error");
@@ -1430,9 +1901,51 @@ void DefinitionFreeArrayField(DefinitionArrayDef* theArray, DefMap* theDefMap)
     theArray->mArrayData = nullptr;
 }
 
+// 定义的全部数据均位于分配区中时，只需清空根结构中的指针，然后一次性释放分配区
+static void DefinitionClearRootPointers(DefMap* theDefMap, void* theDefinition)
+{
+    for (DefField* aField = theDefMap->mMapFields; *aField->mFieldName != '\0'; aField++)
+    {
+        void* aVar = (void*)((intptr_t)theDefinition + aField->mFieldOffset);
+        switch (aField->mFieldType)
+        {
+        case DefFieldType::DT_STRING:
+            *(char**)aVar = nullptr;
+            break;
+        case DefFieldType::DT_ARRAY:
+            ((DefinitionArrayDef*)aVar)->mArrayData = nullptr;
+            ((DefinitionArrayDef*)aVar)->mArrayCount = 0;
+            break;
+        case DefFieldType::DT_TRACK_FLOAT:
+            ((FloatParameterTrack*)aVar)->mNodes = nullptr;
+            ((FloatParameterTrack*)aVar)->mCountNodes = 0;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 //0x444A90
 void DefinitionFreeMap(DefMap* theDefMap, void* theDefinition)
 {
+    DefinitionArena* anArena = nullptr;
+    {
+        std::scoped_lock aLock(gDefinitionArenaLock);
+        auto anItr = gDefinitionArenas.find(theDefinition);
+        if (anItr != gDefinitionArenas.end())
+        {
+            anArena = anItr->second;
+            gDefinitionArenas.erase(anItr);
+        }
+    }
+    if (anArena)
+    {
+        DefinitionClearRootPointers(theDefMap, theDefinition);
+        delete anArena;
+        return;
+    }
+
     // 根据 theDefMap 遍历 theDefinition 的每个成员变量
     for (DefField* aField = theDefMap->mMapFields; *aField->mFieldName != '\0'; aField++)
     {
@@ -1458,3 +1971,177 @@ void DefinitionFreeMap(DefMap* theDefMap, void* theDefinition)
         }
     }
 }
+
+void DefinitionTraceArenaStats()
+{
+    TodTrace("definition arena: %d allocs in %d blocks, %d KB used, %d KB wasted, %d definitions",
+        gDefinitionArenaStats.mAllocs.load(), gDefinitionArenaStats.mBlocks.load(), (int)(gDefinitionArenaStats.mBytes.load() / 1024),
+        (int)(gDefinitionArenaStats.mBytesWasted.load() / 1024), gDefinitionArenaStats.mArenas.load());
+}
+
+int DefinitionGetLoadThreadCount(int theTaskCount)
+{
+#ifdef __3DS__
+    int aThreadCount = 1;
+#else
+    int aThreadCount = gDefinitionLoadThreads;
+    if (aThreadCount <= 0)
+        aThreadCount = std::min<int>(std::max<int>(std::thread::hardware_concurrency(), 1), 8);
+#endif
+    return std::max(std::min(aThreadCount, theTaskCount), 1);
+}
+
+// 以工作线程池依次领取 [0, theTaskCount) 中的任务，调用线程也参与执行，全部完成后返回。
+// 在加载任务图的任务中调用时，额外的线程从图的空闲名额中借用，不会超出图的线程数
+int DefinitionParallelFor(const char* theName, int theTaskCount, const std::function<std::string(int)>& theTask)
+{
+    PerfTimer aTimer;
+    aTimer.Start();
+
+    int aThreadCount = 1 + TodTaskGraph::ReserveSpareThreads(DefinitionGetLoadThreadCount(theTaskCount) - 1);
+    std::vector<std::string> anErrors(theTaskCount);
+    std::atomic<int> aNextTask(0);
+    auto aWorker = [&]()
+    {
+        for (int aTask = aNextTask++; aTask < theTaskCount; aTask = aNextTask++)
+        {
+            try
+            {
+                anErrors[aTask] = theTask(aTask);
+            }
+            catch (const std::exception& anException)
+            {
+                anErrors[aTask] = anException.what();
+            }
+        }
+    };
+
+    std::vector<std::thread> aThreads;
+    aThreads.reserve(aThreadCount - 1);
+    for (int i = 1; i < aThreadCount; i++)
+        aThreads.emplace_back(aWorker);
+    aWorker();
+    for (std::thread& aThread : aThreads)
+        aThread.join();
+    TodTaskGraph::ReleaseSpareThreads(aThreadCount - 1);
+
+    int aDuration = (int)aTimer.GetDuration();
+    TodTrace("loading '%s' %d ms (%d threads)", theName, aDuration, aThreadCount);
+
+    // 先全部记录下来：在桌面平台上 TodErrorMessageBox 会抛出异常，只有第一条能弹出
+    for (const std::string& anError : anErrors)
+        if (!anError.empty())
+            TodTrace("%s", anError.c_str());
+    for (const std::string& anError : anErrors)
+        if (!anError.empty())
+            TodErrorMessageBox(anError.c_str(), "Error");
+    return aDuration;
+}
+
+const char* DefinitionGetCodecName(int theCodec)
+{
+    switch (theCodec)
+    {
+    case DEFINITION_CODEC_NONE:     return "none";
+    case DEFINITION_CODEC_LZ4:      return "lz4";
+    case DEFINITION_CODEC_ZLIB:     return "zlib";
+    default:                        return "unknown";
+    }
+}
+
+bool DefinitionEncodeBlob(int theCodec, const char* theData, size_t theSize, std::vector<char>& theResult)
+{
+    switch (theCodec)
+    {
+    case DEFINITION_CODEC_NONE:
+        theResult.assign(theData, theData + theSize);
+        return true;
+    case DEFINITION_CODEC_LZ4:
+    {
+        theResult.resize(LZ4CompressBound((int)theSize));
+        int aSize = LZ4Compress((const unsigned char*)theData, (int)theSize, (unsigned char*)theResult.data(), (int)theResult.size());
+        theResult.resize(aSize);
+        return aSize > 0;
+    }
+    case DEFINITION_CODEC_ZLIB:
+    {
+        uLongf aSize = compressBound((uLong)theSize);
+        theResult.resize(aSize);
+        if (compress((Bytef*)theResult.data(), &aSize, (const Bytef*)theData, (uLong)theSize) != Z_OK)
+            return false;
+        theResult.resize(aSize);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool DefinitionDecodeBlob(int theCodec, const char* theData, size_t theSize, char* theResult, size_t theResultSize)
+{
+    switch (theCodec)
+    {
+    case DEFINITION_CODEC_NONE:
+        if (theSize != theResultSize)
+            return false;
+        memcpy(theResult, theData, theSize);
+        return true;
+    case DEFINITION_CODEC_LZ4:
+        return LZ4Decompress((const unsigned char*)theData, (int)theSize, (unsigned char*)theResult, (int)theResultSize) == (int)theResultSize;
+    case DEFINITION_CODEC_ZLIB:
+    {
+        uLongf aSize = (uLongf)theResultSize;
+        return uncompress((Bytef*)theResult, &aSize, (const Bytef*)theData, (uLong)theSize) == Z_OK && aSize == theResultSize;
+    }
+    default:
+        return false;
+    }
+}
+
+// 将给出的定义依次展开为数据块，以每种压缩方式压缩后反复解压，输出总大小与解压耗时
+void DefinitionBenchmarkCodecs(const std::vector<std::pair<DefMap*, void*>>& theDefinitions)
+{
+    const int BENCHMARK_PASSES = 20;
+
+    std::vector<std::vector<char>> aBlobs;
+    size_t aRawSize = 0;
+    for (const auto& aDefinition : theDefinitions)
+    {
+        DefinitionBlobWriter aWriter;
+        aWriter.Append(aDefinition.second, aDefinition.first->mDefSize, alignof(std::max_align_t));
+        aWriter.WriteMap(aDefinition.first, 0);
+        aRawSize += aWriter.mBlob.size();
+        aBlobs.push_back(std::move(aWriter.mBlob));
+    }
+
+    std::vector<char> aScratch;
+    for (int aCodec = 0; aCodec < NUM_DEFINITION_CODECS; aCodec++)
+    {
+        std::vector<std::vector<char>> aEncoded(aBlobs.size());
+        size_t aStoredSize = 0;
+        PerfTimer aTimer;
+        aTimer.Start();
+        for (size_t i = 0; i < aBlobs.size(); i++)
+        {
+            DefinitionEncodeBlob(aCodec, aBlobs[i].data(), aBlobs[i].size(), aEncoded[i]);
+            aStoredSize += aEncoded[i].size();
+        }
+        double anEncodeTime = aTimer.GetDuration();
+
+        bool aOk = true;
+        aTimer.Start();
+        for (int aPass = 0; aPass < BENCHMARK_PASSES; aPass++)
+        {
+            for (size_t i = 0; i < aBlobs.size(); i++)
+            {
+                aScratch.resize(aBlobs[i].size());
+                aOk &= DefinitionDecodeBlob(aCodec, aEncoded[i].data(), aEncoded[i].size(), aScratch.data(), aScratch.size());
+            }
+        }
+        double aDecodeTime = aTimer.GetDuration() / BENCHMARK_PASSES;
+
+        TodTrace("codec %-4s: %d defs, %d KB -> %d KB, encode %.2f ms, decode %.2f ms (%.0f MB/s)%s",
+            DefinitionGetCodecName(aCodec), (int)aBlobs.size(), (int)(aRawSize / 1024), (int)(aStoredSize / 1024),
+            anEncodeTime, aDecodeTime, aDecodeTime > 0.0 ? aRawSize / 1048.576 / aDecodeTime : 0.0, aOk ? "" : " FAILED");
+    }
+}
@@ -2,6 +2,13 @@
 #define __TODDEFINITION_H__
 
 #include <string>
+#include <iosfwd>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include "TodList.h"
 #include "Reanimator.h"
 #include "TodParticle.h"
@@ -129,6 +136,48 @@ public:
     unsigned int        mUncompressedSize;              //+0x4：未压缩数据的长度
 };
 
+// ====================================================================================================
+// ★ 【可重定位定义数据头】（v2 编译格式）
+// ----------------------------------------------------------------------------------------------------
+// v2 格式将整个定义树（根结构、数组、字符串、轨道节点）连续存放于一个数据块中，指针成员记录为相对数据块起始处的偏移量。
+// 文件布局：头 | 数据块（mBlobSize 字节）| 重定位表（mRelocCount 个 uint32，均为指针成员在数据块中的偏移）| 资源表（mResourceCount 个 DefinitionBlobResource）
+// 读取时数据块只需一次分配、一次读入，按重定位表加上基址即可直接使用，无需逐个分配数组与字符串。
+// ====================================================================================================
+constexpr unsigned int COMPILED_DEFINITION_COOKIE = 0xDEADFED4;
+constexpr unsigned int COMPILED_DEFINITION_BLOB_COOKIE = 0xDEADFED6;
+
+// 数据块的压缩方式
+enum DefinitionCodec
+{
+    DEFINITION_CODEC_NONE = 0,
+    DEFINITION_CODEC_LZ4 = 1,                           // 解压速度优先，为默认方式
+    DEFINITION_CODEC_ZLIB = 2,
+    NUM_DEFINITION_CODECS
+};
+
+constexpr unsigned int MAX_COMPILED_BLOB_SIZE = 64 << 20;   // 读取时数据块长度的上限，远大于任何原版定义
+
+class CompiledDefinitionBlobHeader
+{
+public:
+    unsigned int        mCookie;                        //+0x0：固定为 COMPILED_DEFINITION_BLOB_COOKIE
+    unsigned int        mSchemaHash;                    //+0x4：定义结构图的校验值
+    unsigned int        mBlobSize;                      //+0x8：数据块的长度
+    unsigned int        mRelocCount;                    //+0xC：重定位表的项数
+    unsigned int        mResourceCount;                 //+0x10：资源表的项数
+    unsigned int        mCodec;                         //+0x14：数据块的压缩方式，见 DefinitionCodec
+    unsigned int        mStoredSize;                    //+0x18：数据块在文件中（压缩后）的长度
+};
+
+// 贴图与字体无法存入文件，以名称记录，读取时再通过资源管理器加载并填入相应成员
+class DefinitionBlobResource
+{
+public:
+    unsigned int        mFieldOffset;                   //+0x0：Image* 或 _Font* 成员在数据块中的偏移
+    unsigned int        mFieldType;                     //+0x4：DT_IMAGE 或 DT_FONT
+    unsigned int        mNameOffset;                    //+0x8：资源名称字符串在数据块中的偏移
+};
+
 // ====================================================================================================
 // ★ 【定义路径】
 // ----------------------------------------------------------------------------------------------------
@@ -161,6 +210,12 @@ bool                    DefinitionReadImageField(XMLParser* theXmlParser, Image*
 bool                    DefinitionReadFontField(XMLParser* theXmlParser, _Font** theFont);
 bool                    DefinitionReadField(XMLParser* theXmlParser, DefMap* theDefMap, void* theDefinition, bool* theDone);
 bool                    DefinitionWriteCompiledFile(const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition);
+bool                    DefinitionReadCompiledBlob(std::ifstream& theFileStream, const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition);
+uint                    DefinitionGetSchemaHash(DefMap* theDefMap);
+bool                    DefinitionEncodeBlob(int theCodec, const char* theData, size_t theSize, std::vector<char>& theResult);
+bool                    DefinitionDecodeBlob(int theCodec, const char* theData, size_t theSize, char* theResult, size_t theResultSize);
+const char*             DefinitionGetCodecName(int theCodec);
+void                    DefinitionBenchmarkCodecs(const std::vector<std::pair<DefMap*, void*>>& theDefinitions);
 bool                    DefinitionCompileFile(const std::string theXMLFilePath, const std::string& theCompiledFilePath, DefMap* theDefMap, void* theDefinition);
 
 void                    DefMapWriteToCache(void*& theWritePtr, DefMap* theDefMap, void* theDefinition);
@@ -198,6 +253,57 @@ bool                    DefinitionLoadFont(_Font** theFont, const std::string& t
 bool                    DefinitionLoadXML(const std::string& theFilename, DefMap* theDefMap, void* theDefinition);
 void                    DefinitionFreeArrayField(DefinitionArrayDef* theArray, DefMap* theDefMap);
 void                    DefinitionFreeMap(DefMap* theDefMap, void* theDefinition);
+void                    DefinitionFree(void* thePtr);
+
+// ====================================================================================================
+// ★ 【定义数据分配区】
+// ----------------------------------------------------------------------------------------------------
+// 作用域内当前线程的 DefinitionAlloc 均从属于 theDefinition 的分配区中切分，DefinitionFreeMap 时一次性释放。
+// 加载成功后须调用 Commit()，否则离开作用域时分配区连同定义中指向它的指针一并作废（不会登记）。
+// ====================================================================================================
+class DefinitionArena;
+class DefinitionArenaScope
+{
+public:
+    DefMap*             mDefMap;
+    void*               mDefinition;
+    DefinitionArena*    mArena;                         // 为空指针时表示沿用外层作用域的分配区
+    bool                mCommitted;
+
+public:
+    DefinitionArenaScope(DefMap* theDefMap, void* theDefinition);
+    ~DefinitionArenaScope();
+
+    void                Commit() { mCommitted = true; }
+};
+
+// 统计：mAllocs 次分配仅向堆申请了 mBlocks 块内存
+struct DefinitionArenaStats
+{
+    std::atomic<int>        mArenas{ 0 };               // 已登记的分配区数
+    std::atomic<int>        mAllocs{ 0 };               // 由分配区满足的分配次数
+    std::atomic<int>        mBlocks{ 0 };               // 分配区实际向堆申请的内存块数
+    std::atomic<int64_t>    mBytes{ 0 };                // 由分配区满足的字节数
+    std::atomic<int64_t>    mBytesWasted{ 0 };          // 块尾未能利用的字节数
+};
+extern DefinitionArenaStats gDefinitionArenaStats;
+
+void                    DefinitionTraceArenaStats();
+
+// ====================================================================================================
+// ★ 【并行加载】
+// ----------------------------------------------------------------------------------------------------
+// 各定义文件的读取与修复互不相关，可由多个工作线程同时进行。
+// 资源管理器与贴图表不是线程安全的，DefinitionLoadImage 等对其的访问均须持有 gDefinitionResourceLock。
+// ====================================================================================================
+extern int              gDefinitionLoadThreads;         // 加载定义时使用的线程数，为 0 时自动选择
+extern int              gDefinitionCompiledCodec;       // 写入编译文件时使用的压缩方式
+extern std::mutex       gDefinitionResourceLock;
+
+int                     DefinitionGetLoadThreadCount(int theTaskCount);
+// 任务返回错误信息（成功时为空串），任务内抛出的异常也按错误处理；工作线程上不弹出错误框，
+// 全部完成后才在调用线程上按任务顺序逐条报告。theName 用于记录耗时，返回总耗时（毫秒）
+int                     DefinitionParallelFor(const char* theName, int theTaskCount, const std::function<std::string(int)>& theTask);
 
 /*inline*/ bool         FloatTrackIsSet(const FloatParameterTrack& theTrack);
 /*inline*/ void         FloatTrackSetDefault(FloatParameterTrack& theTrack, float theValue);
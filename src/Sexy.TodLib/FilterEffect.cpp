@@ -3,66 +3,110 @@
 #include "FilterEffect.h"
 #include "graphics/MemoryImage.h"
 
-//0x446B80
-void RGB_to_HSL(float r, float g, float b, float& h, float& s, float& l)
+// 软件路径的整数版 RGB→HSL→RGB 往返，所有量均为 16.16 定点数，色相以六分区为单位
+static inline uint32_t LumSatPixel(uint32_t thePixel, int64_t theLum, int64_t theSat)
 {
-	float maxval = std::max(r, g);
-	maxval = std::max(maxval, b);
-	float minval = std::min(r, g);
-	minval = std::min(minval, b);
+	constexpr int64_t ONE = 1 << 16;
+	int r = thePixel >> 16 & 255;
+	int g = thePixel >> 8 & 255;
+	int b = thePixel & 255;
+	int maxval = std::max(std::max(r, g), b);
+	int minval = std::min(std::min(r, g), b);
+	int sum = maxval + minval;
+	int delta = maxval - minval;
 
-	l = (minval + maxval) / 2;  //luminosity
-	if (l <= 0.0f)
-		return;
+	int64_t l = sum * (ONE / 2) / 255;  //luminosity
+	int64_t s = 0;
+	int64_t h = 0;
+	if (delta > 0)
+	{
+		s = (static_cast<int64_t>(delta) << 16) / ((sum <= 255) ? sum : (510 - sum));  //saturation
+		int64_t r2 = (static_cast<int64_t>(maxval - r) << 16) / delta;
+		int64_t g2 = (static_cast<int64_t>(maxval - g) << 16) / delta;
+		int64_t b2 = (static_cast<int64_t>(maxval - b) << 16) / delta;
+		if (maxval == r)
+			h = ((g == minval) ? (5 * ONE + b2) : (ONE - g2));
+		else if (maxval == g)
+			h = ((b == minval) ? (ONE + r2) : (3 * ONE - b2));
+		else
+			h = ((r == minval) ? (3 * ONE + g2) : (5 * ONE - r2));
+	}
+	s = s * theSat >> 16;
+	l = l * theLum >> 16;
 
-	float delta = maxval - minval;
-	s = delta;
-	if (s <= 0.0f)
-		return;
-	s /= ((l <= 0.5f) ? (minval + maxval) : (2.0f - minval - maxval));  //saturation
-
-	float r2 = (maxval - r) / delta;
-	float g2 = (maxval - g) / delta;
-	float b2 = (maxval - b) / delta;
-	if (maxval == r)
-		h = ((g == minval) ? (5.0f + b2) : (1.0f - g2));
-	else if (maxval == g)
-		h = ((b == minval) ? (1.0f + r2) : (3.0f - b2));
-	else
-		h = ((r == minval) ? (3.0f + g2) : (5.0f - r2));
-	h /= 6.0f;  //hue
+	uint32_t a = thePixel & 0xFF000000;
+	int64_t v = (l <= ONE / 2) ? (l * (ONE + s) >> 16) : (l + s - (l * s >> 16));
+	if (v <= 0)
+		return a;
+
+	int64_t y = 2 * l - v;
+	int64_t sextant = ClampInt(static_cast<int>(h >> 16), 0, 5);
+	int64_t vsf = (v - y) * (h - (sextant << 16)) >> 16;
+	int64_t x = y + vsf;
+	int64_t z = v - vsf;
+
+	int64_t ro, go, bo;
+	switch (sextant)
+	{
+	case 0:		ro = v;	go = x;	bo = y;	break;
+	case 1:		ro = z;	go = v;	bo = y;	break;
+	case 2:		ro = y;	go = v;	bo = x;	break;
+	case 3:		ro = y;	go = z;	bo = v;	break;
+	case 4:		ro = x;	go = y;	bo = v;	break;
+	default:	ro = v;	go = y;	bo = z;	break;
+	}
+	return a | ClampInt(static_cast<int>(ro * 255 >> 16), 0, 255) << 16 | ClampInt(static_cast<int>(go * 255 >> 16), 0, 255) << 8 | ClampInt(static_cast<int>(bo * 255 >> 16), 0, 255);
 }
 
-//0x446D80
-void HSL_to_RGB(float h, float sl, float l, float& r, float& g, float& b)
+static void FilterEffectGetParams(FilterEffect theFilterEffect, int& theColorFilter, float& theLum, float& theSat)
 {
-	float v = (l <= 0.5f) ? (l * (1.0f + sl)) : (l + sl - l * sl);
-	if (v <= 0.0f)
+	theLum = 1.0f;
+	theSat = 1.0f;
+	switch (theFilterEffect)
 	{
-		r = 0.0f;
-		g = 0.0f;
-		b = 0.0f;
-		return;
+	case FilterEffect::FILTER_EFFECT_WASHED_OUT:		theColorFilter = ColorFilter_LumSat;	theLum = 1.8f;	theSat = 0.2f;	break;
+	case FilterEffect::FILTER_EFFECT_LESS_WASHED_OUT:	theColorFilter = ColorFilter_LumSat;	theLum = 1.2f;	theSat = 0.3f;	break;
+	case FilterEffect::FILTER_EFFECT_WHITE:				theColorFilter = ColorFilter_White;								break;
+	default:											theColorFilter = ColorFilter_None;								break;
 	}
+}
 
-	float y = 2 * l - v;
-	float sv = (v - y) / v;
-	h *= 6.0f;
-	int sextant = ClampInt(static_cast<int>(h), 0, 5);
-	float vsf = v * sv * (h - sextant);
-	float x = y + vsf;
-	float z = v - vsf;
+// 滤镜代理贴图：自身不持有像素，3D 绘制时由 GLInterface 采样源贴图的副本并在着色器中应用滤镜；
+// 仅当软件路径（或不支持着色器滤镜的平台）读取像素时才在 CPU 上烘焙一份
+class FilterEffectImage : public MemoryImage
+{
+public:
+	FilterEffect			mFilterEffect;
 
-	switch (sextant)
+public:
+	FilterEffectImage(Image* theImage, FilterEffect theFilterEffect) : mFilterEffect(theFilterEffect)
 	{
-	case 0:	r = v;	g = x;	b = y;	break;
-	case 1:	r = z;	g = v;	b = y;	break;
-	case 2:	r = y;	g = v;	b = x;	break;
-	case 3:	r = y;	g = z;	b = v;	break;
-	case 4:	r = x;	g = y;	b = v;	break;
-	case 5:	r = v;	g = y;	b = z;	break;
+		mWidth = theImage->mWidth;
+		mHeight = theImage->mHeight;
+		mNumCols = theImage->mNumCols;
+		mNumRows = theImage->mNumRows;
+		mHasTrans = true;
+		mHasAlpha = true;
+		SetColorFilterSource((MemoryImage*)theImage);
+		float aLum, aSat;
+		FilterEffectGetParams(theFilterEffect, mColorFilter, aLum, aSat);
+		mColorFilterParams[0] = aLum;
+		mColorFilterParams[1] = aSat;
 	}
-}
+
+	virtual uint32_t* GetBits()
+	{
+		if (mBits == nullptr && mColorTable == nullptr && mColorFilterSource != nullptr)
+		{
+			MemoryImage* aBaked = FilterEffectCreateImage(mColorFilterSource, mFilterEffect);
+			mBits = aBaked->mBits;
+			aBaked->mBits = nullptr;
+			delete aBaked;
+			BitsChanged();
+		}
+		return MemoryImage::GetBits();
+	}
+};
 
 ImageFilterMap gFilterMap[FilterEffect::NUM_FILTER_EFFECTS];
 
@@ -91,25 +135,20 @@ void FilterEffectDisposeForApp()
 //0x446FD0
 void FilterEffectDoLumSat(MemoryImage* theImage, float theLum, float theSat)
 {
+	int64_t aLum = static_cast<int64_t>(theLum * 65536.0f);
+	int64_t aSat = static_cast<int64_t>(theSat * 65536.0f);
 	uint32_t* ptr = theImage->mBits;
-	for (int y = 0; y < theImage->mHeight; y++)
+	uint32_t aLastIn = 0;
+	uint32_t aLastOut = LumSatPixel(0, aLum, aSat);
+	for (int i = theImage->mWidth * theImage->mHeight; i > 0; i--)
 	{
-		for (int x = 0; x < theImage->mWidth; x++)
+		// 相邻像素经常相同（尤其是透明区域），直接复用上一次的结果
+		if (*ptr != aLastIn)
 		{
-			float b = static_cast<float>(*ptr & 255) / 255;
-			float g = static_cast<float>(*ptr >> 8 & 255) / 255;
-			float r = static_cast<float>(*ptr >> 16 & 255) / 255;
-			int a = *ptr >> 24 & 255;
-
-			float h, s, l;
-			RGB_to_HSL(r, g, b, h, s, l);
-			s *= theSat;
-			l *= theLum;
-			HSL_to_RGB(h, s, l, r, g, b);
-
-			*ptr = a << 24 | ClampInt(r * 255, 0, 255) << 16 | ClampInt(g * 255, 0, 255) << 8 | ClampInt(b * 255, 0, 255);
-			ptr++;
+			aLastIn = *ptr;
+			aLastOut = LumSatPixel(aLastIn, aLum, aSat);
 		}
+		*ptr++ = aLastOut;
 	}
 }
 
@@ -132,22 +171,33 @@ void FilterEffectDoWhite(MemoryImage* theImage)
 			*ptr++ |= 0x00FFFFFF;
 }
 
-//0x4471D0
-MemoryImage* FilterEffectCreateImage(Image* theImage, FilterEffect theFilterEffect)
+// 将 theImage 绘制到 theDest 上并修正透明边缘像素的颜色，源贴图本身不受影响
+static void FilterEffectCopyBits(MemoryImage* theDest, Image* theImage)
 {
-	MemoryImage* aImage = new MemoryImage();
-	aImage->mWidth = theImage->mWidth;
-	aImage->mHeight = theImage->mHeight;
 	int aNumBits = theImage->mWidth * theImage->mHeight;
-	aImage->mBits = new uint32_t[aNumBits + 1];
-	aImage->mHasTrans = true;
-	aImage->mHasAlpha = true;
-	memset(aImage->mBits, 0, aNumBits * 4);
-	aImage->mBits[aNumBits] = Sexy::MEMORYCHECK_ID;
+	if (theDest->mBits == nullptr)
+	{
+		theDest->mWidth = theImage->mWidth;
+		theDest->mHeight = theImage->mHeight;
+		theDest->mNumCols = theImage->mNumCols;
+		theDest->mNumRows = theImage->mNumRows;
+		theDest->mBits = new uint32_t[aNumBits + 1];
+		theDest->mHasTrans = true;
+		theDest->mHasAlpha = true;
+		theDest->mBits[aNumBits] = Sexy::MEMORYCHECK_ID;
+	}
+	memset(theDest->mBits, 0, aNumBits * 4);
 
-	Graphics aMemoryGraphics(aImage);
+	Graphics aMemoryGraphics(theDest);
 	aMemoryGraphics.DrawImage(theImage, 0, 0);
-	FixPixelsOnAlphaEdgeForBlending(aImage);
+	FixPixelsOnAlphaEdgeForBlending(theDest);
+}
+
+//0x4471D0
+MemoryImage* FilterEffectCreateImage(Image* theImage, FilterEffect theFilterEffect)
+{
+	MemoryImage* aImage = new MemoryImage();
+	FilterEffectCopyBits(aImage, theImage);
 	
 	switch (theFilterEffect)
 	{
@@ -160,11 +210,32 @@ MemoryImage* FilterEffectCreateImage(Image* theImage, FilterEffect theFilterEffe
 	}
 
 	aImage->mBitsChangedCount++;
-	aImage->mNumCols = theImage->mNumCols;
-	aImage->mNumRows = theImage->mNumRows;
 	return aImage;
 }
 
+// 着色器采样的源贴图副本（源贴图的 mColorFilterTexture），边缘像素与软件路径烘焙前一样经过修正
+class FilterEffectSourceCopy : public MemoryImage
+{
+public:
+	int						mSourceBitsChangedCount = -1;
+};
+
+// 源贴图为另一张代理贴图时，副本即为其烘焙结果，因此两层滤镜都会生效；源贴图的像素改变后重新复制
+static void FilterEffectUpdateSourceCopy(MemoryImage* theSourceImage)
+{
+	if (theSourceImage->mColorFilterTexture == nullptr)
+		theSourceImage->mColorFilterTexture = new FilterEffectSourceCopy();
+
+	FilterEffectSourceCopy* aCopy = static_cast<FilterEffectSourceCopy*>(theSourceImage->mColorFilterTexture);
+	if (aCopy->mSourceBitsChangedCount == theSourceImage->mBitsChangedCount)
+		return;
+
+	FilterEffectCopyBits(aCopy, theSourceImage);
+	aCopy->BitsChanged();
+	// 复制时代理贴图可能刚完成烘焙，因此在复制之后记录
+	aCopy->mSourceBitsChangedCount = theSourceImage->mBitsChangedCount;
+}
+
 //0x447340
 Image* FilterEffectGetImage(Image* theImage, FilterEffect theFilterEffect)
 {
@@ -173,9 +244,26 @@ Image* FilterEffectGetImage(Image* theImage, FilterEffect theFilterEffect)
 	ImageFilterMap& aFilterMap = gFilterMap[theFilterEffect];
 	ImageFilterMap::iterator it = aFilterMap.find(theImage);
 	if (it != aFilterMap.end())
-		return it->second;
+	{
+		// 源贴图已被释放的代理贴图属于此前位于同一地址的旧贴图，需重新创建
+		MemoryImage* aSourceImage = ((MemoryImage*)it->second)->mColorFilterSource;
+		if (aSourceImage != nullptr)
+		{
+			FilterEffectUpdateSourceCopy(aSourceImage);
+			return it->second;
+		}
+
+		delete it->second;
+		aFilterMap.erase(it);
+	}
+
+	// 白色滤镜只保留透明度，作用于另一张代理贴图时等价于直接作用于其源贴图
+	MemoryImage* aSourceImage = (MemoryImage*)theImage;
+	if (theFilterEffect == FilterEffect::FILTER_EFFECT_WHITE && aSourceImage->mColorFilterSource != nullptr)
+		aSourceImage = aSourceImage->mColorFilterSource;
 
-	MemoryImage* aImage = FilterEffectCreateImage(theImage, theFilterEffect);
+	FilterEffectUpdateSourceCopy(aSourceImage);
+	MemoryImage* aImage = new FilterEffectImage(aSourceImage, theFilterEffect);
 	aFilterMap.insert(ImageFilterMap::value_type(theImage, aImage));
 	return aImage;
 }
@@ -1163,13 +1163,21 @@ void ReanimatorLoadDefinitions(ReanimationParams* theReanimationParamArray, int
 	gReanimatorDefArray = new ReanimatorDefinition[theReanimationParamArraySize];
 
 #ifndef LOW_MEMORY
-	for (unsigned int i = 0; i < gReanimationParamArraySize; i++)
+	// 每个动画定义各自独立，交由工作线程并行加载
+	// 与 ReanimatorEnsureDefinitionLoaded 的预加载相同，但失败时返回错误信息，由 DefinitionParallelFor 在调用线程上报告
+	DefinitionParallelFor("reanim", gReanimationParamArraySize, [theReanimationParamArray](int i)
 	{
 		ReanimationParams* aReanimationParams = &theReanimationParamArray[i];
 		TOD_ASSERT(aReanimationParams->mReanimationType == i);
-		if (DefinitionIsCompiled(aReanimationParams->mReanimFileName))
-			ReanimatorEnsureDefinitionLoaded(aReanimationParams->mReanimationType, true);
-	}
+		ReanimatorDefinition* aReanimDef = &gReanimatorDefArray[i];
+		if (!DefinitionIsCompiled(aReanimationParams->mReanimFileName) || aReanimDef->mTracks.tracks != nullptr)
+			return std::string();
+		if (gSexyAppBase->mShutdown || gAppCloseRequest())
+			return std::string();
+		if (!ReanimationLoadDefinition(aReanimationParams->mReanimFileName, aReanimDef))
+			return std::string("Failed to load reanim '") + aReanimationParams->mReanimFileName + "'";
+		return std::string();
+	});
 #endif
 }
 
@@ -454,6 +454,18 @@ void TodDrawImageCelScaled(Graphics* g, Image* theImageStrip, int thePosX, int t
 	g->DrawImage(theImageStrip, aDestRect, aSrcRect);
 }
 
+class RenderCommand
+{
+public:
+	Image*					mImage;
+	int						mDest[2];
+	int						mSrc[4];
+	int						mMode;
+	Color					mColor;
+	bool					mUseAlphaCorrection;
+	RenderCommand*			mNext;
+};
+
 static const int POOL_SIZE = 4096;
 static RenderCommand gRenderCommandPool[POOL_SIZE];
 static RenderCommand* gRenderTail[256];
@@ -5,6 +5,7 @@
 #include "../GameConstants.h"
 #include "graphics/Graphics.h"
 #include "graphics/GLInterface.h"
+#include "misc/PerfTimer.h"
 
 int gParticleDefCount;                      // [0x6A9F08]
 TodParticleDefinition* gParticleDefArray;   // [0x6A9F0C]
@@ -124,13 +125,9 @@ ParticleParams gLawnParticleArray[ParticleEffect::NUM_PARTICLES] = {
 bool TodParticleLoadADef(TodParticleDefinition* theParticleDef, const char* theParticleFileName)
 {
 	TodHesitationBracket("Load Particle %s", theParticleFileName);
+	DefinitionArenaScope aArenaScope(&gParticleDefMap, theParticleDef);  // 默认轨道节点也从定义的分配区中分配
 	if (!DefinitionLoadXML(theParticleFileName, &gParticleDefMap, theParticleDef))
-	{
-		char aBuf[512];
-		snprintf(aBuf, sizeof(aBuf), "Failed to load particle '%s'", theParticleFileName);
-		TodErrorMessageBox(aBuf, "Error");
-		return false;
-	}
+		return false;  // 由调用者报告：加载在工作线程上进行，不能在此弹出错误框
 	else
 	{
 		for (int i = 0; i < theParticleDef->mEmitterDefCount; i++)
@@ -174,8 +171,13 @@ bool TodParticleLoadADef(TodParticleDefinition* theParticleDef, const char* theP
 			FloatTrackSetDefault(aDef.mClipRight, 0.0f);
 			FloatTrackSetDefault(aDef.mAnimationRate, 0.0f);
 			if (aDef.mImage)
+			{
+				// 贴图可能被多个粒子共用，而各粒子定义会并行加载
+				std::scoped_lock aLock(gDefinitionResourceLock);
 				reinterpret_cast<MemoryImage*>(aDef.mImage)->mRenderFlags |= RenderImageFlags::RenderImageFlag_MinimizeNumSubdivisions;
+			}
 		}
+		aArenaScope.Commit();
 		return true;
 	}
 }
@@ -192,18 +194,14 @@ void TodParticleLoadDefinitions(ParticleParams* theParticleParamArray, int thePa
 	// This was uninitialised before!
 	// memset(gParticleDefArray, 0, theParticleParamArraySize*sizeof(TodParticleDefinition));
 
-	for (int i = 0; i < gParticleParamArraySize; i++)
+	DefinitionParallelFor("particle", gParticleParamArraySize, [](int i)
 	{
 		ParticleParams& aParticleParams = gParticleParamArray[i];
 		TOD_ASSERT(aParticleParams.mParticleEffect == i);
 		if (!TodParticleLoadADef(&gParticleDefArray[i], aParticleParams.mParticleFileName))
-		{
-			char aBuf[512];
-			snprintf(aBuf, sizeof(aBuf), "Failed to load particle '%s'", aParticleParams.mParticleFileName);
-			TodErrorMessageBox(aBuf, "Error");
-		}
-		gSexyAppBase->mNumLoadingThreadTasks += 6;
-	}
+			return std::string("Failed to load particle '") + aParticleParams.mParticleFileName + "'";
+		return std::string();
+	});
 }
 
 //0x515E30
@@ -0,0 +1,246 @@
+#include <thread>
+#include <algorithm>
+#include "TodDebug.h"
+#include "TodCommon.h"
+#include "TodTaskGraph.h"
+
+static thread_local TodTaskGraph::Task* gTodCurrentTask = nullptr;
+static thread_local TodTaskGraph* gTodCurrentGraph = nullptr;
+
+TodTaskGraph::TodTaskGraph()
+{
+    mRemaining = 0;
+    mNumThreads = 1;
+    mNumBusy = 0;
+    mFailed = false;
+    mWallTime = 0.0;
+}
+
+// 前置任务须先于本任务添加，因此任务序号本身即为一个拓扑序
+int TodTaskGraph::AddTask(const char* theName, int theCost, TaskFunc theFunc, std::initializer_list<int> theDependencies, int theLane)
+{
+    int aTaskIndex = (int)mTasks.size();
+    std::unique_ptr<Task> aTask = std::make_unique<Task>();
+    aTask->mName = theName;
+    aTask->mFunc = std::move(theFunc);
+    aTask->mNumDependencies = (int)theDependencies.size();
+    aTask->mPendingDependencies = 0;
+    aTask->mLane = theLane;
+    aTask->mCost = std::max(theCost, 1);
+    aTask->mPriority = 0;
+    aTask->mUnits = 0;
+    aTask->mStartTime = 0.0;
+    aTask->mDuration = 0.0;
+    for (int aDependency : theDependencies)
+    {
+        TOD_ASSERT(aDependency >= 0 && aDependency < aTaskIndex);
+        mTasks[aDependency]->mDependents.push_back(aTaskIndex);
+    }
+    if (theLane >= (int)mLaneBusy.size())
+        mLaneBusy.resize(theLane + 1, false);
+
+    mTasks.push_back(std::move(aTask));
+    return aTaskIndex;
+}
+
+double TodTaskGraph::GetElapsed() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStartTime).count();
+}
+
+// 在就绪任务中选出优先级最高、且所在通道空闲的任务；没有可执行的任务时返回 -1
+int TodTaskGraph::PopReadyTask()
+{
+    if (mFailed)
+        return -1;
+
+    int aBest = -1;
+    for (int i = 0; i < (int)mReady.size(); i++)
+    {
+        const Task& aTask = *mTasks[mReady[i]];
+        if (aTask.mLane != NO_LANE && mLaneBusy[aTask.mLane])
+            continue;
+        if (aBest == -1 || aTask.mPriority > mTasks[mReady[aBest]]->mPriority)
+            aBest = i;
+    }
+    if (aBest == -1)
+        return -1;
+
+    int aTaskIndex = mReady[aBest];
+    mReady.erase(mReady.begin() + aBest);
+    return aTaskIndex;
+}
+
+void TodTaskGraph::WorkerProc()
+{
+    std::unique_lock<std::mutex> aLock(mLock);
+    for (;;)
+    {
+        // 名额被任务借走时，即使有就绪任务也要等待归还
+        int aTaskIndex = -1;
+        while (mNumBusy >= mNumThreads || (aTaskIndex = PopReadyTask()) == -1)
+        {
+            if (mRemaining == 0 || mFailed)
+                return;
+            mCondition.wait(aLock);
+        }
+
+        Task& aTask = *mTasks[aTaskIndex];
+        if (aTask.mLane != NO_LANE)
+            mLaneBusy[aTask.mLane] = true;
+        mNumBusy++;
+        aLock.unlock();
+
+        // 调用 Run 的线程可能本身正在执行外层图的任务，结束后恢复
+        Task* aOuterTask = gTodCurrentTask;
+        TodTaskGraph* aOuterGraph = gTodCurrentGraph;
+        gTodCurrentTask = &aTask;
+        gTodCurrentGraph = this;
+        aTask.mStartTime = GetElapsed();
+        bool aResult = aTask.mFunc();
+        aTask.mDuration = GetElapsed() - aTask.mStartTime;
+        gTodCurrentTask = aOuterTask;
+        gTodCurrentGraph = aOuterGraph;
+#ifdef _PVZ_DEBUG
+        if (aResult && aTask.mUnits > 0 && aTask.mUnitsDone != aTask.mUnits)
+            TodTrace("Didn't calculate loading task count correctly!!!! '%s' advanced %d of %d units", aTask.mName.c_str(), aTask.mUnitsDone.load(), aTask.mUnits);
+#endif
+
+        aLock.lock();
+        if (aTask.mLane != NO_LANE)
+            mLaneBusy[aTask.mLane] = false;
+        mNumBusy--;
+        aTask.mDone = true;
+        mRemaining--;
+        if (!aResult)
+        {
+            TodTrace("loading task '%s' failed", aTask.mName.c_str());
+            mFailed = true;
+        }
+        else
+        {
+            for (int aDependent : aTask.mDependents)
+                if (--mTasks[aDependent]->mPendingDependencies == 0)
+                    mReady.push_back(aDependent);
+        }
+        mCondition.notify_all();
+    }
+}
+
+// 以 theThreadCount 个线程（含调用线程）执行全部任务，任一任务失败时返回 false
+bool TodTaskGraph::Run(int theThreadCount)
+{
+    for (int i = (int)mTasks.size() - 1; i >= 0; i--)
+    {
+        Task& aTask = *mTasks[i];
+        int aLongestTail = 0;
+        for (int aDependent : aTask.mDependents)
+            aLongestTail = std::max(aLongestTail, mTasks[aDependent]->mPriority);
+        aTask.mPriority = aTask.mCost + aLongestTail;
+        aTask.mPendingDependencies = aTask.mNumDependencies;
+        aTask.mUnitsDone = 0;
+        aTask.mDone = false;
+    }
+
+    mReady.clear();
+    for (int i = 0; i < (int)mTasks.size(); i++)
+        if (mTasks[i]->mPendingDependencies == 0)
+            mReady.push_back(i);
+    mRemaining = (int)mTasks.size();
+    mNumThreads = std::max(theThreadCount, 1);
+    mNumBusy = 0;
+    mFailed = false;
+    mStartTime = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> aWorkers;
+    for (int i = 1; i < theThreadCount; i++)
+        aWorkers.emplace_back(&TodTaskGraph::WorkerProc, this);
+    WorkerProc();
+    for (std::thread& aWorker : aWorkers)
+        aWorker.join();
+
+    mWallTime = GetElapsed();
+    return !mFailed;
+}
+
+// 按预计耗时加权的完成比例，可在其他线程中随时调用
+double TodTaskGraph::GetProgress() const
+{
+    double aTotal = 0.0;
+    double aDone = 0.0;
+    for (const std::unique_ptr<Task>& aTask : mTasks)
+    {
+        aTotal += aTask->mCost;
+        if (aTask->mDone)
+            aDone += aTask->mCost;
+        else if (aTask->mUnits > 0)
+            aDone += aTask->mCost * std::min(aTask->mUnitsDone / (double)aTask->mUnits, 1.0);
+    }
+    return aTotal > 0.0 ? aDone / aTotal : 0.0;
+}
+
+// 输出各任务的实际耗时，以及按实际耗时计算出的关键路径
+void TodTaskGraph::TraceSchedule() const
+{
+    int aNumTasks = (int)mTasks.size();
+    std::vector<double> aFinish(aNumTasks, 0.0);
+    std::vector<int> aPrevious(aNumTasks, -1);
+    double aTotalWork = 0.0;
+    int aLast = -1;
+    for (int i = 0; i < aNumTasks; i++)
+    {
+        const Task& aTask = *mTasks[i];
+        TodTrace("loading '%s' %d ms (at %d ms)", aTask.mName.c_str(), (int)aTask.mDuration, (int)aTask.mStartTime);
+        aTotalWork += aTask.mDuration;
+        aFinish[i] += aTask.mDuration;
+        for (int aDependent : aTask.mDependents)
+        {
+            if (aFinish[i] > aFinish[aDependent])
+            {
+                aFinish[aDependent] = aFinish[i];
+                aPrevious[aDependent] = i;
+            }
+        }
+        if (aLast == -1 || aFinish[i] > aFinish[aLast])
+            aLast = i;
+    }
+    if (aLast == -1)
+        return;
+
+    std::string aPath;
+    for (int i = aLast; i != -1; i = aPrevious[i])
+        aPath = mTasks[i]->mName + (aPath.empty() ? "" : " > ") + aPath;
+    TodTrace("loading critical path %d ms [%s], wall %d ms, work %d ms", (int)aFinish[aLast], aPath.c_str(), (int)mWallTime, (int)aTotalWork);
+}
+
+bool TodTaskGraph::AdvanceCurrentTask(int theUnits)
+{
+    if (gTodCurrentTask == nullptr)
+        return false;
+
+    gTodCurrentTask->mUnitsDone += theUnits;
+    return true;
+}
+
+int TodTaskGraph::ReserveSpareThreads(int theWanted)
+{
+    TodTaskGraph* aGraph = gTodCurrentGraph;
+    if (aGraph == nullptr || theWanted <= 0)
+        return std::max(theWanted, 0);
+
+    std::lock_guard<std::mutex> aLock(aGraph->mLock);
+    int aGranted = std::clamp(aGraph->mNumThreads - aGraph->mNumBusy, 0, theWanted);
+    aGraph->mNumBusy += aGranted;
+    return aGranted;
+}
+
+void TodTaskGraph::ReleaseSpareThreads(int theCount)
+{
+    TodTaskGraph* aGraph = gTodCurrentGraph;
+    if (aGraph == nullptr || theCount <= 0)
+        return;
+
+    std::lock_guard<std::mutex> aLock(aGraph->mLock);
+    aGraph->mNumBusy -= theCount;
+    aGraph->mCondition.notify_all();
+}
@@ -0,0 +1,82 @@
+#ifndef __TODTASKGRAPH_H__
+#define __TODTASKGRAPH_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ====================================================================================================
+// ★ 【任务图】
+// ----------------------------------------------------------------------------------------------------
+// 每个任务声明其前置任务，前置任务全部完成后即可由工作线程池中的任一线程执行。
+// 就绪任务按“自身起至图末端的最长预计耗时”优先调度，因此总耗时受关键路径约束。
+// 同一通道（mLane）上的任务互斥执行，用于保护不可重入的子系统，例如资源管理器的分组迭代。
+// 任务内部再开线程时须先以 ReserveSpareThreads 向图借用空闲的工作线程名额，使同时运行的线程总数不超过 Run 的线程数。
+// ====================================================================================================
+class TodTaskGraph
+{
+public:
+    typedef std::function<bool()> TaskFunc;     // 返回 false 表示失败，尚未开始的任务将不再执行
+
+    static constexpr int NO_LANE = -1;
+
+    struct Task
+    {
+        std::string             mName;
+        TaskFunc                mFunc;
+        std::vector<int>        mDependents;                // 以本任务为前置的任务
+        int                     mNumDependencies;
+        int                     mPendingDependencies;       // 尚未完成的前置任务数
+        int                     mLane;
+        int                     mCost;                      // 预计耗时（毫秒），用于调度优先级与进度
+        int                     mPriority;                  // 自本任务起至图末端的最长预计耗时
+        int                     mUnits;                     // 任务内部进度的总单位数，为 0 时仅在完成时计入进度
+        std::atomic<int>        mUnitsDone{ 0 };
+        std::atomic<bool>       mDone{ false };
+        double                  mStartTime;                 // 相对于 Run 开始的时刻（毫秒）
+        double                  mDuration;                  // 实际耗时（毫秒）
+    };
+
+protected:
+    std::vector<std::unique_ptr<Task>> mTasks;
+    std::vector<int>            mReady;
+    std::vector<bool>           mLaneBusy;
+    std::mutex                  mLock;
+    std::condition_variable     mCondition;
+    int                         mRemaining;
+    int                         mNumThreads;                // Run 的线程数
+    int                         mNumBusy;                   // 正在执行任务的线程数，加上任务借用的线程数
+    bool                        mFailed;
+    double                      mWallTime;
+    std::chrono::steady_clock::time_point mStartTime;
+
+    int                         PopReadyTask();
+    void                        WorkerProc();
+    double                      GetElapsed() const;
+
+public:
+    TodTaskGraph();
+
+    int                         AddTask(const char* theName, int theCost, TaskFunc theFunc, std::initializer_list<int> theDependencies = {}, int theLane = NO_LANE);
+    void                        SetTaskUnits(int theTask, int theUnits) { mTasks[theTask]->mUnits = theUnits; }
+    int                         GetNumTasks() const { return (int)mTasks.size(); }
+    const Task&                 GetTask(int theTask) const { return *mTasks[theTask]; }
+
+    bool                        Run(int theThreadCount);
+    double                      GetProgress() const;
+    void                        TraceSchedule() const;
+
+    // 为当前线程正在执行的任务推进 theUnits 个进度单位；当前线程不在任务中时返回 false
+    static bool                 AdvanceCurrentTask(int theUnits);
+    // 当前任务最多借用 theWanted 个额外线程，返回实际可开启的线程数；不在任务中时不加限制。用完后须归还
+    static int                  ReserveSpareThreads(int theWanted);
+    static void                 ReleaseSpareThreads(int theCount);
+};
+
+#endif
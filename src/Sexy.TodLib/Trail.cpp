@@ -31,6 +31,7 @@ TrailPoint::TrailPoint()
 bool TrailLoadADef(TrailDefinition* theTrailDef, const char* theTrailFileName)
 {
 	TodHesitationBracket aHesitation("Load Trail '%s'", theTrailFileName);
+	DefinitionArenaScope aArenaScope(&gTrailDefMap, theTrailDef);  // 默认轨道节点也从定义的分配区中分配
 
 	if (!DefinitionLoadXML(theTrailFileName, &gTrailDefMap, theTrailDef))
 		return false;
@@ -40,6 +41,7 @@ bool TrailLoadADef(TrailDefinition* theTrailDef, const char* theTrailFileName)
 	FloatTrackSetDefault(theTrailDef->mTrailDuration, 100.0f);
 	FloatTrackSetDefault(theTrailDef->mAlphaOverLength, 1.0f);
 	FloatTrackSetDefault(theTrailDef->mAlphaOverTime, 1.0f);
+	aArenaScope.Commit();
 	return true;
 }
 
@@ -54,17 +56,14 @@ void TrailLoadDefinitions(TrailParams* theTrailParamArray, int theTrailParamArra
 	gTrailDefCount = theTrailParamArraySize;
 	gTrailDefArray = new TrailDefinition[theTrailParamArraySize];
 
-	for (int i = 0; i < gTrailParamArraySize; i++)
+	DefinitionParallelFor("trail", gTrailParamArraySize, [theTrailParamArray](int i)
 	{
 		TrailParams* aTrailParams = &theTrailParamArray[i];
 		TOD_ASSERT(aTrailParams->mTrailType == static_cast<TrailType>(i));
 		if (!TrailLoadADef(&gTrailDefArray[i], aTrailParams->mTrailFileName))
-		{
-			char aBuf[512];
-			snprintf(aBuf, sizeof(aBuf), "Failed to load trail '%s'", aTrailParams->mTrailFileName);
-			TodErrorMessageBox(aBuf, "Error");
-		}
-	}
+			return std::string("Failed to load trail '") + aTrailParams->mTrailFileName + "'";
+		return std::string();
+	});
 }
 
 //0x51BAB0
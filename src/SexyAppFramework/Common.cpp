@@ -66,6 +66,16 @@ void Sexy::SRand(ulong theSeed)
 	gMTRand.SRand(theSeed);
 }
 
+void Sexy::GetRandState(MTRand& theState)
+{
+	theState = gMTRand;
+}
+
+void Sexy::SetRandState(const MTRand& theState)
+{
+	gMTRand = theState;
+}
+
 std::string Sexy::GetAppDataFolder()
 {
 	return PathToU8(Sexy::gAppDataFolder);
@@ -103,10 +103,14 @@ extern bool			gDebug;
 #define printf(...) Sexy::PrintF(__VA_ARGS__)
 void				PrintF(const char *text, ...);
 
+class MTRand;
+
 int					Rand();
 int					Rand(int range);
 float				Rand(float range);
 void				SRand(ulong theSeed);
+void				GetRandState(MTRand& theState);
+void				SetRandState(const MTRand& theState);
 extern std::string	VFormat(const char* fmt, va_list argPtr);
 extern std::string	StrFormat(const char* fmt ...);
 std::string			GetAppDataFolder();
@@ -11,6 +11,7 @@
 #include <math.h>
 #include <vector>
 #include <algorithm>
+#include <climits>
 
 #include <SDL.h>
 
@@ -54,7 +55,7 @@
 using namespace Sexy;
 
 const int DEMO_FILE_ID = 0x42BEEF78;
-const int DEMO_VERSION = 2;
+const int DEMO_VERSION = 4;	// adds the start time and wall clock changes; key codes and mouse positions are 32 bits
 
 SexyAppBase* Sexy::gSexyAppBase = nullptr;
 
@@ -265,9 +266,15 @@ SexyAppBase::SexyAppBase()
 	mDemoCmdNum = 0;
 	mDemoCmdOrder = -1; // Means we haven't processed any demo commands yet
 	mDemoCmdBitPos = 0;
+	mDemoStartTime = 0;
+	mDemoWallTime = 0;
+	mDemoFastPlayback = false;
+	mDemoNoDraw = false;
+	mDemoPlaybackStartTick = 0;
 
 	mWidgetManager = new WidgetManager(this);
 	mResourceManager = new ResourceManager(this);
+	mFileWriter = new AsyncFileWriter();
 
 	mPrimaryThreadId = std::this_thread::get_id();
 
@@ -307,6 +314,8 @@ SexyAppBase::~SexyAppBase()
 	delete mSoundManager;			
 
 	WaitForLoadingThread();	
+	delete mFileWriter;
+	regemu::Sync();
 
 	gSexyAppBase = nullptr;
 
@@ -354,9 +363,16 @@ bool SexyAppBase::ReadDemoBuffer(std::string &theError)
 
 	uint32_t aVersion;
 	if (!aFile.read(reinterpret_cast<char*>(&aVersion), sizeof(aVersion))) return false;
+	if (aVersion < DEMO_VERSION)
+	{
+		theError = "This demo file was recorded by an older version.";
+		return false;
+	}
 	
 	if (!aFile.read(reinterpret_cast<char*>(&mRandSeed), sizeof(mRandSeed))) return false;
 	SRand(mRandSeed);
+	if (!aFile.read(reinterpret_cast<char*>(&mDemoStartTime), sizeof(mDemoStartTime))) return false;
+	mDemoWallTime = mDemoStartTime;
 
 	ushort aStrLen = 4;
 	if (!aFile.read(reinterpret_cast<char*>(&aStrLen), sizeof(aStrLen))) return false;
@@ -446,6 +462,11 @@ void SexyAppBase::WriteDemoBuffer()
 {
 	if (mRecordingDemoBuffer)
 	{
+		// Playback shuts down on the same update
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_CLOSE, 5);
+
 		std::ofstream aFile(PathFromU8(mDemoFileName), std::ios::out | std::ios::binary | std::ios::trunc);
 		if (aFile)
 		{
@@ -456,6 +477,7 @@ void SexyAppBase::WriteDemoBuffer()
 			aFile.write(reinterpret_cast<const char*>(&aVersion), sizeof(aVersion));
 			
 			aFile.write(reinterpret_cast<const char*>(&mRandSeed), sizeof(mRandSeed));
+			aFile.write(reinterpret_cast<const char*>(&mDemoStartTime), sizeof(mDemoStartTime));
 
 			ushort aStrLen = mProductVersion.length();
 			aFile.write(reinterpret_cast<const char*>(&aStrLen), sizeof(aStrLen));		
@@ -570,6 +592,15 @@ void SexyAppBase::DemoAddMarker(const std::string& theString)
 	}
 }
 
+// Seconds since the epoch. While recording, the real clock is sampled once per update and every change
+// goes into the demo; playback returns the recorded values, so timers based on the wall clock replay the same way.
+int64_t SexyAppBase::GetWallTime()
+{
+	if (mRecordingDemoBuffer || mPlayingDemoBuffer)
+		return mDemoWallTime;
+	return static_cast<int64_t>(time(nullptr));
+}
+
 void SexyAppBase::DemoAssertIntEqual(int theInt)
 {
 	if (mPlayingDemoBuffer)
@@ -895,6 +926,8 @@ void SexyAppBase::WriteToRegistry()
 	RegistryWriteInteger("CustomCursors", mCustomCursorsEnabled ? 1 : 0);		
 	RegistryWriteInteger("InProgress", 0);
 	RegistryWriteBoolean("WaitForVSync", mWaitForVSync);	
+
+	regemu::Sync();
 }
 
 bool SexyAppBase::RegistryEraseKey(const std::string& _theKeyName)
@@ -1167,6 +1200,7 @@ bool SexyAppBase::WriteBytesToFile(const std::string& theFileName, const void *t
 		return true;
 	}	
 
+	mFileWriter->WaitForFile(theFileName);
 	MkDir(GetFileDir(theFileName));
 	std::ofstream aFile(PathFromU8(theFileName), std::ios::out | std::ios::binary | std::ios::trunc);
 	if (!aFile)
@@ -1197,6 +1231,21 @@ bool SexyAppBase::WriteBytesToFile(const std::string& theFileName, const void *t
 	return true;
 }
 
+// Queues the write on the file writer thread. Demo recording and playback log every file access
+// in order, so there the write happens immediately instead.
+void SexyAppBase::WriteBytesToFileAsync(const std::string& theFileName, std::vector<uchar> theData, AsyncFileWriter::PrepareFunc thePrepare, AsyncFileWriter::DoneFunc theDone)
+{
+	if (mPlayingDemoBuffer || mRecordingDemoBuffer)
+	{
+		bool aSuccess = (!thePrepare || thePrepare(theData)) && WriteBytesToFile(theFileName, theData.data(), theData.size());
+		if (theDone)
+			theDone(aSuccess);
+		return;
+	}
+
+	mFileWriter->Write(theFileName, std::move(theData), std::move(thePrepare), std::move(theDone));
+}
+
 bool SexyAppBase::WriteBufferToFile(const std::string& theFileName, const Buffer* theBuffer)
 {
 	return WriteBytesToFile(theFileName,theBuffer->GetDataPtr(),theBuffer->GetDataLen());
@@ -1205,6 +1254,8 @@ bool SexyAppBase::WriteBufferToFile(const std::string& theFileName, const Buffer
 
 bool SexyAppBase::ReadBufferFromFile(const std::string& theFileName, Buffer* theBuffer, bool dontWriteToDemo)
 {
+	mFileWriter->WaitForFile(theFileName);
+
 	if ((mPlayingDemoBuffer) && (!dontWriteToDemo))
 	{
 		if (mManualShutdown)
@@ -1275,6 +1326,8 @@ bool SexyAppBase::ReadBufferFromFile(const std::string& theFileName, Buffer* the
 
 bool SexyAppBase::FileExists(const std::string& theFileName)
 {
+	mFileWriter->WaitForFile(theFileName);
+
 	if (mPlayingDemoBuffer)
 	{
 		if (mManualShutdown)
@@ -1314,6 +1367,7 @@ bool SexyAppBase::EraseFile(const std::string& theFileName)
 	if (mPlayingDemoBuffer)
 		return true;
 
+	mFileWriter->WaitForFile(theFileName);
 	return remove(theFileName.c_str()) == 0;
 }
 
@@ -1398,6 +1452,19 @@ void SexyAppBase::DoExit(int theCode)
 
 void SexyAppBase::UpdateFrames()
 {
+	if (mRecordingDemoBuffer)
+	{
+		int64_t aNow = static_cast<int64_t>(time(nullptr));
+		if (aNow != mDemoWallTime)
+		{
+			WriteDemoTimingBlock();
+			mDemoBuffer.WriteNumBits(0, 1);
+			mDemoBuffer.WriteNumBits(DEMO_WALL_TIME, 5);
+			mDemoBuffer.WriteLong(static_cast<int32_t>(aNow - mDemoWallTime));
+			mDemoWallTime = aNow;
+		}
+	}
+
 	mUpdateCount++;	
 
 	if (!mMinimized)
@@ -1407,6 +1474,8 @@ void SexyAppBase::UpdateFrames()
 	}
 
 	mMusicInterface->Update();	
+	mFileWriter->DispatchCompletions();
+	regemu::Update();
 	CleanSharedImages();
 }
 
@@ -1890,8 +1959,8 @@ void SexyAppBase::ProcessDemo()
 					{
 					case DEMO_MOUSE_POSITION:
 						{
-							mLastDemoMouseX = mDemoBuffer.ReadNumBits(12, false);
-							mLastDemoMouseY = mDemoBuffer.ReadNumBits(12, false);
+							mLastDemoMouseX = static_cast<int32_t>(mDemoBuffer.ReadLong());
+							mLastDemoMouseY = static_cast<int32_t>(mDemoBuffer.ReadLong());
 
 							mWidgetManager->MouseMove(mLastDemoMouseX, mLastDemoMouseY);						
 						}
@@ -1938,13 +2007,13 @@ void SexyAppBase::ProcessDemo()
 						break;
 					case DEMO_KEY_DOWN:
 						{
-							KeyCode aKeyCode = static_cast<KeyCode>(mDemoBuffer.ReadNumBits(8, false));
+							KeyCode aKeyCode = static_cast<KeyCode>(mDemoBuffer.ReadLong());
 							mWidgetManager->KeyDown(aKeyCode);
 						}
 						break;
 					case DEMO_KEY_UP:
 						{
-							KeyCode aKeyCode = static_cast<KeyCode>(mDemoBuffer.ReadNumBits(8, false));
+							KeyCode aKeyCode = static_cast<KeyCode>(mDemoBuffer.ReadLong());
 							mWidgetManager->KeyUp(aKeyCode);
 						}
 						break;
@@ -1956,7 +2025,12 @@ void SexyAppBase::ProcessDemo()
 						}
 						break;
 					case DEMO_CLOSE:
-						Shutdown();
+						{
+							double aSeconds = std::max<uint32_t>(SDL_GetTicks() - mDemoPlaybackStartTick, 1) / 1000.0;
+							printf("Demo playback: %d updates in %.2f s, %.0f updates/s (%.1fx real time)\n", mUpdateCount, aSeconds,
+								mUpdateCount / aSeconds, mUpdateCount * mFrameTime / 1000.0 / aSeconds);
+							Shutdown();
+						}
 						break;
 					case DEMO_MOUSE_ENTER:
 						mMouseIn = true;
@@ -1974,6 +2048,9 @@ void SexyAppBase::ProcessDemo()
 						mIsWindowed = mDemoBuffer.ReadBoolean();
 						mSyncRefreshRate = mDemoBuffer.ReadByte();
 						break;
+					case DEMO_WALL_TIME:
+						mDemoWallTime += static_cast<int32_t>(mDemoBuffer.ReadLong());
+						break;
 					case DEMO_IDLE:
 						break;
 					default:
@@ -1986,6 +2063,163 @@ void SexyAppBase::ProcessDemo()
 	}
 }
 
+void SexyAppBase::WriteDemoMousePosition(int theX, int theY)
+{
+	if (theX == mLastDemoMouseX && theY == mLastDemoMouseY)
+		return;
+
+	WriteDemoTimingBlock();
+	int aDeltaX = theX - mLastDemoMouseX;
+	int aDeltaY = theY - mLastDemoMouseY;
+	if (aDeltaX >= -32 && aDeltaX < 32 && aDeltaY >= -32 && aDeltaY < 32)
+	{
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(aDeltaX, 6);
+		mDemoBuffer.WriteNumBits(aDeltaY, 6);
+	}
+	else
+	{
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_MOUSE_POSITION, 5);
+		mDemoBuffer.WriteLong(theX);
+		mDemoBuffer.WriteLong(theY);
+	}
+	mLastDemoMouseX = theX;
+	mLastDemoMouseY = theY;
+}
+
+void SexyAppBase::InputMouseMove(int theX, int theY)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	mLastUserInputTick = mLastTimerTime;
+	if (mRecordingDemoBuffer)
+		WriteDemoMousePosition(theX, theY);
+	mWidgetManager->MouseMove(theX, theY);
+}
+
+void SexyAppBase::InputMouseDown(int theX, int theY, int theClickCount)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	InputMouseMove(theX, theY);
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(theClickCount, 3);
+	}
+	mWidgetManager->MouseDown(theX, theY, theClickCount);
+}
+
+void SexyAppBase::InputMouseUp(int theX, int theY, int theClickCount)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	InputMouseMove(theX, theY);
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(1, 1);
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(theClickCount, 3);
+	}
+	mWidgetManager->MouseUp(theX, theY, theClickCount);
+}
+
+void SexyAppBase::InputMouseWheel(int theDelta)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	mLastUserInputTick = mLastTimerTime;
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_MOUSE_WHEEL, 5);
+		mDemoBuffer.WriteNumBits(std::clamp(theDelta, -128, 127), 8);
+	}
+	mWidgetManager->MouseWheel(theDelta);
+}
+
+void SexyAppBase::InputKeyDown(KeyCode theKey)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	// Debug keys act on the app itself, so they are neither recorded nor passed to the widgets
+	if (mDebugKeysEnabled && DebugKeyDown(theKey))
+		return;
+
+	mLastUserInputTick = mLastTimerTime;
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_KEY_DOWN, 5);
+		mDemoBuffer.WriteLong(static_cast<int32_t>(theKey));
+	}
+	mWidgetManager->KeyDown(theKey);
+}
+
+void SexyAppBase::InputKeyUp(KeyCode theKey)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	mLastUserInputTick = mLastTimerTime;
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_KEY_UP, 5);
+		mDemoBuffer.WriteLong(static_cast<int32_t>(theKey));
+	}
+	mWidgetManager->KeyUp(theKey);
+}
+
+void SexyAppBase::InputKeyChar(char theChar)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	mLastUserInputTick = mLastTimerTime;
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_KEY_CHAR, 5);
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(static_cast<unsigned char>(theChar), 8);
+	}
+	mWidgetManager->KeyChar(theChar);
+}
+
+// Losing focus pauses the game, so playback only follows the recorded focus changes
+void SexyAppBase::InputActivate(bool theActive)
+{
+	if (mPlayingDemoBuffer)
+		return;
+
+	if (mRecordingDemoBuffer)
+	{
+		WriteDemoTimingBlock();
+		mDemoBuffer.WriteNumBits(0, 1);
+		mDemoBuffer.WriteNumBits(DEMO_ACTIVATE_APP, 5);
+		mDemoBuffer.WriteNumBits(theActive ? 1 : 0, 1);
+	}
+	mActive = theActive;
+	RehupFocus();
+}
+
 void SexyAppBase::ShowMemoryUsage()
 {
 	// Memory usage display not implemented
@@ -2297,7 +2531,8 @@ bool SexyAppBase::Process(bool allowSleep)
 				{
 					mFastForwardStep = false;
 					aTick = SDL_GetTicks();
-					DrawDirtyStuff();			
+					if (!mDemoNoDraw)
+						DrawDirtyStuff();			
 					return true;
 				}
 			}
@@ -2931,6 +3166,19 @@ void SexyAppBase::HandleCmdLineParam(const std::string& theParamName, const std:
 		mRecordingDemoBuffer = false;
 		mPlayingDemoBuffer = true;
 	}
+	else if (theParamName == "-playfast")
+	{
+		mPlayingDemoBuffer = true;
+		mRecordingDemoBuffer = false;
+		mDemoFastPlayback = true;
+	}
+	else if (theParamName == "-playnodraw")
+	{
+		mPlayingDemoBuffer = true;
+		mRecordingDemoBuffer = false;
+		mDemoFastPlayback = true;
+		mDemoNoDraw = true;
+	}
 	else if (theParamName == "-record")
 	{
 		mRecordingDemoBuffer = true;
@@ -3049,6 +3297,8 @@ void SexyAppBase::Init()
 
 	mRandSeed = SDL_GetTicks();
 	SRand(mRandSeed);
+	mDemoStartTime = static_cast<int64_t>(time(nullptr));
+	mDemoWallTime = mDemoStartTime;
 
 	// Set up demo recording stuff
 	if (mPlayingDemoBuffer)
@@ -3060,9 +3310,13 @@ void SexyAppBase::Init()
 			Popup(anError);
 			DoExit(0);
 		}
+		mDemoPlaybackStartTick = SDL_GetTicks();
+		if (mDemoFastPlayback)
+			mFastForwardToUpdateNum = INT_MAX;
 	}
 
-	srand(SDL_GetTicks());
+	// The C generator feeds particle jitter; a demo seeds it like the rest
+	srand(mPlayingDemoBuffer || mRecordingDemoBuffer ? mRandSeed : SDL_GetTicks());
 
 	mIsWideWindow = sizeof(char) > 1;
 		
@@ -7,6 +7,8 @@
 #include "widget/ButtonListener.h"
 #include "widget/DialogListener.h"
 #include "misc/Buffer.h"
+#include "misc/AsyncFileWriter.h"
+#include "misc/KeyCodes.h"
 #include <mutex>
 #include <thread>
 #include <set>
@@ -110,6 +112,7 @@ enum
 	DEMO_MOUSE_WHEEL,
 	DEMO_HANDLE_COMPLETE,
 	DEMO_VIDEO_DATA,
+	DEMO_WALL_TIME,
 	DEMO_IDLE = 31
 };
 
@@ -293,6 +296,11 @@ public:
 	int						mDemoCmdOrder;
 	int						mDemoCmdBitPos;
 	bool					mDemoLoadingComplete;
+	int64_t					mDemoStartTime;				// wall clock time when Init() started the recording; read back from the demo when playing
+	int64_t					mDemoWallTime;				// wall clock time seen by the game; sampled once per update while recording and replayed from the demo
+	bool					mDemoFastPlayback;			// play back as fast as possible, without sleeping or waiting for vsync
+	bool					mDemoNoDraw;				// fast playback draws nothing at all (-playnodraw implies -playfast)
+	uint32_t				mDemoPlaybackStartTick;
 
 	typedef std::pair<std::string, int> DemoMarker;
 	typedef std::list<DemoMarker> DemoMarkerList;
@@ -329,6 +337,7 @@ public:
 	StringDoubleMap			mDoubleProperties;
 	StringStringVectorMap	mStringVectorProperties;
 	ResourceManager*		mResourceManager;
+	AsyncFileWriter*		mFileWriter;
 
 #ifdef ZYLOM
 	uint					mZylomGameId;
@@ -372,6 +381,17 @@ protected:
 
 	// Demo recording helpers	
 	void					ProcessDemo();
+	void					WriteDemoMousePosition(int theX, int theY);
+
+	// Input from the platform layer; recorded into a demo, ignored while one plays back
+	void					InputMouseMove(int theX, int theY);
+	void					InputMouseDown(int theX, int theY, int theClickCount);
+	void					InputMouseUp(int theX, int theY, int theClickCount);
+	void					InputMouseWheel(int theDelta);
+	void					InputKeyDown(KeyCode theKey);
+	void					InputKeyUp(KeyCode theKey);
+	void					InputKeyChar(char theChar);
+	void					InputActivate(bool theActive);
 
 public:
 	SexyAppBase();
@@ -542,6 +562,7 @@ public:
 	void					DemoAssertStringEqual(const std::string& theString);
 	void					DemoAssertIntEqual(int theInt);
 	void					DemoAddMarker(const std::string& theString);
+	int64_t					GetWallTime();
 
 	
 
@@ -562,6 +583,7 @@ public:
 	bool					WriteBufferToFile(const std::string& theFileName, const Buffer* theBuffer);
 	bool					ReadBufferFromFile(const std::string& theFileName, Buffer* theBuffer, bool dontWriteToDemo = false);//UNICODE
 	bool					WriteBytesToFile(const std::string& theFileName, const void *theData, unsigned long theDataLen);
+	void					WriteBytesToFileAsync(const std::string& theFileName, std::vector<uchar> theData, AsyncFileWriter::PrepareFunc thePrepare = nullptr, AsyncFileWriter::DoneFunc theDone = nullptr);
 	bool					FileExists(const std::string& theFileName);
 	bool					EraseFile(const std::string& theFileName);
 
@@ -9,13 +9,18 @@
 #include "graphics/GLImage.h"
 #include "graphics/Graphics.h"
 #include "graphics/MemoryImage.h"
+#include "imagelib/PixelKernels.h"
+#include "misc/LZ4Block.h"
 #include "SexyAppBase.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
 #include <vector>
 
 #define MAX_VERTICES 16384
+#define MAX_INDICES (MAX_VERTICES / 2 * 3)
 
 #ifndef GL_FRAMEBUFFER_SRGB
 #define GL_FRAMEBUFFER_SRGB 0x8DB9 // Not in GLES 2.0 headers, but needed to disable sRGB on Windows.
@@ -59,117 +64,269 @@ static bool gLinearFilter = false;
 
 static GLVertex* gVertices;
 static int gNumVertices;
-static GLenum gVertexMode;
+static GLushort* gIndices;
+static int gNumIndices;
 static GLuint gProgram;
 static GLuint gVbo;
-static GLint gUfViewProjMtx, gUfTexture, gUfUseTexture, gUfUvBounds;
+static GLuint gIbo;
+static GLint gUfViewProjMtx, gUfTexture, gUfUseTexture, gUfColorFilter, gUfLumSat;
 
-static void GfxBegin(GLenum vertexMode)
+// State of the pending batch; changing any of it flushes the vertices queued so far.
+static GLuint gTexture;
+static int gDrawMode;
+static int gColorFilter;
+static float gLumSat[2];
+
+// State last sent to GL, so redundant uniform and blend changes are skipped at flush time.
+static int gAppliedUseTexture;
+static int gAppliedDrawMode;
+static int gAppliedColorFilter;
+static float gAppliedLumSat[2];
+
+static RenderStats gRenderStats;
+static int64_t gResidentTextureBytes;	// sum of mTexMemSize over all TextureData
+
+static constexpr float kDefaultUvBounds[4] = { 0.f, 0.f, 1.f, 1.f };
+
+static inline GLVertex MakeVertex(float x, float y, uint32_t color, float u, float v, const float *uvBounds = kDefaultUvBounds)
 {
-	if (gVertexMode != (GLenum)-1) return;
-	gVertexMode = vertexMode;
+	return { x, y, color, u, v, { uvBounds[0], uvBounds[1], uvBounds[2], uvBounds[3] } };
 }
 
-static void GfxEnd()
+static void GfxApplyState()
 {
-	if (gVertexMode == (GLenum)-1) return;
+	int useTexture = gTexture != 0;
+	if (useTexture)
+	{
+		glBindTexture(GL_TEXTURE_2D, gTexture);
+		gRenderStats.mTextureBinds++;
+		int f = gLinearFilter ? GL_LINEAR : GL_NEAREST;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, f);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, f);
+	}
+	if (useTexture != gAppliedUseTexture)
+	{
+		gAppliedUseTexture = useTexture;
+		glUniform1i(gUfUseTexture, useTexture);
+	}
+	if (gDrawMode != gAppliedDrawMode)
+	{
+		gAppliedDrawMode = gDrawMode;
+		gRenderStats.mBlendChanges++;
+		// Destination alpha only matters for render targets, where it has to stay opaque under opaque layers
+		if (gDrawMode == Graphics::DRAWMODE_NORMAL)
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		else
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE);
+	}
+	if (gColorFilter != gAppliedColorFilter)
+	{
+		gAppliedColorFilter = gColorFilter;
+		glUniform1i(gUfColorFilter, gColorFilter);
+	}
+	if (gColorFilter == ColorFilter_LumSat && (gLumSat[0] != gAppliedLumSat[0] || gLumSat[1] != gAppliedLumSat[1]))
+	{
+		gAppliedLumSat[0] = gLumSat[0];
+		gAppliedLumSat[1] = gLumSat[1];
+		glUniform2fv(gUfLumSat, 1, gAppliedLumSat);
+	}
+}
+
+// Every primitive is queued with its own indices (6 per quad, 3 per triangle) and drawn as indexed
+// GL_TRIANGLES, so consecutive primitives sharing state go out in one call.
+static void GfxFlush()
+{
+	if (gNumIndices == 0)
+	{
+		gNumVertices = 0;
+		return;
+	}
 
+	GfxApplyState();
 	glBindBuffer(GL_ARRAY_BUFFER, gVbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLVertex) * gNumVertices, gVertices, GL_DYNAMIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT,         GL_FALSE, sizeof(GLVertex), (const void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE,  GL_TRUE,  sizeof(GLVertex), (const void*)(sizeof(float)*3));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT,         GL_FALSE, sizeof(GLVertex), (const void*)(sizeof(float)*3 + sizeof(uint32_t)));
-	glEnableVertexAttribArray(2);
-
-	glDrawArrays(gVertexMode, 0, gNumVertices);
-
-	gVertexMode = (GLenum)-1;
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * gNumIndices, gIndices, GL_DYNAMIC_DRAW);
+	glDrawElements(GL_TRIANGLES, gNumIndices, GL_UNSIGNED_SHORT, nullptr);
+	gRenderStats.mDrawCalls++;
+	gRenderStats.mVertices += gNumVertices;
 	gNumVertices = 0;
+	gNumIndices = 0;
 }
 
-static void GfxAddVertices(const GLVertex *arr, int arrCount)
+static void GfxSetTexture(GLuint theTexture)
 {
-	if (gVertexMode == (GLenum)-1) return;
+	if (theTexture != gTexture)
+	{
+		GfxFlush();
+		gTexture = theTexture;
+	}
+}
 
-	if (gNumVertices + arrCount >= MAX_VERTICES)
+static void GfxSetDrawMode(int theDrawMode)
+{
+	if (theDrawMode != gDrawMode)
 	{
-		GLenum oldMode = gVertexMode;
-		GfxEnd();
-		GfxBegin(oldMode);
+		GfxFlush();
+		gDrawMode = theDrawMode;
 	}
+}
+
+// Reserves room for theNumVertices vertices and theNumIndices indices; *theBase receives the batch index
+// of the first reserved vertex.
+static inline GLVertex* GfxReserve(int theNumVertices, int theNumIndices, GLushort* theBase)
+{
+	if (gNumVertices + theNumVertices > MAX_VERTICES || gNumIndices + theNumIndices > MAX_INDICES)
+		GfxFlush();
 
-	memcpy(gVertices + gNumVertices, arr, sizeof(GLVertex) * arrCount);
-	gNumVertices += arrCount;
+	*theBase = (GLushort)gNumVertices;
+	GLVertex* aVerts = gVertices + gNumVertices;
+	gNumVertices += theNumVertices;
+	return aVerts;
 }
 
-static void GfxAddVertices(VertexList &arr)
+static inline void GfxAddIndices(GLushort a, GLushort b, GLushort c)
 {
-	if (gVertexMode == (GLenum)-1) return;
+	GLushort* i = gIndices + gNumIndices;
+	i[0] = a;
+	i[1] = b;
+	i[2] = c;
+	gNumIndices += 3;
+}
 
-	if (gNumVertices + arr.size() >= MAX_VERTICES)
-	{
-		GLenum oldMode = gVertexMode;
-		GfxEnd();
-		GfxBegin(oldMode);
-	}
+// Vertices in strip order: top-left, bottom-left, top-right, bottom-right.
+static void GfxAddQuad(const GLVertex *v)
+{
+	GLushort aBase;
+	memcpy(GfxReserve(4, 6, &aBase), v, sizeof(GLVertex) * 4);
+	GfxAddIndices(aBase + 0, aBase + 1, aBase + 2);
+	GfxAddIndices(aBase + 2, aBase + 1, aBase + 3);
+}
 
-	memcpy(gVertices + gNumVertices, arr.mVerts, sizeof(GLVertex) * arr.size());
-	gNumVertices += arr.size();
+static void GfxAddTriangle(const GLVertex &a, const GLVertex &b, const GLVertex &c)
+{
+	GLushort aBase;
+	GLVertex* v = GfxReserve(3, 3, &aBase);
+	v[0] = a;
+	v[1] = b;
+	v[2] = c;
+	GfxAddIndices(aBase + 0, aBase + 1, aBase + 2);
 }
 
-static void GfxAddVertices(const TriVertex arr[][3], int arrCount, unsigned int theColor,
-                           float tx, float ty, float aMaxTotalU, float aMaxTotalV)
+// The fan's vertices are queued once and shared by its triangles.
+static void GfxAddFan(VertexList &arr)
 {
-	if (gVertexMode == (GLenum)-1) return;
+	int aCount = arr.size();
+	if (aCount < 3)
+		return;
 
-	if (gNumVertices + arrCount * 3 >= MAX_VERTICES)
-	{
-		GLenum oldMode = gVertexMode;
-		GfxEnd();
-		GfxBegin(oldMode);
-	}
+	GLushort aBase;
+	GLVertex* v = GfxReserve(aCount, (aCount - 2) * 3, &aBase);
+	for (int i = 0; i < aCount; i++)
+		v[i] = arr[i];
+	for (int i = 1; i < aCount - 1; i++)
+		GfxAddIndices(aBase, aBase + i, aBase + i + 1);
+}
 
+static void GfxAddTriangles(const TriVertex arr[][3], int arrCount, unsigned int theColor,
+                            float tx, float ty, float aMaxTotalU, float aMaxTotalV, const float *uvBounds)
+{
 	for (int tri = 0; tri < arrCount; tri++)
 	{
-		TriVertex* v = (TriVertex*)arr[tri];
+		const TriVertex* v = arr[tri];
+		GLushort aBase;
+		GLVertex* out = GfxReserve(3, 3, &aBase);
 		for (int i = 0; i < 3; i++)
-		{
-			gVertices[gNumVertices + i].sx    = v[i].x + tx;
-			gVertices[gNumVertices + i].sy    = v[i].y + ty;
-			gVertices[gNumVertices + i].color = GetColorFromTriVertex(v[i], theColor);
-			gVertices[gNumVertices + i].tu    = v[i].u * aMaxTotalU;
-			gVertices[gNumVertices + i].tv    = v[i].v * aMaxTotalV;
-		}
-		gNumVertices += 3;
+			out[i] = MakeVertex(v[i].x + tx, v[i].y + ty, GetColorFromTriVertex(v[i], theColor), v[i].u * aMaxTotalU, v[i].v * aMaxTotalV, uvBounds);
+		GfxAddIndices(aBase + 0, aBase + 1, aBase + 2);
 	}
 }
 
+// Lines cannot join the triangle batch; they are drawn immediately after flushing it.
+static void GfxDrawLineStrip(const GLVertex *v, int theNumVertices)
+{
+	GfxFlush();
+	GfxApplyState();
+	glBindBuffer(GL_ARRAY_BUFFER, gVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLVertex) * theNumVertices, v, GL_DYNAMIC_DRAW);
+	glDrawArrays(GL_LINE_STRIP, 0, theNumVertices);
+	gRenderStats.mDrawCalls++;
+	gRenderStats.mVertices += theNumVertices;
+}
+
 // Unified GLSL body; VERT_IN / V2F / FRAG_OUT / TEX2D macros from GLPlatform.h.
 static constexpr const char *SHADER_CODE = R"DELIMITER(
 V2F vec4 v_color;
 V2F vec2 v_uv;
+V2F vec4 v_uvBounds;
 
 #ifdef VERTEX
 	uniform mat4 u_viewProj;
-	VERT_IN vec3 a_position;
+	VERT_IN vec2 a_position;
 	VERT_IN vec4 a_color;
 	VERT_IN vec2 a_uv;
+	VERT_IN vec4 a_uvBounds;
 	void main() {
 		v_color = a_color;
 		v_uv = a_uv;
-		gl_Position = u_viewProj * vec4(a_position, 1.0);
+		v_uvBounds = a_uvBounds;
+		gl_Position = u_viewProj * vec4(a_position, 0.0, 1.0);
 	}
 #endif
 #ifdef FRAGMENT
 	uniform sampler2D u_texture;
 	uniform int u_useTexture;
-	uniform vec4 u_uvBounds;
+	uniform int u_colorFilter;
+	uniform vec2 u_lumSat;
+
+	// Same HSL round trip as the software FilterEffectDoLumSat kernel; hue is kept in sextant units.
+	vec3 LumSat(vec3 c) {
+		float maxv = max(max(c.r, c.g), c.b);
+		float minv = min(min(c.r, c.g), c.b);
+		float d = maxv - minv;
+		float l = (maxv + minv) * 0.5;
+		float s = 0.0;
+		float h = 0.0;
+		if (d > 0.0) {
+			s = d / ((l <= 0.5) ? (maxv + minv) : (2.0 - maxv - minv));
+			vec3 c2 = (vec3(maxv) - c) / d;
+			if (maxv == c.r)
+				h = (c.g == minv) ? (5.0 + c2.b) : (1.0 - c2.g);
+			else if (maxv == c.g)
+				h = (c.b == minv) ? (1.0 + c2.r) : (3.0 - c2.b);
+			else
+				h = (c.r == minv) ? (3.0 + c2.g) : (5.0 - c2.r);
+		}
+		s *= u_lumSat.y;
+		l *= u_lumSat.x;
+
+		float v = (l <= 0.5) ? (l * (1.0 + s)) : (l + s - l * s);
+		if (v <= 0.0)
+			return vec3(0.0);
+		float y = 2.0 * l - v;
+		float sextant = clamp(floor(h), 0.0, 5.0);
+		float vsf = (v - y) * (h - sextant);
+		float x = y + vsf;
+		float z = v - vsf;
+		vec3 r;
+		if (sextant < 0.5)		r = vec3(v, x, y);
+		else if (sextant < 1.5)	r = vec3(z, v, y);
+		else if (sextant < 2.5)	r = vec3(y, v, x);
+		else if (sextant < 3.5)	r = vec3(y, z, v);
+		else if (sextant < 4.5)	r = vec3(x, y, v);
+		else					r = vec3(v, y, z);
+		return clamp(r, 0.0, 1.0);
+	}
+
 	void main() {
-		if (u_useTexture == 1)
-			FRAG_OUT = TEX2D(u_texture, clamp(v_uv, u_uvBounds.xy, u_uvBounds.zw)) * v_color;
+		if (u_useTexture == 1) {
+			vec4 texel = TEX2D(u_texture, clamp(v_uv, v_uvBounds.xy, v_uvBounds.zw));
+			if (u_colorFilter == 1)
+				texel.rgb = LumSat(texel.rgb);
+			else if (u_colorFilter == 2)
+				texel.rgb = vec3(1.0);
+			FRAG_OUT = texel * v_color;
+		}
 		else
 			FRAG_OUT = v_color;
 	}
@@ -218,8 +375,8 @@ static GLuint shaderLoad(const char *src)
 	glAttachShader(prog, vert);
 	glAttachShader(prog, frag);
 
-	const char *attribs[] = { "a_position", "a_color", "a_uv" };
-	for (int i = 0; i < 3; i++)
+	const char *attribs[] = { "a_position", "a_color", "a_uv", "a_uvBounds" };
+	for (int i = 0; i < 4; i++)
 		glBindAttribLocation(prog, i, attribs[i]);
 
 	glLinkProgram(prog);
@@ -237,6 +394,16 @@ static void MakeOrthoMatrix(float l, float r, float b, float t, float n, float f
 	m[12] = -(r+l)/(r-l);    m[13] = -(t+b)/(t-b);     m[14] = -(f+n)/(f-n);      m[15] = 1;
 }
 
+static void SetViewProjection(float theWidth, float theHeight, bool theFlipY)
+{
+	float ortho[16];
+	if (theFlipY)
+		MakeOrthoMatrix(0, theWidth, 0, theHeight, -10, 10, ortho);
+	else
+		MakeOrthoMatrix(0, theWidth, theHeight, 0, -10, 10, ortho);
+	glUniformMatrix4fv(gUfViewProjMtx, 1, GL_FALSE, ortho);
+}
+
 static void CopyImageToTexture8888(MemoryImage *img, int offx, int offy,
 	int w, int h, int pitch, int dstH, bool padR, bool padB, bool create)
 {
@@ -246,12 +413,11 @@ static void CopyImageToTexture8888(MemoryImage *img, int offx, int offy,
 	{
 		uint32_t *srcRow = (uint32_t*)img->GetBits() + offy * img->GetWidth() + offx;
 		uint32_t *dstRow = dst;
+		const ImageLib::PixelKernels &kernels = ImageLib::GetPixelKernels();
 		for (int y = 0; y < h; y++)
 		{
-			uint32_t *s = srcRow, *d = dstRow;
-			for (int x = 0; x < w; x++)
-				*d++ = ArgbToRgba(*s++);
-			if (padR) *d = *(d - 1);
+			kernels.mArgbToRgba(dstRow, srcRow, w);
+			if (padR) dstRow[w] = dstRow[w - 1];
 			srcRow += img->GetWidth();
 			dstRow += pitch;
 		}
@@ -300,12 +466,11 @@ static void CopyImageToTexture4444(MemoryImage *img, int offx, int offy,
 	{
 		uint32_t *srcRow = (uint32_t*)img->GetBits() + offy * img->GetWidth() + offx;
 		uint16_t *dstRow = dst;
+		const ImageLib::PixelKernels &kernels = ImageLib::GetPixelKernels();
 		for (int y = 0; y < h; y++)
 		{
-			uint32_t *s = srcRow; uint16_t *d = dstRow;
-			for (int x = 0; x < w; x++)
-				*d++ = argbTo4444(*s++);
-			if (padR) *d = *(d - 1);
+			kernels.mArgbTo4444(dstRow, srcRow, w);
+			if (padR) dstRow[w] = dstRow[w - 1];
 			srcRow += img->GetWidth();
 			dstRow += pitch;
 		}
@@ -353,12 +518,11 @@ static void CopyImageToTexture565(MemoryImage *img, int offx, int offy,
 	{
 		uint32_t *srcRow = (uint32_t*)img->GetBits() + offy * img->GetWidth() + offx;
 		uint16_t *dstRow = dst;
+		const ImageLib::PixelKernels &kernels = ImageLib::GetPixelKernels();
 		for (int y = 0; y < h; y++)
 		{
-			uint32_t *s = srcRow; uint16_t *d = dstRow;
-			for (int x = 0; x < w; x++)
-				*d++ = argbTo565(*s++);
-			if (padR) *d = *(d - 1);
+			kernels.mArgbTo565(dstRow, srcRow, w);
+			if (padR) dstRow[w] = dstRow[w - 1];
 			srcRow += img->GetWidth();
 			dstRow += pitch;
 		}
@@ -507,7 +671,7 @@ static void GetBestTextureDimensions(int &w, int &h, bool isEdge, bool usePow2,
 TextureData::TextureData()
 	: mWidth(0), mHeight(0), mTexVecWidth(0), mTexVecHeight(0),
 	  mBitsChangedCount(0), mTexMemSize(0), mTexPieceWidth(64), mTexPieceHeight(64),
-	  mPixelFormat(PixelFormat_Unknown), mImageFlags(0)
+	  mPixelFormat(PixelFormat_Unknown), mImageFlags(0), mFramebuffer(0), mLastUseFrame(0), mEvicted(false)
 {
 }
 
@@ -518,9 +682,17 @@ TextureData::~TextureData()
 
 void TextureData::ReleaseTextures()
 {
+	if (!mTextures.empty())
+		GfxFlush();
+	if (mFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &mFramebuffer);
+		mFramebuffer = 0;
+	}
 	for (auto &piece : mTextures)
 		glDeleteTextures(1, &piece.mTexture);
 	mTextures.clear();
+	gResidentTextureBytes -= mTexMemSize;
 	mTexMemSize = 0;
 }
 
@@ -569,6 +741,8 @@ void TextureData::CreateTextureDimensions(MemoryImage *theImage)
 
 void TextureData::CreateTextures(MemoryImage *theImage)
 {
+	// Queued vertices may still sample the old contents of these textures
+	GfxFlush();
 	theImage->DeleteSWBuffers();
 
 	PixelFormat aFormat = PixelFormat_A8R8G8B8;
@@ -613,9 +787,13 @@ void TextureData::CreateTextures(MemoryImage *theImage)
 			{
 				glGenTextures(1, &piece.mTexture);
 				mTexMemSize += piece.mWidth * piece.mHeight * fmtSize;
+				gResidentTextureBytes += piece.mWidth * piece.mHeight * fmtSize;
 			}
 			glBindTexture(GL_TEXTURE_2D, piece.mTexture);
+			gRenderStats.mTextureBinds++;
 			CopyImageToTexture(theImage, x, y, piece.mWidth, piece.mHeight, aFormat, createTextures);
+			gRenderStats.mTextureUploads++;
+			gRenderStats.mTextureUploadBytes += piece.mWidth * piece.mHeight * fmtSize;
 		}
 	}
 
@@ -623,10 +801,15 @@ void TextureData::CreateTextures(MemoryImage *theImage)
 	mHeight = theImage->mHeight;
 	mBitsChangedCount = theImage->mBitsChangedCount;
 	mPixelFormat = aFormat;
+	mEvicted = false;
+	std::vector<uchar>().swap(mEvictedBits);
 }
 
 void TextureData::CheckCreateTextures(MemoryImage *theImage)
 {
+	if (mFramebuffer != 0)
+		return;
+
 	if (mPixelFormat == PixelFormat_Unknown
 	    || theImage->mWidth != mWidth || theImage->mHeight != mHeight
 	    || theImage->mBitsChangedCount != mBitsChangedCount
@@ -684,18 +867,47 @@ GLuint& TextureData::GetTextureF(float x, float y, float &width, float &height,
 
 static void SetLinearFilter(bool linear)
 {
-	gLinearFilter = linear;
+	if (linear != gLinearFilter)
+	{
+		GfxFlush();
+		gLinearFilter = linear;
+	}
 }
 
-static constexpr float kDefaultUvBounds[4] = { 0.f, 0.f, 1.f, 1.f };
+static void SetColorFilter(int theFilter, const float* theParams)
+{
+	if (theFilter != gColorFilter || (theFilter == ColorFilter_LumSat && (theParams[0] != gLumSat[0] || theParams[1] != gLumSat[1])))
+	{
+		GfxFlush();
+		gColorFilter = theFilter;
+		if (theFilter == ColorFilter_LumSat)
+		{
+			gLumSat[0] = theParams[0];
+			gLumSat[1] = theParams[1];
+		}
+	}
+}
 
-static void GfxBindTexture(GLuint tex, const float *uvBounds = kDefaultUvBounds)
+// Filter proxies own no texture; draw their source's edge-fixed copy instead with the filter applied in the
+// fragment shader. An inner filter is already baked into that copy, so only the outermost one is applied here.
+static MemoryImage* ResolveColorFilter(Image* theImage)
 {
-	glBindTexture(GL_TEXTURE_2D, tex);
-	int f = gLinearFilter ? GL_LINEAR : GL_NEAREST;
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, f);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, f);
-	glUniform4fv(gUfUvBounds, 1, uvBounds);
+	MemoryImage* mem = (MemoryImage*)theImage;
+	if (mem->mColorFilterSource == nullptr)
+	{
+		SetColorFilter(ColorFilter_None, nullptr);
+		return mem;
+	}
+
+	SetColorFilter(mem->mColorFilter, mem->mColorFilterParams);
+	MemoryImage* aSource = mem->mColorFilterSource;
+	if (aSource->mColorFilterTexture != nullptr)
+		return aSource->mColorFilterTexture;
+
+	// No copy yet: never sample another proxy, which owns no pixels
+	while (aSource->mColorFilterSource != nullptr)
+		aSource = aSource->mColorFilterSource;
+	return aSource;
 }
 
 void TextureData::Blt(float theX, float theY, const Rect& theSrcRect, const Color& theColor)
@@ -707,8 +919,6 @@ void TextureData::Blt(float theX, float theY, const Rect& theSrcRect, const Colo
 	if (srcLeft >= srcRight || srcTop >= srcBottom) return;
 
 	uint32_t aColor = theColor.ToGLColor();
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(gUfUseTexture, 1);
 
 	int srcX, srcY;
 	float dstX, dstY;
@@ -727,15 +937,13 @@ void TextureData::Blt(float theX, float theY, const Rect& theSrcRect, const Colo
 			float x = dstX, y = dstY;
 
 			GLVertex v[4] = {
-				{ x,     y,     0, aColor, u1, v1 },
-				{ x,     y + h, 0, aColor, u1, v2 },
-				{ x + w, y,     0, aColor, u2, v1 },
-				{ x + w, y + h, 0, aColor, u2, v2 },
+				MakeVertex(x,     y,     aColor, u1, v1, uvb),
+				MakeVertex(x,     y + h, aColor, u1, v2, uvb),
+				MakeVertex(x + w, y,     aColor, u2, v1, uvb),
+				MakeVertex(x + w, y + h, aColor, u2, v2, uvb),
 			};
-			GfxBindTexture(tex, uvb);
-			GfxBegin(GL_TRIANGLE_STRIP);
-			GfxAddVertices(v, 4);
-			GfxEnd();
+			GfxSetTexture(tex);
+			GfxAddQuad(v);
 
 			srcX += w; dstX += w;
 		}
@@ -747,7 +955,7 @@ static inline float GetCoord(const GLVertex& v, int n)
 {
 	switch (n)
 	{
-	case 0: return v.sx; case 1: return v.sy; case 2: return v.sz;
+	case 0: return v.sx; case 1: return v.sy;
 	case 3: return v.tu; case 4: return v.tv; default: return 0;
 	}
 }
@@ -819,11 +1027,7 @@ static void DrawPolyClipped(const Rect *clip, const VertexList &list)
 	gc.ClipPoints(1, bottom, *in, *out);
 
 	if (out->size() >= 3)
-	{
-		GfxBegin(GL_TRIANGLE_FAN);
-		GfxAddVertices(*out);
-		GfxEnd();
-	}
+		GfxAddFan(*out);
 }
 
 static void DoPolyTextureClip(VertexList &list)
@@ -856,8 +1060,6 @@ void TextureData::BltTransformed(const SexyMatrix3 &theTrans, const Rect& theSrc
 	}
 
 	uint32_t aColor = theColor.ToGLColor();
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(gUfUseTexture, 1);
 
 	int srcX, srcY;
 	float dstX, dstY;
@@ -895,19 +1097,15 @@ void TextureData::BltTransformed(const SexyMatrix3 &theTrans, const Rect& theSrc
 			}
 
 			GLVertex vtx[4] = {
-				{ tp[0].x, tp[0].y, 0, aColor, u1, v1 },
-				{ tp[1].x, tp[1].y, 0, aColor, u1, v2 },
-				{ tp[2].x, tp[2].y, 0, aColor, u2, v1 },
-				{ tp[3].x, tp[3].y, 0, aColor, u2, v2 },
+				MakeVertex(tp[0].x, tp[0].y, aColor, u1, v1, uvb),
+				MakeVertex(tp[1].x, tp[1].y, aColor, u1, v2, uvb),
+				MakeVertex(tp[2].x, tp[2].y, aColor, u2, v1, uvb),
+				MakeVertex(tp[3].x, tp[3].y, aColor, u2, v2, uvb),
 			};
-			GfxBindTexture(tex, uvb);
+			GfxSetTexture(tex);
 
 			if (!clipped)
-			{
-				GfxBegin(GL_TRIANGLE_STRIP);
-				GfxAddVertices(vtx, 4);
-				GfxEnd();
-			}
+				GfxAddQuad(vtx);
 			else
 			{
 				VertexList vl;
@@ -939,13 +1137,8 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
 			std::max(mMaxTotalU - halfU, midU),
 			std::max(mMaxTotalV - halfV, midV)
 		};
-		glActiveTexture(GL_TEXTURE0);
-		GfxBindTexture(piece.mTexture, uvb);
-		glUniform1i(gUfUseTexture, 1);
-
-		GfxBegin(GL_TRIANGLES);
-		GfxAddVertices(theVertices, theNumTriangles, theColor, tx, ty, mMaxTotalU, mMaxTotalV);
-		GfxEnd();
+		GfxSetTexture(piece.mTexture);
+		GfxAddTriangles(theVertices, theNumTriangles, theColor, tx, ty, mMaxTotalU, mMaxTotalV, uvb);
 		return;
 	}
 
@@ -954,9 +1147,9 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
 	{
 		TriVertex* tv = (TriVertex*)theVertices[tri];
 		GLVertex vtx[3] = {
-			{ tv[0].x+tx, tv[0].y+ty, 0, GetColorFromTriVertex(tv[0], theColor), tv[0].u*mMaxTotalU, tv[0].v*mMaxTotalV },
-			{ tv[1].x+tx, tv[1].y+ty, 0, GetColorFromTriVertex(tv[1], theColor), tv[1].u*mMaxTotalU, tv[1].v*mMaxTotalV },
-			{ tv[2].x+tx, tv[2].y+ty, 0, GetColorFromTriVertex(tv[2], theColor), tv[2].u*mMaxTotalU, tv[2].v*mMaxTotalV },
+			MakeVertex(tv[0].x+tx, tv[0].y+ty, GetColorFromTriVertex(tv[0], theColor), tv[0].u*mMaxTotalU, tv[0].v*mMaxTotalV),
+			MakeVertex(tv[1].x+tx, tv[1].y+ty, GetColorFromTriVertex(tv[1], theColor), tv[1].u*mMaxTotalU, tv[1].v*mMaxTotalV),
+			MakeVertex(tv[2].x+tx, tv[2].y+ty, GetColorFromTriVertex(tv[2], theColor), tv[2].u*mMaxTotalU, tv[2].v*mMaxTotalV),
 		};
 
 		float minU = mMaxTotalU, minV = mMaxTotalV, maxU = 0, maxV = 0;
@@ -991,6 +1184,7 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
 				VertexList vl = master;
 				for (int k = 0; k < 3; k++)
 				{
+					memcpy(vl[k].uvBounds, uvb, sizeof(uvb));
 					vl[k].tu -= j;
 					vl[k].tv -= i;
 					if (i == mTexVecHeight - 1)
@@ -1001,10 +1195,8 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
 				DoPolyTextureClip(vl);
 				if (vl.size() >= 3)
 				{
-					GfxBindTexture(piece.mTexture, uvb);
-					GfxBegin(GL_TRIANGLE_FAN);
-					GfxAddVertices(vl);
-					GfxEnd();
+					GfxSetTexture(piece.mTexture);
+					GfxAddFan(vl);
 				}
 			}
 		}
@@ -1022,31 +1214,38 @@ GLInterface::GLInterface(SexyAppBase* theApp)
 	mRefreshRate = 60;
 	mMillisecondsPerFrame = 1000 / mRefreshRate;
 	mScreenImage = nullptr;
+	mRenderTarget = nullptr;
+	memset(&mLastFrameStats, 0, sizeof(mLastFrameStats));
+	mRenderStatsLog = nullptr;
+	mRenderStatsFrame = 0;
+	mTextureBudget = 0;
+	mTextureFrame = 0;
+	mTextureBudgetDirty = false;
 	mNextCursorX = mNextCursorY = 0;
 	mCursorX = mCursorY = 0;
 
-	gVertexMode  = (GLenum)-1;
 	gNumVertices = 0;
 	gVertices = new GLVertex[MAX_VERTICES]();
+	gNumIndices = 0;
+	gIndices = new GLushort[MAX_INDICES];
 }
 
 GLInterface::~GLInterface()
 {
 	Flush();
+	StopRenderStatsLog();
 	for (auto *img : mImageSet)
 	{
 		delete (TextureData*)img->mRenderData;
 		img->mRenderData = nullptr;
 	}
 	delete[] gVertices;
+	delete[] gIndices;
 }
 
 void GLInterface::SetDrawMode(int theDrawMode)
 {
-	if (theDrawMode == Graphics::DRAWMODE_NORMAL)
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	else
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	GfxSetDrawMode(theDrawMode);
 }
 
 void GLInterface::AddGLImage(GLImage* theGLImage)
@@ -1083,10 +1282,12 @@ void GLInterface::UpdateViewport()
 #else
 	int width, height;
 	SDL_GL_GetDrawableSize((SDL_Window*)mApp->mWindow, &width, &height);
+	GfxFlush();
 	glClear(GL_COLOR_BUFFER_BIT);
 	Flush();
 #endif
 
+	GfxFlush();
 	vw = width; vh = height;
 
 	// Letterbox to 4:3
@@ -1119,11 +1320,25 @@ int GLInterface::Init(bool IsWindowed)
 		gUfViewProjMtx = glGetUniformLocation(gProgram, "u_viewProj");
 		gUfTexture     = glGetUniformLocation(gProgram, "u_texture");
 		gUfUseTexture  = glGetUniformLocation(gProgram, "u_useTexture");
-		gUfUvBounds    = glGetUniformLocation(gProgram, "u_uvBounds");
+		gUfColorFilter = glGetUniformLocation(gProgram, "u_colorFilter");
+		gUfLumSat      = glGetUniformLocation(gProgram, "u_lumSat");
 
 		glGenBuffers(1, &gVbo);
 		glBindBuffer(GL_ARRAY_BUFFER, gVbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GLVertex) * MAX_VERTICES, nullptr, GL_DYNAMIC_DRAW);
+
+		glGenBuffers(1, &gIbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIbo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * MAX_INDICES, nullptr, GL_DYNAMIC_DRAW);
+
+		glVertexAttribPointer(0, 2, GL_FLOAT,         GL_FALSE, sizeof(GLVertex), (const void*)offsetof(GLVertex, sx));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(GLVertex), (const void*)offsetof(GLVertex, color));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT,         GL_FALSE, sizeof(GLVertex), (const void*)offsetof(GLVertex, tu));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 4, GL_FLOAT,         GL_FALSE, sizeof(GLVertex), (const void*)offsetof(GLVertex, uvBounds));
+		glEnableVertexAttribArray(3);
 	}
 
 	int aMaxSize;
@@ -1142,10 +1357,18 @@ int GLInterface::Init(bool IsWindowed)
 	gLinearFilter = false;
 
 	glUseProgram(gProgram);
-	float ortho[16];
-	MakeOrthoMatrix(0, (float)mWidth, (float)mHeight, 0, -10, 10, ortho);
-	glUniformMatrix4fv(gUfViewProjMtx, 1, GL_FALSE, ortho);
+	SetViewProjection((float)mWidth, (float)mHeight, false);
 	glUniform1i(gUfTexture, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	gNumVertices = 0;
+	gNumIndices = 0;
+	gTexture = 0;
+	gDrawMode = Graphics::DRAWMODE_NORMAL;
+	gColorFilter = ColorFilter_None;
+	gLumSat[0] = gLumSat[1] = 1.0f;
+	gAppliedUseTexture = gAppliedDrawMode = gAppliedColorFilter = -1;
+	gAppliedLumSat[0] = gAppliedLumSat[1] = -1.0f;
 
 	glEnable(GL_BLEND);
 	glDisable(GL_DITHER);
@@ -1188,13 +1411,27 @@ void GLInterface::SetCursorPos(int x, int y)
 
 bool GLInterface::PreDraw()
 {
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	return true;
 }
 
 void GLInterface::Flush()
 {
-	gNumVertices = 0;
+	GfxFlush();
+	if (mTextureBudgetDirty)
+		EnforceTextureBudget();
+
+	gRenderStats.mResidentTextureBytes = gResidentTextureBytes;
+	mLastFrameStats = gRenderStats;
+	memset(&gRenderStats, 0, sizeof(gRenderStats));
+	mTextureFrame++;
+	if (mRenderStatsLog != nullptr)
+	{
+		const RenderStats& s = mLastFrameStats;
+		fprintf(mRenderStatsLog, "%d,%d,%d,%d,%d,%d,%lld,%d,%d,%d,%d,%lld\n", mRenderStatsFrame++, s.mDrawCalls, s.mVertices, s.mTextureBinds,
+			s.mBlendChanges, s.mTextureUploads, (long long)s.mTextureUploadBytes, s.mFramebufferSwitches,
+			s.mTextureHits, s.mTextureMisses, s.mTextureEvictions, (long long)s.mResidentTextureBytes);
+	}
+
 #ifdef NINTENDO_SWITCH
 	eglSwapBuffers(mApp->mWindow, mApp->mSurface);
 #else
@@ -1202,6 +1439,120 @@ void GLInterface::Flush()
 #endif
 }
 
+// Appends one CSV row of RenderStats per presented frame until StopRenderStatsLog().
+bool GLInterface::StartRenderStatsLog(const std::string& theFileName)
+{
+	StopRenderStatsLog();
+
+	mRenderStatsLog = fopen(theFileName.c_str(), "w");
+	if (mRenderStatsLog == nullptr)
+		return false;
+
+	fprintf(mRenderStatsLog, "frame,draw_calls,vertices,texture_binds,blend_changes,texture_uploads,texture_upload_bytes,fbo_switches,"
+		"texture_hits,texture_misses,texture_evictions,resident_texture_bytes\n");
+	mRenderStatsFrame = 0;
+	return true;
+}
+
+void GLInterface::StopRenderStatsLog()
+{
+	if (mRenderStatsLog != nullptr)
+	{
+		fclose(mRenderStatsLog);
+		mRenderStatsLog = nullptr;
+	}
+}
+
+// Redirects all drawing into theImage's texture until EndRenderTarget(). The texture is created on first
+// use as a single RGBA piece; its contents are GPU-only and survive until the image is destroyed.
+bool GLInterface::BeginRenderTarget(MemoryImage* theImage)
+{
+	if (mRenderTarget != nullptr)
+		return false;
+
+	GfxFlush();
+
+	if (theImage->mRenderData == nullptr)
+	{
+		theImage->mRenderData = new TextureData();
+		std::scoped_lock lk(mCritSect);
+		mImageSet.insert(theImage);
+	}
+
+	TextureData *data = (TextureData*)theImage->mRenderData;
+	if (data->mFramebuffer == 0 || data->mWidth != theImage->mWidth || data->mHeight != theImage->mHeight)
+	{
+		data->ReleaseTextures();
+		data->mPixelFormat = PixelFormat_Unknown;
+		if (theImage->mWidth > gMaxTextureWidth || theImage->mHeight > gMaxTextureHeight)
+			return false;
+
+		// Exact-size (NPOT) texture: clamped, unmipmapped NPOT textures are core in ES 2.0
+		data->mTextures.resize(1);
+		data->mTexVecWidth = data->mTexVecHeight = 1;
+		data->mTexPieceWidth = theImage->mWidth;
+		data->mTexPieceHeight = theImage->mHeight;
+		data->mMaxTotalU = data->mMaxTotalV = 1.0f;
+		data->mImageFlags = theImage->mRenderFlags & RenderImageFlag_TextureMask;
+
+		TextureDataPiece &piece = data->mTextures[0];
+		piece.mWidth = theImage->mWidth;
+		piece.mHeight = theImage->mHeight;
+		glGenTextures(1, &piece.mTexture);
+		glBindTexture(GL_TEXTURE_2D, piece.mTexture);
+		gRenderStats.mTextureBinds++;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, piece.mWidth, piece.mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		glGenFramebuffers(1, &data->mFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, data->mFramebuffer);
+		gRenderStats.mFramebufferSwitches++;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, piece.mTexture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			data->ReleaseTextures();
+			return false;
+		}
+
+		data->mWidth = theImage->mWidth;
+		data->mHeight = theImage->mHeight;
+		data->mTexMemSize = piece.mWidth * piece.mHeight * 4;
+		gResidentTextureBytes += data->mTexMemSize;
+		data->mPixelFormat = PixelFormat_A8R8G8B8;
+		data->mBitsChangedCount = theImage->mBitsChangedCount;
+	}
+	else
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, data->mFramebuffer);
+		gRenderStats.mFramebufferSwitches++;
+	}
+
+	// Row 0 of the image is row 0 of the texture, so the target samples upright like an uploaded image
+	glViewport(0, 0, theImage->mWidth, theImage->mHeight);
+	SetViewProjection((float)theImage->mWidth, (float)theImage->mHeight, true);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(0, 0, 0, 1);
+
+	mRenderTarget = theImage;
+	return true;
+}
+
+void GLInterface::EndRenderTarget()
+{
+	if (mRenderTarget == nullptr)
+		return;
+
+	GfxFlush();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gRenderStats.mFramebufferSwitches++;
+	glViewport(mPresentationRect.mX, mPresentationRect.mY, mPresentationRect.mWidth, mPresentationRect.mHeight);
+	SetViewProjection((float)mWidth, (float)mHeight, false);
+	mRenderTarget = nullptr;
+}
+
 bool GLInterface::CreateImageTexture(MemoryImage *theImage)
 {
 	bool wantPurge = false;
@@ -1214,13 +1565,124 @@ bool GLInterface::CreateImageTexture(MemoryImage *theImage)
 	}
 
 	TextureData *data = (TextureData*)theImage->mRenderData;
+	if (data->mEvicted)
+	{
+		gRenderStats.mTextureMisses++;
+		wantPurge = theImage->mPurgeBits;
+	}
+	else if (data->mPixelFormat != PixelFormat_Unknown)
+		gRenderStats.mTextureHits++;
+	data->mLastUseFrame = mTextureFrame;
+
+	int aUploads = gRenderStats.mTextureUploads;
 	data->CheckCreateTextures(theImage);
 
 	if (wantPurge)
 		theImage->PurgeBits();
+	if (gRenderStats.mTextureUploads != aUploads)
+		mTextureBudgetDirty = true;
 	return data->mPixelFormat != PixelFormat_Unknown;
 }
 
+void GLInterface::SetTextureBudget(int64_t theBytes)
+{
+	mTextureBudget = std::max<int64_t>(theBytes, 0);
+	mTextureBudgetDirty = true;
+}
+
+int64_t GLInterface::GetResidentTextureBytes()
+{
+	return gResidentTextureBytes;
+}
+
+// Releases theImage's textures; the next draw uploads them again. Images whose bits were purged
+// are read back first and kept LZ4-compressed, since the texture was their only copy.
+bool GLInterface::EvictTexture(MemoryImage* theImage)
+{
+	TextureData* data = (TextureData*)theImage->mRenderData;
+	if (data == nullptr || data->mTextures.empty() || data->mFramebuffer != 0)
+		return false;
+
+	if (theImage->mBits == nullptr && theImage->mColorIndices == nullptr)
+	{
+		if (data->mBitsChangedCount != theImage->mBitsChangedCount)
+			return false;
+
+		int aSize = theImage->mWidth * theImage->mHeight * sizeof(uint32_t);
+		const uchar* aBits = (const uchar*)theImage->GetBits();
+		data->mEvictedBits.resize(LZ4CompressBound(aSize));
+		int aCompressedSize = LZ4Compress(aBits, aSize, data->mEvictedBits.data(), (int)data->mEvictedBits.size());
+		delete[] theImage->mBits;
+		theImage->mBits = nullptr;
+		if (aCompressedSize == 0)
+		{
+			std::vector<uchar>().swap(data->mEvictedBits);
+			return false;
+		}
+		data->mEvictedBits.resize(aCompressedSize);
+		data->mEvictedBits.shrink_to_fit();
+	}
+
+	data->ReleaseTextures();
+	data->mPixelFormat = PixelFormat_Unknown;
+	data->mEvicted = true;
+	gRenderStats.mTextureEvictions++;
+	return true;
+}
+
+// Evicts the least recently drawn textures until the resident total fits mTextureBudget.
+// Runs from Flush once per frame with uploads, never while a render target is bound.
+// Textures drawn in the current frame and render targets stay, so the budget is exceeded
+// rather than thrashing when a single frame needs more. Images that still have their bits
+// go first; purged ones need a readback, so at most MAX_READBACK_EVICTIONS of them are
+// evicted per frame and the rest wait for the following frames.
+void GLInterface::EnforceTextureBudget()
+{
+	const int MAX_READBACK_EVICTIONS = 1;
+
+	if (mRenderTarget != nullptr)
+		return;
+	mTextureBudgetDirty = false;
+	if (mTextureBudget <= 0 || gResidentTextureBytes <= mTextureBudget)
+		return;
+
+	std::vector<std::pair<int, MemoryImage*>> aCandidates;
+	{
+		std::scoped_lock lk(mCritSect);
+		for (MemoryImage* img : mImageSet)
+		{
+			TextureData* data = (TextureData*)img->mRenderData;
+			if (data != nullptr && !data->mTextures.empty() && data->mFramebuffer == 0 && data->mLastUseFrame != mTextureFrame)
+				aCandidates.emplace_back(data->mLastUseFrame, img);
+		}
+	}
+	std::sort(aCandidates.begin(), aCandidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	for (auto& [aLastUse, anImage] : aCandidates)
+	{
+		if (gResidentTextureBytes <= mTextureBudget)
+			return;
+		if (anImage->mBits != nullptr || anImage->mColorIndices != nullptr)
+			EvictTexture(anImage);
+	}
+
+	int aReadbacks = 0;
+	for (auto& [aLastUse, anImage] : aCandidates)
+	{
+		if (gResidentTextureBytes <= mTextureBudget)
+			return;
+		if (aReadbacks == MAX_READBACK_EVICTIONS)
+		{
+			mTextureBudgetDirty = true;
+			return;
+		}
+		if (((TextureData*)anImage->mRenderData)->mTextures.empty())
+			continue;
+		if (EvictTexture(anImage))
+			aReadbacks++;
+	}
+}
+
 bool GLInterface::RecoverBits(MemoryImage* theImage)
 {
 	if (!theImage->mRenderData) return false;
@@ -1228,6 +1690,18 @@ bool GLInterface::RecoverBits(MemoryImage* theImage)
 	TextureData* data = (TextureData*)theImage->mRenderData;
 	if (data->mBitsChangedCount != theImage->mBitsChangedCount) return false;
 
+	if (!data->mEvictedBits.empty())
+	{
+		int aSize = theImage->mWidth * theImage->mHeight * sizeof(uint32_t);
+		if (LZ4Decompress(data->mEvictedBits.data(), (int)data->mEvictedBits.size(), (uchar*)theImage->GetBits(), aSize) != aSize)
+			return false;
+		return true;	// the copy is kept until the textures are uploaded again, in case the bits get purged meanwhile
+	}
+	if (data->mTextures.empty()) return false;
+
+	GfxFlush();
+	GLuint aBoundFramebuffer = mRenderTarget != nullptr ? ((TextureData*)mRenderTarget->mRenderData)->mFramebuffer : 0;
+
 	for (int row = 0; row < data->mTexVecHeight; row++)
 	{
 		for (int col = 0; col < data->mTexVecWidth; col++)
@@ -1238,18 +1712,19 @@ bool GLInterface::RecoverBits(MemoryImage* theImage)
 			int w = std::min(theImage->mWidth  - offx, piece.mWidth);
 			int h = std::min(theImage->mHeight - offy, piece.mHeight);
 
-			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, piece.mTexture);
+			gRenderStats.mTextureBinds++;
 
 			// FBO readback (ES 2.0 has no glGetTexImage)
 			GLuint fbo;
 			glGenFramebuffers(1, &fbo);
 			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			gRenderStats.mFramebufferSwitches += 2;
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, piece.mTexture, 0);
 
 			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			{
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glBindFramebuffer(GL_FRAMEBUFFER, aBoundFramebuffer);
 				glDeleteFramebuffers(1, &fbo);
 				return false;
 			}
@@ -1257,7 +1732,7 @@ bool GLInterface::RecoverBits(MemoryImage* theImage)
 			std::vector<uint32_t> buf(w * h);
 			glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf.data());
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, aBoundFramebuffer);
 			glDeleteFramebuffers(1, &fbo);
 
 			uint32_t* dst = theImage->GetBits() + offy * theImage->GetWidth() + offx;
@@ -1298,7 +1773,7 @@ void GLInterface::Blt(Image* theImage, float theX, float theY,
 	}
 	if (!PreDraw()) return;
 
-	MemoryImage* mem = (MemoryImage*)theImage;
+	MemoryImage* mem = ResolveColorFilter(theImage);
 	if (!CreateImageTexture(mem)) return;
 
 	SetDrawMode(theDrawMode);
@@ -1361,7 +1836,7 @@ void GLInterface::BltTransformed(Image* theImage, const Rect* theClipRect,
 {
 	if (!PreDraw()) return;
 
-	MemoryImage* mem = (MemoryImage*)theImage;
+	MemoryImage* mem = ResolveColorFilter(theImage);
 	if (!CreateImageTexture(mem)) return;
 
 	SetDrawMode(theDrawMode);
@@ -1406,16 +1881,14 @@ void GLInterface::DrawLine(double x1, double y1, double x2, double y2,
 		fx1 = p1.x; fy1 = p1.y; fx2 = p2.x; fy2 = p2.y;
 	}
 
-	glUniform1i(gUfUseTexture, 0);
+	GfxSetTexture(0);
 	uint32_t c = theColor.ToGLColor();
 	GLVertex v[3] = {
-		{ fx1, fy1, 0, c, 0, 0 },
-		{ fx2, fy2, 0, c, 0, 0 },
-		{ fx2 + 0.5f, fy2 + 0.5f, 0, c, 0, 0 },
+		MakeVertex(fx1, fy1, c, 0, 0),
+		MakeVertex(fx2, fy2, c, 0, 0),
+		MakeVertex(fx2 + 0.5f, fy2 + 0.5f, c, 0, 0),
 	};
-	GfxBegin(GL_LINE_STRIP);
-	GfxAddVertices(v, 3);
-	GfxEnd();
+	GfxDrawLineStrip(v, 3);
 }
 
 void GLInterface::FillRect(const Rect& theRect, const Color& theColor, int theDrawMode)
@@ -1428,10 +1901,10 @@ void GLInterface::FillRect(const Rect& theRect, const Color& theColor, int theDr
 	uint32_t c = theColor.ToGLColor();
 
 	GLVertex v[4] = {
-		{ x,     y,     0, c, 0, 0 },
-		{ x,     y + h, 0, c, 0, 0 },
-		{ x + w, y,     0, c, 0, 0 },
-		{ x + w, y + h, 0, c, 0, 0 },
+		MakeVertex(x,     y,     c, 0, 0),
+		MakeVertex(x,     y + h, c, 0, 0),
+		MakeVertex(x + w, y,     c, 0, 0),
+		MakeVertex(x + w, y + h, c, 0, 0),
 	};
 
 	if (!mTransformStack.empty())
@@ -1445,10 +1918,8 @@ void GLInterface::FillRect(const Rect& theRect, const Color& theColor, int theDr
 		}
 	}
 
-	glUniform1i(gUfUseTexture, 0);
-	GfxBegin(GL_TRIANGLE_STRIP);
-	GfxAddVertices(v, 4);
-	GfxEnd();
+	GfxSetTexture(0);
+	GfxAddQuad(v);
 }
 
 void GLInterface::DrawTriangle(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3,
@@ -1458,16 +1929,11 @@ void GLInterface::DrawTriangle(const TriVertex &p1, const TriVertex &p2, const T
 	SetDrawMode(theDrawMode);
 
 	uint32_t c = theColor.ToGLColor();
-	glUniform1i(gUfUseTexture, 0);
-
-	GLVertex v[3] = {
-		{ p1.x, p1.y, 0, GetColorFromTriVertex(p1, c), 0, 0 },
-		{ p2.x, p2.y, 0, GetColorFromTriVertex(p2, c), 0, 0 },
-		{ p3.x, p3.y, 0, GetColorFromTriVertex(p3, c), 0, 0 },
-	};
-	GfxBegin(GL_TRIANGLE_STRIP);
-	GfxAddVertices(v, 3);
-	GfxEnd();
+	GfxSetTexture(0);
+	GfxAddTriangle(
+		MakeVertex(p1.x, p1.y, GetColorFromTriVertex(p1, c), 0, 0),
+		MakeVertex(p2.x, p2.y, GetColorFromTriVertex(p2, c), 0, 0),
+		MakeVertex(p3.x, p3.y, GetColorFromTriVertex(p3, c), 0, 0));
 }
 
 void GLInterface::DrawTriangleTex(const TriVertex &p1, const TriVertex &p2, const TriVertex &p3,
@@ -1482,7 +1948,7 @@ void GLInterface::DrawTrianglesTex(const TriVertex theVertices[][3], int theNumT
 {
 	if (!PreDraw()) return;
 
-	MemoryImage* mem = (MemoryImage*)theTexture;
+	MemoryImage* mem = ResolveColorFilter(theTexture);
 	if (!CreateImageTexture(mem)) return;
 
 	SetDrawMode(theDrawMode);
@@ -1519,12 +1985,12 @@ void GLInterface::FillPoly(const Point theVertices[], int theNumVertices,
 	SetDrawMode(theDrawMode);
 
 	uint32_t c = theColor.ToGLColor();
-	glUniform1i(gUfUseTexture, 0);
+	GfxSetTexture(0);
 
 	VertexList vl;
 	for (int i = 0; i < theNumVertices; i++)
 	{
-		GLVertex v = { theVertices[i].mX + (float)tx, theVertices[i].mY + (float)ty, 0, c, 0, 0 };
+		GLVertex v = MakeVertex(theVertices[i].mX + (float)tx, theVertices[i].mY + (float)ty, c, 0, 0);
 		if (!mTransformStack.empty())
 		{
 			SexyVector2 p(v.sx, v.sy);
@@ -1537,9 +2003,5 @@ void GLInterface::FillPoly(const Point theVertices[], int theNumVertices,
 	if (theClipRect)
 		DrawPolyClipped(theClipRect, vl);
 	else
-	{
-		GfxBegin(GL_TRIANGLE_FAN);
-		GfxAddVertices(vl);
-		GfxEnd();
-	}
+		GfxAddFan(vl);
 }
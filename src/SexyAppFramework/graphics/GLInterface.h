@@ -49,10 +49,10 @@ struct GLVertex
 {
 	float sx;
 	float sy;
-	float sz;
 	uint32_t color;
 	float tu;
 	float tv;
+	float uvBounds[4];	// per-vertex UV clamp so quads from different texture sub-rects can share one draw
 };
 
 struct VertexList
@@ -133,6 +133,10 @@ public:
 	float mMaxTotalU, mMaxTotalV;
 	PixelFormat mPixelFormat;
 	int mImageFlags;
+	GLuint mFramebuffer;	// non-zero for render targets, whose contents live only in the texture
+	int mLastUseFrame;		// GLInterface::mTextureFrame of the last draw, for LRU eviction
+	bool mEvicted;			// textures released by the budget; recreated on the next draw
+	std::vector<uchar> mEvictedBits;	// LZ4 copy of the pixels of an evicted image whose bits were purged
 
 	TextureData();
 	~TextureData();
@@ -150,6 +154,22 @@ public:
 	void BltTriangles(const TriVertex theVertices[][3], int theNumTriangles, unsigned int theColor, float tx = 0, float ty = 0);
 };
 
+// Counters for one frame; reset at every Flush().
+struct RenderStats
+{
+	int mDrawCalls;
+	int mVertices;
+	int mTextureBinds;
+	int mBlendChanges;
+	int mTextureUploads;
+	int64_t mTextureUploadBytes;
+	int mFramebufferSwitches;
+	int mTextureHits;		// draws of an image whose textures were resident
+	int mTextureMisses;		// draws that had to recreate evicted textures
+	int mTextureEvictions;
+	int64_t mResidentTextureBytes;	// at the end of the frame
+};
+
 class GLInterface : public NativeDisplay
 {
 public:
@@ -166,6 +186,7 @@ public:
 	int						mMillisecondsPerFrame;
 
 	GLImage*				mScreenImage;
+	MemoryImage*			mRenderTarget;
 
 	int						mNextCursorX;
 	int						mNextCursorY;
@@ -179,6 +200,14 @@ public:
 	typedef std::list<SexyMatrix3> TransformStack;
 	TransformStack mTransformStack;
 
+	RenderStats				mLastFrameStats;
+	FILE*					mRenderStatsLog;
+	int						mRenderStatsFrame;
+
+	int64_t					mTextureBudget;		// bytes of texture memory to keep resident, 0 for no limit
+	int						mTextureFrame;
+	bool					mTextureBudgetDirty;	// uploads or a new budget since the last frame boundary
+
 	void					SetDrawMode(int theDrawMode);
 
 public:
@@ -205,6 +234,18 @@ public:
 	bool					PreDraw();
 	void					Flush();
 
+	bool					BeginRenderTarget(MemoryImage* theImage);
+	void					EndRenderTarget();
+
+	bool					StartRenderStatsLog(const std::string& theFileName);
+	void					StopRenderStatsLog();
+	bool					IsRenderStatsLogging() const { return mRenderStatsLog != nullptr; }
+
+	void					SetTextureBudget(int64_t theBytes);
+	int64_t					GetResidentTextureBytes();
+	bool					EvictTexture(MemoryImage* theImage);
+	void					EnforceTextureBudget();
+
 	bool					CreateImageTexture(MemoryImage* theImage);
 	bool					RecoverBits(MemoryImage* theImage);
 	void					Blt(Image* theImage, float theX, float theY, const Rect& theSrcRect, const Color& theColor, int theDrawMode, bool linearFilter = true);
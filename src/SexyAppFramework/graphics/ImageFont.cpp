@@ -6,6 +6,7 @@
 #include "graphics/GLImage.h"
 #include <algorithm>
 #include <mutex>
+#include <shared_mutex>
 #include "fcaseopen/fcaseopen.h"
 
 using namespace Sexy;
@@ -1233,7 +1234,7 @@ ImageFont::ImageFont(const ImageFont& theImageFont) :
 	mFontData(theImageFont.mFontData),
 	mPointSize(theImageFont.mPointSize),
 	mTagVector(theImageFont.mTagVector),
-	mActiveListValid(theImageFont.mActiveListValid),
+	mActiveListValid(theImageFont.mActiveListValid.load()),
 	mScale(theImageFont.mScale),
 	mForceScaledImagesWhite(theImageFont.mForceScaledImagesWhite)
 {
@@ -1260,11 +1261,13 @@ ImageFont::~ImageFont()
 	mFontData->DeRef();
 }
 
+// Called with mMeshCritSect held exclusively (see Prepare), or before the font is shared
 void ImageFont::GenerateActiveFontLayers()
 {
 	if (!mFontData->mInitialized)
 		return;
 
+	mMeshCache.clear();
 	mActiveLayerList.clear();
 
 	uint32_t i;
@@ -1491,43 +1494,48 @@ int ImageFont::CharWidth(char theChar)
 	return CharWidthKern(theChar, 0);
 }
 
-std::mutex gRenderCritSec;
-static const int POOL_SIZE = 4096;
-static RenderCommand gRenderCommandPool[POOL_SIZE];
-static RenderCommand* gRenderTail[256];
-static RenderCommand* gRenderHead[256];
+static const size_t MAX_CACHED_STRING_MESHES = 256;
 
-void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string& theString, const Color& theColor, RectList* theDrawnAreas, int* theWidth)
+// Meshes are shared with the callers drawing them, so clearing the cache never pulls one out from under a draw
+// Returns with theReadLock held: the quads index mActiveLayerList, which cannot be regenerated until the caller
+// has finished drawing and released it
+std::shared_ptr<const StringGlyphMesh> ImageFont::GetStringMesh(const std::string& theString, std::shared_lock<std::shared_mutex>& theReadLock)
 {
-	std::scoped_lock anAutoCrit(gRenderCritSec);
-
-	int aPoolIdx;
-
-	for (aPoolIdx = 0; aPoolIdx < 256; aPoolIdx++)
+	for (;;)
 	{
-		gRenderHead[aPoolIdx] = nullptr;
-		gRenderTail[aPoolIdx] = nullptr;
+		theReadLock = std::shared_lock(mMeshCritSect);
+		StringGlyphMeshMap::iterator aMeshItr = mMeshCache.find(theString);
+		if (aMeshItr != mMeshCache.end())
+			return aMeshItr->second;
+
+		// The layers may be regenerated between the build and the lookup, emptying the cache again
+		theReadLock.unlock();
+		BuildStringMesh(theString);
 	}
+}
 
-	// int aXPos = theX; // unused
-
-	if (theDrawnAreas != nullptr)
-		theDrawnAreas->clear();
-
-	if (!mFontData->mInitialized)
-	{
-		if (theWidth != nullptr)
-			*theWidth = 0;
+void ImageFont::BuildStringMesh(const std::string& theString)
+{
+	std::unique_lock aWriteLock(mMeshCritSect);
+	if (mMeshCache.find(theString) != mMeshCache.end())
 		return;
-	}
 
-	Prepare();
+	// Damage numbers and counters produce an unbounded stream of strings; start over rather than grow forever
+	if (mMeshCache.size() >= MAX_CACHED_STRING_MESHES)
+		mMeshCache.clear();
 
-	bool colorizeImages = g->GetColorizeImages();
-	g->SetColorizeImages(true);
+	std::shared_ptr<StringGlyphMesh> aMeshPtr = std::make_shared<StringGlyphMesh>();
+	StringGlyphMesh& aMesh = *aMeshPtr;
 
-	int aCurXPos = theX;
-	int aCurPoolIdx = 0;
+	struct OrderedGlyph
+	{
+		int					mOrderIdx;
+		GlyphQuad			mQuad;
+	};
+	std::vector<OrderedGlyph> aGlyphs;
+	aGlyphs.reserve(theString.length() * mActiveLayerList.size());
+
+	int aCurXPos = 0;
 
 	for (uint32_t aCharNum = 0; aCharNum < theString.length(); aCharNum++)
 	{
@@ -1540,10 +1548,12 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string&
 		int aMaxXPos = aCurXPos;
 
 		ActiveFontLayerList::iterator anItr = mActiveLayerList.begin();
-		int layerOrderOffset = 0;
+		int layerOrderOffset = 0;	// also the layer's index in mActiveLayerList
 		while (anItr != mActiveLayerList.end())
 		{
 			ActiveFontLayer* anActiveFontLayer = &*anItr;
+			FontLayer* aBaseFontLayer = anActiveFontLayer->mBaseFontLayer;
+			CharData* aCharData = aBaseFontLayer->GetCharData(aChar);
 
 			int aLayerXPos = aCurXPos;
 
@@ -1552,7 +1562,7 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string&
 			int aCharWidth;
 			int aSpacing;
 
-			int aLayerPointSize = anActiveFontLayer->mBaseFontLayer->mPointSize;
+			int aLayerPointSize = aBaseFontLayer->mPointSize;
 
 			double aScale = mScale;
 			if (aLayerPointSize != 0)
@@ -1560,79 +1570,39 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string&
 
 			if (aScale == 1.0)
 			{
-				anImageX = aLayerXPos + anActiveFontLayer->mBaseFontLayer->mOffset.mX + anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mOffset.mX;
-				anImageY = theY - (anActiveFontLayer->mBaseFontLayer->mAscent - anActiveFontLayer->mBaseFontLayer->mOffset.mY - anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mOffset.mY);
-				aCharWidth = anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mWidth;
+				anImageX = aLayerXPos + aBaseFontLayer->mOffset.mX + aCharData->mOffset.mX;
+				anImageY = -(aBaseFontLayer->mAscent - aBaseFontLayer->mOffset.mY - aCharData->mOffset.mY);
+				aCharWidth = aCharData->mWidth;
 
 				if (aNextChar != 0)
-				{
-					aSpacing = anActiveFontLayer->mBaseFontLayer->mSpacing +
-						anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mKerningOffsets[aNextChar];
-				}
+					aSpacing = aBaseFontLayer->mSpacing + aCharData->mKerningOffsets[aNextChar];
 				else
 					aSpacing = 0;
 			}
 			else
 			{
-				anImageX = aLayerXPos + (int)((anActiveFontLayer->mBaseFontLayer->mOffset.mX + anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mOffset.mX) * aScale);
-				anImageY = theY - (int)((anActiveFontLayer->mBaseFontLayer->mAscent - anActiveFontLayer->mBaseFontLayer->mOffset.mY - anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mOffset.mY) * aScale);
-				aCharWidth = (anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mWidth * aScale);
+				anImageX = aLayerXPos + (int)((aBaseFontLayer->mOffset.mX + aCharData->mOffset.mX) * aScale);
+				anImageY = -(int)((aBaseFontLayer->mAscent - aBaseFontLayer->mOffset.mY - aCharData->mOffset.mY) * aScale);
+				aCharWidth = (aCharData->mWidth * aScale);
 
 				if (aNextChar != 0)
-				{
-					aSpacing = (int)((anActiveFontLayer->mBaseFontLayer->mSpacing +
-						anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mKerningOffsets[aNextChar]) * aScale);
-				}
+					aSpacing = (int)((aBaseFontLayer->mSpacing + aCharData->mKerningOffsets[aNextChar]) * aScale);
 				else
 					aSpacing = 0;
 			}
 
-			Color aColor;
-			aColor.mRed = std::min((theColor.mRed * anActiveFontLayer->mBaseFontLayer->mColorMult.mRed / 255) + anActiveFontLayer->mBaseFontLayer->mColorAdd.mRed, 255);
-			aColor.mGreen = std::min((theColor.mGreen * anActiveFontLayer->mBaseFontLayer->mColorMult.mGreen / 255) + anActiveFontLayer->mBaseFontLayer->mColorAdd.mGreen, 255);
-			aColor.mBlue = std::min((theColor.mBlue * anActiveFontLayer->mBaseFontLayer->mColorMult.mBlue / 255) + anActiveFontLayer->mBaseFontLayer->mColorAdd.mBlue, 255);
-			aColor.mAlpha = std::min((theColor.mAlpha * anActiveFontLayer->mBaseFontLayer->mColorMult.mAlpha / 255) + anActiveFontLayer->mBaseFontLayer->mColorAdd.mAlpha, 255);
-
-			int anOrder = layerOrderOffset + anActiveFontLayer->mBaseFontLayer->mBaseOrder + anActiveFontLayer->mBaseFontLayer->GetCharData(aChar)->mOrder;
-
-			if (aCurPoolIdx >= POOL_SIZE)
-				break;
-
-			RenderCommand* aRenderCommand = &gRenderCommandPool[aCurPoolIdx++];
-
-			aRenderCommand->mImage = anActiveFontLayer->mScaledImage;
-			aRenderCommand->mColor = aColor;
-			aRenderCommand->mDest[0] = anImageX;
-			aRenderCommand->mDest[1] = anImageY;
-			aRenderCommand->mSrc[0] = anActiveFontLayer->mScaledCharImageRects[aChar].mX;
-			aRenderCommand->mSrc[1] = anActiveFontLayer->mScaledCharImageRects[aChar].mY;
-			aRenderCommand->mSrc[2] = anActiveFontLayer->mScaledCharImageRects[aChar].mWidth;
-			aRenderCommand->mSrc[3] = anActiveFontLayer->mScaledCharImageRects[aChar].mHeight;
-			aRenderCommand->mMode = anActiveFontLayer->mBaseFontLayer->mDrawMode;
-			aRenderCommand->mNext = nullptr;
+			int anOrder = layerOrderOffset + aBaseFontLayer->mBaseOrder + aCharData->mOrder;
+			const Rect& aSrcRect = anActiveFontLayer->mScaledCharImageRects[aChar];
 
-			int anOrderIdx = std::min(std::max(anOrder + 128, 0), 255);
+			OrderedGlyph aGlyph;
+			aGlyph.mOrderIdx = std::min(std::max(anOrder + 128, 0), 255);
+			aGlyph.mQuad.mLayerIdx = layerOrderOffset;
+			aGlyph.mQuad.mDest[0] = anImageX;
+			aGlyph.mQuad.mDest[1] = anImageY;
+			aGlyph.mQuad.mSrc = aSrcRect;
+			aGlyphs.push_back(aGlyph);
 
-			if (gRenderTail[anOrderIdx] == nullptr)
-			{
-				gRenderTail[anOrderIdx] = aRenderCommand;
-				gRenderHead[anOrderIdx] = aRenderCommand;
-			}
-			else
-			{
-				gRenderTail[anOrderIdx]->mNext = aRenderCommand;
-				gRenderTail[anOrderIdx] = aRenderCommand;
-			}
-
-			//aRenderCommandMap.insert(RenderCommandMap::value_type(aPriority, aRenderCommand));
-
-			if (theDrawnAreas != nullptr)
-			{
-				Rect aDestRect(anImageX, anImageY, anActiveFontLayer->mScaledCharImageRects[aChar].mWidth, anActiveFontLayer->mScaledCharImageRects[aChar].mHeight);
-
-				theDrawnAreas->push_back(aDestRect);
-
-			}
+			aMesh.mDrawnAreas.push_back(Rect(anImageX, anImageY, aSrcRect.mWidth, aSrcRect.mHeight));
 
 			aLayerXPos += aCharWidth + aSpacing;
 
@@ -1646,29 +1616,83 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string&
 		aCurXPos = aMaxXPos;
 	}
 
+	// Same order the old per-call render pools produced: by order index, then layout order
+	std::stable_sort(aGlyphs.begin(), aGlyphs.end(), [](const OrderedGlyph& a, const OrderedGlyph& b) { return a.mOrderIdx < b.mOrderIdx; });
+
+	aMesh.mQuads.reserve(aGlyphs.size());
+	for (const OrderedGlyph& aGlyph : aGlyphs)
+		aMesh.mQuads.push_back(aGlyph.mQuad);
+	aMesh.mWidth = aCurXPos;
+	mMeshCache[theString] = aMeshPtr;
+}
+
+void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const std::string& theString, const Color& theColor, RectList* theDrawnAreas, int* theWidth)
+{
+	if (theDrawnAreas != nullptr)
+		theDrawnAreas->clear();
+
+	if (!mFontData->mInitialized)
+	{
+		if (theWidth != nullptr)
+			*theWidth = 0;
+		return;
+	}
+
+	Prepare();
+
+	std::shared_lock<std::shared_mutex> aReadLock;
+	std::shared_ptr<const StringGlyphMesh> aMeshPtr = GetStringMesh(theString, aReadLock);
+	const StringGlyphMesh& aMesh = *aMeshPtr;
+
 	if (theWidth != nullptr)
-		*theWidth = aCurXPos - theX;
+		*theWidth = aMesh.mWidth;
+
+	if (theDrawnAreas != nullptr)
+	{
+		for (const Rect& aRect : aMesh.mDrawnAreas)
+			theDrawnAreas->push_back(Rect(aRect.mX + theX, aRect.mY + theY, aRect.mWidth, aRect.mHeight));
+	}
+
+	bool colorizeImages = g->GetColorizeImages();
+	g->SetColorizeImages(true);
 
 	Color anOrigColor = g->GetColor();
+	int anOldDrawMode = g->GetDrawMode();
 
-	for (aPoolIdx = 0; aPoolIdx < 256; aPoolIdx++)
+	size_t aQuadCount = aMesh.mQuads.size();
+	size_t aRunStart = 0;
+	while (aRunStart < aQuadCount)
 	{
-		RenderCommand* aRenderCommand = gRenderHead[aPoolIdx];
-
-		while (aRenderCommand != nullptr)
+		int aLayerIdx = aMesh.mQuads[aRunStart].mLayerIdx;
+		ActiveFontLayer* anActiveFontLayer = &*std::next(mActiveLayerList.begin(), aLayerIdx);
+		FontLayer* aBaseFontLayer = anActiveFontLayer->mBaseFontLayer;
+
+		size_t aRunEnd = aRunStart + 1;
+		while (aRunEnd < aQuadCount && aMesh.mQuads[aRunEnd].mLayerIdx == aLayerIdx)
+			aRunEnd++;
+
+		Color aColor;
+		aColor.mRed = std::min((theColor.mRed * aBaseFontLayer->mColorMult.mRed / 255) + aBaseFontLayer->mColorAdd.mRed, 255);
+		aColor.mGreen = std::min((theColor.mGreen * aBaseFontLayer->mColorMult.mGreen / 255) + aBaseFontLayer->mColorAdd.mGreen, 255);
+		aColor.mBlue = std::min((theColor.mBlue * aBaseFontLayer->mColorMult.mBlue / 255) + aBaseFontLayer->mColorAdd.mBlue, 255);
+		aColor.mAlpha = std::min((theColor.mAlpha * aBaseFontLayer->mColorMult.mAlpha / 255) + aBaseFontLayer->mColorAdd.mAlpha, 255);
+
+		Image* anImage = anActiveFontLayer->mScaledImage;
+		if (anImage != nullptr)
 		{
-			int anOldDrawMode = g->GetDrawMode();
-			if (aRenderCommand->mMode != -1)
-				g->SetDrawMode(aRenderCommand->mMode);
-			g->SetColor(Color(aRenderCommand->mColor));
-			if (aRenderCommand->mImage != nullptr)
-				g->DrawImage(aRenderCommand->mImage, aRenderCommand->mDest[0], aRenderCommand->mDest[1], Rect(aRenderCommand->mSrc[0], aRenderCommand->mSrc[1], aRenderCommand->mSrc[2], aRenderCommand->mSrc[3]));
-			g->SetDrawMode(anOldDrawMode);
-
-			aRenderCommand = aRenderCommand->mNext;
+			g->SetDrawMode(aBaseFontLayer->mDrawMode != -1 ? aBaseFontLayer->mDrawMode : anOldDrawMode);
+			g->SetColor(aColor);
+			for (size_t i = aRunStart; i < aRunEnd; i++)
+			{
+				const GlyphQuad& aQuad = aMesh.mQuads[i];
+				g->DrawImage(anImage, theX + aQuad.mDest[0], theY + aQuad.mDest[1], aQuad.mSrc);
+			}
 		}
+
+		aRunStart = aRunEnd;
 	}
 
+	g->SetDrawMode(anOldDrawMode);
 	g->SetColor(anOrigColor);
 
 	g->SetColorizeImages(colorizeImages);
@@ -1751,8 +1775,12 @@ void ImageFont::Prepare()
 {
 	if (!mActiveListValid)
 	{
-		GenerateActiveFontLayers();
-		mActiveListValid = true;
+		std::unique_lock aWriteLock(mMeshCritSect);
+		if (!mActiveListValid)
+		{
+			GenerateActiveFontLayers();
+			mActiveListValid = true;
+		}
 	}
 }
 
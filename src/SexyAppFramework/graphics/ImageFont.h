@@ -6,6 +6,10 @@
 #include "SexyAppBase.h"
 #include "SharedImage.h"
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace Sexy
 {
@@ -122,19 +126,25 @@ public:
 
 typedef std::list<ActiveFontLayer> ActiveFontLayerList;
 
-class RenderCommand
+class GlyphQuad
 {
 public:
-	Image*					mImage;
-	int						mDest[2];
-	int						mSrc[4];
-	int						mMode;
-	Color					mColor;
-	bool					mUseAlphaCorrection;
-	RenderCommand*			mNext;
+	int						mLayerIdx;		// position in mActiveLayerList when the mesh was built
+	int						mDest[2];		// relative to the string origin
+	Rect					mSrc;
 };
 
-typedef std::multimap<int, RenderCommand> RenderCommandMap;
+// Laid-out glyphs of one string, already sorted into draw order. Consecutive quads of the same
+// layer share image, draw mode and color, so they are submitted as one run.
+class StringGlyphMesh
+{
+public:
+	std::vector<GlyphQuad>	mQuads;
+	std::vector<Rect>		mDrawnAreas;	// relative to the string origin, in layout order
+	int						mWidth;
+};
+
+typedef std::unordered_map<std::string, std::shared_ptr<const StringGlyphMesh>> StringGlyphMeshMap;
 
 class ImageFont : public _Font
 {
@@ -143,13 +153,18 @@ public:
 	int						mPointSize;
 	StringVector			mTagVector;
 
-	bool					mActiveListValid;
+	std::atomic<bool>		mActiveListValid;
 	ActiveFontLayerList		mActiveLayerList;
 	double					mScale;
 	bool					mForceScaledImagesWhite;
 
+	StringGlyphMeshMap		mMeshCache;		// invalidated whenever the active layers are regenerated
+	std::shared_mutex		mMeshCritSect;	// shared for cache lookups; exclusive to build a mesh or regenerate the layers
+
 public:
 	virtual void			GenerateActiveFontLayers();
+	void					BuildStringMesh(const std::string& theString);
+	std::shared_ptr<const StringGlyphMesh> GetStringMesh(const std::string& theString, std::shared_lock<std::shared_mutex>& theReadLock);
 	virtual void			DrawStringEx(Graphics* g, int theX, int theY, const std::string& theString, const Color& theColor, RectList* theDrawnAreas, int* theWidth);
 
 public:
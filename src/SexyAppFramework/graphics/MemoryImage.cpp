@@ -11,6 +11,7 @@
 #include "SWTri.h"
 
 #include <math.h>
+#include <algorithm>
 
 using namespace Sexy;
 
@@ -42,8 +43,15 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 	mPurgeBits(theMemoryImage.mPurgeBits),
 	mWantPal(theMemoryImage.mWantPal),
 	mBitsChanged(theMemoryImage.mBitsChanged),
-	mApp(theMemoryImage.mApp)
+	mApp(theMemoryImage.mApp),
+	mColorFilterSource(nullptr),
+	mColorFilter(ColorFilter_None),
+	mColorFilterTexture(nullptr)
 {
+	// The bits of a filter proxy are baked below, so the copy draws them directly
+	mColorFilterParams[0] = 1.0f;
+	mColorFilterParams[1] = 1.0f;
+
 	bool deleteBits = false;
 
 	MemoryImage* aNonConstMemoryImage = (MemoryImage*) &theMemoryImage;
@@ -124,6 +132,12 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
 MemoryImage::~MemoryImage()
 {	
+	// Proxies that outlive their source are left without one and draw their own (empty) bits
+	while (!mColorFilterProxies.empty())
+		mColorFilterProxies.back()->SetColorFilterSource(nullptr);
+	SetColorFilterSource(nullptr);
+	delete mColorFilterTexture;
+
 	mApp->RemoveMemoryImage(this);
 	
 	delete [] mBits;
@@ -156,9 +170,28 @@ void MemoryImage::Init()
 	mPurgeBits = false;
 	mWantPal = false;
 
+	mColorFilterSource = nullptr;
+	mColorFilter = ColorFilter_None;
+	mColorFilterParams[0] = 1.0f;
+	mColorFilterParams[1] = 1.0f;
+	mColorFilterTexture = nullptr;
+
 	mApp->AddMemoryImage(this);
 }
 
+void MemoryImage::SetColorFilterSource(MemoryImage* theSource)
+{
+	if (mColorFilterSource != nullptr)
+	{
+		std::vector<MemoryImage*>& aProxies = mColorFilterSource->mColorFilterProxies;
+		aProxies.erase(std::remove(aProxies.begin(), aProxies.end(), this), aProxies.end());
+	}
+
+	mColorFilterSource = theSource;
+	if (theSource != nullptr)
+		theSource->mColorFilterProxies.push_back(this);
+}
+
 void MemoryImage::BitsChanged()
 {
 	mBitsChanged = true;
@@ -16,6 +16,13 @@ const uint32_t MEMORYCHECK_ID = 0x4BEEFADE;
 class NativeDisplay;
 class SexyAppBase;
 
+enum ColorFilterMode
+{
+	ColorFilter_None,
+	ColorFilter_LumSat,		// scale HSL luminosity and saturation by mColorFilterParams[0] and [1]
+	ColorFilter_White		// force RGB to white, keep alpha
+};
+
 class MemoryImage : public Image
 {
 public:
@@ -40,6 +47,13 @@ public:
 
 	bool					mBitsChanged;
 	SexyAppBase*			mApp;
+
+	// When set, GLInterface draws mColorFilterSource's texture through the mColorFilter shader instead of this image's own bits
+	MemoryImage*			mColorFilterSource;
+	int						mColorFilter;
+	float					mColorFilterParams[2];
+	std::vector<MemoryImage*> mColorFilterProxies;	// images whose mColorFilterSource is this one
+	MemoryImage*			mColorFilterTexture;	// owned copy that the proxies sample in place of these bits, if any
 	
 private:
 	void					Init();
@@ -56,6 +70,8 @@ public:
 
 	virtual void			BitsChanged();
 	virtual void			CommitBits();
+
+	void					SetColorFilterSource(MemoryImage* theSource);
 	
 	virtual void			DeleteNativeData();	
 
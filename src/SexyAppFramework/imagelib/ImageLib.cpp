@@ -2,6 +2,7 @@
 
 #include "Common.h"
 #include "ImageLib.h"
+#include "PixelKernels.h"
 #include "png.h"
 #include <math.h>
 #include <algorithm>
@@ -30,7 +31,7 @@ Image::Image()
 
 Image::~Image()
 {
-	delete mBits;
+	delete[] mBits;
 }
 
 int	Image::GetWidth()
@@ -1237,7 +1238,7 @@ static unsigned char Sample(int w, int h, const unsigned char *pData, int u, int
 	return Value/(ScaleW*ScaleH);
 }
 
-static unsigned char *Rescale(int Width, int Height, int NewWidth, int NewHeight, const unsigned char *pData)
+unsigned char *ImageLib::RescaleReference(int Width, int Height, int NewWidth, int NewHeight, const unsigned char *pData)
 {
 	unsigned char *pTmpData;
 	int ScaleW = Width/NewWidth;
@@ -1261,6 +1262,78 @@ static unsigned char *Rescale(int Width, int Height, int NewWidth, int NewHeight
 	return pTmpData;
 }
 
+// Same box filter as RescaleReference, done a whole pixel at a time; each byte lane is averaged on its own,
+// so the result does not depend on the channel order or endianness
+static void DownscaleBox(uint32_t* theDst, const uint32_t* theSrc, int theWidth, int theNewWidth, int theNewHeight, int theScaleW, int theScaleH)
+{
+	const uint32_t aCount = theScaleW * theScaleH;
+	for (int y = 0; y < theNewHeight; y++)
+	{
+		const uint32_t* aRow = theSrc + y * theScaleH * theWidth;
+		for (int x = 0; x < theNewWidth; x++)
+		{
+			uint32_t aSum[4] = { 0, 0, 0, 0 };
+			for (int v = 0; v < theScaleH; v++)
+			{
+				const uint32_t* aBlock = aRow + v * theWidth + x * theScaleW;
+				for (int u = 0; u < theScaleW; u++)
+				{
+					aSum[0] += aBlock[u] & 0xFF;
+					aSum[1] += (aBlock[u] >> 8) & 0xFF;
+					aSum[2] += (aBlock[u] >> 16) & 0xFF;
+					aSum[3] += aBlock[u] >> 24;
+				}
+			}
+			*theDst++ = (aSum[0] / aCount) | ((aSum[1] / aCount) << 8) | ((aSum[2] / aCount) << 16) | ((aSum[3] / aCount) << 24);
+		}
+	}
+}
+
+bool ImageLib::DownscaleImage(Image* theImage, int theFactor)
+{
+	if (theFactor <= 1)
+		return false;
+
+	const int aNewWidth = theImage->mWidth / theFactor;
+	const int aNewHeight = theImage->mHeight / theFactor;
+	if (aNewWidth <= 0 || aNewHeight <= 0)
+		return false;
+
+	// Odd sizes leave a remainder that is dropped, tiny images may end up with a larger block than theFactor
+	const int aScaleW = theImage->mWidth / aNewWidth;
+	const int aScaleH = theImage->mHeight / aNewHeight;
+	uint32_t* aNewBits = new uint32_t[aNewWidth * aNewHeight];
+	if (aScaleW == 2 && aScaleH == 2)
+	{
+		const auto aHalve = GetPixelKernels().mHalve;
+		for (int y = 0; y < aNewHeight; y++)
+		{
+			const uint32_t* aRow0 = theImage->mBits + y * 2 * theImage->mWidth;
+			aHalve(aNewBits + y * aNewWidth, aRow0, aRow0 + theImage->mWidth, aNewWidth);
+		}
+	}
+	else
+		DownscaleBox(aNewBits, theImage->mBits, theImage->mWidth, aNewWidth, aNewHeight, aScaleW, aScaleH);
+
+	delete[] theImage->mBits;
+	theImage->mBits = aNewBits;
+	theImage->mWidth = aNewWidth;
+	theImage->mHeight = aNewHeight;
+	return true;
+}
+
+int ImageLib::ReadDownscaleMarker()
+{
+	PFILE* aFile = p_fopen(DOWNSCALE_MARKER_FILE, "rb");
+	if (aFile == nullptr)
+		return 1;
+
+	char aBuffer[16] = { 0 };
+	p_fread(aBuffer, 1, sizeof(aBuffer) - 1, aFile);
+	p_fclose(aFile);
+	return std::max(atoi(aBuffer), 1);
+}
+
 using ImageLoader = Image* (*)(const std::string&);
 using ImageExtEntry = std::pair<std::string_view, ImageLoader>;
 static constexpr std::array<ImageExtEntry, 4> kImageExts = {
@@ -1375,21 +1448,12 @@ static void ComposeAlpha(Image* theImage, Image* theAlphaImage)
 		theImage->mHeight != theAlphaImage->mHeight)
 		return;
 
-	uint32_t* aDstBits = theImage->mBits;
-	const uint32_t* aSrcBits = theAlphaImage->mBits;
-	const int aSize = theImage->mWidth * theImage->mHeight;
-
-	for (int i = 0; i < aSize; i++)
-		aDstBits[i] = (aDstBits[i] & 0x00FFFFFF) | ((aSrcBits[i] & 0xFF) << 24);
+	GetPixelKernels().mComposeAlpha(theImage->mBits, theAlphaImage->mBits, theImage->mWidth * theImage->mHeight);
 }
 
 static void ApplyAlphaAsImage(Image* theImage, uint32_t theBaseColor)
 {
-	uint32_t* aBits = theImage->mBits;
-	const int aSize = theImage->mWidth * theImage->mHeight;
-
-	for (int i = 0; i < aSize; i++)
-		aBits[i] = theBaseColor | ((aBits[i] & 0xFF) << 24);
+	GetPixelKernels().mAlphaToImage(theImage->mBits, theBaseColor, theImage->mWidth * theImage->mHeight);
 }
 
 Image* ImageLib::GetImage(const std::string& theFilename, bool lookForAlphaImage)
@@ -1415,21 +1479,17 @@ Image* ImageLib::GetImage(const std::string& theFilename, bool lookForAlphaImage
 	// Load image, trying each supported format
 	Image* anImage = TryLoadByExt(aFilename, anExt);
 
-	// Downscale only when configured to do so
+	// Downscale only when configured to do so, and only if the data has not been downscaled offline
 #if IMG_DOWNSCALE != 1
-	if (anImage)
+	static const bool aPreDownscaled = ReadDownscaleMarker() == IMG_DOWNSCALE;
+	if (aPreDownscaled)
 	{
-		const int aNewWidth = anImage->mWidth / IMG_DOWNSCALE;
-		const int aNewHeight = anImage->mHeight / IMG_DOWNSCALE;
-		if (aNewWidth > 0 && aNewHeight > 0)
-		{
-			auto* aNewData = Rescale(anImage->mWidth, anImage->mHeight, aNewWidth, aNewHeight, (unsigned char*)anImage->mBits);
-			delete[] anImage->mBits;
-			anImage->mBits = (uint32_t*)aNewData;
-			anImage->mWidth = aNewWidth;
-			anImage->mHeight = aNewHeight;
-		}
+		// Downscaled packs store every image as png
+		if (anImage == nullptr && !anExt.empty())
+			anImage = TryLoadByExt(aFilename, {});
 	}
+	else if (anImage)
+		DownscaleImage(anImage, IMG_DOWNSCALE);
 #endif
 
 	// Probe alpha images with fast existence check
@@ -32,6 +32,14 @@ extern bool gIgnoreJPEG2000Alpha;  // I've noticed alpha in jpeg2000's that shou
 
 Image* GetImage(const std::string& theFileName, bool lookForAlphaImage = true);
 
+// Shrinks theImage in place by an integer factor with a box filter, byte-identical to RescaleReference
+bool DownscaleImage(Image* theImage, int theFactor);
+unsigned char* RescaleReference(int theWidth, int theHeight, int theNewWidth, int theNewHeight, const unsigned char* theData);
+
+// Data written by pvz-downscale holds this file with the factor its images are already shrunk by
+#define DOWNSCALE_MARKER_FILE "images/downscaled.txt"
+int ReadDownscaleMarker();
+
 //void InitJPEG2000();
 //void CloseJPEG2000();
 //void SetJ2KCodecKey(const std::string& theKey);
@@ -0,0 +1,443 @@
+#include "Common.h"
+#include "PixelKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_KERNELS_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+#define PIXEL_KERNELS_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PIXEL_TARGET_AVX2
+#else
+#define PIXEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#elif (defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)) && !defined(__ARM_BIG_ENDIAN)
+#define PIXEL_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace ImageLib;
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar
+///////////////////////////////////////////////////////////////////////////////
+static inline uint32_t ArgbToRgbaPixel(uint32_t p)
+{
+	return Sexy::ToLE32((p & 0xFF00FF00u) | ((p >> 16) & 0x000000FFu) | ((p << 16) & 0x00FF0000u));
+}
+
+static inline uint16_t ArgbTo4444Pixel(uint32_t p)
+{
+	return static_cast<uint16_t>(((p >> 8) & 0xF000) | ((p >> 4) & 0x0F00) | (p & 0x00F0) | ((p >> 28) & 0x000F));
+}
+
+static inline uint16_t ArgbTo565Pixel(uint32_t p)
+{
+	return static_cast<uint16_t>(((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F));
+}
+
+static void ComposeAlphaScalar(uint32_t* theDst, const uint32_t* theAlpha, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+		theDst[i] = (theDst[i] & 0x00FFFFFF) | ((theAlpha[i] & 0xFF) << 24);
+}
+
+static void AlphaToImageScalar(uint32_t* theDst, uint32_t theBaseColor, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+		theDst[i] = theBaseColor | ((theDst[i] & 0xFF) << 24);
+}
+
+static void ArgbToRgbaScalar(uint32_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+		theDst[i] = ArgbToRgbaPixel(theSrc[i]);
+}
+
+static void ArgbTo4444Scalar(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+		theDst[i] = ArgbTo4444Pixel(theSrc[i]);
+}
+
+static void ArgbTo565Scalar(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+		theDst[i] = ArgbTo565Pixel(theSrc[i]);
+}
+
+// The four channels are summed two at a time in 16-bit lanes, which cannot overflow for four pixels
+static void HalveScalar(uint32_t* theDst, const uint32_t* theRow0, const uint32_t* theRow1, int theCount)
+{
+	for (int i = 0; i < theCount; i++)
+	{
+		uint32_t p0 = theRow0[i * 2], p1 = theRow0[i * 2 + 1], p2 = theRow1[i * 2], p3 = theRow1[i * 2 + 1];
+		uint32_t aEven = (p0 & 0x00FF00FF) + (p1 & 0x00FF00FF) + (p2 & 0x00FF00FF) + (p3 & 0x00FF00FF);
+		uint32_t anOdd = ((p0 >> 8) & 0x00FF00FF) + ((p1 >> 8) & 0x00FF00FF) + ((p2 >> 8) & 0x00FF00FF) + ((p3 >> 8) & 0x00FF00FF);
+		theDst[i] = ((aEven >> 2) & 0x00FF00FF) | ((anOdd << 6) & 0xFF00FF00);
+	}
+}
+
+static const PixelKernels gScalarKernels = {
+	"scalar", ComposeAlphaScalar, AlphaToImageScalar, ArgbToRgbaScalar, ArgbTo4444Scalar, ArgbTo565Scalar, HalveScalar
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2
+///////////////////////////////////////////////////////////////////////////////
+#ifdef PIXEL_KERNELS_SSE2
+
+static void ComposeAlphaSSE2(uint32_t* theDst, const uint32_t* theAlpha, int theCount)
+{
+	const __m128i aColorMask = _mm_set1_epi32(0x00FFFFFF);
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+	{
+		__m128i aDst = _mm_loadu_si128((const __m128i*)(theDst + i));
+		__m128i anAlpha = _mm_loadu_si128((const __m128i*)(theAlpha + i));
+		_mm_storeu_si128((__m128i*)(theDst + i), _mm_or_si128(_mm_and_si128(aDst, aColorMask), _mm_slli_epi32(anAlpha, 24)));
+	}
+	ComposeAlphaScalar(theDst + i, theAlpha + i, theCount - i);
+}
+
+static void AlphaToImageSSE2(uint32_t* theDst, uint32_t theBaseColor, int theCount)
+{
+	const __m128i aBase = _mm_set1_epi32((int)theBaseColor);
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+	{
+		__m128i aDst = _mm_loadu_si128((const __m128i*)(theDst + i));
+		_mm_storeu_si128((__m128i*)(theDst + i), _mm_or_si128(aBase, _mm_slli_epi32(aDst, 24)));
+	}
+	AlphaToImageScalar(theDst + i, theBaseColor, theCount - i);
+}
+
+static inline __m128i ArgbToRgbaSSE2(__m128i p)
+{
+	const __m128i aAGMask = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i aLowMask = _mm_set1_epi32(0x000000FF);
+	const __m128i aRedMask = _mm_set1_epi32(0x00FF0000);
+	return _mm_or_si128(_mm_and_si128(p, aAGMask),
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), aLowMask), _mm_and_si128(_mm_slli_epi32(p, 16), aRedMask)));
+}
+
+static void ArgbToRgbaSSE2(uint32_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+		_mm_storeu_si128((__m128i*)(theDst + i), ArgbToRgbaSSE2(_mm_loadu_si128((const __m128i*)(theSrc + i))));
+	ArgbToRgbaScalar(theDst + i, theSrc + i, theCount - i);
+}
+
+// SSE2 only has a signed 32->16 pack, so the 16-bit results are sign extended first
+static inline __m128i Pack16SSE2(__m128i theLo, __m128i theHi)
+{
+	theLo = _mm_srai_epi32(_mm_slli_epi32(theLo, 16), 16);
+	theHi = _mm_srai_epi32(_mm_slli_epi32(theHi, 16), 16);
+	return _mm_packs_epi32(theLo, theHi);
+}
+
+static inline __m128i ArgbTo4444SSE2(__m128i p)
+{
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF000)), _mm_and_si128(_mm_srli_epi32(p, 4), _mm_set1_epi32(0x0F00))),
+		_mm_or_si128(_mm_and_si128(p, _mm_set1_epi32(0x00F0)), _mm_srli_epi32(p, 28)));
+}
+
+static inline __m128i ArgbTo565SSE2(__m128i p)
+{
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800)), _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0))),
+		_mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F)));
+}
+
+static void ArgbTo4444SSE2(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+	{
+		__m128i aLo = ArgbTo4444SSE2(_mm_loadu_si128((const __m128i*)(theSrc + i)));
+		__m128i aHi = ArgbTo4444SSE2(_mm_loadu_si128((const __m128i*)(theSrc + i + 4)));
+		_mm_storeu_si128((__m128i*)(theDst + i), Pack16SSE2(aLo, aHi));
+	}
+	ArgbTo4444Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+static void ArgbTo565SSE2(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+	{
+		__m128i aLo = ArgbTo565SSE2(_mm_loadu_si128((const __m128i*)(theSrc + i)));
+		__m128i aHi = ArgbTo565SSE2(_mm_loadu_si128((const __m128i*)(theSrc + i + 4)));
+		_mm_storeu_si128((__m128i*)(theDst + i), Pack16SSE2(aLo, aHi));
+	}
+	ArgbTo565Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+static void HalveSSE2(uint32_t* theDst, const uint32_t* theRow0, const uint32_t* theRow1, int theCount)
+{
+	const __m128i aZero = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+	{
+		__m128i aTop0 = _mm_loadu_si128((const __m128i*)(theRow0 + i * 2));
+		__m128i aTop1 = _mm_loadu_si128((const __m128i*)(theRow0 + i * 2 + 4));
+		__m128i aBottom0 = _mm_loadu_si128((const __m128i*)(theRow1 + i * 2));
+		__m128i aBottom1 = _mm_loadu_si128((const __m128i*)(theRow1 + i * 2 + 4));
+
+		// column sums with 16 bits per channel, two source pixels per register
+		__m128i aSum01 = _mm_add_epi16(_mm_unpacklo_epi8(aTop0, aZero), _mm_unpacklo_epi8(aBottom0, aZero));
+		__m128i aSum23 = _mm_add_epi16(_mm_unpackhi_epi8(aTop0, aZero), _mm_unpackhi_epi8(aBottom0, aZero));
+		__m128i aSum45 = _mm_add_epi16(_mm_unpacklo_epi8(aTop1, aZero), _mm_unpacklo_epi8(aBottom1, aZero));
+		__m128i aSum67 = _mm_add_epi16(_mm_unpackhi_epi8(aTop1, aZero), _mm_unpackhi_epi8(aBottom1, aZero));
+
+		// add neighbouring columns: even pixels from the low halves, odd pixels from the high halves
+		__m128i aLo = _mm_add_epi16(_mm_unpacklo_epi64(aSum01, aSum23), _mm_unpackhi_epi64(aSum01, aSum23));
+		__m128i aHi = _mm_add_epi16(_mm_unpacklo_epi64(aSum45, aSum67), _mm_unpackhi_epi64(aSum45, aSum67));
+		_mm_storeu_si128((__m128i*)(theDst + i), _mm_packus_epi16(_mm_srli_epi16(aLo, 2), _mm_srli_epi16(aHi, 2)));
+	}
+	HalveScalar(theDst + i, theRow0 + i * 2, theRow1 + i * 2, theCount - i);
+}
+
+static const PixelKernels gSSE2Kernels = {
+	"sse2", ComposeAlphaSSE2, AlphaToImageSSE2, ArgbToRgbaSSE2, ArgbTo4444SSE2, ArgbTo565SSE2, HalveSSE2
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2
+///////////////////////////////////////////////////////////////////////////////
+#ifdef PIXEL_KERNELS_AVX2
+
+PIXEL_TARGET_AVX2 static void ComposeAlphaAVX2(uint32_t* theDst, const uint32_t* theAlpha, int theCount)
+{
+	const __m256i aColorMask = _mm256_set1_epi32(0x00FFFFFF);
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+	{
+		__m256i aDst = _mm256_loadu_si256((const __m256i*)(theDst + i));
+		__m256i anAlpha = _mm256_loadu_si256((const __m256i*)(theAlpha + i));
+		_mm256_storeu_si256((__m256i*)(theDst + i), _mm256_or_si256(_mm256_and_si256(aDst, aColorMask), _mm256_slli_epi32(anAlpha, 24)));
+	}
+	ComposeAlphaScalar(theDst + i, theAlpha + i, theCount - i);
+}
+
+PIXEL_TARGET_AVX2 static void AlphaToImageAVX2(uint32_t* theDst, uint32_t theBaseColor, int theCount)
+{
+	const __m256i aBase = _mm256_set1_epi32((int)theBaseColor);
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+	{
+		__m256i aDst = _mm256_loadu_si256((const __m256i*)(theDst + i));
+		_mm256_storeu_si256((__m256i*)(theDst + i), _mm256_or_si256(aBase, _mm256_slli_epi32(aDst, 24)));
+	}
+	AlphaToImageScalar(theDst + i, theBaseColor, theCount - i);
+}
+
+PIXEL_TARGET_AVX2 static void ArgbToRgbaAVX2(uint32_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	// swap bytes 0 and 2 of every pixel
+	const __m256i aShuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+		_mm256_storeu_si256((__m256i*)(theDst + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(theSrc + i)), aShuffle));
+	ArgbToRgbaScalar(theDst + i, theSrc + i, theCount - i);
+}
+
+PIXEL_TARGET_AVX2 static inline __m256i ArgbTo4444AVX2(__m256i p)
+{
+	return _mm256_or_si256(
+		_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xF000)), _mm256_and_si256(_mm256_srli_epi32(p, 4), _mm256_set1_epi32(0x0F00))),
+		_mm256_or_si256(_mm256_and_si256(p, _mm256_set1_epi32(0x00F0)), _mm256_srli_epi32(p, 28)));
+}
+
+PIXEL_TARGET_AVX2 static inline __m256i ArgbTo565AVX2(__m256i p)
+{
+	return _mm256_or_si256(
+		_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xF800)), _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07E0))),
+		_mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001F)));
+}
+
+// packus works per 128-bit lane, the permute puts the pixels back in order
+PIXEL_TARGET_AVX2 static inline __m256i Pack16AVX2(__m256i theLo, __m256i theHi)
+{
+	return _mm256_permute4x64_epi64(_mm256_packus_epi32(theLo, theHi), 0xD8);
+}
+
+PIXEL_TARGET_AVX2 static void ArgbTo4444AVX2(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 16 <= theCount; i += 16)
+	{
+		__m256i aLo = ArgbTo4444AVX2(_mm256_loadu_si256((const __m256i*)(theSrc + i)));
+		__m256i aHi = ArgbTo4444AVX2(_mm256_loadu_si256((const __m256i*)(theSrc + i + 8)));
+		_mm256_storeu_si256((__m256i*)(theDst + i), Pack16AVX2(aLo, aHi));
+	}
+	ArgbTo4444Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+PIXEL_TARGET_AVX2 static void ArgbTo565AVX2(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 16 <= theCount; i += 16)
+	{
+		__m256i aLo = ArgbTo565AVX2(_mm256_loadu_si256((const __m256i*)(theSrc + i)));
+		__m256i aHi = ArgbTo565AVX2(_mm256_loadu_si256((const __m256i*)(theSrc + i + 8)));
+		_mm256_storeu_si256((__m256i*)(theDst + i), Pack16AVX2(aLo, aHi));
+	}
+	ArgbTo565Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+// halving is bound by memory bandwidth, so AVX2 shares the SSE2 version
+static const PixelKernels gAVX2Kernels = {
+	"avx2", ComposeAlphaAVX2, AlphaToImageAVX2, ArgbToRgbaAVX2, ArgbTo4444AVX2, ArgbTo565AVX2, HalveSSE2
+};
+
+static bool CPUHasAVX2()
+{
+#ifdef _MSC_VER
+	int anInfo[4];
+	__cpuid(anInfo, 0);
+	if (anInfo[0] < 7)
+		return false;
+	__cpuid(anInfo, 1);
+	bool anOSXSave = (anInfo[2] & (1 << 27)) != 0;
+	bool anAVX = (anInfo[2] & (1 << 28)) != 0;
+	if (!anOSXSave || !anAVX || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(anInfo, 7, 0);
+	return (anInfo[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// NEON
+///////////////////////////////////////////////////////////////////////////////
+#ifdef PIXEL_KERNELS_NEON
+
+static void ComposeAlphaNEON(uint32_t* theDst, const uint32_t* theAlpha, int theCount)
+{
+	const uint32x4_t aColorMask = vdupq_n_u32(0x00FFFFFF);
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+		vst1q_u32(theDst + i, vorrq_u32(vandq_u32(vld1q_u32(theDst + i), aColorMask), vshlq_n_u32(vld1q_u32(theAlpha + i), 24)));
+	ComposeAlphaScalar(theDst + i, theAlpha + i, theCount - i);
+}
+
+static void AlphaToImageNEON(uint32_t* theDst, uint32_t theBaseColor, int theCount)
+{
+	const uint32x4_t aBase = vdupq_n_u32(theBaseColor);
+	int i = 0;
+	for (; i + 4 <= theCount; i += 4)
+		vst1q_u32(theDst + i, vorrq_u32(aBase, vshlq_n_u32(vld1q_u32(theDst + i), 24)));
+	AlphaToImageScalar(theDst + i, theBaseColor, theCount - i);
+}
+
+static void ArgbToRgbaNEON(uint32_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 16 <= theCount; i += 16)
+	{
+		// de-interleave into B, G, R, A planes and store them back with R and B swapped
+		uint8x16x4_t aPixels = vld4q_u8((const uint8_t*)(theSrc + i));
+		uint8x16_t aBlue = aPixels.val[0];
+		aPixels.val[0] = aPixels.val[2];
+		aPixels.val[2] = aBlue;
+		vst4q_u8((uint8_t*)(theDst + i), aPixels);
+	}
+	ArgbToRgbaScalar(theDst + i, theSrc + i, theCount - i);
+}
+
+static inline uint16x4_t ArgbTo4444NEON(uint32x4_t p)
+{
+	uint32x4_t aResult = vorrq_u32(
+		vorrq_u32(vandq_u32(vshrq_n_u32(p, 8), vdupq_n_u32(0xF000)), vandq_u32(vshrq_n_u32(p, 4), vdupq_n_u32(0x0F00))),
+		vorrq_u32(vandq_u32(p, vdupq_n_u32(0x00F0)), vshrq_n_u32(p, 28)));
+	return vmovn_u32(aResult);
+}
+
+static inline uint16x4_t ArgbTo565NEON(uint32x4_t p)
+{
+	uint32x4_t aResult = vorrq_u32(
+		vorrq_u32(vandq_u32(vshrq_n_u32(p, 8), vdupq_n_u32(0xF800)), vandq_u32(vshrq_n_u32(p, 5), vdupq_n_u32(0x07E0))),
+		vandq_u32(vshrq_n_u32(p, 3), vdupq_n_u32(0x001F)));
+	return vmovn_u32(aResult);
+}
+
+static void ArgbTo4444NEON(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+		vst1q_u16(theDst + i, vcombine_u16(ArgbTo4444NEON(vld1q_u32(theSrc + i)), ArgbTo4444NEON(vld1q_u32(theSrc + i + 4))));
+	ArgbTo4444Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+static void ArgbTo565NEON(uint16_t* theDst, const uint32_t* theSrc, int theCount)
+{
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+		vst1q_u16(theDst + i, vcombine_u16(ArgbTo565NEON(vld1q_u32(theSrc + i)), ArgbTo565NEON(vld1q_u32(theSrc + i + 4))));
+	ArgbTo565Scalar(theDst + i, theSrc + i, theCount - i);
+}
+
+static void HalveNEON(uint32_t* theDst, const uint32_t* theRow0, const uint32_t* theRow1, int theCount)
+{
+	int i = 0;
+	for (; i + 8 <= theCount; i += 8)
+	{
+		// one plane per channel; pairwise add the top row, accumulate the bottom row, then narrow
+		uint8x16x4_t aTop = vld4q_u8((const uint8_t*)(theRow0 + i * 2));
+		uint8x16x4_t aBottom = vld4q_u8((const uint8_t*)(theRow1 + i * 2));
+		uint8x8x4_t aResult;
+		for (int c = 0; c < 4; c++)
+			aResult.val[c] = vshrn_n_u16(vpadalq_u8(vpaddlq_u8(aTop.val[c]), aBottom.val[c]), 2);
+		vst4_u8((uint8_t*)(theDst + i), aResult);
+	}
+	HalveScalar(theDst + i, theRow0 + i * 2, theRow1 + i * 2, theCount - i);
+}
+
+static const PixelKernels gNEONKernels = {
+	"neon", ComposeAlphaNEON, AlphaToImageNEON, ArgbToRgbaNEON, ArgbTo4444NEON, ArgbTo565NEON, HalveNEON
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+std::vector<const PixelKernels*> ImageLib::GetAvailablePixelKernels()
+{
+	std::vector<const PixelKernels*> aKernels = { &gScalarKernels };
+#ifdef PIXEL_KERNELS_SSE2
+	aKernels.push_back(&gSSE2Kernels);
+#endif
+#ifdef PIXEL_KERNELS_AVX2
+	if (CPUHasAVX2())
+		aKernels.push_back(&gAVX2Kernels);
+#endif
+#ifdef PIXEL_KERNELS_NEON
+	aKernels.push_back(&gNEONKernels);
+#endif
+	return aKernels;
+}
+
+const PixelKernels& ImageLib::GetPixelKernels()
+{
+	static const PixelKernels* aBest = GetAvailablePixelKernels().back();
+	return *aBest;
+}
+
+const PixelKernels& ImageLib::GetScalarPixelKernels()
+{
+	return gScalarKernels;
+}
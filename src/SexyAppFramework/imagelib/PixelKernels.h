@@ -0,0 +1,36 @@
+#ifndef __PIXELKERNELS_H__
+#define __PIXELKERNELS_H__
+
+#include <cstdint>
+#include <vector>
+
+namespace ImageLib
+{
+
+// Row kernels for the per-pixel loops of image loading and texture upload.
+// Every variant produces exactly the same output as the scalar one.
+struct PixelKernels
+{
+	const char*				mName;
+
+	// theDst alpha = blue channel of theAlpha
+	void					(*mComposeAlpha)(uint32_t* theDst, const uint32_t* theAlpha, int theCount);
+	// theDst = theBaseColor with alpha taken from the blue channel of theDst
+	void					(*mAlphaToImage)(uint32_t* theDst, uint32_t theBaseColor, int theCount);
+	// ARGB to the byte order GL_RGBA/GL_UNSIGNED_BYTE expects
+	void					(*mArgbToRgba)(uint32_t* theDst, const uint32_t* theSrc, int theCount);
+	// ARGB to GL_UNSIGNED_SHORT_4_4_4_4 (RGBA)
+	void					(*mArgbTo4444)(uint16_t* theDst, const uint32_t* theSrc, int theCount);
+	// ARGB to GL_UNSIGNED_SHORT_5_6_5
+	void					(*mArgbTo565)(uint16_t* theDst, const uint32_t* theSrc, int theCount);
+	// 2x2 box average of two source rows into theCount pixels, every channel rounded down
+	void					(*mHalve)(uint32_t* theDst, const uint32_t* theRow0, const uint32_t* theRow1, int theCount);
+};
+
+const PixelKernels&					GetPixelKernels();				// fastest variant this CPU supports
+const PixelKernels&					GetScalarPixelKernels();
+std::vector<const PixelKernels*>	GetAvailablePixelKernels();		// scalar first
+
+}
+
+#endif //__PIXELKERNELS_H__
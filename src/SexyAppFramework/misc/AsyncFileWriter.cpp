@@ -0,0 +1,287 @@
+#include "AsyncFileWriter.h"
+#include "Common.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#elif !defined(__SWITCH__) && !defined(__3DS__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Sexy;
+
+AsyncFileWriter::AsyncFileWriter()
+{
+	mQuit = false;
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	{
+		std::scoped_lock aLock(mLock);
+		mQuit = true;
+	}
+	mCondition.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+}
+
+void AsyncFileWriter::ThreadProc()
+{
+	std::unique_lock<std::mutex> aLock(mLock);
+	for (;;)
+	{
+		mCondition.wait(aLock, [this]() { return mQuit || !mQueue.empty(); });
+		if (mQueue.empty())
+			return;
+
+		// The job stays at the front of the queue while it is written so that WaitForFile sees it;
+		// deque references survive push_back from other threads.
+		Job& aJob = mQueue.front();
+		aLock.unlock();
+		aJob.mSuccess = (!aJob.mPrepare || aJob.mPrepare(aJob.mData)) && WriteFileAtomic(aJob.mFileName, aJob.mData.data(), aJob.mData.size());
+		aLock.lock();
+
+		if (aJob.mDone)
+		{
+			aJob.mData.clear();
+			aJob.mData.shrink_to_fit();
+			mCompleted.push_back(std::move(aJob));
+		}
+		mQueue.pop_front();
+		mCondition.notify_all();
+	}
+}
+
+bool AsyncFileWriter::IsQueued(const std::string& theFileName)
+{
+	for (const Job& aJob : mQueue)
+		if (aJob.mFileName == theFileName)
+			return true;
+	return false;
+}
+
+// A file that is still waiting in the queue only gets the newest data: the queued job takes it over,
+// and the DoneFuncs of both writes run once it is written. The front job is being written and is left alone.
+void AsyncFileWriter::Write(const std::string& theFileName, std::vector<unsigned char> theData, PrepareFunc thePrepare, DoneFunc theDone)
+{
+	{
+		std::scoped_lock aLock(mLock);
+		for (size_t i = 1; i < mQueue.size(); i++)
+		{
+			Job& aJob = mQueue[i];
+			if (aJob.mFileName != theFileName)
+				continue;
+
+			aJob.mData = std::move(theData);
+			aJob.mPrepare = std::move(thePrepare);
+			if (aJob.mDone && theDone)
+				aJob.mDone = [anOldDone = std::move(aJob.mDone), aNewDone = std::move(theDone)](bool theSuccess) { anOldDone(theSuccess); aNewDone(theSuccess); };
+			else if (theDone)
+				aJob.mDone = std::move(theDone);
+			return;
+		}
+
+		mQueue.push_back(Job{ theFileName, std::move(theData), std::move(thePrepare), std::move(theDone), false });
+		if (!mThread.joinable())
+			mThread = std::thread(&AsyncFileWriter::ThreadProc, this);
+	}
+	mCondition.notify_all();
+}
+
+void AsyncFileWriter::WaitForFile(const std::string& theFileName)
+{
+	std::unique_lock<std::mutex> aLock(mLock);
+	mCondition.wait(aLock, [&]() { return !IsQueued(theFileName); });
+}
+
+void AsyncFileWriter::Flush()
+{
+	std::unique_lock<std::mutex> aLock(mLock);
+	mCondition.wait(aLock, [this]() { return mQueue.empty(); });
+}
+
+int AsyncFileWriter::GetNumPending()
+{
+	std::scoped_lock aLock(mLock);
+	return (int)mQueue.size();
+}
+
+void AsyncFileWriter::DispatchCompletions()
+{
+	std::vector<Job> aCompleted;
+	{
+		std::scoped_lock aLock(mLock);
+		if (mCompleted.empty())
+			return;
+		aCompleted.swap(mCompleted);
+	}
+	for (Job& aJob : aCompleted)
+		aJob.mDone(aJob.mSuccess);
+}
+
+static FILE* OpenForWrite(const std::filesystem::path& thePath, bool theAppend = false)
+{
+#ifdef _WIN32
+	return _wfopen(thePath.c_str(), theAppend ? L"ab" : L"wb");
+#else
+	return fopen(thePath.c_str(), theAppend ? "ab" : "wb");
+#endif
+}
+
+// Pushes the file contents to the storage device, not just to the OS cache
+static bool SyncFile(FILE* theFile)
+{
+	if (fflush(theFile) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(theFile)) == 0;
+#elif defined(__SWITCH__) || defined(__3DS__)
+	return true;
+#else
+	return fsync(fileno(theFile)) == 0;
+#endif
+}
+
+// Makes the rename itself durable; only needed (and possible) on POSIX file systems
+static void SyncDir(const std::filesystem::path& theDir)
+{
+#if !defined(_WIN32) && !defined(__SWITCH__) && !defined(__3DS__)
+	int aFd = open(theDir.empty() ? "." : theDir.c_str(), O_RDONLY);
+	if (aFd >= 0)
+	{
+		fsync(aFd);
+		close(aFd);
+	}
+#else
+	(void)theDir;
+#endif
+}
+
+bool AsyncFileWriter::WriteFileAtomic(const std::string& theFileName, const void* theData, size_t theDataLen)
+{
+	return WriteFileAtomicSteps(theFileName, theData, theDataLen, INT_MAX);
+}
+
+// Appends theData to theFileName and syncs it, for journals that are only ever appended to. A crash during the
+// append can leave part of theData at the end of the file, so the reader has to detect a torn tail.
+bool AsyncFileWriter::AppendFileSynced(const std::string& theFileName, const void* theData, size_t theDataLen)
+{
+	std::filesystem::path aPath = PathFromU8(theFileName);
+	std::error_code anError;
+	bool aIsNew = !std::filesystem::exists(aPath, anError);
+	FILE* aFile = OpenForWrite(aPath, true);
+	if (!aFile)
+		return false;
+
+	bool aSuccess = fwrite(theData, 1, theDataLen, aFile) == theDataLen && SyncFile(aFile);
+	aSuccess = fclose(aFile) == 0 && aSuccess;
+	if (aSuccess && aIsNew)
+		SyncDir(aPath.parent_path());
+	return aSuccess;
+}
+
+// Write temp, sync, rename over the target, sync the directory. theNumSteps stops the sequence early
+// to simulate a crash (see TestCrashSafety); the return value then says whether all steps ran.
+bool AsyncFileWriter::WriteFileAtomicSteps(const std::string& theFileName, const void* theData, size_t theDataLen, int theNumSteps)
+{
+	MkDir(GetFileDir(theFileName));
+
+	std::filesystem::path aPath = PathFromU8(theFileName);
+	std::filesystem::path aTempPath = PathFromU8(theFileName + ".tmp");
+	std::error_code anError;
+	{
+		FILE* aFile = OpenForWrite(aTempPath);
+		if (!aFile)
+			return false;
+
+		size_t aHalfLen = theNumSteps <= WRITE_STEP_PARTIAL ? theDataLen / 2 : theDataLen;
+		bool aSuccess = fwrite(theData, 1, aHalfLen, aFile) == aHalfLen;
+		if (aSuccess && theNumSteps <= WRITE_STEP_PARTIAL)
+		{
+			fflush(aFile);
+			fclose(aFile);
+			return false;
+		}
+		aSuccess = aSuccess && SyncFile(aFile);
+		aSuccess = fclose(aFile) == 0 && aSuccess;
+		if (!aSuccess)
+		{
+			std::filesystem::remove(aTempPath, anError);
+			return false;
+		}
+	}
+	if (theNumSteps <= WRITE_STEP_SYNCED)
+		return false;
+
+	std::filesystem::rename(aTempPath, aPath, anError);
+	if (anError)
+	{
+		std::filesystem::remove(aTempPath, anError);
+		return false;
+	}
+	if (theNumSteps <= WRITE_STEP_RENAMED)
+		return false;
+
+	SyncDir(aPath.parent_path());
+	return true;
+}
+
+static bool FileEquals(const std::string& theFileName, const std::string& theData)
+{
+	std::ifstream aFile(PathFromU8(theFileName), std::ios::in | std::ios::binary);
+	if (!aFile)
+		return false;
+	std::string aContents((std::istreambuf_iterator<char>(aFile)), std::istreambuf_iterator<char>());
+	return aContents == theData;
+}
+
+// Interrupts a replacement after every step and checks that the target then holds either the complete old
+// or the complete new data, and that the next write recovers. Also checks that queued writes to one file
+// coalesce into the newest data. Returns the number of failed checks; everything is reported on stdout.
+int AsyncFileWriter::TestCrashSafety(const std::string& theDir)
+{
+	std::string aFileName = theDir + "/crashtest.dat";
+	std::string anOldData(4096, 'o');
+	std::string aNewData(6000, 'n');
+	int aNumFailed = 0;
+
+	for (int aStep = WRITE_STEP_PARTIAL; aStep <= NUM_WRITE_STEPS; aStep++)
+	{
+		bool aOk = WriteFileAtomic(aFileName, anOldData.data(), anOldData.size());
+		WriteFileAtomicSteps(aFileName, aNewData.data(), aNewData.size(), aStep);
+		const std::string& anExpected = aStep < WRITE_STEP_RENAMED ? anOldData : aNewData;
+		aOk = aOk && FileEquals(aFileName, anExpected);
+		// the next run must be able to write over whatever the crash left behind
+		aOk = aOk && WriteFileAtomic(aFileName, aNewData.data(), aNewData.size()) && FileEquals(aFileName, aNewData);
+		printf("crash test: stop after step %d: %s\n", aStep, aOk ? "ok" : "FAILED");
+		if (!aOk)
+			aNumFailed++;
+	}
+
+	{
+		AsyncFileWriter aWriter;
+		int aNumDone = 0;
+		for (int i = 0; i < 50; i++)
+		{
+			std::string aData = StrFormat("write %d", i);
+			aWriter.Write(aFileName, std::vector<unsigned char>(aData.begin(), aData.end()), nullptr, [&aNumDone](bool) { aNumDone++; });
+		}
+		aWriter.Flush();
+		aWriter.DispatchCompletions();
+		bool aOk = FileEquals(aFileName, "write 49") && aNumDone == 50;
+		printf("crash test: coalesced writes: %s\n", aOk ? "ok" : "FAILED");
+		if (!aOk)
+			aNumFailed++;
+	}
+
+	std::error_code anError;
+	std::filesystem::remove(PathFromU8(aFileName), anError);
+	std::filesystem::remove(PathFromU8(aFileName + ".tmp"), anError);
+	return aNumFailed;
+}
@@ -0,0 +1,72 @@
+#ifndef __ASYNCFILEWRITER_H__
+#define __ASYNCFILEWRITER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Sexy
+{
+
+// Writes files on a background thread, in the order they were submitted. Every file is
+// written under a temporary name, synced and then renamed over the target, so an interrupted
+// write leaves the previous version intact. Repeated writes of a queued file are coalesced.
+class AsyncFileWriter
+{
+public:
+	// Runs on the I/O thread just before the data is written (checksums, compression); returning false fails the write
+	typedef std::function<bool(std::vector<unsigned char>& theData)> PrepareFunc;
+	// Runs on the thread that calls DispatchCompletions(), normally the main thread
+	typedef std::function<void(bool theSuccess)> DoneFunc;
+
+protected:
+	struct Job
+	{
+		std::string					mFileName;
+		std::vector<unsigned char>	mData;
+		PrepareFunc					mPrepare;
+		DoneFunc					mDone;
+		bool						mSuccess;
+	};
+
+	std::thread					mThread;
+	std::mutex					mLock;
+	std::condition_variable		mCondition;
+	std::deque<Job>				mQueue;				// the front job is the one being written
+	std::vector<Job>			mCompleted;			// finished jobs with a DoneFunc
+	bool						mQuit;
+
+	enum
+	{
+		WRITE_STEP_PARTIAL = 1,		// half of the temporary file written
+		WRITE_STEP_SYNCED,			// temporary file complete and synced
+		WRITE_STEP_RENAMED,			// renamed over the target
+		NUM_WRITE_STEPS
+	};
+
+	void						ThreadProc();
+	bool						IsQueued(const std::string& theFileName);
+	static bool					WriteFileAtomicSteps(const std::string& theFileName, const void* theData, size_t theDataLen, int theNumSteps);
+
+public:
+	AsyncFileWriter();
+	virtual ~AsyncFileWriter();						// finishes every queued write
+
+	void						Write(const std::string& theFileName, std::vector<unsigned char> theData, PrepareFunc thePrepare = nullptr, DoneFunc theDone = nullptr);
+	void						WaitForFile(const std::string& theFileName);	// blocks while theFileName has a queued write
+	void						Flush();
+	int							GetNumPending();
+	void						DispatchCompletions();
+
+	static bool					WriteFileAtomic(const std::string& theFileName, const void* theData, size_t theDataLen);
+	static bool					AppendFileSynced(const std::string& theFileName, const void* theData, size_t theDataLen);
+	static int					TestCrashSafety(const std::string& theDir);
+};
+
+}
+
+#endif //__ASYNCFILEWRITER_H__
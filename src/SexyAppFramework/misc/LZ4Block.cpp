@@ -0,0 +1,200 @@
+#include "LZ4Block.h"
+#include "Common.h"
+#include <cstdint>
+#include <cstring>
+
+using namespace Sexy;
+
+static const int LZ4_MIN_MATCH = 4;
+static const int LZ4_LAST_LITERALS = 5;		// the last 5 bytes are always literals
+static const int LZ4_MF_LIMIT = 12;			// the last match must start at least 12 bytes before the end
+static const int LZ4_MAX_OFFSET = 65535;
+static const int LZ4_HASH_LOG = 12;
+
+// Read as little-endian so the hash, and so the chosen matches, are the same on every host; the converter
+// script relies on producing byte-identical blocks
+static inline uint32_t LZ4Read32(const unsigned char* thePtr)
+{
+	uint32_t aValue;
+	memcpy(&aValue, thePtr, sizeof(aValue));
+	return FromLE32(aValue);
+}
+
+static inline uint32_t LZ4Hash(uint32_t theValue)
+{
+	return (theValue * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline unsigned char* LZ4WriteLength(unsigned char* theDest, int theLength)
+{
+	while (theLength >= 255)
+	{
+		*theDest++ = 255;
+		theLength -= 255;
+	}
+	*theDest++ = (unsigned char)theLength;
+	return theDest;
+}
+
+int Sexy::LZ4CompressBound(int theSize)
+{
+	return theSize + theSize / 255 + 16;
+}
+
+int Sexy::LZ4Compress(const unsigned char* theSource, int theSourceSize, unsigned char* theDest, int theDestCapacity)
+{
+	if (theSourceSize < 0 || theDestCapacity < LZ4CompressBound(theSourceSize))
+		return 0;
+
+	unsigned char* anOut = theDest;
+	int anAnchor = 0;
+
+	if (theSourceSize > LZ4_MF_LIMIT)
+	{
+		int aHashTable[1 << LZ4_HASH_LOG];
+		for (int& anEntry : aHashTable)
+			anEntry = -1;
+
+		const int aMatchStartLimit = theSourceSize - LZ4_MF_LIMIT;
+		const int aMatchEndLimit = theSourceSize - LZ4_LAST_LITERALS;
+		int aPos = 0;
+		while (aPos < aMatchStartLimit)
+		{
+			uint32_t aSequence = LZ4Read32(theSource + aPos);
+			uint32_t aHash = LZ4Hash(aSequence);
+			int aRef = aHashTable[aHash];
+			aHashTable[aHash] = aPos;
+			if (aRef < 0 || aPos - aRef > LZ4_MAX_OFFSET || LZ4Read32(theSource + aRef) != aSequence)
+			{
+				aPos++;
+				continue;
+			}
+
+			while (aPos > anAnchor && aRef > 0 && theSource[aPos - 1] == theSource[aRef - 1])
+			{
+				aPos--;
+				aRef--;
+			}
+			int aMatchLen = LZ4_MIN_MATCH;
+			while (aPos + aMatchLen < aMatchEndLimit && theSource[aPos + aMatchLen] == theSource[aRef + aMatchLen])
+				aMatchLen++;
+
+			int aLiteralLen = aPos - anAnchor;
+			unsigned char* aToken = anOut++;
+			if (aLiteralLen >= 15)
+			{
+				*aToken = 15 << 4;
+				anOut = LZ4WriteLength(anOut, aLiteralLen - 15);
+			}
+			else
+				*aToken = (unsigned char)(aLiteralLen << 4);
+			memcpy(anOut, theSource + anAnchor, aLiteralLen);
+			anOut += aLiteralLen;
+
+			int anOffset = aPos - aRef;
+			*anOut++ = (unsigned char)(anOffset & 0xFF);
+			*anOut++ = (unsigned char)(anOffset >> 8);
+
+			int aLenCode = aMatchLen - LZ4_MIN_MATCH;
+			if (aLenCode >= 15)
+			{
+				*aToken |= 15;
+				anOut = LZ4WriteLength(anOut, aLenCode - 15);
+			}
+			else
+				*aToken |= (unsigned char)aLenCode;
+
+			aPos += aMatchLen;
+			anAnchor = aPos;
+			if (aPos - 2 > 0 && aPos - 2 < aMatchStartLimit)
+				aHashTable[LZ4Hash(LZ4Read32(theSource + aPos - 2))] = aPos - 2;
+		}
+	}
+
+	// last literals
+	int aLiteralLen = theSourceSize - anAnchor;
+	if (aLiteralLen >= 15)
+	{
+		*anOut++ = 15 << 4;
+		anOut = LZ4WriteLength(anOut, aLiteralLen - 15);
+	}
+	else
+		*anOut++ = (unsigned char)(aLiteralLen << 4);
+	if (aLiteralLen > 0)  // theSource may be null for empty input
+		memcpy(anOut, theSource + anAnchor, aLiteralLen);
+	anOut += aLiteralLen;
+
+	return (int)(anOut - theDest);
+}
+
+int Sexy::LZ4Decompress(const unsigned char* theSource, int theSourceSize, unsigned char* theDest, int theDestSize)
+{
+	const unsigned char* anIn = theSource;
+	const unsigned char* anInEnd = theSource + theSourceSize;
+	unsigned char* anOut = theDest;
+	unsigned char* anOutEnd = theDest + theDestSize;
+
+	while (anIn < anInEnd)
+	{
+		unsigned int aToken = *anIn++;
+
+		size_t aLiteralLen = aToken >> 4;
+		if (aLiteralLen == 15)
+		{
+			unsigned int aByte;
+			do
+			{
+				if (anIn >= anInEnd)
+					return -1;
+				aByte = *anIn++;
+				aLiteralLen += aByte;
+			} while (aByte == 255);
+		}
+		if (aLiteralLen > (size_t)(anInEnd - anIn) || aLiteralLen > (size_t)(anOutEnd - anOut))
+			return -1;
+		if (aLiteralLen > 0)  // theDest may be null for empty output
+			memcpy(anOut, anIn, aLiteralLen);
+		anIn += aLiteralLen;
+		anOut += aLiteralLen;
+
+		if (anIn == anInEnd)  // the last sequence has no match part
+			break;
+
+		if (anInEnd - anIn < 2)
+			return -1;
+		size_t anOffset = anIn[0] | (anIn[1] << 8);
+		anIn += 2;
+		if (anOffset == 0 || anOffset > (size_t)(anOut - theDest))
+			return -1;
+
+		size_t aMatchLen = aToken & 15;
+		if (aMatchLen == 15)
+		{
+			unsigned int aByte;
+			do
+			{
+				if (anIn >= anInEnd)
+					return -1;
+				aByte = *anIn++;
+				aMatchLen += aByte;
+			} while (aByte == 255);
+		}
+		aMatchLen += LZ4_MIN_MATCH;
+		if (aMatchLen > (size_t)(anOutEnd - anOut))
+			return -1;
+
+		const unsigned char* aMatch = anOut - anOffset;
+		if (anOffset >= aMatchLen)
+		{
+			memcpy(anOut, aMatch, aMatchLen);
+			anOut += aMatchLen;
+		}
+		else
+		{
+			for (size_t i = 0; i < aMatchLen; i++)  // overlapping copy repeats the pattern
+				*anOut++ = aMatch[i];
+		}
+	}
+
+	return (int)(anOut - theDest);
+}
@@ -0,0 +1,21 @@
+#ifndef __SEXY_LZ4BLOCK_H__
+#define __SEXY_LZ4BLOCK_H__
+
+// Minimal LZ4 block format codec (no frame header, no checksum).
+// Output is compatible with LZ4_decompress_safe; the encoder is a simple
+// single-probe greedy matcher tuned for decode speed, not ratio.
+
+namespace Sexy
+{
+
+int LZ4CompressBound(int theSize);
+
+// Returns the compressed size, or 0 if theDestCapacity is smaller than LZ4CompressBound(theSourceSize).
+int LZ4Compress(const unsigned char* theSource, int theSourceSize, unsigned char* theDest, int theDestCapacity);
+
+// Returns the decompressed size, or -1 if the input is malformed or does not fit in theDestSize bytes.
+int LZ4Decompress(const unsigned char* theSource, int theSourceSize, unsigned char* theDest, int theDestSize);
+
+}
+
+#endif //__SEXY_LZ4BLOCK_H__
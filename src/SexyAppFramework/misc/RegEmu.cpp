@@ -2,13 +2,32 @@
 
 #include "RegEmu.h"
 #include "Common.h"
+#include "AsyncFileWriter.h"
 
 #include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <filesystem>
+#include <vector>
+#include "zlib.h"
 
 #define REGEMU_VERSION 1
+#define REGEMU_FLUSH_DELAY_MS 500		// changes are written once the registry has been idle this long...
+#define REGEMU_FLUSH_MAX_DELAY_MS 5000	// ...or this long after the first unwritten change
+#define REGEMU_COMPACT_SIZE 65536		// journal size at which the registry file is rewritten
+
+// Changes are first collected in memory, then appended to "<file>.journal" as one checksummed batch.
+// The journal is replayed on load, and folded back into the registry file when it grows large or at Sync().
+enum
+{
+	JOURNAL_WRITE_VALUE = 1,
+	JOURNAL_ERASE_VALUE,
+	JOURNAL_ERASE_KEY
+};
 
 struct RegValue
 {
@@ -19,58 +38,279 @@ struct RegValue
 typedef std::map<std::string, std::map<std::string, RegValue> > RegContents;
 static RegContents registry;
 static std::string currFile;
+static std::mutex registryLock;			// writes can come from loading threads
 
-static void SaveToFile()
+typedef std::chrono::steady_clock RegClock;
+static std::set<std::pair<std::string, std::string> > dirtyValues;
+static std::set<std::string> erasedKeys;
+static bool dirty = false;
+static RegClock::time_point firstDirtyTime;
+static RegClock::time_point lastDirtyTime;
+static size_t journalSize = 0;
+
+static std::string GetJournalFile()
 {
-	if (currFile.empty())
-	{
-		printf("RegEmu: Filename not specified, can't save\n");
-		return;
-	}
+	return currFile + ".journal";
+}
 
-	std::ofstream f(Sexy::PathFromU8(currFile), std::ios::binary);
-	if (!f)
+static void SerializeRegistry(std::vector<unsigned char>& theData)
+{
+	auto aWrite = [&theData](const void* theBytes, size_t theLen)
 	{
-		printf("RegEmu: Couldn't open '%s' for writing\n", currFile.c_str());
-		return;
-	}
+		theData.insert(theData.end(), static_cast<const unsigned char*>(theBytes), static_cast<const unsigned char*>(theBytes) + theLen);
+	};
 
-	f.write("REGEMU", 6);
+	aWrite("REGEMU", 6);
 
 	uint16_t aVersion = REGEMU_VERSION;
-	f.write(reinterpret_cast<const char*>(&aVersion), sizeof(uint16_t));
+	aWrite(&aVersion, sizeof(uint16_t));
 
 	uint32_t aNumKeys = registry.size();
-	f.write(reinterpret_cast<const char*>(&aNumKeys), sizeof(uint32_t));
+	aWrite(&aNumKeys, sizeof(uint32_t));
 
 	for (auto& keyPair : registry)
 	{
 		uint32_t aKeyNameLen = keyPair.first.size()+1;
-		f.write(reinterpret_cast<const char*>(&aKeyNameLen), sizeof(uint32_t));
-		f.write(keyPair.first.c_str(), aKeyNameLen);
+		aWrite(&aKeyNameLen, sizeof(uint32_t));
+		aWrite(keyPair.first.c_str(), aKeyNameLen);
 
 		uint32_t aNumValues = keyPair.second.size();
-		f.write(reinterpret_cast<const char*>(&aNumValues), sizeof(uint32_t));
+		aWrite(&aNumValues, sizeof(uint32_t));
 
-		for (auto& valuePair : registry[keyPair.first])
+		for (auto& valuePair : keyPair.second)
 		{
 			uint32_t aValueNameLen = valuePair.first.size()+1;
-			f.write(reinterpret_cast<const char*>(&aValueNameLen), sizeof(uint32_t));
-			f.write(valuePair.first.c_str(), aValueNameLen);
+			aWrite(&aValueNameLen, sizeof(uint32_t));
+			aWrite(valuePair.first.c_str(), aValueNameLen);
 
 			RegValue& value = valuePair.second;
-			f.write(reinterpret_cast<const char*>(&value.mType), sizeof(uint32_t));
-			f.write(reinterpret_cast<const char*>(&value.mLength), sizeof(uint32_t));
-			f.write(reinterpret_cast<const char*>(value.mValue), value.mLength);
+			aWrite(&value.mType, sizeof(uint32_t));
+			aWrite(&value.mLength, sizeof(uint32_t));
+			aWrite(value.mValue, value.mLength);
 		}
 	}
 }
 
-void regemu::SetRegFile(const std::string& fileName)
+// Rewrites the whole registry file with AsyncFileWriter::WriteFileAtomic and drops the journal.
+// A crash before the journal is removed is harmless: replaying it over the new file changes nothing.
+static void SaveToFile()
 {
-	currFile = fileName;
-	registry.clear();
+	if (currFile.empty())
+	{
+		printf("RegEmu: Filename not specified, can't save\n");
+		return;
+	}
+
+	std::vector<unsigned char> aData;
+	SerializeRegistry(aData);
+	if (!Sexy::AsyncFileWriter::WriteFileAtomic(currFile, aData.data(), aData.size()))
+	{
+		printf("RegEmu: Couldn't write '%s'\n", currFile.c_str());
+		return;
+	}
+
+	std::error_code anError;
+	std::filesystem::remove(Sexy::PathFromU8(GetJournalFile()), anError);
+	journalSize = 0;
+	dirtyValues.clear();
+	erasedKeys.clear();
+	dirty = false;
+}
+
+static void AppendU32(std::string& theOut, uint32_t theValue)
+{
+	theOut.append(reinterpret_cast<const char*>(&theValue), sizeof(uint32_t));
+}
+
+static void AppendName(std::string& theOut, const std::string& theName)
+{
+	AppendU32(theOut, theName.size() + 1);
+	theOut.append(theName.c_str(), theName.size() + 1);
+}
+
+static bool ReadU32(const std::string& theData, size_t& thePos, uint32_t& theValue)
+{
+	if (theData.size() - thePos < sizeof(uint32_t))
+		return false;
+	memcpy(&theValue, theData.data() + thePos, sizeof(uint32_t));
+	thePos += sizeof(uint32_t);
+	return true;
+}
+
+static bool ReadName(const std::string& theData, size_t& thePos, std::string& theName)
+{
+	uint32_t aLen;
+	if (!ReadU32(theData, thePos, aLen) || aLen == 0 || theData.size() - thePos < aLen)
+		return false;
+	theName.assign(theData.data() + thePos, aLen - 1);
+	thePos += aLen;
+	return true;
+}
+
+static void SetValue(const std::string& keyName, const std::string& valueName, uint32_t type, const uint8_t* value, uint32_t length)
+{
+	std::map<std::string, RegValue>& aKey = registry[keyName];
+	auto anIt = aKey.find(valueName);
+	if (anIt != aKey.end())
+		delete[] anIt->second.mValue;
+
+	RegValue regvalue;
+	regvalue.mType = type;
+	regvalue.mLength = length;
+	regvalue.mValue = new uint8_t[length];
+	memcpy(regvalue.mValue, value, length);
+	aKey[valueName] = regvalue;
+}
+
+static bool EraseValue(const std::string& keyName, const std::string& valueName)
+{
+	auto aKeyIt = registry.find(keyName);
+	if (aKeyIt == registry.end())
+		return false;
+	auto anIt = aKeyIt->second.find(valueName);
+	if (anIt == aKeyIt->second.end())
+		return false;
+
+	delete[] anIt->second.mValue;
+	aKeyIt->second.erase(anIt);
+	return true;
+}
+
+static bool EraseKey(const std::string& keyName)
+{
+	auto aKeyIt = registry.find(keyName);
+	if (aKeyIt == registry.end())
+		return false;
+
+	for (auto& valuePair : aKeyIt->second)
+		delete[] valuePair.second.mValue;
+	registry.erase(aKeyIt);
+	return true;
+}
+
+// Appends every change since the last flush to the journal as one batch: size, crc32, then the records.
+// Erased keys come first, so that a value written after its key was erased survives the replay.
+static void FlushJournal()
+{
+	if (!dirty || currFile.empty())
+		return;
+
+	std::string aRecords;
+	for (const std::string& aKeyName : erasedKeys)
+	{
+		aRecords.push_back(JOURNAL_ERASE_KEY);
+		AppendName(aRecords, aKeyName);
+	}
+	for (const auto& aValueKey : dirtyValues)
+	{
+		const RegValue* aValue = nullptr;
+		auto aKeyIt = registry.find(aValueKey.first);
+		if (aKeyIt != registry.end())
+		{
+			auto anIt = aKeyIt->second.find(aValueKey.second);
+			if (anIt != aKeyIt->second.end())
+				aValue = &anIt->second;
+		}
+
+		aRecords.push_back(aValue ? JOURNAL_WRITE_VALUE : JOURNAL_ERASE_VALUE);
+		AppendName(aRecords, aValueKey.first);
+		AppendName(aRecords, aValueKey.second);
+		if (aValue)
+		{
+			AppendU32(aRecords, aValue->mType);
+			AppendU32(aRecords, aValue->mLength);
+			aRecords.append(reinterpret_cast<const char*>(aValue->mValue), aValue->mLength);
+		}
+	}
+
+	std::string aBatch;
+	AppendU32(aBatch, aRecords.size());
+	AppendU32(aBatch, crc32(0, reinterpret_cast<const Bytef*>(aRecords.data()), aRecords.size()));
+	aBatch += aRecords;
+
+	dirtyValues.clear();
+	erasedKeys.clear();
+	dirty = false;
+
+	// Synced, so a batch that Update() reported as written survives a power loss
+	if (!Sexy::AsyncFileWriter::AppendFileSynced(GetJournalFile(), aBatch.data(), aBatch.size()))
+	{
+		printf("RegEmu: Couldn't append to '%s'\n", GetJournalFile().c_str());
+		SaveToFile();
+		return;
+	}
+
+	journalSize += aBatch.size();
+	if (journalSize >= REGEMU_COMPACT_SIZE)
+		SaveToFile();
+}
+
+// Applies the journal left by the previous run; returns whether there was one.
+// Replay stops at the first incomplete or corrupt batch, which is what a crash during an append leaves behind.
+static bool ReplayJournal()
+{
+	std::ifstream f(Sexy::PathFromU8(GetJournalFile()), std::ios::binary);
+	if (!f)
+		return false;
+	std::string aData((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+	size_t aPos = 0;
+	int aNumBatches = 0;
+	for (;;)
+	{
+		uint32_t aSize, aCrc;
+		if (!ReadU32(aData, aPos, aSize) || !ReadU32(aData, aPos, aCrc) || aData.size() - aPos < aSize ||
+			crc32(0, reinterpret_cast<const Bytef*>(aData.data() + aPos), aSize) != aCrc)
+			break;
+
+		std::string aRecords = aData.substr(aPos, aSize);
+		aPos += aSize;
+		aNumBatches++;
+
+		size_t aRecordPos = 0;
+		while (aRecordPos < aRecords.size())
+		{
+			uint8_t anOp = aRecords[aRecordPos++];
+			std::string aKeyName, aValueName;
+			if (!ReadName(aRecords, aRecordPos, aKeyName))
+				break;
+			if (anOp == JOURNAL_ERASE_KEY)
+			{
+				EraseKey(aKeyName);
+				continue;
+			}
+			if (!ReadName(aRecords, aRecordPos, aValueName))
+				break;
+			if (anOp == JOURNAL_ERASE_VALUE)
+			{
+				EraseValue(aKeyName, aValueName);
+				continue;
+			}
+
+			uint32_t aType, aLength;
+			if (anOp != JOURNAL_WRITE_VALUE || !ReadU32(aRecords, aRecordPos, aType) || !ReadU32(aRecords, aRecordPos, aLength) ||
+				aRecords.size() - aRecordPos < aLength)
+				break;
+			SetValue(aKeyName, aValueName, aType, reinterpret_cast<const uint8_t*>(aRecords.data() + aRecordPos), aLength);
+			aRecordPos += aLength;
+		}
+	}
+
+	printf("RegEmu: Replayed %d journal batch(es) from '%s'\n", aNumBatches, GetJournalFile().c_str());
+	return !aData.empty();
+}
 
+static void MarkDirty()
+{
+	RegClock::time_point aNow = RegClock::now();
+	if (!dirty)
+		firstDirtyTime = aNow;
+	lastDirtyTime = aNow;
+	dirty = true;
+}
+
+static void LoadFromFile()
+{
 	std::ifstream f(Sexy::PathFromU8(currFile), std::ios::binary);
 	if (!f)
 	{
@@ -131,8 +371,26 @@ void regemu::SetRegFile(const std::string& fileName)
 	printf("RegEmu: Loaded from '%s': %zu total key(s)\n", currFile.c_str(), static_cast<size_t>(registry.size()));
 }
 
+void regemu::SetRegFile(const std::string& fileName)
+{
+	std::scoped_lock aLock(registryLock);
+	FlushJournal();
+	currFile = fileName;
+	registry.clear();
+	dirtyValues.clear();
+	erasedKeys.clear();
+	dirty = false;
+	journalSize = 0;
+
+	LoadFromFile();
+	// Fold the journal into the file right away, so that new batches never follow a torn one
+	if (ReplayJournal())
+		SaveToFile();
+}
+
 bool regemu::RegistryRead(const std::string& keyName, const std::string& valueName, uint32_t* type, uint8_t* value, uint32_t* length)
 {
+	std::scoped_lock aLock(registryLock);
 	if (!registry.count(keyName))
 	{
 		printf("RegEmu: Key '%s' does not exist\n", keyName.c_str());
@@ -152,50 +410,52 @@ bool regemu::RegistryRead(const std::string& keyName, const std::string& valueNa
 
 bool regemu::RegistryWrite(const std::string& keyName, const std::string& valueName, uint32_t type, const uint8_t* value, uint32_t length)
 {
-	if (!registry.count(keyName))
-		registry[keyName] = {}; // create
-	else
-		delete[] registry[keyName][valueName].mValue;
-
-	RegValue regvalue;
-	regvalue.mType = type;
-	regvalue.mLength = length;
-	regvalue.mValue = new uint8_t[length];
-	memcpy(regvalue.mValue, value, length);
-
-	registry[keyName][valueName] = regvalue;
-
-	SaveToFile();
-
+	std::scoped_lock aLock(registryLock);
+	SetValue(keyName, valueName, type, value, length);
+	dirtyValues.emplace(keyName, valueName);
+	MarkDirty();
 	return true;
 }
 
 bool regemu::RegistryEraseKey(const std::string& keyName)
 {
-	if (!registry.count(keyName))
+	std::scoped_lock aLock(registryLock);
+	if (!EraseKey(keyName))
 		return false;
 
-	for (auto& valuePair : registry[keyName])
-		delete[] valuePair.second.mValue;
-
-	registry.erase(keyName);
 	printf("RegEmu: Erased key '%s'\n", keyName.c_str());
-
-	SaveToFile();
-
+	erasedKeys.insert(keyName);
+	MarkDirty();
 	return true;
 }
 
 bool regemu::RegistryEraseValue(const std::string& keyName, const std::string& valueName)
 {
-	if (!registry.count(keyName) || !registry[keyName].count(valueName))
+	std::scoped_lock aLock(registryLock);
+	if (!EraseValue(keyName, valueName))
 		return false;
 
-	delete[] registry[keyName][valueName].mValue;
-	registry[keyName].erase(valueName);
 	printf("RegEmu: Erased value '%s' from key '%s'\n", valueName.c_str(), keyName.c_str());
+	dirtyValues.emplace(keyName, valueName);
+	MarkDirty();
+	return true;
+}
+
+void regemu::Update()
+{
+	std::scoped_lock aLock(registryLock);
+	if (!dirty)
+		return;
 
-	SaveToFile();
+	RegClock::time_point aNow = RegClock::now();
+	if (aNow - lastDirtyTime >= std::chrono::milliseconds(REGEMU_FLUSH_DELAY_MS) ||
+		aNow - firstDirtyTime >= std::chrono::milliseconds(REGEMU_FLUSH_MAX_DELAY_MS))
+		FlushJournal();
+}
 
-	return true;
+void regemu::Sync()
+{
+	std::scoped_lock aLock(registryLock);
+	if (dirty || journalSize > 0)
+		SaveToFile();
 }
@@ -27,6 +27,10 @@ namespace regemu
 	bool RegistryWrite(const std::string& keyName, const std::string& valueName, uint32_t type, const uint8_t* value, uint32_t length);
 	bool RegistryEraseKey(const std::string& keyName);
 	bool RegistryEraseValue(const std::string& keyName, const std::string& valueName);
+
+	// Writes and erases only change the in-memory registry; these put the changes on disk.
+	void Update();	// call every frame: appends pending changes to the journal once writes pause
+	void Sync();	// rewrites the registry file with everything and removes the journal
 }
 
 #endif
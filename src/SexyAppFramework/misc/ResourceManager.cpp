@@ -1,6 +1,15 @@
 #include <memory>
+#include <fstream>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+#include <zlib.h>
+#include <sys/stat.h>
 #include "ResourceManager.h"
 #include "XMLParser.h"
+#include "paklib/PakInterface.h"
+#include "misc/AsyncFileWriter.h"
 #include "sound/SoundManager.h"
 #include "graphics/GLImage.h"
 #include "graphics/GLInterface.h"
@@ -13,6 +22,220 @@
 
 using namespace Sexy;
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Compiled form of a resources xml file. Strings are interned once and every
+// record refers to its attributes by index, so the whole manifest comes back
+// from disk in a single read. The source size, modification time (the pak
+// record time for packed files) and crc are kept in the header; the crc catches
+// edits that keep the size within the same second. Any mismatch sends us back
+// to the XML.
+static const uint32_t RESOURCE_MANIFEST_COOKIE = 0x4E414D52; // "RMAN"
+static const uint32_t RESOURCE_MANIFEST_VERSION = 3;
+static const uint64_t RESOURCE_MANIFEST_MAX_BODY = 64 * 1024 * 1024;
+
+struct ResourceManifestHeader
+{
+	uint32_t				mCookie;
+	uint32_t				mVersion;
+	uint32_t				mSourceSize;
+	uint32_t				mSourceCrc;
+	int64_t					mSourceTime;
+	uint32_t				mNumStrings;
+	uint32_t				mStringBytes;
+	uint32_t				mNumRecords;
+	uint32_t				mNumAttributes;
+};
+
+struct ResourceManager::CompiledManifest
+{
+	struct Record
+	{
+		uint32_t			mKind;
+		uint32_t			mFirstAttribute;
+		uint32_t			mNumAttributes;
+	};
+
+	struct Attribute
+	{
+		uint32_t			mKey;
+		uint32_t			mValue;
+	};
+
+	uint32_t				mSourceSize = 0;
+	uint32_t				mSourceCrc = 0;
+	int64_t					mSourceTime = 0;
+
+	std::vector<std::string> mStrings;
+	std::unordered_map<std::string, uint32_t> mStringIndex;
+	std::vector<Record>		mRecords;
+	std::vector<Attribute>	mAttributes;
+
+	uint32_t Intern(const std::string& theString)
+	{
+		auto anItr = mStringIndex.find(theString);
+		if (anItr != mStringIndex.end())
+			return anItr->second;
+
+		uint32_t anIndex = (uint32_t)mStrings.size();
+		mStrings.push_back(theString);
+		mStringIndex.emplace(theString, anIndex);
+		return anIndex;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+static bool StampResourceManifestSource(const std::string& theFilename, ResourceManager::CompiledManifest& theManifest)
+{
+	PFILE* aFile = p_fopen(theFilename.c_str(), "rb");
+	if (aFile == nullptr)
+		return false;
+
+	bool aResult = false;
+	if (aFile->mRecord != nullptr)
+	{
+		theManifest.mSourceSize = (uint32_t)aFile->mRecord->mSize;
+		theManifest.mSourceTime = aFile->mRecord->mFileTime;
+		aResult = true;
+	}
+	else
+	{
+		struct stat aStat;
+		if (fstat(fileno(aFile->mFP), &aStat) == 0)
+		{
+			theManifest.mSourceSize = (uint32_t)aStat.st_size;
+			theManifest.mSourceTime = (int64_t)aStat.st_mtime;
+			aResult = true;
+		}
+	}
+
+	// Hashing is far cheaper than parsing, and a packed file is already in memory
+	uLong aCrc = crc32(0, nullptr, 0);
+	unsigned char aBuffer[16384];
+	size_t aRead;
+	while (aResult && (aRead = p_fread(aBuffer, 1, sizeof(aBuffer), aFile)) > 0)
+		aCrc = crc32(aCrc, aBuffer, (uInt)aRead);
+	theManifest.mSourceCrc = (uint32_t)aCrc;
+
+	p_fclose(aFile);
+	return aResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+static bool ReadResourceManifest(const std::string& theCachePath, const ResourceManager::CompiledManifest& theSource, ResourceManager::CompiledManifest& theManifest)
+{
+	typedef ResourceManager::CompiledManifest CompiledManifest;
+
+	std::ifstream aFileStream(PathFromU8(theCachePath), std::ios::binary);
+	if (!aFileStream)
+		return false;
+
+	ResourceManifestHeader aHeader;
+	if (!aFileStream.read(reinterpret_cast<char*>(&aHeader), sizeof(aHeader)))
+		return false;
+
+	if (aHeader.mCookie != RESOURCE_MANIFEST_COOKIE || aHeader.mVersion != RESOURCE_MANIFEST_VERSION ||
+		aHeader.mSourceSize != theSource.mSourceSize || aHeader.mSourceTime != theSource.mSourceTime ||
+		aHeader.mSourceCrc != theSource.mSourceCrc)
+		return false;
+
+	uint64_t anOffsetBytes = ((uint64_t)aHeader.mNumStrings + 1) * sizeof(uint32_t);
+	uint64_t aRecordBytes = (uint64_t)aHeader.mNumRecords * sizeof(CompiledManifest::Record);
+	uint64_t anAttributeBytes = (uint64_t)aHeader.mNumAttributes * sizeof(CompiledManifest::Attribute);
+	uint64_t aBodySize = anOffsetBytes + aHeader.mStringBytes + aRecordBytes + anAttributeBytes;
+	if (aBodySize > RESOURCE_MANIFEST_MAX_BODY)
+		return false;
+
+	std::vector<char> aBody((size_t)aBodySize);
+	if (!aFileStream.read(aBody.data(), (std::streamsize)aBodySize))
+		return false;
+
+	const char* aPtr = aBody.data();
+	std::vector<uint32_t> anOffsets(aHeader.mNumStrings + 1);
+	memcpy(anOffsets.data(), aPtr, (size_t)anOffsetBytes);
+	aPtr += anOffsetBytes;
+
+	const char* aStringData = aPtr;
+	aPtr += aHeader.mStringBytes;
+
+	if (anOffsets[0] != 0 || anOffsets[aHeader.mNumStrings] != aHeader.mStringBytes)
+		return false;
+
+	theManifest.mStrings.reserve(aHeader.mNumStrings);
+	for (uint32_t i = 0; i < aHeader.mNumStrings; i++)
+	{
+		if (anOffsets[i + 1] < anOffsets[i])
+			return false;
+		theManifest.mStrings.emplace_back(aStringData + anOffsets[i], anOffsets[i + 1] - anOffsets[i]);
+	}
+
+	theManifest.mRecords.resize(aHeader.mNumRecords);
+	memcpy(theManifest.mRecords.data(), aPtr, (size_t)aRecordBytes);
+	aPtr += aRecordBytes;
+
+	theManifest.mAttributes.resize(aHeader.mNumAttributes);
+	memcpy(theManifest.mAttributes.data(), aPtr, (size_t)anAttributeBytes);
+
+	for (const CompiledManifest::Record& aRecord : theManifest.mRecords)
+	{
+		if (aRecord.mKind > ResourceManager::ManifestRecord_SetDefaults ||
+			(uint64_t)aRecord.mFirstAttribute + aRecord.mNumAttributes > aHeader.mNumAttributes)
+			return false;
+	}
+
+	for (const CompiledManifest::Attribute& anAttribute : theManifest.mAttributes)
+	{
+		if (anAttribute.mKey >= aHeader.mNumStrings || anAttribute.mValue >= aHeader.mNumStrings)
+			return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+static void WriteResourceManifest(const std::string& theCachePath, const ResourceManager::CompiledManifest& theManifest)
+{
+	typedef ResourceManager::CompiledManifest CompiledManifest;
+
+	ResourceManifestHeader aHeader;
+	aHeader.mCookie = RESOURCE_MANIFEST_COOKIE;
+	aHeader.mVersion = RESOURCE_MANIFEST_VERSION;
+	aHeader.mSourceSize = theManifest.mSourceSize;
+	aHeader.mSourceCrc = theManifest.mSourceCrc;
+	aHeader.mSourceTime = theManifest.mSourceTime;
+	aHeader.mNumStrings = (uint32_t)theManifest.mStrings.size();
+	aHeader.mNumRecords = (uint32_t)theManifest.mRecords.size();
+	aHeader.mNumAttributes = (uint32_t)theManifest.mAttributes.size();
+
+	std::vector<uint32_t> anOffsets;
+	anOffsets.reserve(theManifest.mStrings.size() + 1);
+	std::string aStringData;
+	for (const std::string& aString : theManifest.mStrings)
+	{
+		anOffsets.push_back((uint32_t)aStringData.size());
+		aStringData += aString;
+	}
+	anOffsets.push_back((uint32_t)aStringData.size());
+	aHeader.mStringBytes = (uint32_t)aStringData.size();
+
+	std::vector<char> aData;
+	auto Append = [&aData](const void* theBytes, size_t theSize)
+	{
+		aData.insert(aData.end(), static_cast<const char*>(theBytes), static_cast<const char*>(theBytes) + theSize);
+	};
+	Append(&aHeader, sizeof(aHeader));
+	Append(anOffsets.data(), anOffsets.size() * sizeof(uint32_t));
+	Append(aStringData.data(), aStringData.size());
+	Append(theManifest.mRecords.data(), theManifest.mRecords.size() * sizeof(CompiledManifest::Record));
+	Append(theManifest.mAttributes.data(), theManifest.mAttributes.size() * sizeof(CompiledManifest::Attribute));
+
+	// An interrupted write must not leave a truncated cache behind
+	AsyncFileWriter::WriteFileAtomic(theCachePath, aData.data(), aData.size());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 void ResourceManager::ImageRes::DeleteResource()
@@ -48,6 +271,7 @@ ResourceManager::ResourceManager(SexyAppBase *theApp)
 	mApp = theApp;
 	mHasFailed = false;
 	mXMLParser = nullptr;
+	mCompiledManifest = nullptr;
 
 	mAllowMissingProgramResources = false;
 	mAllowAlreadyDefinedResources = false;
@@ -83,6 +307,29 @@ void ResourceManager::DeleteMap(ResMap &theMap)
 	theMap.clear();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::RemoveResourcesNotIn(ResMap &theMap, const ResMap &theKept)
+{
+	for (ResMap::iterator anItr = theMap.begin(); anItr != theMap.end(); )
+	{
+		ResMap::const_iterator aKeptItr = theKept.find(anItr->first);
+		if (aKeptItr != theKept.end() && aKeptItr->second == anItr->second)
+		{
+			++anItr;
+			continue;
+		}
+
+		BaseRes* aRes = anItr->second;
+		auto aGroupItr = mResGroupMap.find(aRes->mResGroup);
+		if (aGroupItr != mResGroupMap.end())
+			aGroupItr->second.remove(aRes);
+		aRes->DeleteResource();
+		delete aRes;
+		anItr = theMap.erase(anItr);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 void ResourceManager::DeleteResources(ResMap &theMap, const std::string &theGroup)
@@ -470,6 +717,7 @@ bool ResourceManager::ParseResources()
 		{
 			if (aXMLElement.mValue == "Image")
 			{
+				RecordManifestElement(ManifestRecord_Image, aXMLElement.mAttributes);
 				if (!ParseImageResource(aXMLElement))
 					return false;
 
@@ -481,6 +729,7 @@ bool ResourceManager::ParseResources()
 			}
 			else if (aXMLElement.mValue == "Sound")
 			{
+				RecordManifestElement(ManifestRecord_Sound, aXMLElement.mAttributes);
 				if (!ParseSoundResource(aXMLElement))
 					return false;
 
@@ -492,6 +741,7 @@ bool ResourceManager::ParseResources()
 			}
 			else if (aXMLElement.mValue == "Font")
 			{
+				RecordManifestElement(ManifestRecord_Font, aXMLElement.mAttributes);
 				if (!ParseFontResource(aXMLElement))
 					return false;
 
@@ -503,6 +753,7 @@ bool ResourceManager::ParseResources()
 			}
 			else if (aXMLElement.mValue == "SetDefaults")
 			{
+				RecordManifestElement(ManifestRecord_SetDefaults, aXMLElement.mAttributes);
 				if (!ParseSetDefaults(aXMLElement))
 					return false;
 
@@ -555,6 +806,8 @@ bool ResourceManager::DoParseResources()
 						break;
 					}
 
+					RecordManifestElement(ManifestRecord_Group, aXMLElement.mAttributes);
+
 					if (!ParseResources())
 						break;
 				}
@@ -581,9 +834,142 @@ bool ResourceManager::DoParseResources()
 	return !mHasFailed;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::RecordManifestElement(ManifestRecordKind theKind, const XMLParamMap& theAttributes)
+{
+	if (mCompiledManifest == nullptr)
+		return;
+
+	CompiledManifest::Record aRecord;
+	aRecord.mKind = theKind;
+	aRecord.mFirstAttribute = (uint32_t)mCompiledManifest->mAttributes.size();
+	aRecord.mNumAttributes = (uint32_t)theAttributes.size();
+	mCompiledManifest->mRecords.push_back(aRecord);
+
+	for (const auto& anAttribute : theAttributes)
+	{
+		CompiledManifest::Attribute aCompiledAttribute;
+		aCompiledAttribute.mKey = mCompiledManifest->Intern(anAttribute.first);
+		aCompiledAttribute.mValue = mCompiledManifest->Intern(anAttribute.second);
+		mCompiledManifest->mAttributes.push_back(aCompiledAttribute);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::ReplayCompiledManifest(const CompiledManifest& theManifest)
+{
+	for (const CompiledManifest::Record& aRecord : theManifest.mRecords)
+	{
+		XMLElement aXMLElement;
+		aXMLElement.mType = XMLElement::TYPE_START;
+		for (uint32_t i = 0; i < aRecord.mNumAttributes; i++)
+		{
+			const CompiledManifest::Attribute& anAttribute = theManifest.mAttributes[aRecord.mFirstAttribute + i];
+			aXMLElement.mAttributes.emplace_hint(aXMLElement.mAttributes.end(), theManifest.mStrings[anAttribute.mKey], theManifest.mStrings[anAttribute.mValue]);
+		}
+
+		switch (aRecord.mKind)
+		{
+		case ManifestRecord_Group:
+			mCurResGroup = aXMLElement.mAttributes["id"];
+			mCurResGroupList = &mResGroupMap[mCurResGroup];
+			break;
+
+		case ManifestRecord_Image:
+			aXMLElement.mValue = "Image";
+			if (!ParseImageResource(aXMLElement))
+				return false;
+			break;
+
+		case ManifestRecord_Sound:
+			aXMLElement.mValue = "Sound";
+			if (!ParseSoundResource(aXMLElement))
+				return false;
+			break;
+
+		case ManifestRecord_Font:
+			aXMLElement.mValue = "Font";
+			if (!ParseFontResource(aXMLElement))
+				return false;
+			break;
+
+		case ManifestRecord_SetDefaults:
+			aXMLElement.mValue = "SetDefaults";
+			if (!ParseSetDefaults(aXMLElement))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::ParseResourcesFile(const std::string& theFilename)
+{
+	// Reparsing while running is meant to pick up live edits, so it always reads the XML
+	if (mAllowAlreadyDefinedResources)
+		return DoParseResourcesXML(theFilename);
+
+	CompiledManifest aSource;
+	if (!StampResourceManifestSource(theFilename, aSource))
+		return DoParseResourcesXML(theFilename);
+
+	std::string aCachePath = GetAppDataPath("cache/" + theFilename + ".bin");
+
+	CompiledManifest aCompiled;
+	if (ReadResourceManifest(aCachePath, aSource, aCompiled))
+	{
+		ResMap anImageMap = mImageMap, aSoundMap = mSoundMap, aFontMap = mFontMap;
+		std::set<std::string, StringLessNoCase> aGroups;
+		for (const auto& aGroup : mResGroupMap)
+			aGroups.insert(aGroup.first);
+		std::string aCurResGroup = mCurResGroup, aDefaultPath = mDefaultPath, aDefaultIdPrefix = mDefaultIdPrefix;
+		ResList* aCurResGroupList = mCurResGroupList;
+
+		if (ReplayCompiledManifest(aCompiled) && !mHasFailed)
+			return true;
+
+		// A cache that no longer replays cleanly is thrown away: undo everything it added and read the XML instead,
+		// which either rebuilds the cache or reports the error with its line number
+		RemoveResourcesNotIn(mImageMap, anImageMap);
+		RemoveResourcesNotIn(mSoundMap, aSoundMap);
+		RemoveResourcesNotIn(mFontMap, aFontMap);
+		for (auto anItr = mResGroupMap.begin(); anItr != mResGroupMap.end(); )
+		{
+			if (anItr->second.empty() && aGroups.find(anItr->first) == aGroups.end())
+				anItr = mResGroupMap.erase(anItr);
+			else
+				++anItr;
+		}
+		mCurResGroup = aCurResGroup;
+		mDefaultPath = aDefaultPath;
+		mDefaultIdPrefix = aDefaultIdPrefix;
+		mCurResGroupList = aCurResGroupList;
+		mHasFailed = false;
+		mHadAlreadyDefinedError = false;
+		mError.clear();
+
+		std::error_code anError;
+		std::filesystem::remove(PathFromU8(aCachePath), anError);
+	}
+
+	mCompiledManifest = &aSource;
+	bool aResult = DoParseResourcesXML(theFilename);
+	mCompiledManifest = nullptr;
+
+	if (aResult)
+		WriteResourceManifest(aCachePath, aSource);
+
+	return aResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::DoParseResourcesXML(const std::string& theFilename)
 {
 	mXMLParser = new XMLParser();
 	if (!mXMLParser->OpenFile(theFilename))
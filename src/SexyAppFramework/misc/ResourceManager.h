@@ -128,6 +128,20 @@ public: // @Patoke todo: revert to protected
 	ResList*				mCurResGroupList;
 	ResList::iterator		mCurResGroupListItr;
 
+	// Binary manifest cache. Every element accepted from the XML is recorded
+	// so the next boot can replay it without running the XML parser.
+	enum ManifestRecordKind
+	{
+		ManifestRecord_Group,
+		ManifestRecord_Image,
+		ManifestRecord_Sound,
+		ManifestRecord_Font,
+		ManifestRecord_SetDefaults
+	};
+
+	struct CompiledManifest;
+	CompiledManifest*		mCompiledManifest;
+
 
 	bool					Fail(const std::string& theErrorText);
 
@@ -139,7 +153,11 @@ public: // @Patoke todo: revert to protected
 	virtual bool			ParseResources();
 
 	bool					DoParseResources();
+	bool					DoParseResourcesXML(const std::string& theFilename);
+	void					RecordManifestElement(ManifestRecordKind theKind, const XMLParamMap& theAttributes);
+	bool					ReplayCompiledManifest(const CompiledManifest& theManifest);
 	void					DeleteMap(ResMap &theMap);
+	void					RemoveResourcesNotIn(ResMap &theMap, const ResMap &theKept);
 	virtual void			DeleteResources(ResMap &theMap, const std::string &theGroup);
 
 	bool					LoadAlphaGridImage(ImageRes *theRes, GLImage *theImage);
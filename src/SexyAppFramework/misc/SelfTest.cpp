@@ -0,0 +1,243 @@
+#include "SelfTest.h"
+#include "AsyncFileWriter.h"
+#include "Common.h"
+#include "LZ4Block.h"
+#include "MTRand.h"
+#include "XMLParser.h"
+#include "imagelib/ImageLib.h"
+#include "imagelib/PixelKernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <zlib.h>
+
+using namespace Sexy;
+
+static int ReportCheck(const char* theName, bool theOk)
+{
+	printf("self test: %s: %s\n", theName, theOk ? "ok" : "FAILED");
+	return theOk ? 0 : 1;
+}
+
+// Pixels that hit the interesting cases: fully transparent and opaque, and every channel at 0, 1, 0x7F, 0x80 and 0xFF
+static void FillTestPixels(std::vector<uint32_t>& thePixels, MTRand& theRand)
+{
+	static const uint32_t EDGE_VALUES[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+	for (uint32_t& aPixel : thePixels)
+	{
+		if (theRand.NextNoAssert(4UL) == 0)
+		{
+			aPixel = 0;
+			for (int aShift = 0; aShift < 32; aShift += 8)
+				aPixel |= EDGE_VALUES[theRand.NextNoAssert((unsigned long)LENGTH(EDGE_VALUES))] << aShift;
+		}
+		else
+			aPixel = (uint32_t)theRand.NextNoAssert();
+	}
+}
+
+// Row lengths around every vector width so both the vector loops and the scalar tails are covered
+static int TestPixelKernels()
+{
+	static const int WIDTHS[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127 };
+	static const uint32_t BASE_COLORS[] = { 0x00000000, 0x00FFFFFF, 0x00123456, 0x00FF00FF };
+
+	const ImageLib::PixelKernels& aScalar = ImageLib::GetScalarPixelKernels();
+	MTRand aRand(1234);
+	int aNumFailed = 0;
+
+	for (const ImageLib::PixelKernels* aVariant : ImageLib::GetAvailablePixelKernels())
+	{
+		const ImageLib::PixelKernels& aKernels = *aVariant;
+		bool aComposeOk = true, anAlphaToImageOk = true, aRgbaOk = true, a4444Ok = true, a565Ok = true, aHalveOk = true;
+		for (int aWidth : WIDTHS)
+		{
+			std::vector<uint32_t> aSrc(aWidth * 2), anAlpha(aWidth);
+			FillTestPixels(aSrc, aRand);
+			FillTestPixels(anAlpha, aRand);
+			std::vector<uint32_t> anExpected32(aWidth), aResult32(aWidth);
+			std::vector<uint16_t> anExpected16(aWidth), aResult16(aWidth);
+
+			anExpected32.assign(aSrc.begin(), aSrc.begin() + aWidth);
+			aResult32 = anExpected32;
+			aScalar.mComposeAlpha(anExpected32.data(), anAlpha.data(), aWidth);
+			aKernels.mComposeAlpha(aResult32.data(), anAlpha.data(), aWidth);
+			aComposeOk = aComposeOk && anExpected32 == aResult32;
+
+			for (uint32_t aBaseColor : BASE_COLORS)
+			{
+				anExpected32.assign(aSrc.begin(), aSrc.begin() + aWidth);
+				aResult32 = anExpected32;
+				aScalar.mAlphaToImage(anExpected32.data(), aBaseColor, aWidth);
+				aKernels.mAlphaToImage(aResult32.data(), aBaseColor, aWidth);
+				anAlphaToImageOk = anAlphaToImageOk && anExpected32 == aResult32;
+			}
+
+			aScalar.mArgbToRgba(anExpected32.data(), aSrc.data(), aWidth);
+			aKernels.mArgbToRgba(aResult32.data(), aSrc.data(), aWidth);
+			aRgbaOk = aRgbaOk && anExpected32 == aResult32;
+
+			aScalar.mArgbTo4444(anExpected16.data(), aSrc.data(), aWidth);
+			aKernels.mArgbTo4444(aResult16.data(), aSrc.data(), aWidth);
+			a4444Ok = a4444Ok && anExpected16 == aResult16;
+
+			aScalar.mArgbTo565(anExpected16.data(), aSrc.data(), aWidth);
+			aKernels.mArgbTo565(aResult16.data(), aSrc.data(), aWidth);
+			a565Ok = a565Ok && anExpected16 == aResult16;
+
+			const int aHalfWidth = aWidth / 2;
+			aScalar.mHalve(anExpected32.data(), aSrc.data(), aSrc.data() + aWidth, aHalfWidth);
+			aKernels.mHalve(aResult32.data(), aSrc.data(), aSrc.data() + aWidth, aHalfWidth);
+			aHalveOk = aHalveOk && std::equal(anExpected32.begin(), anExpected32.begin() + aHalfWidth, aResult32.begin());
+		}
+
+		std::string aName = std::string("pixel kernels '") + aKernels.mName + "' ";
+		aNumFailed += ReportCheck((aName + "compose").c_str(), aComposeOk);
+		aNumFailed += ReportCheck((aName + "alpha to image").c_str(), anAlphaToImageOk);
+		aNumFailed += ReportCheck((aName + "rgba").c_str(), aRgbaOk);
+		aNumFailed += ReportCheck((aName + "4444").c_str(), a4444Ok);
+		aNumFailed += ReportCheck((aName + "565").c_str(), a565Ok);
+		aNumFailed += ReportCheck((aName + "halve").c_str(), aHalveOk);
+	}
+	return aNumFailed;
+}
+
+// The downscale used while loading must stay byte-identical to the original per-byte implementation
+static int TestDownscale()
+{
+	static const int SIZES[][3] = { { 2, 2, 2 }, { 3, 5, 2 }, { 17, 9, 2 }, { 64, 33, 2 }, { 33, 64, 4 }, { 9, 4, 4 } };
+
+	MTRand aRand(5678);
+	bool aOk = true;
+	for (const auto& aSize : SIZES)
+	{
+		const int aWidth = aSize[0], aHeight = aSize[1], aFactor = aSize[2];
+		const int aNewWidth = aWidth / aFactor, aNewHeight = aHeight / aFactor;
+		ImageLib::Image anImage;
+		anImage.mWidth = aWidth;
+		anImage.mHeight = aHeight;
+		anImage.mBits = new uint32_t[aWidth * aHeight];
+		std::vector<uint32_t> aPixels(aWidth * aHeight);
+		FillTestPixels(aPixels, aRand);
+		std::copy(aPixels.begin(), aPixels.end(), anImage.mBits);
+
+		std::unique_ptr<unsigned char[]> aReference(ImageLib::RescaleReference(aWidth, aHeight, aNewWidth, aNewHeight, (const unsigned char*)aPixels.data()));
+		aOk = aOk && ImageLib::DownscaleImage(&anImage, aFactor) && anImage.mWidth == aNewWidth && anImage.mHeight == aNewHeight &&
+			memcmp(aReference.get(), anImage.mBits, aNewWidth * aNewHeight * sizeof(uint32_t)) == 0;
+	}
+	return ReportCheck("downscale", aOk);
+}
+
+static bool LZ4RoundTrip(const std::vector<unsigned char>& theData)
+{
+	const int aSize = (int)theData.size();
+	std::vector<unsigned char> aCompressed(LZ4CompressBound(aSize));
+	int aCompressedSize = LZ4Compress(theData.data(), aSize, aCompressed.data(), (int)aCompressed.size());
+	if (aCompressedSize <= 0)
+		return false;
+
+	std::vector<unsigned char> aDecompressed(aSize);
+	if (LZ4Decompress(aCompressed.data(), aCompressedSize, aDecompressed.data(), aSize) != aSize || aDecompressed != theData)
+		return false;
+
+	// Cutting the block short must be rejected, never read past the end
+	for (int aCut = 1; aCut < aCompressedSize && aCut <= 16; aCut++)
+		if (LZ4Decompress(aCompressed.data(), aCompressedSize - aCut, aDecompressed.data(), aSize) == aSize)
+			return false;
+	return true;
+}
+
+// The encoder must choose the same matches on every host: scripts/pvzp-v4-converter.py rebuilds compressed saves
+// byte for byte. The expected size and crc come from the script's encoder; a native-endian hash gives 12877 bytes
+static bool LZ4StableOutput()
+{
+	MTRand aRand(7);
+	std::vector<unsigned char> aData(20000);
+	for (unsigned char& aByte : aData)
+		aByte = (unsigned char)(aRand.NextNoAssert(3UL) == 0 ? aRand.NextNoAssert(16UL) : 0);
+
+	std::vector<unsigned char> aCompressed(LZ4CompressBound((int)aData.size()));
+	int aCompressedSize = LZ4Compress(aData.data(), (int)aData.size(), aCompressed.data(), (int)aCompressed.size());
+	return aCompressedSize == 12897 && crc32(0, aCompressed.data(), aCompressedSize) == 0xBD50F567UL;
+}
+
+static int TestLZ4()
+{
+	MTRand aRand(42);
+	std::vector<unsigned char> aRandom(5000), aRepeated(5000), aText;
+	for (unsigned char& aByte : aRandom)
+		aByte = (unsigned char)aRand.NextNoAssert(256UL);
+	for (size_t i = 0; i < aRepeated.size(); i++)
+		aRepeated[i] = (unsigned char)(i % 7 == 0 ? aRand.NextNoAssert(4UL) : 0);
+	for (int i = 0; i < 200; i++)
+		aText.insert(aText.end(), { 'z', 'o', 'm', 'b', 'i', 'e', (unsigned char)('0' + i % 10) });
+
+	int aNumFailed = 0;
+	aNumFailed += ReportCheck("lz4 empty", LZ4RoundTrip({}));
+	aNumFailed += ReportCheck("lz4 one byte", LZ4RoundTrip({ 7 }));
+	aNumFailed += ReportCheck("lz4 random", LZ4RoundTrip(aRandom));
+	aNumFailed += ReportCheck("lz4 repeated", LZ4RoundTrip(aRepeated));
+	aNumFailed += ReportCheck("lz4 text", LZ4RoundTrip(aText));
+	aNumFailed += ReportCheck("lz4 stable output", LZ4StableOutput());
+	return aNumFailed;
+}
+
+// Parses theData from a file in theTempDir and checks it yields <a x="1"/><b>t</b> without failing at the end
+static bool XMLParseFile(const std::string& theTempDir, const std::string& theData)
+{
+	std::string aFileName = theTempDir + "/xmltest.xml";
+	MkDir(theTempDir);
+	FILE* aFile = fopen(aFileName.c_str(), "wb");
+	if (aFile == nullptr)
+		return false;
+	bool aWritten = fwrite(theData.data(), 1, theData.size(), aFile) == theData.size();
+	if (fclose(aFile) != 0 || !aWritten)
+		return false;
+
+	XMLParser aParser;
+	if (!aParser.OpenFile(aFileName))
+		return false;
+	std::string aStream;
+	XMLElement anElement;
+	while (aParser.NextElement(&anElement))
+	{
+		aStream += std::to_string(anElement.mType) + anElement.mValue;
+		for (const auto& anAttribute : anElement.mAttributes)
+			aStream += anAttribute.first + "=" + anAttribute.second;
+		aStream += ";";
+	}
+	return !aParser.HasFailed() && aStream == "1ax=1;2a;1b;3t;2b;";
+}
+
+// Byte order marks are dropped without the "Illegal Character" the old reader raised at the end of the file
+static int TestXMLParser(const std::string& theTempDir)
+{
+	const std::string aDocument = "<a x=\"1\"/>\n<b>t</b>\n";
+	std::string aUTF16LE = "\xFF\xFE", aUTF16BE = "\xFE\xFF";
+	for (char aChar : aDocument)
+	{
+		aUTF16LE += { aChar, '\0' };
+		aUTF16BE += { '\0', aChar };
+	}
+
+	int aNumFailed = 0;
+	aNumFailed += ReportCheck("xml plain", XMLParseFile(theTempDir, aDocument));
+	aNumFailed += ReportCheck("xml utf-8 bom", XMLParseFile(theTempDir, "\xEF\xBB\xBF" + aDocument));
+	aNumFailed += ReportCheck("xml utf-16le bom", XMLParseFile(theTempDir, aUTF16LE));
+	aNumFailed += ReportCheck("xml utf-16be bom", XMLParseFile(theTempDir, aUTF16BE));
+	return aNumFailed;
+}
+
+int Sexy::RunSelfTests(const std::string& theTempDir)
+{
+	int aNumFailed = 0;
+	aNumFailed += TestPixelKernels();
+	aNumFailed += TestDownscale();
+	aNumFailed += TestLZ4();
+	aNumFailed += TestXMLParser(theTempDir);
+	aNumFailed += AsyncFileWriter::TestCrashSafety(theTempDir);
+	printf("self test: %d check(s) failed\n", aNumFailed);
+	return aNumFailed;
+}
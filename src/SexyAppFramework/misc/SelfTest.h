@@ -0,0 +1,17 @@
+#ifndef __SELFTEST_H__
+#define __SELFTEST_H__
+
+#include <string>
+
+namespace Sexy
+{
+
+// Correctness checks that need neither a window nor the game data: every pixel kernel variant against the
+// scalar one (including the image downscale), LZ4 round trips, XML byte order mark handling and the crash
+// safety of AsyncFileWriter.
+// theTempDir receives scratch files. Every check is reported on stdout; returns the number of failed checks.
+int RunSelfTests(const std::string& theTempDir);
+
+}
+
+#endif //__SELFTEST_H__
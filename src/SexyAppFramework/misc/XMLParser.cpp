@@ -1,5 +1,8 @@
 #include "XMLParser.h"
 #include "paklib/PakInterface.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
 
 using namespace Sexy;
 
@@ -35,31 +38,31 @@ static int EncodeUTF8(uint32_t code, char out[4])
 	return 1;
 }
 
+// Decodes entities only when the string contains any, avoiding a copy in the common case
+static inline void XMLDecodeInPlace(std::string& theString)
+{
+	if (theString.find('&') != std::string::npos)
+		theString = XMLDecodeString(theString);
+}
+
 XMLParser::XMLParser()
 {
-	mFile = nullptr;
 	mLineNum = 0;
 	mAllowComments = false;
-	mGetCharFunc = &XMLParser::GetUTF8Char;
+	mSourcePos = 0;
+	mSourceError = false;
+	mEncoding = UTF_8;
 	mForcedEncodingType = false;
 }
 
 XMLParser::~XMLParser()
 {
-	if (mFile != nullptr)
-		p_fclose(mFile);
 }
 
 void XMLParser::SetEncodingType(XMLEncodingType theEncoding)
 {
-	switch (theEncoding)
-	{
-		case ASCII:		mGetCharFunc = &XMLParser::GetAsciiChar;	mForcedEncodingType = true; break;
-		case UTF_8:		mGetCharFunc = &XMLParser::GetUTF8Char;		mForcedEncodingType = true; break;
-		case UTF_16:	mGetCharFunc = &XMLParser::GetUTF16Char;	mForcedEncodingType = true; break;
-		case UTF_16_LE:	mGetCharFunc = &XMLParser::GetUTF16LEChar;	mForcedEncodingType = true; break;
-		case UTF_16_BE:	mGetCharFunc = &XMLParser::GetUTF16BEChar;	mForcedEncodingType = true; break;
-	}
+	mEncoding = theEncoding;
+	mForcedEncodingType = true;
 }
 
 void XMLParser::Fail(const std::string& theErrorText)
@@ -74,8 +77,10 @@ void XMLParser::Init()
 	mLineNum = 1;
 	mHasFailed = false;
 	mErrorText = "";
-	mFirstChar = true;
-	mByteSwap = false;
+	mSource.clear();
+	mSourcePos = 0;
+	mSourceError = false;
+	mBufferedText.clear();
 }
 
 bool XMLParser::AddAttribute(XMLElement* theElement, const std::string& theAttributeKey, const std::string& theAttributeValue)
@@ -92,221 +97,154 @@ bool XMLParser::AddAttribute(XMLElement* theElement, const std::string& theAttri
 	return aRet.second;
 }
 
-bool XMLParser::GetAsciiChar(char* theChar, bool* error)
+void XMLParser::DecodeUTF16(std::string_view theData, bool theBigEndian)
 {
-	(void)error;
-	char aChar = 0;
-	if (p_fread(&aChar, 1, 1, mFile) != 1) return false;
-
-	*theChar = aChar;
-	return true;
-}
-
-bool XMLParser::GetUTF8Char(char* theChar, bool* error)
-{
-	*error = true;
-	unsigned char aChar = 0;
-	if (p_fread(&aChar, 1, 1, mFile) != 1) return false;
-
-	if (mFirstChar)
+	mSource.reserve(theData.size());
+	for (size_t i = 0; i + 1 < theData.size(); i += 2)
 	{
-		mFirstChar = false;
-		if (aChar == 0xEF)
+		uint16_t aChar;
+		memcpy(&aChar, theData.data() + i, 2);
+		aChar = theBigEndian ? FromBE16(aChar) : FromLE16(aChar);
+
+		uint32_t aCodepoint = aChar;
+		if (aChar >= 0xD800 && aChar < 0xE000)
 		{
-			unsigned char b2 = 0;
-			unsigned char b3 = 0;
-			if (p_fread(&b2, 1, 1, mFile) == 1 && p_fread(&b3, 1, 1, mFile) == 1)
+			uint16_t aNextChar = 0;
+			if (aChar >= 0xDC00 || i + 3 >= theData.size())
 			{
-				if (b2 == 0xBB && b3 == 0xBF)
-					return GetUTF8Char(theChar, error);
-				mBufferedText.push_back((char)b3);
-				mBufferedText.push_back((char)b2);
+				mSourceError = true;
+				return;
 			}
+			memcpy(&aNextChar, theData.data() + i + 2, 2);
+			aNextChar = theBigEndian ? FromBE16(aNextChar) : FromLE16(aNextChar);
+			if (aNextChar < 0xDC00 || aNextChar >= 0xE000)
+			{
+				mSourceError = true;
+				return;
+			}
+			aCodepoint = (((aChar - 0xD800) << 10) | (aNextChar - 0xDC00)) + 0x10000;
+			i += 2;
 		}
-	}
-
-	*theChar = (char)aChar;
-	*error = false;
-	return true;
-}
-
-bool XMLParser::GetUTF16Char(char* theChar, bool* error)
-{
-	*error = true;
-	uint16_t aTempChar = 0;
-	if (p_fread(&aTempChar, 2, 1, mFile) != 1) return false;
-
-	if (mFirstChar)
-	{
-		mFirstChar = false;
-		if (aTempChar == 0xFEFF)
-		{
-			mByteSwap = false;
-			return GetUTF16Char(theChar, error);
-		}
-		else if (aTempChar == 0xFFFE)
-		{
-			mByteSwap = true;
-			return GetUTF16Char(theChar, error);
-		}
-	}
-	if (mByteSwap)
-		aTempChar = (uint16_t)((aTempChar << 8) | (aTempChar >> 8));
 
-	uint32_t codepoint = aTempChar;
-	if ((aTempChar & 0xD800) == 0xD800)
-	{
-		uint16_t aNextChar = 0;
-		if (p_fread(&aNextChar, 2, 1, mFile) != 1) return false;
-
-		if (mByteSwap)
-			aNextChar = (uint16_t)((aNextChar << 8) | (aNextChar >> 8));
-		if ((aNextChar & 0xDC00) == 0xDC00)
-			codepoint = (((aTempChar & ~0xD800) << 10) | (aNextChar & ~0xDC00)) + 0x10000;
-		else
-			return false;
+		char aUTF8[4];
+		int aLen = EncodeUTF8(aCodepoint, aUTF8);
+		mSource.append(aUTF8, aLen);
 	}
-
-	char utf8[4];
-	int len = EncodeUTF8(codepoint, utf8);
-	for (int i = len - 1; i >= 1; --i)
-		mBufferedText.push_back(utf8[i]);
-
-	*theChar = utf8[0];
-	*error = false;
-	return true;
 }
 
-bool XMLParser::GetUTF16LEChar(char* theChar, bool* error)
+// The whole document is decoded up front so NextElement can scan it in place
+void XMLParser::SetSource(std::string_view theData, XMLEncodingType theEncoding)
 {
-	*error = true;
-	uint16_t aTempChar = 0;
-	if (p_fread(&aTempChar, 2, 1, mFile) != 1) return false;
+	const unsigned char* aBytes = (const unsigned char*)theData.data();
+	bool aHasUTF16BOM = theData.size() >= 2 && ((aBytes[0] == 0xFF && aBytes[1] == 0xFE) || (aBytes[0] == 0xFE && aBytes[1] == 0xFF));
+	bool aHasUTF8BOM = theData.size() >= 3 && aBytes[0] == 0xEF && aBytes[1] == 0xBB && aBytes[2] == 0xBF;
 
-	aTempChar = FromLE16(aTempChar);
-
-	uint32_t codepoint = aTempChar;
-	if ((aTempChar & 0xD800) == 0xD800)
+	switch (theEncoding)
 	{
-		uint16_t aNextChar = 0;
-		if (p_fread(&aNextChar, 2, 1, mFile) != 1) return false;
-
-		aNextChar = FromLE16(aNextChar);
-		if ((aNextChar & 0xDC00) == 0xDC00)
-			codepoint = (((aTempChar & ~0xD800) << 10) | (aNextChar & ~0xDC00)) + 0x10000;
+	case UTF_16:
+		if (aHasUTF16BOM)
+			DecodeUTF16(theData.substr(2), aBytes[0] == 0xFE);
 		else
-			return false;
+			DecodeUTF16(theData, std::endian::native == std::endian::big);
+		break;
+	case UTF_16_LE:
+		DecodeUTF16(theData, false);
+		break;
+	case UTF_16_BE:
+		DecodeUTF16(theData, true);
+		break;
+	case UTF_8:
+		mSource.assign(aHasUTF8BOM ? theData.substr(3) : theData);
+		break;
+	case ASCII:
+	default:
+		mSource.assign(theData);
+		break;
 	}
-
-	char utf8[4];
-	int len = EncodeUTF8(codepoint, utf8);
-	for (int i = len - 1; i >= 1; --i)
-		mBufferedText.push_back(utf8[i]);
-
-	*theChar = utf8[0];
-	*error = false;
-	return true;
-}
-
-bool XMLParser::GetUTF16BEChar(char* theChar, bool* error)
-{
-	*error = true;
-	uint16_t aTempChar = 0;
-	if (p_fread(&aTempChar, 2, 1, mFile) != 1) return false;
-
-	aTempChar = FromBE16(aTempChar);
-
-	uint32_t codepoint = aTempChar;
-	if ((aTempChar & 0xD800) == 0xD800)
-	{
-		uint16_t aNextChar = 0;
-		if (p_fread(&aNextChar, 2, 1, mFile) != 1) return false;
-
-		aNextChar = FromBE16(aNextChar);
-		if ((aNextChar & 0xDC00) == 0xDC00)
-			codepoint = (((aTempChar & ~0xD800) << 10) | (aNextChar & ~0xDC00)) + 0x10000;
-		else
-			return false;
-	}
-
-	char utf8[4];
-	int len = EncodeUTF8(codepoint, utf8);
-	for (int i = len - 1; i >= 1; --i)
-		mBufferedText.push_back(utf8[i]);
-
-	*theChar = utf8[0];
-	*error = false;
-	return true;
 }
 
+// A UTF-8 or UTF-16 byte order mark selects the encoding and is dropped. The old per-character reader
+// reported "Illegal Character" on reaching the end of a UTF-8 file with a mark, and never decoded UTF-16
+// files at all; both now parse cleanly (checked by the XML self test).
 bool XMLParser::OpenFile(const std::string& theFileName)
-{		
-	mFile = p_fopen(theFileName.c_str(), "r");
-
-	if (mFile == nullptr)
+{
+	PFILE* aFile = p_fopen(theFileName.c_str(), "r");
+	if (aFile == nullptr)
 	{
 		mLineNum = 0;
 		Fail("Unable to open file " + theFileName);
 		return false;
 	}
-	else if (!mForcedEncodingType)
-	{
-		p_fseek(mFile, 0, SEEK_END);
-		long aFileLen = p_ftell(mFile);
-		p_fseek(mFile, 0, SEEK_SET);
 
-		mGetCharFunc = &XMLParser::GetAsciiChar;
-		if (aFileLen >= 2) // UTF-16?
-		{
-			int aChar1 = p_fgetc(mFile);
-			int aChar2 = p_fgetc(mFile);
-
-			if ( (aChar1 == 0xFF && aChar2 == 0xFE) || (aChar1 == 0xFE && aChar2 == 0xFF) )
-				mGetCharFunc = &XMLParser::GetUTF16Char;
+	// Slurp the file in one read instead of pulling it through p_fgetc a character at a time
+	p_fseek(aFile, 0, SEEK_END);
+	long aFileLen = p_ftell(aFile);
+	p_fseek(aFile, 0, SEEK_SET);
 
-			p_ungetc(aChar2, mFile);
-			p_ungetc(aChar1, mFile);			
-		}
-		if ((mGetCharFunc = &XMLParser::GetAsciiChar))
-		{
-			if (aFileLen >= 3) // UTF-8?
-			{
-				int aChar1 = p_fgetc(mFile);
-				int aChar2 = p_fgetc(mFile);
-				int aChar3 = p_fgetc(mFile);
+	std::string aData;
+	aData.resize(aFileLen > 0 ? aFileLen : 0);
+	aData.resize(p_fread(aData.data(), 1, aData.size(), aFile));
+	p_fclose(aFile);
 
-				if (aChar1 == 0xEF && aChar2 == 0xBB && aChar3 == 0xBF)
-					mGetCharFunc = &XMLParser::GetUTF8Char;
+	mFileName = theFileName;
+	Init();
 
-				p_ungetc(aChar3, mFile);
-				p_ungetc(aChar2, mFile);
-				p_ungetc(aChar1, mFile);			
-			}
-		}
+	XMLEncodingType anEncoding = mEncoding;
+	if (!mForcedEncodingType)
+	{
+		const unsigned char* aBytes = (const unsigned char*)aData.data();
+		if (aData.size() >= 2 && ((aBytes[0] == 0xFF && aBytes[1] == 0xFE) || (aBytes[0] == 0xFE && aBytes[1] == 0xFF)))
+			anEncoding = UTF_16;
+		else
+			anEncoding = UTF_8;
 	}
-
-	mFileName = theFileName.c_str();
-	Init();
+	SetSource(aData, anEncoding);
 	return true;
 }
 
 void XMLParser::SetStringSource(const std::string& theString)
+{
+	SetBufferSource(theString);
+}
+
+void XMLParser::SetBufferSource(std::string_view theData)
 {
 	Init();
+	SetSource(theData, UTF_8);
+}
+
+// Copies the rest of a token straight from the source. Stops at the first character that
+// NextElement would treat differently from the one just appended to theDest.
+void XMLParser::AppendRun(std::string& theDest, bool theInQuote, bool theStopAtEquals)
+{
+	if (!mBufferedText.empty())
+		return;
 
-	size_t offset = 0;
-	if (theString.size() >= 3 &&
-		(unsigned char)theString[0] == 0xEF &&
-		(unsigned char)theString[1] == 0xBB &&
-		(unsigned char)theString[2] == 0xBF)
+	const char* aStart = mSource.data() + mSourcePos;
+	const char* anEnd = mSource.data() + mSource.size();
+	const char* aPos = aStart;
+	if (theInQuote)
 	{
-		offset = 3;
+		while (aPos < anEnd && *aPos != '"' && !(theStopAtEquals && *aPos == '='))
+		{
+			if (*aPos == '\n')
+				mLineNum++;
+			aPos++;
+		}
+	}
+	else
+	{
+		while (aPos < anEnd)
+		{
+			unsigned char c = (unsigned char)*aPos;
+			if (c <= 32 || c >= 128 || c == '"' || c == '<' || c == '>' || (theStopAtEquals && c == '='))
+				break;
+			aPos++;
+		}
 	}
 
-	int aSize = (int)theString.size() - (int)offset;
-	mBufferedText.resize(aSize);
-	for (int i = 0; i < aSize; i++)
-		mBufferedText[i] = theString[theString.size() - 1 - i];
+	theDest.append(aStart, aPos - aStart);
+	mSourcePos += aPos - aStart;
 }
 
 bool XMLParser::NextElement(XMLElement* theElement)
@@ -316,7 +254,8 @@ bool XMLParser::NextElement(XMLElement* theElement)
 		theElement->mType = XMLElement::TYPE_NONE;
 		theElement->mSection = mSection;
 		theElement->mValue = "";
-		theElement->mAttributes.clear();			
+		theElement->mAttributes.clear();
+		theElement->mAttributeIteratorList.clear();
 		theElement->mInstruction.erase();
 
 		bool hasSpace = false;	
@@ -344,25 +283,15 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
 				aVal = 1;
 			}
+			else if (mSourcePos < mSource.size())
+			{
+				c = mSource[mSourcePos++];
+				aVal = 1;
+			}
 			else
 			{
-				if (mFile != nullptr)
-				{
-					bool error = false;
-					if ((this->*mGetCharFunc)(&c, &error))
-					{
-						aVal = 1;
-					}
-					else
-					{
-						if (error) Fail("Illegal Character");
-						aVal = 0;
-					}
-				}
-				else
-				{
-					aVal = 0;
-				}
+				if (mSourceError) Fail("Illegal Character");
+				aVal = 0;
 			}
 			
 			if (aVal == 1)
@@ -386,9 +315,20 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
 					if ((c == '>') && (aLen >= 3) && ((*aStrPtr)[aLen - 2] == '-') && ((*aStrPtr)[aLen - 3] == '-'))
 					{
-						*aStrPtr = aStrPtr->substr(0, aLen - 3);
+						aStrPtr->resize(aLen - 3);
 						break;
 					}
+
+					// Nothing but '>' can end the comment, so take everything before the next one in bulk
+					if (mBufferedText.empty())
+					{
+						size_t anEnd = mSource.find('>', mSourcePos);
+						if (anEnd == std::string::npos)
+							anEnd = mSource.size();
+						mLineNum += (int)std::count(mSource.begin() + mSourcePos, mSource.begin() + anEnd, '\n');
+						aStrPtr->append(mSource, mSourcePos, anEnd - mSourcePos);
+						mSourcePos = anEnd;
+					}
 				}
 				else if (theElement->mType == XMLElement::TYPE_INSTRUCTION)
 				{
@@ -463,8 +403,8 @@ bool XMLParser::NextElement(XMLElement* theElement)
 									{										
 //										theElement->mAttributes[aLastAttributeKey] = aAttributeValue;
 
-										aAttributeKey = XMLDecodeString(aAttributeKey);
-										aAttributeValue = XMLDecodeString(aAttributeValue);
+										XMLDecodeInPlace(aAttributeKey);
+										XMLDecodeInPlace(aAttributeValue);
 
 										aLastAttributeKey = aAttributeKey;
 										AddAttribute(theElement, aLastAttributeKey, aAttributeValue);
@@ -593,6 +533,8 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
 					if (processChar)
 					{
+						std::string* aRunDest = nullptr;
+
 						if (theElement->mType == XMLElement::TYPE_NONE)
 							theElement->mType = XMLElement::TYPE_ELEMENT;
 
@@ -605,8 +547,8 @@ bool XMLParser::NextElement(XMLElement* theElement)
 								{
 									if (doingAttribute)
 									{
-										aAttributeKey = XMLDecodeString(aAttributeKey);
-										aAttributeValue = XMLDecodeString(aAttributeValue);
+										XMLDecodeInPlace(aAttributeKey);
+										XMLDecodeInPlace(aAttributeValue);
 
 //										theElement->mAttributes[aAttributeKey] = aAttributeValue;
 
@@ -633,6 +575,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
 							if (!doingAttribute)
 							{
 								theElement->mValue += c;
+								aRunDest = &theElement->mValue;
 							}
 							else
 							{
@@ -653,6 +596,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
 							if (aStrPtr != nullptr)
 							{								
 								*aStrPtr += c;						
+								aRunDest = aStrPtr;
 							}
 						}
 						else
@@ -664,7 +608,12 @@ bool XMLParser::NextElement(XMLElement* theElement)
 							}
 							
 							theElement->mValue += c;
+							aRunDest = &theElement->mValue;
 						}
+
+						// The following characters up to the next delimiter all land in the same string
+						if (aRunDest != nullptr)
+							AppendRun(*aRunDest, inQuote, theElement->mType == XMLElement::TYPE_START && doingAttribute);
 					}
 				}
 			}
@@ -679,14 +628,14 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
 		if (aAttributeKey.length() > 0)
 		{
-			aAttributeKey = XMLDecodeString(aAttributeKey);
-			aAttributeValue = XMLDecodeString(aAttributeValue);
+			XMLDecodeInPlace(aAttributeKey);
+			XMLDecodeInPlace(aAttributeValue);
 //			theElement->mAttributes[aAttributeKey] = aAttributeValue;
 
 			AddAttribute(theElement, aAttributeKey, aAttributeValue);
 		}
 
-		theElement->mValue = XMLDecodeString(theElement->mValue);				
+		XMLDecodeInPlace(theElement->mValue);				
 
 		// Ignore comments
 		if ((theElement->mType != XMLElement::TYPE_COMMENT) || mAllowComments)
@@ -4,11 +4,10 @@
 #include "Common.h"
 
 #include <list>
+#include <string_view>
 
 #include "PerfTimer.h"
 
-struct PFILE;
-
 namespace Sexy
 {
 
@@ -48,19 +47,29 @@ public:
 
 class XMLParser
 {
+public:
+	enum XMLEncodingType
+	{
+		ASCII,
+		UTF_8,
+		UTF_16,
+		UTF_16_LE,
+		UTF_16_BE
+	};
+
 protected:
 	std::string				mFileName;
 	std::string				mErrorText;
 	int						mLineNum;
-	PFILE*					mFile;
 	bool					mHasFailed;
 	bool					mAllowComments;
-	XMLParserBuffer			mBufferedText;
+	std::string				mSource;			// whole document, decoded to UTF-8
+	size_t					mSourcePos;
+	bool					mSourceError;		// decoding stopped early on an illegal character
+	XMLParserBuffer			mBufferedText;		// pushed-back characters, read before mSource (last in, first out)
 	std::string				mSection;
-	bool					(XMLParser::*mGetCharFunc)(char* theChar, bool* error);
+	XMLEncodingType			mEncoding;
 	bool					mForcedEncodingType;
-	bool					mFirstChar;
-	bool					mByteSwap;
 
 protected:
 	void					Fail(const std::string& theErrorText);
@@ -68,21 +77,9 @@ protected:
 
 	bool					AddAttribute(XMLElement* theElement, const std::string& aAttributeKey, const std::string& aAttributeValue);
 
-	bool					GetAsciiChar(char* theChar, bool* error);
-	bool					GetUTF8Char(char* theChar, bool* error);
-	bool					GetUTF16Char(char* theChar, bool* error);
-	bool					GetUTF16LEChar(char* theChar, bool* error);
-	bool					GetUTF16BEChar(char* theChar, bool* error);
-
-public:
-	enum XMLEncodingType
-	{
-		ASCII,
-		UTF_8,
-		UTF_16,
-		UTF_16_LE,
-		UTF_16_BE
-	};
+	void					SetSource(std::string_view theData, XMLEncodingType theEncoding);
+	void					DecodeUTF16(std::string_view theData, bool theBigEndian);
+	void					AppendRun(std::string& theDest, bool theInQuote, bool theStopAtEquals);
 
 public:
 	XMLParser();
@@ -91,6 +88,7 @@ public:
 	void					SetEncodingType(XMLEncodingType theEncoding);
 	bool					OpenFile(const std::string& theFilename);
 	void					SetStringSource(const std::string& theString);
+	void					SetBufferSource(std::string_view theData);
 	bool					NextElement(XMLElement* theElement);
 	std::string				GetErrorText();
 	int						GetCurrentLineNum();
@@ -1289,6 +1289,7 @@ GLInterface::GLInterface(SexyAppBase* theApp)
 	mDisplayHeight = mHeight;
 
 	mPresentationRect = Rect( 0, 0, mWidth, mHeight );
+	memset(&mLastFrameStats, 0, sizeof(mLastFrameStats));
 
 	mRefreshRate = 60;
 	mMillisecondsPerFrame = 1000/mRefreshRate;
@@ -1509,6 +1510,46 @@ void GLInterface::Flush()
 	C3D_FrameDrawOn(bottomTarget);
 }
 
+// Offscreen targets are not wired up on the 3DS yet; callers fall back to drawing directly.
+bool GLInterface::BeginRenderTarget(MemoryImage* theImage)
+{
+	return false;
+}
+
+void GLInterface::EndRenderTarget()
+{
+}
+
+bool GLInterface::StartRenderStatsLog(const std::string& theFileName)
+{
+	return false;
+}
+
+void GLInterface::StopRenderStatsLog()
+{
+}
+
+// Texture residency is not managed on the 3DS; every texture stays until its image is deleted
+void GLInterface::SetTextureBudget(int64_t theBytes)
+{
+	(void)theBytes;
+}
+
+int64_t GLInterface::GetResidentTextureBytes()
+{
+	return 0;
+}
+
+bool GLInterface::EvictTexture(MemoryImage* theImage)
+{
+	(void)theImage;
+	return false;
+}
+
+void GLInterface::EnforceTextureBudget()
+{
+}
+
 bool GLInterface::CreateImageTexture(MemoryImage *theImage)
 {
 	bool wantPurge = false;
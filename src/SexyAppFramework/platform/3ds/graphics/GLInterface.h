@@ -160,6 +160,25 @@ public:
 	void BltTriangles(const TriVertex theVertices[][3], int theNumTriangles, unsigned int theColor, float tx = 0, float ty = 0);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+struct RenderStats
+{
+	int mDrawCalls;
+	int mVertices;
+	int mTextureBinds;
+	int mBlendChanges;
+	int mTextureUploads;
+	int64_t mTextureUploadBytes;
+	int mFramebufferSwitches;
+	int mTextureHits;
+	int mTextureMisses;
+	int mTextureEvictions;
+	int64_t mResidentTextureBytes;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 class GLInterface : public NativeDisplay
 {
 public:
@@ -189,6 +208,8 @@ public:
 	typedef std::list<SexyMatrix3> TransformStack;
 	TransformStack mTransformStack;
 
+	RenderStats				mLastFrameStats;	// not collected on the 3DS, always zero
+
 	void					SetDrawMode(int theDrawMode);
 
 public:
@@ -215,6 +236,17 @@ public:
 	bool					PreDraw();
 	void					Flush();
 
+	bool					BeginRenderTarget(MemoryImage* theImage);
+	void					EndRenderTarget();
+
+	bool					StartRenderStatsLog(const std::string& theFileName);
+	void					StopRenderStatsLog();
+
+	void					SetTextureBudget(int64_t theBytes);
+	int64_t					GetResidentTextureBytes();
+	bool					EvictTexture(MemoryImage* theImage);
+	void					EnforceTextureBudget();
+
 	bool					CreateImageTexture(MemoryImage* theImage);
 	bool					RecoverBits(MemoryImage* theImage);
 	void					Blt(Image* theImage, float theX, float theY, const Rect& theSrcRect, const Color& theColor, int theDrawMode, bool linearFilter = false);
@@ -48,39 +48,28 @@ bool SexyAppBase::ProcessDeferredMessages(bool singleMessage)
 
 					case SDL_WINDOWEVENT_FOCUS_GAINED:
 					case SDL_WINDOWEVENT_FOCUS_LOST:
-						mActive = event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED;
-						RehupFocus();
+						InputActivate(event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED);
 						break;
 				}
 				break;
 
 			case SDL_MOUSEMOTION:
 			{
-				if (!mMouseIn)
-					mMouseIn = true;
-
 				int x = event.motion.x;
 				int y = event.motion.y;
 				mWidgetManager->RemapMouse(x, y);
-
-				mLastUserInputTick = mLastTimerTime;
-				
-				mWidgetManager->MouseMove(x, y);
+				mMouseIn = true;
+				InputMouseMove(x, y);
 				break;
 			}
 
 			case SDL_MOUSEBUTTONDOWN:
 			{
-				if (!mMouseIn)
-					mMouseIn = true;
-
 				int x = event.button.x;
 				int y = event.button.y;
 				mWidgetManager->RemapMouse(x, y);
+				mMouseIn = true;
 
-				mLastUserInputTick = mLastTimerTime;
-				
-				mWidgetManager->MouseMove(x, y);
 				int btn =
 					(event.button.button == SDL_BUTTON_LEFT) ? 1 :
 					(event.button.button == SDL_BUTTON_RIGHT) ? -1 :
@@ -88,44 +77,36 @@ bool SexyAppBase::ProcessDeferredMessages(bool singleMessage)
 				if (event.button.clicks == 2)
 					btn = (event.button.button == SDL_BUTTON_LEFT) ? 2 : -2;
 
-				mWidgetManager->MouseDown(x, y, btn);
+				InputMouseDown(x, y, btn);
 				break;
 			}
 
 			case SDL_MOUSEBUTTONUP:
 			{
-				if (!mMouseIn)
-					mMouseIn = true;
-
 				int x = event.button.x;
 				int y = event.button.y;
 				mWidgetManager->RemapMouse(x, y);
+				mMouseIn = true;
 
-				mLastUserInputTick = mLastTimerTime;
-				
-				mWidgetManager->MouseMove(x, y);
 				int btn =
 					(event.button.button == SDL_BUTTON_LEFT) ? 1 :
 					(event.button.button == SDL_BUTTON_RIGHT) ? -1 :
 					3;
 
-				mWidgetManager->MouseUp(x, y, btn);
+				InputMouseUp(x, y, btn);
 				break;
 			}
 
 			case SDL_KEYDOWN:
-				mLastUserInputTick = mLastTimerTime;
-				mWidgetManager->KeyDown((KeyCode)event.key.keysym.sym);
+				InputKeyDown((KeyCode)event.key.keysym.sym);
 				break;
 
 			case SDL_KEYUP:
-				mLastUserInputTick = mLastTimerTime;
-				mWidgetManager->KeyUp((KeyCode)event.key.keysym.sym);
+				InputKeyUp((KeyCode)event.key.keysym.sym);
 				break;
 
 			case SDL_TEXTINPUT:
-				mLastUserInputTick = mLastTimerTime;
-				mWidgetManager->KeyChar((char)event.text.text[0]);
+				InputKeyChar((char)event.text.text[0]);
 				break;
 		}
 	}
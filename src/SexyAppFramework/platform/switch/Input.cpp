@@ -83,7 +83,7 @@ bool SexyAppBase::ProcessDeferredMessages(bool singleMessage)
 		for (auto& k : keyMaps)
 		{
 			if (kDown & k.first)
-				mWidgetManager->KeyDown(k.second);
+				InputKeyDown(k.second);
 		}
 	}
 
@@ -94,7 +94,7 @@ bool SexyAppBase::ProcessDeferredMessages(bool singleMessage)
 		for (auto& k : keyMaps)
 		{
 			if (kDown & k.first)
-				mWidgetManager->KeyUp(k.second);
+				InputKeyUp(k.second);
 		}
 	}
 
@@ -108,13 +108,13 @@ bool SexyAppBase::ProcessDeferredMessages(bool singleMessage)
 		x = (int)state.touches[0].x;
 		y = (int)state.touches[0].y;
 		mWidgetManager->RemapMouse(x, y);
-		mWidgetManager->MouseMove(x, y);
+		InputMouseMove(x, y);
 	}
 
 	if (state.count && !prev_touchcount)
-		mWidgetManager->MouseDown(x, y, 1);
+		InputMouseDown(x, y, 1);
 	else if (!state.count && prev_touchcount)
-		mWidgetManager->MouseUp(x, y, 1);
+		InputMouseUp(x, y, 1);
 
 	prev_touchcount = state.count;
 
@@ -0,0 +1,208 @@
+#include "ToolApp.h"
+#include "LawnApp.h"
+#include "Sexy.TodLib/Trail.h"
+#include "Sexy.TodLib/Definition.h"
+#include "Sexy.TodLib/Reanimator.h"
+#include "Sexy.TodLib/TodParticle.h"
+#include "misc/PerfTimer.h"
+#include "misc/XMLParser.h"
+#include "paklib/PakInterface.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+using namespace Sexy;
+
+static const int DEFINITION_BENCH_THREADS[] = { 1, 2, 4, 8 };
+static const int DEFINITION_BENCH_RUNS = 3;
+static const int XML_BENCH_PASSES = 10;
+
+// The game keeps its own definitions while a second set is loaded and freed, so nothing that still points
+// at them (the title screen's animations, the effect system) is left dangling
+static double TimeReanimLoad()
+{
+	unsigned int aDefCount = gReanimatorDefCount, aParamCount = gReanimationParamArraySize;
+	ReanimatorDefinition* aDefArray = gReanimatorDefArray;
+	ReanimationParams* aParamArray = gReanimationParamArray;
+	gReanimatorDefCount = gReanimationParamArraySize = 0;
+	gReanimatorDefArray = nullptr;
+	gReanimationParamArray = nullptr;
+
+	PerfTimer aTimer;
+	aTimer.Start();
+	ReanimatorLoadDefinitions(gLawnReanimationArray, ReanimationType::NUM_REANIMS);
+	double aDuration = aTimer.GetDuration();
+	ReanimatorFreeDefinitions();
+
+	gReanimatorDefCount = aDefCount;
+	gReanimationParamArraySize = aParamCount;
+	gReanimatorDefArray = aDefArray;
+	gReanimationParamArray = aParamArray;
+	return aDuration;
+}
+
+static double TimeParticleLoad()
+{
+	int aDefCount = gParticleDefCount, aParamCount = gParticleParamArraySize;
+	TodParticleDefinition* aDefArray = gParticleDefArray;
+	ParticleParams* aParamArray = gParticleParamArray;
+	gParticleDefCount = gParticleParamArraySize = 0;
+	gParticleDefArray = nullptr;
+	gParticleParamArray = nullptr;
+
+	PerfTimer aTimer;
+	aTimer.Start();
+	TodParticleLoadDefinitions(gLawnParticleArray, LENGTH(gLawnParticleArray));
+	double aDuration = aTimer.GetDuration();
+	TodParticleFreeDefinitions();
+
+	gParticleDefCount = aDefCount;
+	gParticleParamArraySize = aParamCount;
+	gParticleDefArray = aDefArray;
+	gParticleParamArray = aParamArray;
+	return aDuration;
+}
+
+static double TimeTrailLoad()
+{
+	int aDefCount = gTrailDefCount, aParamCount = gTrailParamArraySize;
+	TrailDefinition* aDefArray = gTrailDefArray;
+	TrailParams* aParamArray = gTrailParamArray;
+	gTrailDefCount = gTrailParamArraySize = 0;
+	gTrailDefArray = nullptr;
+	gTrailParamArray = nullptr;
+
+	PerfTimer aTimer;
+	aTimer.Start();
+	TrailLoadDefinitions(gLawnTrailArray, LENGTH(gLawnTrailArray));
+	double aDuration = aTimer.GetDuration();
+	TrailFreeDefinitions();
+
+	gTrailDefCount = aDefCount;
+	gTrailParamArraySize = aParamCount;
+	gTrailDefArray = aDefArray;
+	gTrailParamArray = aParamArray;
+	return aDuration;
+}
+
+// Loads the compiled definitions (written by the first, normal load) with each thread count and prints the
+// best of DEFINITION_BENCH_RUNS runs per loader
+static bool BenchmarkDefinitionLoading()
+{
+	int aSavedThreads = gDefinitionLoadThreads;
+	printf("%-8s %10s %10s %10s %10s\n", "threads", "reanim ms", "particle", "trail", "total");
+	for (int aThreads : DEFINITION_BENCH_THREADS)
+	{
+		gDefinitionLoadThreads = aThreads;
+		double aReanim = 1e9, aParticle = 1e9, aTrail = 1e9;
+		for (int aRun = 0; aRun < DEFINITION_BENCH_RUNS; aRun++)
+		{
+			aReanim = std::min(aReanim, TimeReanimLoad());
+			aParticle = std::min(aParticle, TimeParticleLoad());
+			aTrail = std::min(aTrail, TimeTrailLoad());
+		}
+		printf("%-8d %10.1f %10.1f %10.1f %10.1f\n", aThreads, aReanim, aParticle, aTrail, aReanim + aParticle + aTrail);
+	}
+	gDefinitionLoadThreads = aSavedThreads;
+	return true;
+}
+
+// Encodes every loaded definition with each codec and times decoding them (see DefinitionBenchmarkCodecs)
+static bool BenchmarkDefinitionCodecs()
+{
+	std::vector<std::pair<DefMap*, void*>> aDefinitions;
+	for (unsigned int i = 0; i < gReanimatorDefCount; i++)
+		if (gReanimatorDefArray[i].mTracks.tracks != nullptr)
+			aDefinitions.emplace_back(&gReanimatorDefMap, &gReanimatorDefArray[i]);
+	for (int i = 0; i < gParticleDefCount; i++)
+		aDefinitions.emplace_back(&gParticleDefMap, &gParticleDefArray[i]);
+	for (int i = 0; i < gTrailDefCount; i++)
+		aDefinitions.emplace_back(&gTrailDefMap, &gTrailDefArray[i]);
+	DefinitionBenchmarkCodecs(aDefinitions);
+	return true;
+}
+
+// Fully parses the resource manifest and the largest reanim XML XML_BENCH_PASSES times and prints the average
+static bool BenchmarkXMLParser()
+{
+	std::string aLargestReanim;
+	long aLargestSize = -1;
+	for (const ReanimationParams& aParams : gLawnReanimationArray)
+	{
+		PFILE* aFile = p_fopen(aParams.mReanimFileName, "rb");
+		if (aFile == nullptr)
+			continue;
+		p_fseek(aFile, 0, SEEK_END);
+		long aSize = p_ftell(aFile);
+		p_fclose(aFile);
+		if (aSize > aLargestSize)
+		{
+			aLargestSize = aSize;
+			aLargestReanim = aParams.mReanimFileName;
+		}
+	}
+
+	bool aPassed = true;
+	printf("%-40s %10s %10s\n", "file", "elements", "ms");
+	for (const std::string& aFileName : { std::string("properties/resources.xml"), aLargestReanim })
+	{
+		if (aFileName.empty())
+			continue;
+
+		int anElementCount = 0;
+		PerfTimer aTimer;
+		aTimer.Start();
+		for (int aPass = 0; aPass < XML_BENCH_PASSES; aPass++)
+		{
+			XMLParser aParser;
+			if (!aParser.OpenFile(aFileName))
+			{
+				printf("%s: %s\n", aFileName.c_str(), aParser.GetErrorText().c_str());
+				aPassed = false;
+				break;
+			}
+			XMLElement anElement;
+			while (aParser.NextElement(&anElement))
+				anElementCount++;
+		}
+		printf("%-40s %10d %10.2f\n", aFileName.c_str(), anElementCount / XML_BENCH_PASSES, aTimer.GetDuration() / XML_BENCH_PASSES);
+	}
+	return aPassed;
+}
+
+struct BenchmarkEntry
+{
+	const char*				mName;
+	const char*				mDescription;
+	bool					(*mRun)();
+};
+
+static const BenchmarkEntry BENCHMARKS[] = {
+	{ "defload", "load the reanim, particle and trail definitions with 1, 2, 4 and 8 threads", BenchmarkDefinitionLoading },
+	{ "defcodec", "compress every loaded definition with each compiled cache codec and time decoding", BenchmarkDefinitionCodecs },
+	{ "xmlparse", "parse properties/resources.xml and the largest reanim XML", BenchmarkXMLParser },
+};
+
+// Usage: pvz-bench <benchmark> [game options]
+// Brings the game up without its main loop (see ToolStartApp), runs one benchmark and prints its table.
+int main(int argc, char** argv)
+{
+	const BenchmarkEntry* aBenchmark = nullptr;
+	for (const BenchmarkEntry& anEntry : BENCHMARKS)
+		if (argc >= 2 && strcmp(argv[1], anEntry.mName) == 0)
+			aBenchmark = &anEntry;
+	if (aBenchmark == nullptr)
+	{
+		printf("usage: pvz-bench <benchmark> [game options]\n");
+		for (const BenchmarkEntry& anEntry : BENCHMARKS)
+			printf("  %-10s %s\n", anEntry.mName, anEntry.mDescription);
+		return 2;
+	}
+
+	LawnApp* anApp = ToolStartApp(std::vector<std::string>(argv + 2, argv + argc));
+	if (anApp == nullptr)
+		return 2;
+
+	bool aPassed = aBenchmark->mRun();
+	ToolShutdownApp();
+	return aPassed ? 0 : 1;
+}
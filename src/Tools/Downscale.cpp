@@ -0,0 +1,104 @@
+#include "Common.h"
+#include "imagelib/ImageLib.h"
+#include "paklib/PakInterface.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+using namespace Sexy;
+
+static bool IsImageFileName(const std::string& theFileName)
+{
+	size_t aDot = theFileName.rfind('.');
+	std::string anExt = aDot == std::string::npos ? "" : StringToLower(theFileName.substr(aDot));
+	return anExt == ".png" || anExt == ".jpg" || anExt == ".gif" || anExt == ".tga";
+}
+
+// Every image in main.pak, or every image file under the resource folder when there is no pak
+static std::vector<std::string> GetImageFileNames(const std::string& theResourceDir)
+{
+	std::vector<std::string> aFileNames;
+	for (const auto& [aKey, aRecord] : gPakInterface->mPakRecordMap)
+		if (IsImageFileName(aRecord.mFileName))
+			aFileNames.push_back(aRecord.mFileName);
+	if (aFileNames.empty())
+	{
+		std::error_code anError;
+		std::filesystem::path aRoot = PathFromU8(theResourceDir);
+		for (const auto& anEntry : std::filesystem::recursive_directory_iterator(aRoot, anError))
+			if (anEntry.is_regular_file() && IsImageFileName(PathToU8(anEntry.path())))
+				aFileNames.push_back(PathToU8(anEntry.path().lexically_relative(aRoot)));
+	}
+	return aFileNames;
+}
+
+// Usage: pvz-downscale <resource dir> <output dir> [factor]
+// Shrinks every image of the game data with ImageLib::DownscaleImage and writes it as png under the output dir,
+// laid out like the pak, together with DOWNSCALE_MARKER_FILE. Builds with the same DOWNSCALE_COUNT then load
+// the packed output without shrinking it again. Needs neither a display nor the rest of the game.
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: pvz-downscale <resource dir> <output dir> [factor]\n");
+		return 2;
+	}
+	std::string aResourceDir = argv[1];
+	std::string anOutputDir = argv[2];
+#if IMG_DOWNSCALE != 1
+	const int aFactor = IMG_DOWNSCALE;  // GetImage already shrinks every image
+	if (argc > 3 && atoi(argv[3]) != aFactor)
+	{
+		printf("pvz-downscale: this build always shrinks by %d (DOWNSCALE_COUNT)\n", aFactor);
+		return 2;
+	}
+#else
+	const int aFactor = argc > 3 ? atoi(argv[3]) : 2;
+	if (aFactor < 2)
+	{
+		printf("pvz-downscale: the factor must be at least 2\n");
+		return 2;
+	}
+#endif
+
+	SetResourceFolder(aResourceDir);
+	gPakInterface->AddPakFile(GetResourcePath("main.pak"));
+
+	int aNumWritten = 0;
+	int aNumFailed = 0;
+	for (std::string aFileName : GetImageFileNames(aResourceDir))
+	{
+		std::unique_ptr<ImageLib::Image> anImage(ImageLib::GetImage(aFileName, false));
+		if (anImage == nullptr || anImage->mBits == nullptr)
+		{
+			printf("%s: could not be read\n", aFileName.c_str());
+			aNumFailed++;
+			continue;
+		}
+#if IMG_DOWNSCALE == 1
+		ImageLib::DownscaleImage(anImage.get(), aFactor);
+#endif
+
+		std::replace(aFileName.begin(), aFileName.end(), '\\', '/');
+		size_t aDot = aFileName.rfind('.');
+		if (aDot != std::string::npos && aDot > aFileName.rfind('/') + 1)
+			aFileName.resize(aDot);
+		std::string aPath = anOutputDir + "/" + aFileName + ".png";
+		MkDir(GetFileDir(aPath));
+		if (ImageLib::WritePNGImage(aPath, anImage.get()))
+			aNumWritten++;
+		else
+		{
+			printf("%s: could not be written\n", aPath.c_str());
+			aNumFailed++;
+		}
+	}
+
+	std::string aMarkerPath = anOutputDir + "/" + DOWNSCALE_MARKER_FILE;
+	MkDir(GetFileDir(aMarkerPath));
+	std::ofstream aMarker(PathFromU8(aMarkerPath), std::ios::out | std::ios::binary | std::ios::trunc);
+	aMarker << aFactor;
+	printf("downscaled %d images by %d into '%s', %d failed\n", aNumWritten, aFactor, anOutputDir.c_str(), aNumFailed);
+	return aNumFailed == 0 && aMarker.good() ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include "ToolApp.h"
+#include "LawnApp.h"
+#include "Lawn/Board.h"
+#include "Lawn/System/SaveGame.h"
+#include <cstdio>
+#include <filesystem>
+using namespace Sexy;
+
+// Usage: pvz-exportlegacy <userdata dir> [game options]
+// The game only writes .v4 saves. This loads every gameX_Y.v4 save in the folder into a scratch board and writes
+// it back as the old-format gameX_Y.dat next to it, for builds that cannot read .v4 saves. Delta saves are read
+// together with their base. Exits with 1 if any save could not be converted.
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: pvz-exportlegacy <userdata dir> [game options]\n");
+		return 2;
+	}
+	std::filesystem::path aSaveDir = PathFromU8(argv[1]);
+	std::vector<std::string> anArgs(argv + 2, argv + argc);
+
+	LawnApp* anApp = ToolStartApp(anArgs);
+	if (anApp == nullptr)
+		return 2;
+
+	int aNumExported = 0;
+	int aNumFailed = 0;
+	std::error_code anError;
+	for (const std::filesystem::directory_entry& anEntry : std::filesystem::directory_iterator(aSaveDir, anError))
+	{
+		int aProfileId, aMode;
+		std::string aName = PathToU8(anEntry.path().filename());
+		if (sscanf(aName.c_str(), "game%d_%d", &aProfileId, &aMode) != 2 || aName != StrFormat("game%d_%d.v4", aProfileId, aMode))
+			continue;
+
+		std::string aLegacyPath = PathToU8(anEntry.path().parent_path() / StrFormat("game%d_%d.dat", aProfileId, aMode));
+		anApp->mGameMode = (GameMode)aMode;
+		anApp->MakeNewBoard();
+		if (LawnExportLegacySave(anApp->mBoard, PathToU8(anEntry.path()), aLegacyPath))
+			aNumExported++;
+		else
+		{
+			printf("%s: could not be converted\n", aName.c_str());
+			aNumFailed++;
+		}
+		anApp->mBoardResult = BoardResult::BOARDRESULT_NONE;  // keeps KillBoard from erasing the save
+		anApp->KillBoard();
+	}
+	if (anError)
+		printf("%s: %s\n", argv[1], anError.message().c_str());
+
+	printf("exported %d legacy saves, %d failed\n", aNumExported, aNumFailed);
+	ToolShutdownApp();
+	return aNumFailed == 0 && !anError ? 0 : 1;
+}
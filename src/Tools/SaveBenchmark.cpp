@@ -0,0 +1,272 @@
+#include "ToolApp.h"
+#include "LawnApp.h"
+#include "Lawn/Board.h"
+#include "Lawn/System/Music.h"
+#include "Lawn/System/SaveGame.h"
+#include "Lawn/System/BoardSnapshot.h"
+#include "misc/MTRand.h"
+#include "misc/PerfTimer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+using namespace Sexy;
+
+static const int SAVE_ROUND_TRIP_DEFAULT_OBJECTS = 100;
+static const int SAVE_ROUND_TRIP_MAX_OBJECTS = 200;
+static const int SAVE_FUZZ_DEFAULT_ITERATIONS = 1000;
+static const int SAVE_FUZZ_BOARD_OBJECTS = 20;			// board size when only -savefuzz is given
+static const int BENCHMARK_PASSES = 5;
+static const int SNAPSHOT_TEST_UPDATES = 100;
+static const int DELTA_TEST_SAVES = 40;
+static const int DELTA_TEST_UPDATES = 25;
+
+// Places theCount zombies on the lawn, plus plants, particles and animations in proportion; each DataArray's capacity limits the counts
+static void PopulateSaveTestBoard(LawnApp* theApp, Board* theBoard, int theCount)
+{
+	static const ZombieType ZOMBIE_TYPES[] = { ZombieType::ZOMBIE_NORMAL, ZombieType::ZOMBIE_TRAFFIC_CONE, ZombieType::ZOMBIE_PAIL, ZombieType::ZOMBIE_FOOTBALL, ZombieType::ZOMBIE_POLEVAULTER };
+	static const SeedType SEED_TYPES[] = { SeedType::SEED_PEASHOOTER, SeedType::SEED_SUNFLOWER, SeedType::SEED_WALLNUT, SeedType::SEED_SNOWPEA, SeedType::SEED_REPEATER };
+	for (int i = 0; i < theCount; i++)
+	{
+		int aGridX = i % MAX_GRID_SIZE_X;
+		int aGridY = (i / MAX_GRID_SIZE_X) % 5;
+		theBoard->AddZombieInRow(ZOMBIE_TYPES[i % LENGTH(ZOMBIE_TYPES)], aGridY, 0);
+		if (i < MAX_GRID_SIZE_X * 5)
+			theBoard->AddPlant(aGridX, aGridY, SEED_TYPES[i % LENGTH(SEED_TYPES)]);
+		if (i % 2 == 0)
+		{
+			float aX = theBoard->GridToPixelX(aGridX, aGridY);
+			float aY = theBoard->GridToPixelY(aGridX, aGridY);
+			theApp->AddTodParticle(aX, aY, RenderLayer::RENDER_LAYER_PARTICLE, ParticleEffect::PARTICLE_PEA_SPLAT);
+			theApp->AddReanimation(aX, aY, RenderLayer::RENDER_LAYER_TOP, ReanimationType::REANIM_SUN);
+		}
+	}
+}
+
+static std::string FormatChunkList(const std::vector<uint32_t>& theChunkTypes)
+{
+	std::string aList;
+	for (uint32_t aChunkType : theChunkTypes)
+		aList += StrFormat(" %u", aChunkType);
+	return aList;
+}
+
+// Captures a snapshot of the board, lets it play on and restores it; the board must then save to the same chunks as before
+static bool TestBoardSnapshot(Board* theBoard, const std::string& theTempPath)
+{
+	SaveGameTimings aTimings;
+	std::vector<unsigned char> aBeforePayload;
+	std::vector<uint32_t> aDiffs;
+	BoardSnapshot aSnapshot;
+	PerfTimer aTimer;
+	aTimer.Start();
+	aSnapshot.Capture(theBoard);
+	double aCaptureTime = aTimer.GetDuration();
+	bool aRestored = LawnSaveGameTimed(theBoard, theTempPath, aTimings, aBeforePayload);
+	for (int i = 0; i < SNAPSHOT_TEST_UPDATES && aRestored; i++)
+		theBoard->Update();
+	aTimer.Start();
+	aRestored = aRestored && aSnapshot.Restore(theBoard);
+	double aRestoreTime = aTimer.GetDuration();
+	bool aPassed = aRestored && LawnCompareSaveGame(theBoard, aBeforePayload, aDiffs) && aDiffs.empty();
+
+	printf("board snapshot: %zu bytes, capture %.3f ms, restore %.3f ms after %d updates: %s%s\n", aSnapshot.GetMemoryUsage(), aCaptureTime, aRestoreTime,
+		SNAPSHOT_TEST_UPDATES, !aRestored ? "FAILED to save or restore" : aDiffs.empty() ? "all chunks equal" : "chunks differ:", FormatChunkList(aDiffs).c_str());
+	return aPassed;
+}
+
+// Lets the board play on from the same snapshot twice, saving it every few updates once as full saves and once as
+// delta saves, and compares the bytes and time per save
+static void BenchmarkDeltaSaves(LawnApp* theApp)
+{
+	std::string aDeltaPath = GetAppDataPath("userdata/savedelta.tmp");
+	BoardSnapshot aStart;
+	aStart.Capture(theApp->mBoard);
+	for (int aDelta = 0; aDelta < 2; aDelta++)
+	{
+		aStart.Restore(theApp->mBoard);
+		LawnEraseSaveGame(aDeltaPath);
+		SaveGameTimings aTimings;
+		std::vector<unsigned char> aScratch;
+		double aBytes = 0.0;
+		int aNumSaved = 0;
+		for (int i = 0; i < DELTA_TEST_SAVES; i++)
+		{
+			for (int j = 0; j < DELTA_TEST_UPDATES; j++)
+				theApp->mBoard->Update();
+			if (!(aDelta ? LawnSaveGameDeltaTimed(theApp->mBoard, aDeltaPath, aTimings) : LawnSaveGameTimed(theApp->mBoard, aDeltaPath, aTimings, aScratch)))
+				break;
+			aBytes += aTimings.mSize;
+			aNumSaved++;
+		}
+		const double aScale = 1.0 / std::max(aNumSaved, 1);
+		printf("save delta: %s saves (%s), %d of %d saved %d updates apart: %.0f bytes, serialize %.3f ms, encode and write %.3f ms per save\n",
+			aDelta ? "delta" : "full", SaveGameGetCodecName(gSaveGameCodec), aNumSaved, DELTA_TEST_SAVES, DELTA_TEST_UPDATES,
+			aBytes * aScale, aTimings.mSerialize * aScale, (aTimings.mEncode + aTimings.mWrite) * aScale);
+	}
+	LawnEraseSaveGame(aDeltaPath);
+}
+
+// Loads theIterations randomly corrupted copies of thePayload. The payload is re-encoded after corruption, so the
+// checksums pass and the damage reaches the chunk parsers, which must reject or tolerate it without crashing.
+static void FuzzSaveLoad(LawnApp* theApp, const std::vector<unsigned char>& thePayload, int theIterations)
+{
+	static const uint32_t EDGE_VALUES[] = { 0U, 1U, 0x7FU, 0xFFU, 0x7FFFFFFFU, 0x80000000U, 0xFFFFFFFFU };
+	MTRand aRand(0x5A5EF022);
+	int aNumAccepted = 0;
+	for (int i = 0; i < theIterations; i++)
+	{
+		std::vector<unsigned char> aMutated = thePayload;
+		int aNumMutations = 1 + aRand.NextNoAssert(4UL);
+		for (int j = 0; j < aNumMutations && !aMutated.empty(); j++)
+		{
+			size_t anOffset = aRand.NextNoAssert(static_cast<unsigned long>(aMutated.size()));
+			switch (aRand.NextNoAssert(4UL))
+			{
+			case 0:  // flip a bit
+				aMutated[anOffset] ^= 1 << aRand.NextNoAssert(8UL);
+				break;
+			case 1:  // write an edge value, which often lands on a length, count or ID
+			{
+				uint32_t aValue = EDGE_VALUES[aRand.NextNoAssert(static_cast<unsigned long>(LENGTH(EDGE_VALUES)))];
+				memcpy(aMutated.data() + anOffset, &aValue, std::min(sizeof(aValue), aMutated.size() - anOffset));
+				break;
+			}
+			case 2:  // truncate
+				aMutated.resize(anOffset);
+				break;
+			default:  // copy a run of bytes elsewhere
+			{
+				size_t aFrom = aRand.NextNoAssert(static_cast<unsigned long>(aMutated.size()));
+				size_t aLen = std::min<size_t>(1 + aRand.NextNoAssert(64UL), std::min(aMutated.size() - aFrom, aMutated.size() - anOffset));
+				memmove(aMutated.data() + anOffset, aMutated.data() + aFrom, aLen);
+				break;
+			}
+			}
+		}
+
+		std::vector<unsigned char> aData;
+		EncodeSaveGameV4(aMutated.data(), static_cast<unsigned int>(aMutated.size()), SAVE_CODEC_NONE, aData);
+		theApp->mBoardResult = BoardResult::BOARDRESULT_NONE;
+		theApp->MakeNewBoard();
+		if (LawnLoadGameFromData(theApp->mBoard, aData.data(), aData.size()))
+			aNumAccepted++;
+	}
+	printf("save fuzz: %d corrupted saves read, %d loaded, the rest rejected\n", theIterations, aNumAccepted);
+}
+
+// Builds an endless survival board with theNumObjects zombies and times each step of saving and loading it, then
+// saves the loaded board again and compares it chunk by chunk with the original. The loaded board also goes through
+// TestBoardSnapshot and, with -savedelta, BenchmarkDeltaSaves; FuzzSaveLoad runs last. Returns true if everything matched.
+static bool TestSaveRoundTrip(LawnApp* theApp, int theNumObjects, int theFuzzIterations)
+{
+	if (theApp->mPlayerInfo == nullptr)
+	{
+		printf("save round trip: no user profile\n");
+		return false;
+	}
+
+	std::string aTempPath = GetAppDataPath("userdata/saveroundtrip.tmp");
+	int aNumObjects = theNumObjects > 0 ? theNumObjects : SAVE_FUZZ_BOARD_OBJECTS;
+	theApp->mGameMode = GameMode::GAMEMODE_SURVIVAL_ENDLESS_STAGE_1;
+	theApp->MakeNewBoard();
+	theApp->mBoard->InitLevel();
+	PopulateSaveTestBoard(theApp, theApp->mBoard, aNumObjects);
+
+	SaveGameTimings aSaveTimings;
+	std::vector<unsigned char> aPayload;
+	bool aSaved = true;
+	for (int aPass = 0; aPass < BENCHMARK_PASSES && aSaved; aPass++)
+		aSaved = LawnSaveGameTimed(theApp->mBoard, aTempPath, aSaveTimings, aPayload);
+
+	SaveGameTimings aLoadTimings;
+	std::vector<uint32_t> aDiffs;
+	bool aLoaded = aSaved;
+	for (int aPass = 0; aPass < BENCHMARK_PASSES && aLoaded; aPass++)
+	{
+		theApp->mBoardResult = BoardResult::BOARDRESULT_NONE;
+		theApp->MakeNewBoard();
+		aLoaded = LawnLoadGameTimed(theApp->mBoard, aTempPath, aLoadTimings);
+	}
+	bool aCompared = aLoaded && LawnCompareSaveGame(theApp->mBoard, aPayload, aDiffs);
+
+	bool aSnapshotPassed = true;
+	if (theNumObjects > 0)
+	{
+		const double aScale = 1.0 / BENCHMARK_PASSES;
+		printf("save round trip: %d zombies, %d bytes (%s): serialize %.3f ms, crc %.3f ms, encode %.3f ms, write %.3f ms\n",
+			aNumObjects, aSaveTimings.mSize, SaveGameGetCodecName(gSaveGameCodec),
+			aSaveTimings.mSerialize * aScale, aSaveTimings.mCrc * aScale, aSaveTimings.mEncode * aScale, aSaveTimings.mWrite * aScale);
+		printf("save round trip: read %.3f ms, decode %.3f ms, parse %.3f ms, fix-up %.3f ms\n",
+			aLoadTimings.mRead * aScale, aLoadTimings.mDecode * aScale, aLoadTimings.mParse * aScale, aLoadTimings.mFixUp * aScale);
+		printf("save round trip: %s%s\n", !aCompared ? "FAILED to save or load" : aDiffs.empty() ? "all chunks equal" : "chunks differ:", FormatChunkList(aDiffs).c_str());
+
+		if (aLoaded)
+			aSnapshotPassed = TestBoardSnapshot(theApp->mBoard, aTempPath);
+	}
+	if (aLoaded && gSaveGameDelta)
+		BenchmarkDeltaSaves(theApp);
+	if (aSaved && theFuzzIterations > 0)
+		FuzzSaveLoad(theApp, aPayload, theFuzzIterations);
+
+	LawnEraseSaveGame(aTempPath);
+	theApp->mMusic->StopAllMusic();
+	return aCompared && aDiffs.empty() && aSnapshotPassed;
+}
+
+// Reads the value of "-name" or "-name=value"; theDefault when the value is left out
+static bool ParseToolOption(const std::string& theArg, const char* theName, int theDefault, int& theValue)
+{
+	std::string aPrefix = std::string("-") + theName;
+	if (theArg == aPrefix)
+		theValue = theDefault;
+	else if (theArg.rfind(aPrefix + "=", 0) == 0)
+		theValue = atoi(theArg.c_str() + aPrefix.size() + 1);
+	else
+		return false;
+	return true;
+}
+
+// Usage: pvz-savebench [-saveroundtrip[=N]] [-savefuzz[=N]] [game options]
+// -saveroundtrip builds a board with N zombies (default 100, 1 to 200) and runs TestSaveRoundTrip on it; -savefuzz
+// then loads N corrupted copies of its save (default 1000). The game options include -savecodec=..., -savedelta to
+// compare delta with full saves and -savebench[=dir] to compare the codecs over a folder of saves. Without
+// -saveroundtrip, -savefuzz or -savebench the round trip runs with 100 zombies. Exits with 1 if the round trip failed.
+int main(int argc, char** argv)
+{
+	int aNumObjects = 0;
+	int aFuzzIterations = 0;
+	bool aHaveSaveBench = false;
+	std::vector<std::string> anArgs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string anArg = argv[i];
+		if (ParseToolOption(anArg, "saveroundtrip", SAVE_ROUND_TRIP_DEFAULT_OBJECTS, aNumObjects))
+		{
+			if (aNumObjects < 1 || aNumObjects > SAVE_ROUND_TRIP_MAX_OBJECTS)
+			{
+				printf("pvz-savebench: -saveroundtrip takes 1 to %d zombies\n", SAVE_ROUND_TRIP_MAX_OBJECTS);
+				return 2;
+			}
+			continue;
+		}
+		if (ParseToolOption(anArg, "savefuzz", SAVE_FUZZ_DEFAULT_ITERATIONS, aFuzzIterations))
+		{
+			aFuzzIterations = std::max(aFuzzIterations, 0);
+			continue;
+		}
+		aHaveSaveBench |= anArg.rfind("-savebench", 0) == 0;
+		anArgs.push_back(anArg);
+	}
+	if (aNumObjects == 0 && aFuzzIterations == 0 && !aHaveSaveBench)
+		aNumObjects = SAVE_ROUND_TRIP_DEFAULT_OBJECTS;
+
+	LawnApp* anApp = ToolStartApp(anArgs);
+	if (anApp == nullptr)
+		return 2;
+
+	bool aPassed = true;
+	if (aNumObjects > 0 || aFuzzIterations > 0)
+		aPassed = TestSaveRoundTrip(anApp, aNumObjects, aFuzzIterations);
+	ToolShutdownApp();
+	return aPassed ? 0 : 1;
+}
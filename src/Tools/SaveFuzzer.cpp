@@ -0,0 +1,47 @@
+#include "ToolApp.h"
+#include "LawnApp.h"
+#include "Lawn/Board.h"
+#include "Lawn/System/SaveGame.h"
+#include <cstdint>
+#include <cstring>
+
+// libFuzzer target for the .v4 loader: DecodeSaveGameV4, the chunk list and ReadChunkV4 of every chunk.
+// An input that starts like a .v4 file is loaded as a whole file, so the header, the codecs and the crc checks
+// are fuzzed. Any other input is wrapped as an uncompressed payload with a valid crc, so mutations reach the
+// chunk readers. Good seeds are the mid-level saves (userdata/game*.v4). Like the game, the target needs the
+// game data; -resdir= and -savedir= on the command line are passed on to it, libFuzzer only warns about them.
+
+static LawnApp* gFuzzApp = nullptr;
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+	std::vector<std::string> anArgs;
+	for (int i = 1; i < *argc; i++)
+	{
+		std::string anArg = (*argv)[i];
+		if (anArg.rfind("-resdir=", 0) == 0 || anArg.rfind("-savedir=", 0) == 0)
+			anArgs.push_back(anArg);
+	}
+	gFuzzApp = ToolStartApp(anArgs);
+	if (gFuzzApp)
+		gFuzzApp->mGameMode = GameMode::GAMEMODE_SURVIVAL_ENDLESS_STAGE_1;
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* theData, size_t theSize)
+{
+	static const char FILE_MAGIC[] = "PVZP_SAVE4";
+	if (gFuzzApp == nullptr)
+		return 0;
+
+	std::vector<unsigned char> aFile;
+	if (theSize >= sizeof(FILE_MAGIC) - 1 && memcmp(theData, FILE_MAGIC, sizeof(FILE_MAGIC) - 1) == 0)
+		aFile.assign(theData, theData + theSize);
+	else
+		EncodeSaveGameV4(theData, static_cast<unsigned int>(theSize), SAVE_CODEC_NONE, aFile);
+
+	gFuzzApp->mBoardResult = BoardResult::BOARDRESULT_NONE;
+	gFuzzApp->MakeNewBoard();
+	LawnLoadGameFromData(gFuzzApp->mBoard, aFile.data(), aFile.size());
+	return 0;
+}
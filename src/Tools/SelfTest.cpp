@@ -0,0 +1,11 @@
+#include "Common.h"
+#include "misc/SelfTest.h"
+#include <filesystem>
+
+// Usage: pvz-selftest [scratch dir]
+// Runs Sexy::RunSelfTests without starting the game; exits with 1 if any check failed.
+int main(int argc, char** argv)
+{
+	std::string aTempDir = argc > 1 ? argv[1] : Sexy::PathToU8(std::filesystem::temp_directory_path() / "pvz-selftest");
+	return Sexy::RunSelfTests(aTempDir) == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "ToolApp.h"
+#include "LawnApp.h"
+#include "Resources.h"
+#include "Lawn/System/PlayerInfo.h"
+#include "Lawn/System/ProfileMgr.h"
+#include "Sexy.TodLib/TodStringFile.h"
+#include <algorithm>
+#include <filesystem>
+using namespace Sexy;
+
+// main.cpp is not linked into the tools, so the globals it owns are defined here
+bool (*gAppCloseRequest)();
+bool (*gAppHasUsedCheatKeys)();
+std::string (*gGetCurrentLevelName)();
+
+static std::vector<std::string> gToolArgsStorage;
+static std::vector<char*> gToolArgv;
+
+LawnApp* ToolStartApp(const std::vector<std::string>& theArgs)
+{
+	// SexyAppBase keeps the argv pointers, so the strings live until the app is gone
+	gToolArgsStorage.assign(1, "pvz-tool");
+	gToolArgsStorage.insert(gToolArgsStorage.end(), theArgs.begin(), theArgs.end());
+	if (std::none_of(theArgs.begin(), theArgs.end(), [](const std::string& anArg) { return anArg.rfind("-savedir", 0) == 0; }))
+		gToolArgsStorage.push_back("-savedir=" + PathToU8(std::filesystem::temp_directory_path() / "pvz-tools"));
+	gToolArgv.clear();
+	for (std::string& anArg : gToolArgsStorage)
+		gToolArgv.push_back(anArg.data());
+
+	TodStringListSetColors(gLawnStringFormats, gLawnStringFormatCount);
+	gGetCurrentLevelName = LawnGetCurrentLevelName;
+	gAppCloseRequest = LawnGetCloseRequest;
+	gAppHasUsedCheatKeys = LawnHasUsedCheatKeys;
+	gExtractResourcesByName = Sexy::ExtractResourcesByName;
+	gLawnApp = new LawnApp();
+	gLawnApp->SetArgs(static_cast<int>(gToolArgv.size()), gToolArgv.data());
+	gLawnApp->Init();
+	if (gLawnApp->mEffectSystem == nullptr)  // Init stops early if the resources could not be read
+	{
+		delete gLawnApp;
+		gLawnApp = nullptr;
+		return nullptr;
+	}
+
+	gLawnApp->mLoadingThreadStarted = true;
+	gLawnApp->LoadingThreadProc();
+	gLawnApp->mLoadingThreadCompleted = true;
+	// LoadingThreadProc records the task costs only once every stage has succeeded
+	if (gLawnApp->mLoadingFailed || gLawnApp->mLoadingTaskCosts.empty())
+	{
+		ToolShutdownApp();
+		return nullptr;
+	}
+
+	if (gLawnApp->mPlayerInfo == nullptr)
+		gLawnApp->mPlayerInfo = gLawnApp->mProfileMgr->AddProfile("tool");
+	return gLawnApp;
+}
+
+void ToolShutdownApp()
+{
+	if (gLawnApp->mBoard)
+	{
+		gLawnApp->mBoardResult = BoardResult::BOARDRESULT_NONE;  // the tools' boards are never saved
+		gLawnApp->KillBoard();
+	}
+	gLawnApp->Shutdown();
+	delete gLawnApp;
+	gLawnApp = nullptr;
+}
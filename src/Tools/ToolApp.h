@@ -0,0 +1,15 @@
+#ifndef __TOOLAPP_H__
+#define __TOOLAPP_H__
+
+#include <string>
+#include <vector>
+
+class LawnApp;
+
+// Brings the game up the way main() does, but runs the loading stages on the calling thread and never enters
+// the main loop. theArgs are game command line options; saves and settings go to a scratch folder unless they
+// give -savedir. Needs the game data (see -resdir) and a display. Returns nullptr if loading failed.
+LawnApp*				ToolStartApp(const std::vector<std::string>& theArgs);
+void					ToolShutdownApp();
+
+#endif //__TOOLAPP_H__